@@ -0,0 +1,300 @@
+/*
+ * One scenario catalog, run against hsm, cthsm, Boost.SML and TinyFSM.
+ *
+ * For every scenario a library can express, reports throughput, the
+ * p50/p90/p99/p99.9 latency of single dispatches, instructions and cache
+ * misses per dispatch (perf_event_open, when the kernel allows it) and the
+ * heap the machine allocated, and writes <library>_benchmark_results.json
+ * and .csv.
+ *
+ * With --baseline, runs each scenario --runs times (5 unless given) and
+ * compares the throughput against the results file of its library: the
+ * change of the median with a bootstrap 95% interval, a Mann-Whitney test
+ * when the baseline holds at least five runs, and exit status 1 if any
+ * scenario is significantly slower by more than --threshold percent.
+ * Scenarios with fewer baseline runs are reported but not judged. The results
+ * files are then only written with an explicit --output-dir, so the
+ * baseline is not overwritten.
+ *
+ * With --contention, runs the multi-producer benchmark of hsm instead (see
+ * contention.hpp) and writes hsm_contention_results.json.
+ *
+ *   benchmark [--iterations N] [--warmup N] [--filter TEXT]
+ *             [--library hsm|cthsm|sml|tinyfsm] [--output-dir DIR]
+ *             [--no-latency] [--runs N] [--baseline FILE]...
+ *             [--threshold PERCENT] [--alpha P]
+ *   benchmark --contention [--producers N] [--instances N]
+ *             [--duration-ms N] [--output-dir DIR]
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "compare.hpp"
+#include "contention.hpp"
+#include "cthsm_scenarios.hpp"
+#include "harness.hpp"
+#include "hsm_scenarios.hpp"
+#include "sml_scenarios.hpp"
+#include "tinyfsm_scenarios.hpp"
+
+// ==========================================
+// Allocation hook
+// ==========================================
+
+// Every allocation carries its size in a header, so frees can be counted in
+// bytes too. Aligned allocations bypass the hook.
+namespace {
+
+constexpr std::size_t kHeader = alignof(std::max_align_t);
+
+void* countedAlloc(std::size_t size) {
+  auto* block = static_cast<unsigned char*>(std::malloc(size + kHeader));
+  if (!block) return nullptr;
+  *reinterpret_cast<std::size_t*>(block) = size;
+  bench::HeapCounters::allocations.fetch_add(1, std::memory_order_relaxed);
+  bench::HeapCounters::allocatedBytes.fetch_add(size,
+                                                std::memory_order_relaxed);
+  return block + kHeader;
+}
+
+void countedFree(void* ptr) noexcept {
+  if (!ptr) return;
+  auto* block = static_cast<unsigned char*>(ptr) - kHeader;
+  bench::HeapCounters::freedBytes.fetch_add(
+      *reinterpret_cast<std::size_t*>(block), std::memory_order_relaxed);
+  std::free(block);
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  if (void* ptr = countedAlloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAlloc(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAlloc(size);
+}
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  countedFree(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  countedFree(ptr);
+}
+
+// ==========================================
+// Main
+// ==========================================
+
+namespace {
+
+constexpr std::string_view kLibraries[] = {"hsm", "cthsm", "sml", "tinyfsm"};
+
+void usage(const char* argv0) {
+  std::cerr << "usage: " << argv0
+            << " [--iterations N] [--warmup N] [--filter TEXT]"
+               " [--library hsm|cthsm|sml|tinyfsm] [--output-dir DIR]"
+               " [--no-latency] [--runs N] [--baseline FILE]..."
+               " [--threshold PERCENT] [--alpha P]\n"
+            << "       " << argv0
+            << " --contention [--producers N] [--instances N]"
+               " [--duration-ms N] [--output-dir DIR]\n";
+}
+
+bool parseOptions(int argc, char** argv, bench::Options& options,
+                  bool& writeResults) {
+  bool runsGiven = false;
+  bool outputGiven = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--no-latency") {
+      options.latency = false;
+    } else if (arg == "--iterations" && hasValue) {
+      options.iterations = std::atoi(argv[++i]);
+    } else if (arg == "--warmup" && hasValue) {
+      options.warmup = std::atoi(argv[++i]);
+    } else if (arg == "--filter" && hasValue) {
+      options.filter = argv[++i];
+    } else if (arg == "--library" && hasValue) {
+      options.library = argv[++i];
+    } else if (arg == "--output-dir" && hasValue) {
+      options.outputDir = argv[++i];
+      outputGiven = true;
+    } else if (arg == "--runs" && hasValue) {
+      options.runs = std::atoi(argv[++i]);
+      runsGiven = true;
+    } else if (arg == "--baseline" && hasValue) {
+      options.baselines.emplace_back(argv[++i]);
+    } else if (arg == "--threshold" && hasValue) {
+      options.thresholdPercent = std::atof(argv[++i]);
+    } else if (arg == "--alpha" && hasValue) {
+      options.alpha = std::atof(argv[++i]);
+    } else if (arg == "--contention") {
+      options.contention = true;
+    } else if (arg == "--producers" && hasValue) {
+      options.producers = std::atoi(argv[++i]);
+    } else if (arg == "--instances" && hasValue) {
+      options.instances = std::atoi(argv[++i]);
+    } else if (arg == "--duration-ms" && hasValue) {
+      options.contentionMs = std::atoi(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  if (!options.baselines.empty() && !runsGiven) options.runs = 5;
+  writeResults = options.baselines.empty() || outputGiven;
+  return options.iterations > 0 && options.warmup >= 0 && options.runs > 0 &&
+         options.thresholdPercent >= 0 && options.alpha > 0 &&
+         options.alpha < 1 && options.producers > 0 &&
+         options.instances > 0 && options.contentionMs > 0;
+}
+
+std::optional<bench::BenchmarkResult> runLibrary(
+    std::string_view library, const bench::Options& options,
+    const bench::Scenario& scenario) {
+  if (library == "hsm") return bench::hsm_scenarios::run(options, scenario);
+  if (library == "cthsm") return bench::cthsm_scenarios::run(options, scenario);
+  if (library == "sml") return bench::sml_scenarios::run(options, scenario);
+  return bench::tinyfsm_scenarios::run(options, scenario);
+}
+
+int runContention(const bench::Options& options) {
+  std::cout << "hsm Multi-Producer Benchmark" << std::endl;
+  std::cout << "============================" << std::endl;
+  std::cout << "1.." << options.producers << " producers dispatching for "
+            << options.contentionMs << " ms, into one instance and into "
+            << options.instances << " (" << std::thread::hardware_concurrency()
+            << " hardware threads)" << std::endl
+            << std::endl;
+  bench::contention::printHeader();
+  const auto results = bench::contention::runAll(
+      options, [](const auto& r) { bench::contention::printResult(r); });
+  std::cout << std::endl;
+  bench::contention::writeResultsToJSON(
+      results, options.outputDir + "/hsm_contention_results.json");
+  std::cout << std::endl;
+  std::cout << "Note: Latency includes waiting for another producer's drain; "
+               "hold times are of the dispatches that drained the queue."
+            << std::endl;
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bench::Options options;
+  bool writeResults = true;
+  if (!parseOptions(argc, argv, options, writeResults)) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (options.contention) return runContention(options);
+
+  std::vector<bench::Baseline> baselines;
+  for (const auto& path : options.baselines) {
+    auto baseline = bench::loadBaseline(path);
+    if (!baseline) {
+      std::cerr << "Cannot read baseline " << path << std::endl;
+      return 2;
+    }
+    std::cout << "Baseline for " << baseline->library << ": " << path
+              << std::endl;
+    baselines.push_back(std::move(*baseline));
+  }
+
+  std::cout << "State Machine Benchmark" << std::endl;
+  std::cout << "=======================" << std::endl;
+  std::cout << options.iterations << " round trips per scenario (after "
+            << options.warmup << " warmup), two dispatches each";
+  if (options.runs > 1) {
+    std::cout << ", median of " << options.runs << " runs";
+  }
+  std::cout << std::endl;
+  if (!bench::PerfCounters().available()) {
+    std::cout << "Hardware counters unavailable (perf_event_open refused)"
+              << std::endl;
+  }
+
+  std::vector<bench::BenchmarkResult> results;
+  for (const auto& scenario : bench::kScenarios) {
+    bool printed = false;
+    for (const auto library : kLibraries) {
+      if (!options.selects(library, scenario)) continue;
+      auto result = runLibrary(library, options, scenario);
+      if (!result) continue;
+      if (!printed) {
+        std::cout << std::endl << scenario.name << std::endl;
+        bench::printHeader();
+        printed = true;
+      }
+      bench::printResult(*result);
+      results.push_back(std::move(*result));
+    }
+  }
+  bench::computeChanges(results);
+
+  std::cout << std::endl;
+  for (const auto library : kLibraries) {
+    if (!writeResults) break;
+    const bool ran =
+        std::any_of(results.begin(), results.end(),
+                    [&](const auto& r) { return r.library == library; });
+    if (!ran) continue;
+    const std::string base =
+        options.outputDir + "/" + std::string(library) + "_benchmark_results";
+    bench::writeResultsToJSON(results, library, base + ".json");
+    bench::writeResultsToCSV(results, library, base + ".csv");
+  }
+
+  std::cout << std::endl;
+  std::cout << "Benchmark completed." << std::endl;
+  std::cout << std::endl;
+  std::cout << "Note: Transitions/sec counts both dispatches of each round "
+               "trip; latency times them one at a time."
+            << std::endl;
+
+  if (baselines.empty()) return 0;
+  const auto comparisons = bench::compare(
+      results, baselines, options.thresholdPercent, options.alpha);
+  std::cout << std::endl;
+  std::cout << "Comparison with baseline (regression: slower by more than "
+            << options.thresholdPercent << "%, alpha " << options.alpha << ")"
+            << std::endl;
+  bench::printComparisons(comparisons);
+  const auto regressions = std::count_if(
+      comparisons.begin(), comparisons.end(), [](const auto& c) {
+        return c.verdict == bench::Verdict::Regressed;
+      });
+  const auto unjudged = std::count_if(
+      comparisons.begin(), comparisons.end(), [](const auto& c) {
+        return c.verdict == bench::Verdict::InsufficientBaseline;
+      });
+  if (unjudged > 0) {
+    std::cout << std::endl
+              << unjudged << " scenario(s) not judged: fewer than "
+              << bench::kMinBaselineSamples
+              << " baseline runs (write the baseline with --runs "
+              << bench::kMinBaselineSamples << " or more)" << std::endl;
+  }
+  if (regressions > 0) {
+    std::cout << std::endl
+              << regressions << " scenario(s) regressed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
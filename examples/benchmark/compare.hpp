@@ -0,0 +1,473 @@
+#pragma once
+
+// Comparison of a run against baseline results files: a small reader for
+// the *_benchmark_results.json layout, the Mann-Whitney U test, bootstrap
+// confidence intervals and the per-scenario verdict.
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "harness.hpp"
+
+namespace bench {
+
+// ==========================================
+// Baseline files
+// ==========================================
+
+// Throughput samples of every scenario of one library, by scenario name.
+// Files written with --runs hold every run; older files hold one number.
+struct Baseline {
+  std::string library;
+  std::string path;
+  std::map<std::string, std::vector<double>, std::less<>> samples;
+};
+
+namespace detail {
+
+// Reads just enough JSON for the results files: objects, arrays, strings
+// without unicode escapes, numbers, true, false and null
+class JsonReader {
+ public:
+  explicit JsonReader(std::string_view text) : text_(text) {}
+
+  // Calls onResult(name, transitionsPerSecond, runs) for each entry of
+  // "results"; false if the text is not a results file
+  template <typename OnResult>
+  bool readResults(std::string& library, OnResult&& onResult) {
+    if (!consume('{')) return false;
+    if (consume('}')) return false;
+    bool sawResults = false;
+    do {
+      std::string key;
+      if (!readString(key) || !consume(':')) return false;
+      if (key == "library") {
+        if (!readString(library)) return false;
+      } else if (key == "results") {
+        if (!readEntries(onResult)) return false;
+        sawResults = true;
+      } else if (!skipValue()) {
+        return false;
+      }
+    } while (consume(','));
+    return consume('}') && sawResults;
+  }
+
+ private:
+  template <typename OnResult>
+  bool readEntries(OnResult& onResult) {
+    if (!consume('[')) return false;
+    if (consume(']')) return true;
+    do {
+      std::string name;
+      std::optional<double> throughput;
+      std::vector<double> runs;
+      if (!consume('{')) return false;
+      if (!consume('}')) {
+        do {
+          std::string key;
+          if (!readString(key) || !consume(':')) return false;
+          if (key == "name") {
+            if (!readString(name)) return false;
+          } else if (key == "transitionsPerSecond") {
+            double value = 0;
+            if (!readNumber(value)) return false;
+            throughput = value;
+          } else if (key == "runs") {
+            if (!readNumbers(runs)) return false;
+          } else if (!skipValue()) {
+            return false;
+          }
+        } while (consume(','));
+        if (!consume('}')) return false;
+      }
+      if (runs.empty() && throughput) runs.push_back(*throughput);
+      if (!name.empty() && !runs.empty()) onResult(name, std::move(runs));
+    } while (consume(','));
+    return consume(']');
+  }
+
+  bool readNumbers(std::vector<double>& out) {
+    if (!consume('[')) return false;
+    if (consume(']')) return true;
+    do {
+      double value = 0;
+      if (!readNumber(value)) return false;
+      out.push_back(value);
+    } while (consume(','));
+    return consume(']');
+  }
+
+  bool readString(std::string& out) {
+    if (!consume('"')) return false;
+    out.clear();
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      char c = text_[pos_++];
+      if (c == '\\') {
+        if (pos_ >= text_.size()) return false;
+        c = text_[pos_++];
+        if (c == 'n') c = '\n';
+        if (c == 't') c = '\t';
+      }
+      out += c;
+    }
+    return pos_++ < text_.size();
+  }
+
+  bool readNumber(double& out) {
+    skipSpace();
+    const std::size_t start = pos_;
+    while (pos_ < text_.size() &&
+           (std::isdigit(static_cast<unsigned char>(text_[pos_])) ||
+            std::string_view("+-.eE").find(text_[pos_]) !=
+                std::string_view::npos)) {
+      ++pos_;
+    }
+    if (pos_ == start) return false;
+    std::istringstream in{std::string(text_.substr(start, pos_ - start))};
+    in.imbue(std::locale::classic());
+    return static_cast<bool>(in >> out);
+  }
+
+  bool skipValue() {
+    skipSpace();
+    if (pos_ >= text_.size()) return false;
+    const char c = text_[pos_];
+    if (c == '"') {
+      std::string ignored;
+      return readString(ignored);
+    }
+    if (c == '{' || c == '[') {
+      const char close = c == '{' ? '}' : ']';
+      ++pos_;
+      if (consume(close)) return true;
+      do {
+        if (c == '{') {
+          std::string key;
+          if (!readString(key) || !consume(':')) return false;
+        }
+        if (!skipValue()) return false;
+      } while (consume(','));
+      return consume(close);
+    }
+    for (const std::string_view word : {"true", "false", "null"}) {
+      if (text_.substr(pos_, word.size()) == word) {
+        pos_ += word.size();
+        return true;
+      }
+    }
+    double ignored = 0;
+    return readNumber(ignored);
+  }
+
+  bool consume(char c) {
+    skipSpace();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  void skipSpace() {
+    while (pos_ < text_.size() &&
+           std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+      ++pos_;
+    }
+  }
+
+  std::string_view text_;
+  std::size_t pos_ = 0;
+};
+
+}  // namespace detail
+
+// The library is the file's "library", else the part of its name before
+// "_benchmark_results" (as in hsm_benchmark_results.json)
+inline std::optional<Baseline> loadBaseline(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) return std::nullopt;
+  std::stringstream text;
+  text << in.rdbuf();
+  const std::string contents = text.str();
+
+  Baseline baseline;
+  baseline.path = path;
+  detail::JsonReader reader(contents);
+  const bool ok = reader.readResults(
+      baseline.library, [&](const std::string& name, std::vector<double> runs) {
+        baseline.samples[name] = std::move(runs);
+      });
+  if (!ok) return std::nullopt;
+  if (baseline.library.empty()) {
+    const std::size_t slash = path.find_last_of("/\\");
+    const std::string file =
+        slash == std::string::npos ? path : path.substr(slash + 1);
+    const std::size_t suffix = file.find("_benchmark_results");
+    if (suffix == std::string::npos) return std::nullopt;
+    baseline.library = file.substr(0, suffix);
+  }
+  return baseline;
+}
+
+// ==========================================
+// Statistics
+// ==========================================
+
+inline double median(std::vector<double> values) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  const std::size_t mid = values.size() / 2;
+  return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+// Two-sided p-value of the Mann-Whitney U test that a and b come from the
+// same distribution. Exact for small samples without ties, the normal
+// approximation with tie correction otherwise.
+inline double mannWhitneyP(const std::vector<double>& a,
+                           const std::vector<double>& b) {
+  const std::size_t n1 = a.size(), n2 = b.size();
+  if (n1 == 0 || n2 == 0) return 1.0;
+
+  // Midranks of the pooled samples
+  std::vector<std::pair<double, bool>> pooled;
+  for (const double v : a) pooled.emplace_back(v, true);
+  for (const double v : b) pooled.emplace_back(v, false);
+  std::sort(pooled.begin(), pooled.end());
+  double rankSumA = 0;
+  double tieTerm = 0;
+  for (std::size_t i = 0; i < pooled.size();) {
+    std::size_t j = i;
+    while (j < pooled.size() && pooled[j].first == pooled[i].first) ++j;
+    const double rank = static_cast<double>(i + j + 1) / 2.0;
+    const auto t = static_cast<double>(j - i);
+    tieTerm += t * t * t - t;
+    for (std::size_t k = i; k < j; ++k) {
+      if (pooled[k].second) rankSumA += rank;
+    }
+    i = j;
+  }
+  const double u =
+      rankSumA - static_cast<double>(n1) * static_cast<double>(n1 + 1) / 2.0;
+  const double meanU = static_cast<double>(n1) * static_cast<double>(n2) / 2.0;
+
+  if (tieTerm == 0 && n1 + n2 <= 40) {
+    // counts[i][j][k]: orderings of i values of a and j of b with U = k
+    const std::size_t maxU = n1 * n2;
+    std::vector<std::vector<std::vector<double>>> counts(
+        n1 + 1, std::vector<std::vector<double>>(
+                    n2 + 1, std::vector<double>(maxU + 1, 0.0)));
+    for (std::size_t i = 0; i <= n1; ++i) {
+      for (std::size_t j = 0; j <= n2; ++j) {
+        for (std::size_t k = 0; k <= i * j; ++k) {
+          if (i == 0 || j == 0) {
+            counts[i][j][k] = k == 0 ? 1.0 : 0.0;
+            continue;
+          }
+          // The largest value is from a (adds j to U) or from b
+          const double fromA = k >= j ? counts[i - 1][j][k - j] : 0.0;
+          const double fromB = k <= (i * (j - 1)) ? counts[i][j - 1][k] : 0.0;
+          counts[i][j][k] = fromA + fromB;
+        }
+      }
+    }
+    double total = 0, below = 0, above = 0;
+    const auto observed = static_cast<std::size_t>(std::llround(u));
+    for (std::size_t k = 0; k <= maxU; ++k) {
+      total += counts[n1][n2][k];
+      if (k <= observed) below += counts[n1][n2][k];
+      if (k >= observed) above += counts[n1][n2][k];
+    }
+    return std::min(1.0, 2.0 * std::min(below, above) / total);
+  }
+
+  const double n = static_cast<double>(n1 + n2);
+  const double variance = static_cast<double>(n1) * static_cast<double>(n2) /
+                          12.0 * ((n + 1.0) - tieTerm / (n * (n - 1.0)));
+  if (variance <= 0) return 1.0;
+  // Continuity correction towards the mean
+  const double z =
+      std::max(0.0, std::abs(u - meanU) - 0.5) / std::sqrt(variance);
+  return std::erfc(z / std::sqrt(2.0));
+}
+
+struct Interval {
+  double low = 0;
+  double high = 0;
+};
+
+// 95% percentile-bootstrap interval of median(current) / median(baseline)
+// - 1, resampling both sides
+inline Interval bootstrapChange(const std::vector<double>& current,
+                                const std::vector<double>& baseline,
+                                int resamples = 10000) {
+  std::mt19937_64 rng(0x5eed);
+  const auto resample = [&](const std::vector<double>& values) {
+    std::uniform_int_distribution<std::size_t> pick(0, values.size() - 1);
+    std::vector<double> out(values.size());
+    for (auto& v : out) v = values[pick(rng)];
+    return median(std::move(out));
+  };
+  std::vector<double> changes;
+  changes.reserve(static_cast<std::size_t>(resamples));
+  for (int i = 0; i < resamples; ++i) {
+    const double base = resample(baseline);
+    if (base > 0) changes.push_back(resample(current) / base - 1.0);
+  }
+  if (changes.empty()) return {};
+  std::sort(changes.begin(), changes.end());
+  const auto at = [&](double q) {
+    const auto index = static_cast<std::size_t>(
+        q * static_cast<double>(changes.size() - 1));
+    return changes[index];
+  };
+  return {at(0.025), at(0.975)};
+}
+
+// ==========================================
+// Verdicts
+// ==========================================
+
+enum class Verdict {
+  NoBaseline,
+  InsufficientBaseline,
+  Unchanged,
+  Improved,
+  Regressed,
+};
+
+// Baseline runs a scenario needs before its change can be called
+// significant. A single value says nothing about the baseline's noise, and
+// with five runs on each side the Mann-Whitney test can reach p < 0.01.
+constexpr std::size_t kMinBaselineSamples = 5;
+
+inline std::string_view verdictName(Verdict verdict) {
+  switch (verdict) {
+    case Verdict::NoBaseline:
+      return "no baseline";
+    case Verdict::InsufficientBaseline:
+      return "insufficient baseline samples";
+    case Verdict::Unchanged:
+      return "unchanged";
+    case Verdict::Improved:
+      return "faster";
+    case Verdict::Regressed:
+      return "REGRESSED";
+  }
+  return "";
+}
+
+struct Comparison {
+  std::string library;
+  std::string name;
+  double baseline = 0;
+  double current = 0;
+  // Of the median throughput, as fractions
+  double change = 0;
+  Interval interval;
+  // Mann-Whitney p-value; only when the baseline has enough runs
+  std::optional<double> p;
+  Verdict verdict = Verdict::NoBaseline;
+};
+
+// Compares the throughput of each result against the baseline of its
+// library. A change is significant when the Mann-Whitney p-value is below
+// alpha, and a regression when it is also slower by more than threshold
+// percent. A baseline with fewer than kMinBaselineSamples runs of the
+// scenario gets no verdict; its change and bootstrap interval are still
+// reported.
+inline std::vector<Comparison> compare(
+    const std::vector<BenchmarkResult>& results,
+    const std::vector<Baseline>& baselines, double thresholdPercent,
+    double alpha) {
+  std::vector<Comparison> out;
+  for (const auto& result : results) {
+    Comparison c;
+    c.library = result.library;
+    c.name = result.name;
+    c.current = median(result.runs);
+    const auto baseline = std::find_if(
+        baselines.begin(), baselines.end(),
+        [&](const Baseline& b) { return b.library == result.library; });
+    if (baseline == baselines.end()) continue;
+    auto samples = baseline->samples.find(result.name);
+    if (samples == baseline->samples.end() && !result.previousName.empty()) {
+      samples = baseline->samples.find(result.previousName);
+    }
+    if (samples == baseline->samples.end()) {
+      out.push_back(std::move(c));
+      continue;
+    }
+    const std::vector<double>& base = samples->second;
+    c.baseline = median(base);
+    c.change = c.baseline > 0 ? c.current / c.baseline - 1.0 : 0.0;
+    c.interval = bootstrapChange(result.runs, base);
+    if (base.size() < kMinBaselineSamples) {
+      c.verdict = Verdict::InsufficientBaseline;
+      out.push_back(std::move(c));
+      continue;
+    }
+    c.p = mannWhitneyP(result.runs, base);
+    const bool significant = *c.p < alpha;
+    const double threshold = thresholdPercent / 100.0;
+    if (significant && c.change < -threshold) {
+      c.verdict = Verdict::Regressed;
+    } else if (significant && c.change > threshold) {
+      c.verdict = Verdict::Improved;
+    } else {
+      c.verdict = Verdict::Unchanged;
+    }
+    out.push_back(std::move(c));
+  }
+  return out;
+}
+
+inline void printComparisons(const std::vector<Comparison>& comparisons) {
+  std::cout << std::left << std::setw(10) << "Library" << std::setw(66)
+            << "Scenario" << std::right << std::setw(14) << "baseline"
+            << std::setw(14) << "current" << std::setw(9) << "change"
+            << std::setw(20) << "95% CI" << std::setw(9) << "p" << "  "
+            << "verdict" << std::endl;
+  for (const auto& c : comparisons) {
+    std::cout << std::left << std::setw(10) << c.library << std::setw(66)
+              << c.name << std::right << std::fixed << std::setprecision(0);
+    if (c.verdict == Verdict::NoBaseline) {
+      std::cout << std::setw(14) << "-" << std::setw(14) << c.current
+                << std::setw(9) << "-" << std::setw(20) << "-" << std::setw(9)
+                << "-";
+    } else {
+      std::ostringstream interval;
+      interval << std::fixed << std::setprecision(1) << std::showpos << "["
+               << c.interval.low * 100 << ", " << c.interval.high * 100
+               << "]";
+      std::ostringstream change;
+      change << std::fixed << std::setprecision(1) << std::showpos
+             << c.change * 100 << "%";
+      std::cout << std::setw(14) << c.baseline << std::setw(14) << c.current
+                << std::setw(9) << change.str() << std::setw(20)
+                << interval.str() << std::setw(9);
+      if (c.p) {
+        std::cout << std::setprecision(4) << *c.p;
+      } else {
+        std::cout << "-";
+      }
+    }
+    std::cout << "  " << verdictName(c.verdict) << std::endl;
+  }
+}
+
+}  // namespace bench
@@ -0,0 +1,332 @@
+#pragma once
+
+// Several producer threads dispatching into hsm at once, against one
+// instance and against a pool of instances.
+//
+// hsm::dispatch queues the event, and the producer whose try_lock wins the
+// processing mutex drains the queue, events of the other producers
+// included, while they wait for the unlock. The producer whose dispatch ran
+// behaviors is the one that held the lock, so the duration of its dispatch
+// is the lock hold time and the events it ran are the batch it drained for
+// the others.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "harness.hpp"
+#include "hsm.hpp"
+
+namespace bench::contention {
+
+// Behaviors run by the calling thread; a dispatch that ran any held the lock
+inline thread_local std::uint64_t t_ran = 0;
+
+struct Instance : hsm::Instance {
+  // Events that reached a state, whichever thread ran them
+  std::atomic<std::uint64_t> delivered{0};
+};
+
+inline void deliver(hsm::Context&, hsm::Instance& instance, hsm::Event&) {
+  static_cast<Instance&>(instance).delivered.fetch_add(
+      1, std::memory_order_relaxed);
+  ++t_ran;
+  tick();
+}
+
+// Two children of one parent; every event moves to the other one
+inline std::unique_ptr<hsm::Model> toggle() {
+  return hsm::define(
+      "Toggle",
+      hsm::state("parent",
+                 hsm::state("child1", hsm::entry(deliver)),
+                 hsm::state("child2", hsm::entry(deliver)),
+                 hsm::initial(hsm::target("child1")),
+                 hsm::transition(hsm::on("next"), hsm::source("child1"),
+                                 hsm::target("child2")),
+                 hsm::transition(hsm::on("next"), hsm::source("child2"),
+                                 hsm::target("child1"))),
+      hsm::initial(hsm::target("parent")));
+}
+
+class Machine {
+ public:
+  Machine() : model_(toggle()) {
+    hsm::start(instance_, model_);
+    // start() allocates the HSM and leaves it to the instance. Its own
+    // destructor is private, so it is owned through Instance, whose
+    // destructor is public and virtual.
+    hsm_.reset(instance_.__hsm);
+    // Not counting the initial entry
+    instance_.delivered = 0;
+  }
+
+  ~Machine() {
+    hsm::stop(instance_).wait();
+    hsm_.reset();
+    instance_.__hsm = nullptr;
+  }
+
+  Machine(const Machine&) = delete;
+  Machine& operator=(const Machine&) = delete;
+
+  // As a producer would: dispatch, then wait for the queue to be drained
+  void dispatch(const hsm::Event& event) { instance_.dispatch(event).wait(); }
+
+  std::uint64_t delivered() const {
+    return instance_.delivered.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::unique_ptr<hsm::Model> model_;
+  Instance instance_;
+  std::unique_ptr<hsm::Instance> hsm_;
+};
+
+struct ContentionResult {
+  std::string mode;
+  int producers = 0;
+  int instances = 0;
+  double seconds = 0;
+  // Dispatch calls made, and events that ran by the end of the run
+  std::uint64_t dispatches = 0;
+  std::uint64_t delivered = 0;
+  // Events still queued when the producers stopped, which only the next
+  // dispatch runs, and events the full queue refused
+  std::uint64_t stranded = 0;
+  std::uint64_t dropped = 0;
+  double eventsPerSecond = 0;
+  // Jain's index of the dispatches of each producer (1 is perfectly fair),
+  // and the least and most of them relative to the mean
+  double fairness = 1;
+  double minShare = 1;
+  double maxShare = 1;
+  // Of whole dispatch calls, including the wait for the drain
+  Percentiles latencyNs;
+  // Of the dispatch calls that drained the queue
+  Percentiles holdNs;
+  std::uint64_t holds = 0;
+  double eventsPerHold = 0;
+};
+
+struct Producer {
+  std::uint64_t dispatches = 0;
+  std::vector<std::uint64_t> latencyNs;
+  std::vector<std::uint64_t> holdNs;
+  std::uint64_t heldEvents = 0;
+};
+
+// `producers` threads dispatch for options.contentionMs, producer p to
+// instances p, p + 1, ... in turn
+inline ContentionResult runContention(const Options& options,
+                                      std::string mode, int producers,
+                                      int instances) {
+  std::vector<std::unique_ptr<Machine>> machines;
+  for (int i = 0; i < instances; ++i) {
+    machines.push_back(std::make_unique<Machine>());
+  }
+  std::vector<Producer> results(static_cast<std::size_t>(producers));
+  for (auto& producer : results) {
+    producer.latencyNs.reserve(1 << 16);
+    producer.holdNs.reserve(1 << 14);
+  }
+
+  const auto duration = std::chrono::milliseconds(options.contentionMs);
+  std::latch ready(producers + 1);
+  std::atomic<bool> go{false};
+  std::vector<std::jthread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      Producer& self = results[static_cast<std::size_t>(p)];
+      hsm::Event event("next");
+      std::size_t target = static_cast<std::size_t>(p % instances);
+      ready.arrive_and_wait();
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      const auto end = std::chrono::steady_clock::now() + duration;
+      for (auto now = std::chrono::steady_clock::now(); now < end;) {
+        const std::uint64_t ran = t_ran;
+        machines[target]->dispatch(event);
+        const auto after = std::chrono::steady_clock::now();
+        const auto ns = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(after - now)
+                .count());
+        self.latencyNs.push_back(ns);
+        if (t_ran != ran) {
+          self.holdNs.push_back(ns);
+          self.heldEvents += t_ran - ran;
+        }
+        ++self.dispatches;
+        target = (target + 1) % machines.size();
+        now = after;
+      }
+    });
+  }
+  ready.arrive_and_wait();
+  const auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  threads.clear();
+  const auto stop = std::chrono::steady_clock::now();
+
+  ContentionResult result;
+  result.mode = std::move(mode);
+  result.producers = producers;
+  result.instances = instances;
+  result.seconds = std::chrono::duration<double>(stop - start).count();
+  for (const auto& machine : machines) result.delivered += machine->delivered();
+  // One more event runs whatever the last drain left behind
+  const hsm::Event flush("next");
+  for (auto& machine : machines) machine->dispatch(flush);
+  std::uint64_t flushed = 0;
+  for (const auto& machine : machines) flushed += machine->delivered();
+  result.stranded = flushed - result.delivered - machines.size();
+
+  std::vector<std::uint64_t> latency;
+  std::vector<std::uint64_t> hold;
+  std::uint64_t heldEvents = 0;
+  double sum = 0;
+  double sumSquares = 0;
+  for (const auto& producer : results) {
+    result.dispatches += producer.dispatches;
+    latency.insert(latency.end(), producer.latencyNs.begin(),
+                   producer.latencyNs.end());
+    hold.insert(hold.end(), producer.holdNs.begin(), producer.holdNs.end());
+    heldEvents += producer.heldEvents;
+    const auto n = static_cast<double>(producer.dispatches);
+    sum += n;
+    sumSquares += n * n;
+  }
+  const std::uint64_t accounted = result.delivered + result.stranded;
+  result.dropped =
+      result.dispatches > accounted ? result.dispatches - accounted : 0;
+  result.eventsPerSecond =
+      result.seconds > 0 ? static_cast<double>(result.delivered) /
+                               result.seconds
+                         : 0;
+  if (sumSquares > 0) {
+    result.fairness = sum * sum / (static_cast<double>(producers) * sumSquares);
+    const double mean = sum / static_cast<double>(producers);
+    const auto [least, most] = std::minmax_element(
+        results.begin(), results.end(), [](const auto& a, const auto& b) {
+          return a.dispatches < b.dispatches;
+        });
+    result.minShare = static_cast<double>(least->dispatches) / mean;
+    result.maxShare = static_cast<double>(most->dispatches) / mean;
+  }
+  result.holds = hold.size();
+  result.eventsPerHold =
+      hold.empty() ? 0
+                   : static_cast<double>(heldEvents) /
+                         static_cast<double>(hold.size());
+  result.latencyNs = percentiles(latency);
+  result.holdNs = percentiles(hold);
+  return result;
+}
+
+// 1, 2, 4, ... producers up to options.producers, against one instance and
+// against options.instances of them; report() sees each result as it ends
+template <typename Report>
+std::vector<ContentionResult> runAll(const Options& options, Report&& report) {
+  std::vector<int> counts;
+  for (int n = 1; n < options.producers; n *= 2) counts.push_back(n);
+  counts.push_back(options.producers);
+
+  std::vector<ContentionResult> results;
+  for (const int producers : counts) {
+    results.push_back(
+        runContention(options, "single instance", producers, 1));
+    report(results.back());
+  }
+  for (const int producers : counts) {
+    results.push_back(runContention(options, "instance pool", producers,
+                                    options.instances));
+    report(results.back());
+  }
+  return results;
+}
+
+inline void printHeader() {
+  std::cout << std::left << std::setw(17) << "Mode" << std::right
+            << std::setw(10) << "producers" << std::setw(10) << "instances"
+            << std::setw(14) << "events/sec" << std::setw(9) << "fairness"
+            << std::setw(13) << "min/max" << std::setw(10) << "p50 ns"
+            << std::setw(10) << "p99 ns" << std::setw(12) << "hold p50"
+            << std::setw(12) << "hold p99" << std::setw(11) << "ev/hold"
+            << std::setw(10) << "stranded" << std::setw(9) << "dropped"
+            << std::endl;
+}
+
+inline void printResult(const ContentionResult& r) {
+  std::ostringstream shares;
+  shares << std::fixed << std::setprecision(2) << r.minShare << "/"
+         << r.maxShare;
+  std::cout << std::left << std::setw(17) << r.mode << std::right
+            << std::setw(10) << r.producers << std::setw(10) << r.instances
+            << std::fixed << std::setprecision(0) << std::setw(14)
+            << r.eventsPerSecond << std::setprecision(3) << std::setw(9)
+            << r.fairness << std::setw(13) << shares.str()
+            << std::setprecision(0) << std::setw(10) << r.latencyNs.p50
+            << std::setw(10) << r.latencyNs.p99 << std::setw(12)
+            << r.holdNs.p50 << std::setw(12) << r.holdNs.p99
+            << std::setprecision(2) << std::setw(11) << r.eventsPerHold
+            << std::setw(10) << r.stranded << std::setw(9) << r.dropped
+            << std::endl;
+}
+
+inline void writeResultsToJSON(const std::vector<ContentionResult>& results,
+                               const std::string& filename) {
+  std::ofstream json(filename);
+  const auto writePercentiles = [&](const Percentiles& p) {
+    json << "{\"p50\": " << p.p50 << ", \"p90\": " << p.p90
+         << ", \"p99\": " << p.p99 << ", \"p99.9\": " << p.p999 << "}";
+  };
+  json << "{\n";
+  json << "  \"timestamp\": \""
+       << std::chrono::system_clock::now().time_since_epoch().count()
+       << "\",\n";
+  json << "  \"library\": \"hsm\",\n";
+  json << "  \"hardwareThreads\": " << std::thread::hardware_concurrency()
+       << ",\n";
+  json << "  \"results\": [\n";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const auto& r = results[i];
+    json << "    {\n";
+    json << "      \"mode\": \"" << jsonEscape(r.mode) << "\",\n";
+    json << "      \"producers\": " << r.producers << ",\n";
+    json << "      \"instances\": " << r.instances << ",\n";
+    json << "      \"seconds\": " << r.seconds << ",\n";
+    json << "      \"dispatches\": " << r.dispatches << ",\n";
+    json << "      \"delivered\": " << r.delivered << ",\n";
+    json << "      \"stranded\": " << r.stranded << ",\n";
+    json << "      \"dropped\": " << r.dropped << ",\n";
+    json << "      \"eventsPerSecond\": " << r.eventsPerSecond << ",\n";
+    json << "      \"fairness\": " << r.fairness << ",\n";
+    json << "      \"minShare\": " << r.minShare << ",\n";
+    json << "      \"maxShare\": " << r.maxShare << ",\n";
+    json << "      \"latencyNs\": ";
+    writePercentiles(r.latencyNs);
+    json << ",\n";
+    json << "      \"holdNs\": ";
+    writePercentiles(r.holdNs);
+    json << ",\n";
+    json << "      \"holds\": " << r.holds << ",\n";
+    json << "      \"eventsPerHold\": " << r.eventsPerHold << "\n";
+    json << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  json << "  ]\n";
+  json << "}\n";
+  std::cout << "Results written to " << filename << std::endl;
+}
+
+}  // namespace bench::contention
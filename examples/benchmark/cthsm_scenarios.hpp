@@ -0,0 +1,200 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <thread>
+
+#include "cthsm/cthsm.hpp"
+#include "cthsm/thread_pool.hpp"
+#include "harness.hpp"
+
+namespace bench::cthsm_scenarios {
+
+using namespace cthsm;
+
+struct BenchInstance : Instance {};
+
+inline constexpr auto noBehavior = [] { tick(); };
+inline constexpr auto activityBehavior = [](Context& ctx, BenchInstance&,
+                                            const EventBase&) {
+  if (!ctx.is_set()) std::this_thread::yield();
+};
+inline constexpr auto workActivity = [](Context& ctx, BenchInstance&,
+                                        const EventBase&) {
+  workFor50us([&] { return ctx.is_set(); });
+};
+
+template <auto Model, typename TaskProvider = SequentialTaskProvider>
+class Machine {
+ public:
+  Machine(std::string_view first, std::string_view second)
+      : first_(first), second_(second) {
+    sm_.start(instance_);
+  }
+
+  void first() { sm_.dispatch(instance_, first_); }
+  void second() { sm_.dispatch(instance_, second_); }
+
+ private:
+  BenchInstance instance_;
+  compile<Model, BenchInstance, TaskProvider> sm_;
+  EventBase first_;
+  EventBase second_;
+};
+
+constexpr auto nested =
+    define("Nested",
+           state("parent", state("child1"), state("child2"),
+                 initial(target("/Nested/parent/child1")),
+                 transition(on("toChild2"), source("/Nested/parent/child1"),
+                            target("/Nested/parent/child2")),
+                 transition(on("toChild1"), source("/Nested/parent/child2"),
+                            target("/Nested/parent/child1"))),
+           initial(target("/Nested/parent")));
+
+constexpr auto nestedEntry = define(
+    "Nested",
+    state("parent", entry(noBehavior), state("child1", entry(noBehavior)),
+          state("child2", entry(noBehavior)),
+          initial(target("/Nested/parent/child1")),
+          transition(on("toChild2"), source("/Nested/parent/child1"),
+                     target("/Nested/parent/child2")),
+          transition(on("toChild1"), source("/Nested/parent/child2"),
+                     target("/Nested/parent/child1"))),
+    initial(target("/Nested/parent")));
+
+constexpr auto nestedEntryActivity =
+    define("Nested",
+           state("parent", entry(noBehavior), activity(activityBehavior),
+                 state("child1", entry(noBehavior), activity(activityBehavior)),
+                 state("child2", entry(noBehavior), activity(activityBehavior)),
+                 initial(target("/Nested/parent/child1")),
+                 transition(on("toChild2"), source("/Nested/parent/child1"),
+                            target("/Nested/parent/child2")),
+                 transition(on("toChild1"), source("/Nested/parent/child2"),
+                            target("/Nested/parent/child1"))),
+           initial(target("/Nested/parent")));
+
+constexpr auto nestedEntryExitActivity =
+    define("Nested",
+           state("parent", entry(noBehavior), exit(noBehavior),
+                 activity(activityBehavior),
+                 state("child1", entry(noBehavior), exit(noBehavior),
+                       activity(activityBehavior)),
+                 state("child2", entry(noBehavior), exit(noBehavior),
+                       activity(activityBehavior)),
+                 initial(target("/Nested/parent/child1")),
+                 transition(on("toChild2"), source("/Nested/parent/child1"),
+                            target("/Nested/parent/child2")),
+                 transition(on("toChild1"), source("/Nested/parent/child2"),
+                            target("/Nested/parent/child1"))),
+           initial(target("/Nested/parent")));
+
+constexpr auto nestedWithEffect = define(
+    "Nested",
+    state("parent", entry(noBehavior), exit(noBehavior),
+          activity(activityBehavior),
+          state("child1", entry(noBehavior), exit(noBehavior),
+                activity(activityBehavior)),
+          state("child2", entry(noBehavior), exit(noBehavior),
+                activity(activityBehavior)),
+          initial(target("/Nested/parent/child1")),
+          transition(on("toChild2"), source("/Nested/parent/child1"),
+                     target("/Nested/parent/child2"), effect(noBehavior)),
+          transition(on("toChild1"), source("/Nested/parent/child2"),
+                     target("/Nested/parent/child1"), effect(noBehavior))),
+    initial(target("/Nested/parent")));
+
+constexpr auto deepNesting = define(
+    "Deep",
+    state("level1", entry(noBehavior), exit(noBehavior),
+          state("level2", entry(noBehavior), exit(noBehavior),
+                state("level3a", entry(noBehavior), exit(noBehavior)),
+                state("level3b", entry(noBehavior), exit(noBehavior)),
+                initial(target("/Deep/level1/level2/level3a")),
+                transition(on("toLevel3b"),
+                           source("/Deep/level1/level2/level3a"),
+                           target("/Deep/level1/level2/level3b")),
+                transition(on("toLevel3a"),
+                           source("/Deep/level1/level2/level3b"),
+                           target("/Deep/level1/level2/level3a"))),
+          initial(target("/Deep/level1/level2"))),
+    initial(target("/Deep/level1")));
+
+constexpr auto crossHierarchy =
+    define("Cross",
+           state("parent1", entry(noBehavior), exit(noBehavior),
+                 state("child1", entry(noBehavior), exit(noBehavior)),
+                 initial(target("/Cross/parent1/child1"))),
+           state("parent2", entry(noBehavior), exit(noBehavior),
+                 state("child2", entry(noBehavior), exit(noBehavior)),
+                 initial(target("/Cross/parent2/child2"))),
+           transition(on("toParent2"), source("/Cross/parent1"),
+                      target("/Cross/parent2")),
+           transition(on("toParent1"), source("/Cross/parent2"),
+                      target("/Cross/parent1")),
+           initial(target("/Cross/parent1")));
+
+constexpr auto invalidEvents = define(
+    "Invalid",
+    state("level1",
+          state("level2",
+                state("level3", transition(on("validEvent"),
+                                           target("/Invalid/level1/level2/level3"))),
+                initial(target("/Invalid/level1/level2/level3"))),
+          initial(target("/Invalid/level1/level2"))),
+    initial(target("/Invalid/level1")));
+
+constexpr auto activityWork =
+    define("Work",
+           state("parent", state("child1", activity(workActivity)),
+                 state("child2", activity(workActivity)),
+                 initial(target("/Work/parent/child1")),
+                 transition(on("toChild2"), source("/Work/parent/child1"),
+                            target("/Work/parent/child2")),
+                 transition(on("toChild1"), source("/Work/parent/child2"),
+                            target("/Work/parent/child1"))),
+           initial(target("/Work/parent")));
+
+using PoolProvider = ThreadPoolTaskProvider<2, 8>;
+
+template <auto Model, typename TaskProvider = SequentialTaskProvider>
+BenchmarkResult bench(const Options& options, const Scenario& scenario,
+                      std::string_view first, std::string_view second) {
+  return runScenario(options, "cthsm", scenario, [&] {
+    return std::make_unique<Machine<Model, TaskProvider>>(first, second);
+  });
+}
+
+// The result of the scenario, or nothing if cthsm has no equivalent
+inline std::optional<BenchmarkResult> run(const Options& options,
+                                          const Scenario& scenario) {
+  const auto& o = options;
+  const auto& s = scenario;
+  switch (scenario.id) {
+    case ScenarioId::Nested:
+      return bench<nested>(o, s, "toChild2", "toChild1");
+    case ScenarioId::NestedEntry:
+      return bench<nestedEntry>(o, s, "toChild2", "toChild1");
+    case ScenarioId::NestedEntryActivity:
+      return bench<nestedEntryActivity>(o, s, "toChild2", "toChild1");
+    case ScenarioId::NestedEntryExitActivity:
+      return bench<nestedEntryExitActivity>(o, s, "toChild2", "toChild1");
+    case ScenarioId::NestedEntryExitActivityEffect:
+      return bench<nestedWithEffect>(o, s, "toChild2", "toChild1");
+    case ScenarioId::DeepNesting:
+      return bench<deepNesting>(o, s, "toLevel3b", "toLevel3a");
+    case ScenarioId::CrossHierarchy:
+      return bench<crossHierarchy>(o, s, "toParent2", "toParent1");
+    case ScenarioId::InvalidEvents:
+      return bench<invalidEvents>(o, s, "invalidEvent1", "invalidEvent2");
+    case ScenarioId::ActivityWork:
+      return bench<activityWork>(o, s, "toChild2", "toChild1");
+    case ScenarioId::ActivityWorkPool:
+      return bench<activityWork, PoolProvider>(o, s, "toChild2", "toChild1");
+  }
+  return std::nullopt;
+}
+
+}  // namespace bench::cthsm_scenarios
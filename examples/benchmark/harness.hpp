@@ -0,0 +1,544 @@
+#pragma once
+
+// Measurement side of the benchmark: the scenario catalog, per-dispatch
+// latency percentiles, hardware counters, heap counters fed by the
+// allocation hook in benchmark.cpp, and the result files.
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+// Side effect of every behavior, so no library gets its calls optimized away
+inline volatile std::uint64_t g_ticks = 0;
+inline void tick() { g_ticks = g_ticks + 1; }
+
+// ==========================================
+// Scenario catalog
+// ==========================================
+
+enum class ScenarioId {
+  Nested,
+  NestedEntry,
+  NestedEntryActivity,
+  NestedEntryExitActivity,
+  NestedEntryExitActivityEffect,
+  DeepNesting,
+  CrossHierarchy,
+  InvalidEvents,
+  ActivityWork,
+  ActivityWorkPool,
+};
+
+struct Scenario {
+  ScenarioId id;
+  std::string_view name;
+  // Change % is relative to the first scenario of the same group
+  std::string_view group;
+  // Round trips are the --iterations divided by this
+  int divisor = 1;
+  // Name of the scenario in cthsm_benchmark_results.json before the
+  // catalog was shared, so --baseline still finds it there
+  std::string_view previousName = {};
+};
+
+// Every library runs every scenario it can express, in this order. Names
+// match those of hsm_benchmark_results.json.
+inline constexpr Scenario kScenarios[] = {
+    {ScenarioId::Nested, "1. Nested states (no entry/exit/activity)", "1"},
+    {ScenarioId::NestedEntry, "1.a Nested states with entry functions", "1",
+     1, "1.a With entry"},
+    {ScenarioId::NestedEntryActivity,
+     "1.b Nested states with entry and activity functions", "1", 1,
+     "1.b With entry+activity"},
+    {ScenarioId::NestedEntryExitActivity,
+     "1.c Nested states with entry, exit, and activity functions", "1", 1,
+     "1.c With entry+exit+activity"},
+    {ScenarioId::NestedEntryExitActivityEffect,
+     "1.d Nested states with entry, exit, activity, and transition effect",
+     "1", 1, "1.d With entry+exit+activity+effect"},
+    {ScenarioId::DeepNesting, "Deep nesting (3 levels) with entry/exit",
+     "deep", 1, "Deep nesting"},
+    {ScenarioId::CrossHierarchy,
+     "Cross-hierarchy transitions with entry/exit", "cross", 1,
+     "Cross hierarchy"},
+    {ScenarioId::InvalidEvents, "Invalid event handling (graceful failure)",
+     "invalid", 1, "Invalid events"},
+    {ScenarioId::ActivityWork, "2. Activity, 50us of work", "2", 5},
+    {ScenarioId::ActivityWorkPool, "2.a Activity, 50us of work (thread pool)",
+     "2", 5},
+};
+
+// Busy for up to 50us, or until the state is exited
+template <typename Cancelled>
+void workFor50us(Cancelled&& cancelled) {
+  const auto end =
+      std::chrono::steady_clock::now() + std::chrono::microseconds(50);
+  while (!cancelled() && std::chrono::steady_clock::now() < end) {
+  }
+}
+
+// ==========================================
+// Options
+// ==========================================
+
+struct Options {
+  int iterations = 10000;
+  int warmup = 1000;
+  bool latency = true;
+  // Substrings of the scenario names and library names to run; empty runs
+  // all of them
+  std::string filter;
+  std::string library;
+  std::string outputDir = ".";
+  // Measurements of each scenario; the result reports the median run
+  int runs = 1;
+  // Results files to compare against, and what counts as a regression:
+  // slower by more than thresholdPercent, at significance level alpha
+  std::vector<std::string> baselines;
+  double thresholdPercent = 5.0;
+  double alpha = 0.05;
+  // The multi-producer benchmark instead of the scenarios: up to
+  // `producers` threads for contentionMs each, against one instance and
+  // against `instances` of them
+  bool contention = false;
+  int producers = 8;
+  int instances = 16;
+  int contentionMs = 250;
+
+  bool selects(std::string_view lib, const Scenario& scenario) const {
+    if (!library.empty() && lib != library) return false;
+    return filter.empty() ||
+           scenario.name.find(filter) != std::string_view::npos;
+  }
+};
+
+// ==========================================
+// Heap counters
+// ==========================================
+
+// Updated by the replacement operator new/delete in benchmark.cpp, from
+// any thread
+struct HeapCounters {
+  static inline std::atomic<std::uint64_t> allocations{0};
+  static inline std::atomic<std::uint64_t> allocatedBytes{0};
+  static inline std::atomic<std::uint64_t> freedBytes{0};
+};
+
+struct HeapSnapshot {
+  std::uint64_t allocations = 0;
+  std::uint64_t allocatedBytes = 0;
+  std::uint64_t freedBytes = 0;
+
+  static HeapSnapshot now() {
+    return {HeapCounters::allocations.load(std::memory_order_relaxed),
+            HeapCounters::allocatedBytes.load(std::memory_order_relaxed),
+            HeapCounters::freedBytes.load(std::memory_order_relaxed)};
+  }
+
+  std::uint64_t liveSince(const HeapSnapshot& before) const {
+    const std::uint64_t allocated = allocatedBytes - before.allocatedBytes;
+    const std::uint64_t freed = freedBytes - before.freedBytes;
+    return allocated > freed ? allocated - freed : 0;
+  }
+};
+
+// Peak resident set of the whole process, in bytes
+inline std::size_t peakMemoryBytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+// ==========================================
+// Hardware counters
+// ==========================================
+
+// Retired instructions and cache misses of the calling thread, user space
+// only, through perf_event_open. available() is false off Linux, without a
+// PMU (most VMs) or when perf_event_paranoid forbids it.
+class PerfCounters {
+ public:
+  struct Reading {
+    std::uint64_t instructions = 0;
+    std::uint64_t cacheMisses = 0;
+  };
+
+  PerfCounters() {
+#if defined(__linux__)
+    leader_ = open(PERF_COUNT_HW_INSTRUCTIONS, -1);
+    if (leader_ < 0) return;
+    misses_ = open(PERF_COUNT_HW_CACHE_MISSES, leader_);
+    if (misses_ < 0) {
+      close(leader_);
+      leader_ = -1;
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    if (misses_ >= 0) close(misses_);
+    if (leader_ >= 0) close(leader_);
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool available() const { return leader_ >= 0; }
+
+  void start() {
+#if defined(__linux__)
+    if (!available()) return;
+    ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  }
+
+  std::optional<Reading> stop() {
+#if defined(__linux__)
+    if (!available()) return std::nullopt;
+    ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    struct {
+      std::uint64_t count;
+      std::uint64_t values[2];
+    } group{};
+    if (read(leader_, &group, sizeof(group)) != sizeof(group)) {
+      return std::nullopt;
+    }
+    return Reading{group.values[0], group.values[1]};
+#else
+    return std::nullopt;
+#endif
+  }
+
+ private:
+#if defined(__linux__)
+  static int open(std::uint64_t config, int group) {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    // The group starts disabled; start() enables all of it
+    if (group < 0) attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return static_cast<int>(
+        syscall(SYS_perf_event_open, &attr, 0, -1, group, 0UL));
+  }
+#endif
+
+  int leader_ = -1;
+  int misses_ = -1;
+};
+
+// ==========================================
+// Results
+// ==========================================
+
+struct Percentiles {
+  double p50 = 0;
+  double p90 = 0;
+  double p99 = 0;
+  double p999 = 0;
+};
+
+// Nearest-rank percentiles; sorts the samples
+inline Percentiles percentiles(std::vector<std::uint64_t>& samples) {
+  if (samples.empty()) return {};
+  std::sort(samples.begin(), samples.end());
+  const auto at = [&](double q) {
+    const auto rank = static_cast<std::size_t>(
+        std::ceil(q * static_cast<double>(samples.size())));
+    return static_cast<double>(samples[std::max<std::size_t>(rank, 1) - 1]);
+  };
+  return {at(0.50), at(0.90), at(0.99), at(0.999)};
+}
+
+struct BenchmarkResult {
+  std::string library;
+  std::string name;
+  std::string previousName;
+  std::string group;
+  int iterations = 0;
+  double transitionsPerSecond = 0;
+  // Throughput of every run, in the order they ran
+  std::vector<double> runs;
+  double percentChange = 0;
+  // Of single dispatches, in nanoseconds, including one steady_clock read
+  Percentiles latencyNs;
+  std::optional<double> instructionsPerDispatch;
+  std::optional<double> cacheMissesPerDispatch;
+  double allocationsPerDispatch = 0;
+  // Allocated while the machine was built, warmed up and timed, and of
+  // those still live afterwards
+  std::uint64_t heapBytes = 0;
+  std::uint64_t memoryUsedBytes = 0;
+  std::size_t peakMemoryBytes = 0;
+};
+
+// Makes the compiler assume the machine is read and written here, so a
+// dispatch that only moves a state index is not folded across iterations
+inline void clobber(const void* machine) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r"(machine) : "memory");
+#else
+  static_cast<void>(machine);
+#endif
+}
+
+// One run of a library's machine for a scenario. make() builds the
+// machine, which dispatches the two events of a round trip through first()
+// and second(); both are called directly so the compiler sees through them
+// as it would in an application.
+template <typename Make>
+BenchmarkResult measureOnce(const Options& options, std::string_view library,
+                            const Scenario& scenario, Make& make) {
+  BenchmarkResult result;
+  result.library = library;
+  result.name = scenario.name;
+  result.previousName = scenario.previousName;
+  result.group = scenario.group;
+  const int iterations = std::max(1, options.iterations / scenario.divisor);
+  const int warmup = options.warmup / scenario.divisor;
+  result.iterations = iterations;
+
+  const HeapSnapshot before = HeapSnapshot::now();
+  auto machine = make();
+
+  for (int i = 0; i < warmup; ++i) {
+    machine->first();
+    machine->second();
+  }
+
+  // Throughput and counters, with nothing but the dispatches in the loop
+  PerfCounters counters;
+  const HeapSnapshot measured = HeapSnapshot::now();
+  counters.start();
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    machine->first();
+    clobber(machine.get());
+    machine->second();
+    clobber(machine.get());
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const auto reading = counters.stop();
+  const HeapSnapshot after = HeapSnapshot::now();
+  result.heapBytes = after.allocatedBytes - before.allocatedBytes;
+  result.memoryUsedBytes = after.liveSince(before);
+
+  const double dispatches = static_cast<double>(iterations) * 2.0;
+  const double seconds = std::chrono::duration<double>(end - start).count();
+  result.transitionsPerSecond = seconds > 0 ? dispatches / seconds : 0;
+  if (reading) {
+    result.instructionsPerDispatch =
+        static_cast<double>(reading->instructions) / dispatches;
+    result.cacheMissesPerDispatch =
+        static_cast<double>(reading->cacheMisses) / dispatches;
+  }
+  result.allocationsPerDispatch =
+      static_cast<double>(after.allocations - measured.allocations) /
+      dispatches;
+
+  // Latency, timing each dispatch on its own
+  if (options.latency) {
+    std::vector<std::uint64_t> samples;
+    samples.reserve(static_cast<std::size_t>(iterations) * 2);
+    const auto time = [&](auto&& dispatch) {
+      const auto t0 = std::chrono::steady_clock::now();
+      dispatch();
+      const auto t1 = std::chrono::steady_clock::now();
+      samples.push_back(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+              .count()));
+    };
+    for (int i = 0; i < iterations; ++i) {
+      time([&] { machine->first(); });
+      time([&] { machine->second(); });
+    }
+    result.latencyNs = percentiles(samples);
+  }
+
+  result.peakMemoryBytes = peakMemoryBytes();
+  machine.reset();
+  return result;
+}
+
+// Runs the scenario options.runs times on fresh machines and reports the
+// run with the median throughput, with the throughput of all of them
+template <typename Make>
+BenchmarkResult runScenario(const Options& options, std::string_view library,
+                            const Scenario& scenario, Make&& make) {
+  std::vector<BenchmarkResult> runs;
+  std::vector<double> throughputs;
+  for (int i = 0; i < std::max(1, options.runs); ++i) {
+    runs.push_back(measureOnce(options, library, scenario, make));
+    throughputs.push_back(runs.back().transitionsPerSecond);
+  }
+  std::sort(runs.begin(), runs.end(), [](const auto& a, const auto& b) {
+    return a.transitionsPerSecond < b.transitionsPerSecond;
+  });
+  BenchmarkResult result = std::move(runs[runs.size() / 2]);
+  result.runs = std::move(throughputs);
+  return result;
+}
+
+// Fills in percentChange within each library and group
+inline void computeChanges(std::vector<BenchmarkResult>& results) {
+  for (auto& result : results) {
+    const auto first = std::find_if(
+        results.begin(), results.end(), [&](const BenchmarkResult& r) {
+          return r.library == result.library && r.group == result.group;
+        });
+    const double base = first->transitionsPerSecond;
+    result.percentChange =
+        base > 0 ? (result.transitionsPerSecond - base) / base * 100.0 : 0.0;
+  }
+}
+
+// JSON string contents; scenario names are plain ASCII but may hold quotes
+inline std::string jsonEscape(std::string_view text) {
+  std::string out;
+  for (const char c : text) {
+    if (c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+inline void writeOptional(std::ostream& out, const std::optional<double>& v) {
+  if (v) {
+    out << *v;
+  } else {
+    out << "null";
+  }
+}
+
+// The results of one library, in the layout of *_benchmark_results.json
+// with the new measurements added to each entry, and the throughput of
+// every run when there was more than one. Counters the machine could
+// not read are null.
+inline void writeResultsToJSON(const std::vector<BenchmarkResult>& results,
+                               std::string_view library,
+                               const std::string& filename) {
+  std::ofstream json(filename);
+  json << "{\n";
+  json << "  \"timestamp\": \""
+       << std::chrono::system_clock::now().time_since_epoch().count()
+       << "\",\n";
+  json << "  \"library\": \"" << jsonEscape(library) << "\",\n";
+  json << "  \"results\": [\n";
+  bool first = true;
+  for (const auto& result : results) {
+    if (result.library != library) continue;
+    if (!first) json << ",\n";
+    first = false;
+    json << "    {\n";
+    json << "      \"name\": \"" << jsonEscape(result.name) << "\",\n";
+    json << "      \"transitionsPerSecond\": " << result.transitionsPerSecond
+         << ",\n";
+    json << "      \"percentChange\": " << result.percentChange << ",\n";
+    json << "      \"memoryUsedBytes\": " << result.memoryUsedBytes << ",\n";
+    json << "      \"peakMemoryBytes\": " << result.peakMemoryBytes << ",\n";
+    json << "      \"iterations\": " << result.iterations << ",\n";
+    json << "      \"latencyNs\": {\"p50\": " << result.latencyNs.p50
+         << ", \"p90\": " << result.latencyNs.p90
+         << ", \"p99\": " << result.latencyNs.p99
+         << ", \"p99.9\": " << result.latencyNs.p999 << "},\n";
+    json << "      \"instructionsPerDispatch\": ";
+    writeOptional(json, result.instructionsPerDispatch);
+    json << ",\n";
+    json << "      \"cacheMissesPerDispatch\": ";
+    writeOptional(json, result.cacheMissesPerDispatch);
+    json << ",\n";
+    json << "      \"allocationsPerDispatch\": " << result.allocationsPerDispatch
+         << ",\n";
+    json << "      \"heapBytes\": " << result.heapBytes;
+    if (result.runs.size() > 1) {
+      json << ",\n      \"runs\": [";
+      for (std::size_t i = 0; i < result.runs.size(); ++i) {
+        json << (i ? ", " : "") << result.runs[i];
+      }
+      json << "]";
+    }
+    json << "\n    }";
+  }
+  json << "\n  ]\n";
+  json << "}\n";
+  std::cout << "Results written to " << filename << std::endl;
+}
+
+inline void writeResultsToCSV(const std::vector<BenchmarkResult>& results,
+                              std::string_view library,
+                              const std::string& filename) {
+  std::ofstream csv(filename);
+  csv << "Scenario,Transitions/sec,Change %,Memory (KB),Peak Memory "
+         "(KB),Iterations,p50 (ns),p90 (ns),p99 (ns),p99.9 (ns),"
+         "Instructions/dispatch,Cache misses/dispatch,Allocations/dispatch,"
+         "Heap (KB)\n";
+  for (const auto& result : results) {
+    if (result.library != library) continue;
+    csv << "\"" << result.name << "\"," << std::fixed << std::setprecision(0)
+        << result.transitionsPerSecond << "," << std::setprecision(1)
+        << result.percentChange << "," << (result.memoryUsedBytes / 1024)
+        << "," << (result.peakMemoryBytes / 1024) << "," << result.iterations
+        << "," << std::setprecision(0) << result.latencyNs.p50 << ","
+        << result.latencyNs.p90 << "," << result.latencyNs.p99 << ","
+        << result.latencyNs.p999 << "," << std::setprecision(1);
+    if (result.instructionsPerDispatch) csv << *result.instructionsPerDispatch;
+    csv << ",";
+    if (result.cacheMissesPerDispatch) csv << *result.cacheMissesPerDispatch;
+    csv << "," << std::setprecision(2) << result.allocationsPerDispatch << ","
+        << (result.heapBytes / 1024) << "\n";
+  }
+  std::cout << "Results written to " << filename << std::endl;
+}
+
+inline void printHeader() {
+  std::cout << std::left << std::setw(10) << "Library" << std::right
+            << std::setw(14) << "trans/sec" << std::setw(10) << "p50 ns"
+            << std::setw(10) << "p99 ns" << std::setw(10) << "p99.9 ns"
+            << std::setw(10) << "instr" << std::setw(10) << "alloc"
+            << std::setw(12) << "heap KB" << std::endl;
+}
+
+inline void printResult(const BenchmarkResult& result) {
+  std::cout << std::left << std::setw(10) << result.library << std::right
+            << std::fixed << std::setprecision(0) << std::setw(14)
+            << result.transitionsPerSecond << std::setw(10)
+            << result.latencyNs.p50 << std::setw(10) << result.latencyNs.p99
+            << std::setw(10) << result.latencyNs.p999 << std::setw(10);
+  if (result.instructionsPerDispatch) {
+    std::cout << *result.instructionsPerDispatch;
+  } else {
+    std::cout << "-";
+  }
+  std::cout << std::setw(10) << std::setprecision(2)
+            << result.allocationsPerDispatch << std::setw(12)
+            << (result.heapBytes / 1024) << std::endl;
+}
+
+}  // namespace bench
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <thread>
+
+#include "harness.hpp"
+#include "hsm.hpp"
+
+namespace bench::hsm_scenarios {
+
+struct Instance : hsm::Instance {};
+
+inline void noBehavior(hsm::Context&, hsm::Instance&, hsm::Event&) { tick(); }
+
+// Checks the signal once and yields, so rapid transitions don't pile up
+// activity threads
+inline void activityBehavior(hsm::Context& signal, hsm::Instance&,
+                             hsm::Event&) {
+  if (!signal.is_set()) std::this_thread::yield();
+}
+
+inline void workActivity(hsm::Context& signal, hsm::Instance&, hsm::Event&) {
+  workFor50us([&] { return signal.is_set(); });
+}
+
+class Machine {
+ public:
+  Machine(std::unique_ptr<hsm::Model> model, std::string_view first,
+          std::string_view second)
+      : model_(std::move(model)) {
+    first_.name = first;
+    second_.name = second;
+    hsm::start(instance_, model_);
+  }
+
+  ~Machine() {
+    hsm::stop(instance_).wait();
+    // Intentionally leaking the HSM, as its destructor is private and
+    // start() allocates it
+    instance_.__hsm = nullptr;
+  }
+
+  Machine(const Machine&) = delete;
+  Machine& operator=(const Machine&) = delete;
+
+  void first() { instance_.dispatch(first_).wait(); }
+  void second() { instance_.dispatch(second_).wait(); }
+
+ private:
+  std::unique_ptr<hsm::Model> model_;
+  Instance instance_;
+  hsm::Event first_;
+  hsm::Event second_;
+};
+
+// Two children of one parent, with `Behaviors...` on every state
+template <typename... Behaviors>
+std::unique_ptr<hsm::Model> nested(Behaviors... behaviors) {
+  return hsm::define(
+      "Nested",
+      hsm::state("parent", behaviors()...,
+                 hsm::state("child1", behaviors()...),
+                 hsm::state("child2", behaviors()...),
+                 hsm::initial(hsm::target("child1")),
+                 hsm::transition(hsm::on("toChild2"), hsm::source("child1"),
+                                 hsm::target("child2")),
+                 hsm::transition(hsm::on("toChild1"), hsm::source("child2"),
+                                 hsm::target("child1"))),
+      hsm::initial(hsm::target("parent")));
+}
+
+inline std::unique_ptr<hsm::Model> nestedWithEffect() {
+  return hsm::define(
+      "NestedEffect",
+      hsm::state(
+          "parent", hsm::entry(noBehavior), hsm::exit(noBehavior),
+          hsm::activity(activityBehavior),
+          hsm::state("child1", hsm::entry(noBehavior), hsm::exit(noBehavior),
+                     hsm::activity(activityBehavior)),
+          hsm::state("child2", hsm::entry(noBehavior), hsm::exit(noBehavior),
+                     hsm::activity(activityBehavior)),
+          hsm::initial(hsm::target("child1")),
+          hsm::transition(hsm::on("toChild2"), hsm::source("child1"),
+                          hsm::target("child2"), hsm::effect(noBehavior)),
+          hsm::transition(hsm::on("toChild1"), hsm::source("child2"),
+                          hsm::target("child1"), hsm::effect(noBehavior))),
+      hsm::initial(hsm::target("parent")));
+}
+
+inline std::unique_ptr<hsm::Model> deepNesting() {
+  return hsm::define(
+      "Deep",
+      hsm::state(
+          "level1", hsm::entry(noBehavior), hsm::exit(noBehavior),
+          hsm::state(
+              "level2", hsm::entry(noBehavior), hsm::exit(noBehavior),
+              hsm::state("level3a", hsm::entry(noBehavior),
+                         hsm::exit(noBehavior)),
+              hsm::state("level3b", hsm::entry(noBehavior),
+                         hsm::exit(noBehavior)),
+              hsm::initial(hsm::target("level3a")),
+              hsm::transition(hsm::on("toLevel3b"), hsm::source("level3a"),
+                              hsm::target("level3b")),
+              hsm::transition(hsm::on("toLevel3a"), hsm::source("level3b"),
+                              hsm::target("level3a"))),
+          hsm::initial(hsm::target("level2"))),
+      hsm::initial(hsm::target("level1")));
+}
+
+inline std::unique_ptr<hsm::Model> crossHierarchy() {
+  return hsm::define(
+      "Cross",
+      hsm::state(
+          "parent1", hsm::entry(noBehavior), hsm::exit(noBehavior),
+          hsm::state("child1", hsm::entry(noBehavior), hsm::exit(noBehavior)),
+          hsm::initial(hsm::target("child1"))),
+      hsm::state(
+          "parent2", hsm::entry(noBehavior), hsm::exit(noBehavior),
+          hsm::state("child2", hsm::entry(noBehavior), hsm::exit(noBehavior)),
+          hsm::initial(hsm::target("child2"))),
+      hsm::transition(hsm::on("toParent2"), hsm::source("parent1"),
+                      hsm::target("parent2")),
+      hsm::transition(hsm::on("toParent1"), hsm::source("parent2"),
+                      hsm::target("parent1")),
+      hsm::initial(hsm::target("parent1")));
+}
+
+inline std::unique_ptr<hsm::Model> invalidEvents() {
+  return hsm::define(
+      "Invalid",
+      hsm::state(
+          "level1",
+          hsm::state("level2",
+                     hsm::state("level3",
+                                hsm::transition(hsm::on("validEvent"),
+                                                hsm::target("level3"))),
+                     hsm::initial(hsm::target("level3"))),
+          hsm::initial(hsm::target("level2"))),
+      hsm::initial(hsm::target("level1")));
+}
+
+inline std::unique_ptr<hsm::Model> activityWork() {
+  return hsm::define(
+      "Work",
+      hsm::state("parent",
+                 hsm::state("child1", hsm::activity(workActivity)),
+                 hsm::state("child2", hsm::activity(workActivity)),
+                 hsm::initial(hsm::target("child1")),
+                 hsm::transition(hsm::on("toChild2"), hsm::source("child1"),
+                                 hsm::target("child2")),
+                 hsm::transition(hsm::on("toChild1"), hsm::source("child2"),
+                                 hsm::target("child1"))),
+      hsm::initial(hsm::target("parent")));
+}
+
+// The result of the scenario, or nothing if hsm has no equivalent
+inline std::optional<BenchmarkResult> run(const Options& options,
+                                          const Scenario& scenario) {
+  const auto entry = [] { return hsm::entry(noBehavior); };
+  const auto exit = [] { return hsm::exit(noBehavior); };
+  const auto activity = [] { return hsm::activity(activityBehavior); };
+  const auto bench = [&](auto model, std::string_view first,
+                         std::string_view second) {
+    return runScenario(options, "hsm", scenario, [&] {
+      return std::make_unique<Machine>(model(), first, second);
+    });
+  };
+
+  switch (scenario.id) {
+    case ScenarioId::Nested:
+      return bench([] { return nested(); }, "toChild2", "toChild1");
+    case ScenarioId::NestedEntry:
+      return bench([&] { return nested(entry); }, "toChild2", "toChild1");
+    case ScenarioId::NestedEntryActivity:
+      return bench([&] { return nested(entry, activity); }, "toChild2",
+                   "toChild1");
+    case ScenarioId::NestedEntryExitActivity:
+      return bench([&] { return nested(entry, exit, activity); }, "toChild2",
+                   "toChild1");
+    case ScenarioId::NestedEntryExitActivityEffect:
+      return bench(nestedWithEffect, "toChild2", "toChild1");
+    case ScenarioId::DeepNesting:
+      return bench(deepNesting, "toLevel3b", "toLevel3a");
+    case ScenarioId::CrossHierarchy:
+      return bench(crossHierarchy, "toParent2", "toParent1");
+    case ScenarioId::InvalidEvents:
+      return bench(invalidEvents, "invalidEvent1", "invalidEvent2");
+    case ScenarioId::ActivityWork:
+      return bench(activityWork, "toChild2", "toChild1");
+    case ScenarioId::ActivityWorkPool:
+      break;
+  }
+  return std::nullopt;
+}
+
+}  // namespace bench::hsm_scenarios
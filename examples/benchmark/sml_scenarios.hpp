@@ -0,0 +1,188 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+
+#include "boost/sml.hpp"
+#include "harness.hpp"
+
+// Boost.SML takes the hierarchy as composite state machines and the
+// entry, exit and effect behaviors as actions; it has no activities, so
+// the scenarios with them are skipped.
+namespace bench::sml_scenarios {
+
+namespace sml = boost::sml;
+
+struct ToChild1 {};
+struct ToChild2 {};
+struct ToLevel3a {};
+struct ToLevel3b {};
+struct ToParent1 {};
+struct ToParent2 {};
+struct ValidEvent {};
+struct InvalidEvent1 {};
+struct InvalidEvent2 {};
+// Never sent; gives a composite alone in its table a transition
+struct Never {};
+
+inline constexpr auto noBehavior = [] { tick(); };
+
+// sml::sm keeps the dependencies of a machine without any in an empty
+// array member
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+template <typename Table, typename First, typename Second>
+class Machine {
+ public:
+  void first() { sm_.process_event(First{}); }
+  void second() { sm_.process_event(Second{}); }
+
+ private:
+  sml::sm<Table> sm_;
+};
+#pragma GCC diagnostic pop
+
+struct Children {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(*"child1"_s + event<ToChild2> = "child2"_s,
+                                 "child2"_s + event<ToChild1> = "child1"_s);
+  }
+};
+
+struct Nested {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(*state<Children> + event<Never> =
+                                      state<Children>);
+  }
+};
+
+struct ChildrenEntry {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(*"child1"_s + event<ToChild2> = "child2"_s,
+                                 "child2"_s + event<ToChild1> = "child1"_s,
+                                 "child1"_s + sml::on_entry<_> / noBehavior,
+                                 "child2"_s + sml::on_entry<_> / noBehavior);
+  }
+};
+
+struct NestedEntry {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(
+        *state<ChildrenEntry> + sml::on_entry<_> / noBehavior);
+  }
+};
+
+struct Level2 {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(
+        *"level3a"_s + event<ToLevel3b> = "level3b"_s,
+        "level3b"_s + event<ToLevel3a> = "level3a"_s,
+        "level3a"_s + sml::on_entry<_> / noBehavior,
+        "level3a"_s + sml::on_exit<_> / noBehavior,
+        "level3b"_s + sml::on_entry<_> / noBehavior,
+        "level3b"_s + sml::on_exit<_> / noBehavior);
+  }
+};
+
+struct Level1 {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(*state<Level2> + sml::on_entry<_> / noBehavior,
+                                 state<Level2> + sml::on_exit<_> / noBehavior);
+  }
+};
+
+struct Deep {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(*state<Level1> + sml::on_entry<_> / noBehavior,
+                                 state<Level1> + sml::on_exit<_> / noBehavior);
+  }
+};
+
+struct Parent1 {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(*"child1"_s + sml::on_entry<_> / noBehavior,
+                                 "child1"_s + sml::on_exit<_> / noBehavior);
+  }
+};
+
+struct Parent2 {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(*"child2"_s + sml::on_entry<_> / noBehavior,
+                                 "child2"_s + sml::on_exit<_> / noBehavior);
+  }
+};
+
+struct Cross {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(
+        *state<Parent1> + event<ToParent2> = state<Parent2>,
+        state<Parent2> + event<ToParent1> = state<Parent1>,
+        state<Parent1> + sml::on_entry<_> / noBehavior,
+        state<Parent1> + sml::on_exit<_> / noBehavior,
+        state<Parent2> + sml::on_entry<_> / noBehavior,
+        state<Parent2> + sml::on_exit<_> / noBehavior);
+  }
+};
+
+struct Level3 {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(*"level3"_s + event<ValidEvent> =
+                                      "level3"_s);
+  }
+};
+
+struct InvalidLevel2 {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(*state<Level3> + event<Never> =
+                                      state<Level3>);
+  }
+};
+
+struct Invalid {
+  auto operator()() const {
+    using namespace sml;
+    return make_transition_table(*state<InvalidLevel2> + event<Never> =
+                                      state<InvalidLevel2>);
+  }
+};
+
+template <typename Table, typename First, typename Second>
+BenchmarkResult bench(const Options& options, const Scenario& scenario) {
+  return runScenario(options, "sml", scenario, [] {
+    return std::make_unique<Machine<Table, First, Second>>();
+  });
+}
+
+// The result of the scenario, or nothing if SML has no equivalent
+inline std::optional<BenchmarkResult> run(const Options& options,
+                                          const Scenario& scenario) {
+  switch (scenario.id) {
+    case ScenarioId::Nested:
+      return bench<Nested, ToChild2, ToChild1>(options, scenario);
+    case ScenarioId::NestedEntry:
+      return bench<NestedEntry, ToChild2, ToChild1>(options, scenario);
+    case ScenarioId::DeepNesting:
+      return bench<Deep, ToLevel3b, ToLevel3a>(options, scenario);
+    case ScenarioId::CrossHierarchy:
+      return bench<Cross, ToParent2, ToParent1>(options, scenario);
+    case ScenarioId::InvalidEvents:
+      return bench<Invalid, InvalidEvent1, InvalidEvent2>(options, scenario);
+    default:
+      break;
+  }
+  return std::nullopt;
+}
+
+}  // namespace bench::sml_scenarios
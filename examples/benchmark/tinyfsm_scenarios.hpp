@@ -0,0 +1,177 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+
+#include "harness.hpp"
+#include "tinyfsm.hpp"
+
+// TinyFSM is flat: the hierarchy is folded into the leaf states, which call
+// the entry and exit behaviors of the ancestors a transition leaves or
+// enters. It has no activities, so the scenarios with them are skipped.
+// Each machine is static, as TinyFSM keeps the current state in a static.
+namespace bench::tinyfsm_scenarios {
+
+struct ToChild1 : tinyfsm::Event {};
+struct ToChild2 : tinyfsm::Event {};
+struct ToLevel3a : tinyfsm::Event {};
+struct ToLevel3b : tinyfsm::Event {};
+struct ToParent1 : tinyfsm::Event {};
+struct ToParent2 : tinyfsm::Event {};
+struct ValidEvent : tinyfsm::Event {};
+struct InvalidEvent1 : tinyfsm::Event {};
+struct InvalidEvent2 : tinyfsm::Event {};
+
+// States of one machine ignore events they have no reaction to
+template <typename Fsm>
+struct Base : tinyfsm::Fsm<Fsm> {
+  virtual ~Base() = default;
+  virtual void react(const tinyfsm::Event&) {}
+  virtual void entry() {}
+  virtual void exit() {}
+};
+
+// 1. Two children of one parent
+struct Nested : Base<Nested> {
+  using Base::react;
+  virtual void react(const ToChild1&) {}
+  virtual void react(const ToChild2&) {}
+};
+struct NestedChild1 : Nested {
+  using Nested::react;
+  void react(const ToChild2&) override;
+};
+struct NestedChild2 : Nested {
+  using Nested::react;
+  void react(const ToChild1&) override;
+};
+inline void NestedChild1::react(const ToChild2&) { transit<NestedChild2>(); }
+inline void NestedChild2::react(const ToChild1&) { transit<NestedChild1>(); }
+
+// 1.a The same, with entry behaviors
+struct NestedEntry : Base<NestedEntry> {
+  using Base::react;
+  virtual void react(const ToChild1&) {}
+  virtual void react(const ToChild2&) {}
+  void entry() override { tick(); }
+};
+struct NestedEntryChild1 : NestedEntry {
+  using NestedEntry::react;
+  void react(const ToChild2&) override;
+};
+struct NestedEntryChild2 : NestedEntry {
+  using NestedEntry::react;
+  void react(const ToChild1&) override;
+};
+inline void NestedEntryChild1::react(const ToChild2&) {
+  transit<NestedEntryChild2>();
+}
+inline void NestedEntryChild2::react(const ToChild1&) {
+  transit<NestedEntryChild1>();
+}
+
+// Siblings three levels down; only their own entry and exit run
+struct Deep : Base<Deep> {
+  using Base::react;
+  virtual void react(const ToLevel3a&) {}
+  virtual void react(const ToLevel3b&) {}
+  void entry() override { tick(); }
+  void exit() override { tick(); }
+};
+struct DeepLevel3a : Deep {
+  using Deep::react;
+  void react(const ToLevel3b&) override;
+};
+struct DeepLevel3b : Deep {
+  using Deep::react;
+  void react(const ToLevel3a&) override;
+};
+inline void DeepLevel3a::react(const ToLevel3b&) { transit<DeepLevel3b>(); }
+inline void DeepLevel3b::react(const ToLevel3a&) { transit<DeepLevel3a>(); }
+
+// Leaving a child and its parent for the other parent's child
+struct Cross : Base<Cross> {
+  using Base::react;
+  virtual void react(const ToParent1&) {}
+  virtual void react(const ToParent2&) {}
+  void entry() override {
+    tick();  // Parent
+    tick();  // Child
+  }
+  void exit() override {
+    tick();  // Child
+    tick();  // Parent
+  }
+};
+struct CrossChild1 : Cross {
+  using Cross::react;
+  void react(const ToParent2&) override;
+};
+struct CrossChild2 : Cross {
+  using Cross::react;
+  void react(const ToParent1&) override;
+};
+inline void CrossChild1::react(const ToParent2&) { transit<CrossChild2>(); }
+inline void CrossChild2::react(const ToParent1&) { transit<CrossChild1>(); }
+
+// Events no state reacts to
+struct Invalid : Base<Invalid> {
+  using Base::react;
+  virtual void react(const ValidEvent&) {}
+};
+struct InvalidLevel3 : Invalid {
+  using Invalid::react;
+  void react(const ValidEvent&) override;
+};
+inline void InvalidLevel3::react(const ValidEvent&) {
+  transit<InvalidLevel3>();
+}
+
+template <typename Fsm, typename First, typename Second>
+class Machine {
+ public:
+  Machine() { Fsm::start(); }
+
+  void first() { Fsm::dispatch(First{}); }
+  void second() { Fsm::dispatch(Second{}); }
+};
+
+template <typename Fsm, typename First, typename Second>
+BenchmarkResult bench(const Options& options, const Scenario& scenario) {
+  return runScenario(options, "tinyfsm", scenario, [] {
+    return std::make_unique<Machine<Fsm, First, Second>>();
+  });
+}
+
+// The result of the scenario, or nothing if TinyFSM has no equivalent
+inline std::optional<BenchmarkResult> run(const Options& options,
+                                          const Scenario& scenario) {
+  switch (scenario.id) {
+    case ScenarioId::Nested:
+      return bench<Nested, ToChild2, ToChild1>(options, scenario);
+    case ScenarioId::NestedEntry:
+      return bench<NestedEntry, ToChild2, ToChild1>(options, scenario);
+    case ScenarioId::DeepNesting:
+      return bench<Deep, ToLevel3b, ToLevel3a>(options, scenario);
+    case ScenarioId::CrossHierarchy:
+      return bench<Cross, ToParent2, ToParent1>(options, scenario);
+    case ScenarioId::InvalidEvents:
+      return bench<Invalid, InvalidEvent1, InvalidEvent2>(options, scenario);
+    default:
+      break;
+  }
+  return std::nullopt;
+}
+
+}  // namespace bench::tinyfsm_scenarios
+
+FSM_INITIAL_STATE(bench::tinyfsm_scenarios::Nested,
+                  bench::tinyfsm_scenarios::NestedChild1)
+FSM_INITIAL_STATE(bench::tinyfsm_scenarios::NestedEntry,
+                  bench::tinyfsm_scenarios::NestedEntryChild1)
+FSM_INITIAL_STATE(bench::tinyfsm_scenarios::Deep,
+                  bench::tinyfsm_scenarios::DeepLevel3a)
+FSM_INITIAL_STATE(bench::tinyfsm_scenarios::Cross,
+                  bench::tinyfsm_scenarios::CrossChild1)
+FSM_INITIAL_STATE(bench::tinyfsm_scenarios::Invalid,
+                  bench::tinyfsm_scenarios::InvalidLevel3)
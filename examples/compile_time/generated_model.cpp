@@ -0,0 +1,79 @@
+// Generated model for the cthsm compile-time benchmark.
+//
+// Builds a two-level model with CTHSM_BENCH_STATES leaf states: groups of
+// ten leaves under one composite each, every leaf with two event
+// transitions and every composite with one, over CTHSM_BENCH_STATES / 4
+// distinct event names. Compiling this file is the benchmark; the program
+// itself only dispatches a few events so nothing is optimized away.
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <utility>
+
+#include "cthsm/cthsm.hpp"
+
+#ifndef CTHSM_BENCH_STATES
+#define CTHSM_BENCH_STATES 50
+#endif
+
+namespace {
+
+constexpr std::size_t leaf_count = CTHSM_BENCH_STATES;
+constexpr std::size_t group_size = 10;
+constexpr std::size_t group_count = (leaf_count + group_size - 1) / group_size;
+constexpr std::size_t event_count = leaf_count / 4 > 0 ? leaf_count / 4 : 1;
+
+static_assert(leaf_count > 0 && leaf_count < 10000, "1..9999 states");
+
+// "<prefix>NNNN"
+template <char Prefix, std::size_t I>
+constexpr auto name() {
+  std::array<char, 6> buf{};
+  buf[0] = Prefix;
+  buf[1] = static_cast<char>('0' + (I / 1000) % 10);
+  buf[2] = static_cast<char>('0' + (I / 100) % 10);
+  buf[3] = static_cast<char>('0' + (I / 10) % 10);
+  buf[4] = static_cast<char>('0' + I % 10);
+  return cthsm::detail::fixed_string<6>(buf);
+}
+
+template <std::size_t G, std::size_t K>
+constexpr auto leaf() {
+  constexpr std::size_t id = G * group_size + K;
+  constexpr std::size_t next = G * group_size + (K + 1) % group_size;
+  constexpr std::size_t prev = G * group_size + (K + group_size - 1) % group_size;
+  return cthsm::state(
+      name<'s', id>(),
+      cthsm::transition(cthsm::on(name<'e', id % event_count>()), cthsm::target(name<'s', next>())),
+      cthsm::transition(cthsm::on(name<'e', (id * 7 + 3) % event_count>()),
+                        cthsm::target(name<'s', prev>())));
+}
+
+template <std::size_t G, std::size_t... Ks>
+constexpr auto group(std::index_sequence<Ks...>) {
+  return cthsm::state(
+      name<'c', G>(), cthsm::initial(cthsm::target(name<'s', G * group_size>())),
+      cthsm::transition(cthsm::on(name<'n', G % event_count>()),
+                        cthsm::target(name<'c', (G + 1) % group_count>())),
+      leaf<G, Ks>()...);
+}
+
+template <std::size_t... Gs>
+constexpr auto make_model(std::index_sequence<Gs...>) {
+  return cthsm::define("machine", cthsm::initial(cthsm::target(name<'c', 0>())),
+                       group<Gs>(std::make_index_sequence<group_size>{})...);
+}
+
+constexpr auto model = make_model(std::make_index_sequence<group_count>{});
+
+}  // namespace
+
+int main() {
+  cthsm::compile<model> sm;
+  cthsm::Instance instance;
+  sm.start(instance);
+  sm.dispatch(instance, std::string_view{"e0000"});
+  sm.dispatch(instance, std::string_view{"n0000"});
+  return sm.state().empty() ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+// Driver for the cthsm compile-time benchmark.
+//
+// Compiles generated_model.cpp once per requested model size and records
+// the wall-clock compile time and the peak resident memory of the compiler
+// (ru_maxrss of the child, as reported by wait4). Results are printed as a
+// table and written to a CSV file.
+//
+// usage: cthsm_compile_measure --compiler <c++> --source <generated_model.cpp>
+//            --include <dir> [--output <csv>] [--flag <arg>]... <states>...
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct result {
+  std::size_t states{0};
+  double seconds{0.0};
+  long peak_kb{0};
+  int status{0};
+};
+
+result compile_once(const std::vector<std::string>& command, std::size_t states) {
+  std::vector<char*> argv;
+  argv.reserve(command.size() + 1);
+  for (const auto& arg : command) argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  result r{};
+  r.states = states;
+  const auto start = std::chrono::steady_clock::now();
+  const pid_t pid = fork();
+  if (pid == 0) {
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  if (pid < 0) {
+    r.status = -1;
+    return r;
+  }
+
+  int status = 0;
+  struct rusage usage {};
+  wait4(pid, &status, 0, &usage);
+  r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  r.peak_kb = usage.ru_maxrss;  // kilobytes on Linux
+  r.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  return r;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string compiler = "c++";
+  std::string source;
+  std::string include_dir;
+  std::string output = "compile_time.csv";
+  std::vector<std::string> extra_flags;
+  std::vector<std::size_t> sizes;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--compiler" && has_value) {
+      compiler = argv[++i];
+    } else if (arg == "--source" && has_value) {
+      source = argv[++i];
+    } else if (arg == "--include" && has_value) {
+      include_dir = argv[++i];
+    } else if (arg == "--output" && has_value) {
+      output = argv[++i];
+    } else if (arg == "--flag" && has_value) {
+      extra_flags.emplace_back(argv[++i]);
+    } else {
+      sizes.push_back(static_cast<std::size_t>(std::strtoul(arg.c_str(), nullptr, 10)));
+    }
+  }
+  if (source.empty() || include_dir.empty()) {
+    std::cerr << "usage: " << argv[0]
+              << " --compiler <c++> --source <file> --include <dir> [--output <csv>]"
+                 " [--flag <arg>]... <states>...\n";
+    return 2;
+  }
+  if (sizes.empty()) sizes = {50, 200, 1000};
+
+  std::vector<result> results;
+  std::cout << std::left << std::setw(10) << "states" << std::setw(12) << "seconds"
+            << std::setw(14) << "peak MB" << "status\n";
+  for (std::size_t states : sizes) {
+    std::vector<std::string> command{compiler, "-std=c++23", "-O1", "-I" + include_dir,
+                                     "-DCTHSM_BENCH_STATES=" + std::to_string(states)};
+    command.insert(command.end(), extra_flags.begin(), extra_flags.end());
+    command.insert(command.end(), {"-c", source, "-o", "/dev/null"});
+
+    const result r = compile_once(command, states);
+    results.push_back(r);
+    std::cout << std::left << std::setw(10) << r.states << std::setw(12) << std::fixed
+              << std::setprecision(2) << r.seconds << std::setw(14)
+              << static_cast<double>(r.peak_kb) / 1024.0 << (r.status == 0 ? "ok" : "failed")
+              << '\n';
+  }
+
+  std::ofstream csv(output);
+  csv << "states,seconds,peak_kb,status\n";
+  for (const auto& r : results) {
+    csv << r.states << ',' << r.seconds << ',' << r.peak_kb << ',' << r.status << '\n';
+  }
+  std::cout << "wrote " << output << '\n';
+
+  for (const auto& r : results) {
+    if (r.status != 0) return 1;
+  }
+  return 0;
+}
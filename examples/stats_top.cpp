@@ -0,0 +1,106 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stats_exporter.hpp"
+
+// Live view of the state machines a process publishes through an
+// hsm::StatsExporter, refreshed every interval (default 1000 ms):
+//
+//   stats_top <segment> [interval_ms] [--once]
+//
+// --once prints a single view, with rates over one interval.
+namespace {
+
+struct Sample {
+    bool valid = false;
+    std::uint64_t dispatched = 0;
+    std::chrono::steady_clock::time_point at;
+};
+
+double rate(const Sample& before, const hsm::StatsRecord& record,
+            std::chrono::steady_clock::time_point now) {
+    if (!before.valid || record.dispatched < before.dispatched) return 0.0;
+    const std::chrono::duration<double> elapsed = now - before.at;
+    if (elapsed.count() <= 0.0) return 0.0;
+    return static_cast<double>(record.dispatched - before.dispatched) / elapsed.count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <segment> [interval_ms] [--once]" << std::endl;
+        return 2;
+    }
+    const std::string segment = argv[1];
+    long interval_ms = 1000;
+    bool once = false;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--once") {
+            once = true;
+        } else {
+            interval_ms = std::strtol(argv[i], nullptr, 10);
+            if (interval_ms <= 0) interval_ms = 1000;
+        }
+    }
+
+    hsm::StatsReader reader(segment);
+    if (!reader) {
+        std::cerr << "ERROR: " << segment << " is not an hsm stats segment" << std::endl;
+        return 1;
+    }
+
+    std::vector<Sample> samples(reader.slot_count());
+    for (bool first = true;; first = false) {
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<hsm::StatsRecord> records;
+        std::vector<double> rates;
+        for (std::size_t slot = 0; slot < reader.slot_count(); ++slot) {
+            hsm::StatsRecord record;
+            if (!reader.read(slot, record)) {
+                samples[slot].valid = false;
+                continue;
+            }
+            rates.push_back(rate(samples[slot], record, now));
+            samples[slot] = Sample{true, record.dispatched, now};
+            records.push_back(record);
+        }
+
+        if (once && first) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+            continue;
+        }
+        if (!once) std::printf("\033[H\033[2J");
+        std::printf("%s  %zu/%zu slots\n\n", segment.c_str(), records.size(),
+                    reader.slot_count());
+        std::printf("%-20s %9s %12s %10s %10s %6s %6s\n", "MODEL", "INSTANCES",
+                    "DISPATCHED", "DEFERRED", "UNHANDLED", "ACT", "TIMERS");
+        for (const auto& model : hsm::aggregate_by_model(records)) {
+            std::printf("%-20s %9zu %12llu %10llu %10llu %6llu %6llu\n", model.model.c_str(),
+                        model.instances, static_cast<unsigned long long>(model.dispatched),
+                        static_cast<unsigned long long>(model.deferred),
+                        static_cast<unsigned long long>(model.unhandled),
+                        static_cast<unsigned long long>(model.activities),
+                        static_cast<unsigned long long>(model.timers));
+        }
+        std::printf("\n%-20s %-32s %10s %12s %6s %6s %6s\n", "INSTANCE", "STATE", "EVENTS/S",
+                    "DISPATCHED", "QUEUE", "ACT", "TIMERS");
+        for (std::size_t i = 0; i < records.size(); ++i) {
+            const auto& r = records[i];
+            const std::string instance(hsm::stats_name(r.instance));
+            const std::string state(hsm::stats_name(r.state));
+            std::printf("%-20s %-32s %10.1f %12llu %6u %6u %6u\n", instance.c_str(),
+                        state.c_str(), rates[i], static_cast<unsigned long long>(r.dispatched),
+                        r.queue_depth, r.activities, r.timers);
+        }
+        std::fflush(stdout);
+        if (once) return 0;
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+}
@@ -0,0 +1,34 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "flight_recorder.hpp"
+
+// Converts a flight recorder dump (hsm::write_trace_dump) to Chrome trace
+// JSON for chrome://tracing or https://ui.perfetto.dev
+//
+//   trace_dump <dump.bin> [trace.json]
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <dump.bin> [trace.json]" << std::endl;
+        return 2;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    std::vector<std::string> names;
+    std::vector<hsm::TraceRecord> records;
+    if (!in || !hsm::read_trace_dump(in, names, records)) {
+        std::cerr << "ERROR: " << argv[1] << " is not a flight recorder dump" << std::endl;
+        return 1;
+    }
+
+    if (argc > 2) {
+        std::ofstream out(argv[2]);
+        hsm::write_chrome_trace(out, names, records);
+    } else {
+        hsm::write_chrome_trace(std::cout, names, records);
+    }
+    std::cerr << records.size() << " records" << std::endl;
+    return 0;
+}
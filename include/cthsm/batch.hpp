@@ -0,0 +1,393 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+
+namespace cthsm {
+
+// Steps many instances of one compiled machine together. Only the active
+// state of each instance is kept, as a compact id in one contiguous array;
+// the instances themselves are passed in as a span that parallels it.
+//
+// An event is applied to a whole span at once. For each (event, state) pair
+// the batch precomputes the next state when taking the transition runs no
+// behavior and no guard, so those instances advance with a single table
+// gather. The rest select their transition, are grouped by it, and run the
+// transition program one action at a time across the whole group.
+//
+// Machines with activities, timers, deferral, history or orthogonal regions
+// keep per-instance runtime state beyond the active state and cannot be
+// batched.
+template <typename Machine>
+class batch {
+ public:
+  using machine_type = Machine;
+  using instance_type = typename Machine::instance_type;
+  using context_type = typename Machine::context_type;
+
+  static constexpr std::size_t state_count =
+      std::remove_cvref_t<decltype(Machine::normalized_model)>::state_count;
+  static constexpr std::size_t transition_count =
+      std::remove_cvref_t<decltype(Machine::normalized_model)>::transition_count;
+  static constexpr std::size_t event_count =
+      std::remove_cvref_t<decltype(Machine::tables)>::event_count;
+
+  // State ids plus the not_started and slow markers
+  using state_type = detail::compact_index_t<state_count + 2>;
+  // State of an instance that has not been started
+  static constexpr state_type not_started = static_cast<state_type>(state_count);
+
+ private:
+  using index_type = std::uint32_t;
+
+  static constexpr state_type slow = static_cast<state_type>(state_count + 1);
+  static constexpr std::size_t no_transition = transition_count;
+
+  static consteval bool batchable() {
+    for (std::size_t s = 0; s < state_count; ++s) {
+      if (Machine::normalized_model.states[s].defer_count > 0) return false;
+    }
+    for (std::size_t t = 0; t < transition_count; ++t) {
+      if (Machine::programs.transitions[t].generic) return false;
+    }
+    return Machine::history_composite_count == 0;
+  }
+
+  static_assert(Machine::total_activity_count == 0 && Machine::total_timer_count == 0,
+                "batch machines cannot have activities or timers");
+  static_assert(!Machine::has_regions, "batch machines cannot have orthogonal regions");
+  static_assert(Machine::submachine_count == 0, "batch machines cannot have submachine states");
+  static_assert(!Machine::observed, "batch machines cannot have an Observer");
+  static_assert(batchable(), "batch machines cannot defer events or use history");
+
+  // Next state for an instance in `state` receiving the event whose
+  // candidate chain starts at `head`, or `slow` if that runs a behavior or
+  // guard or may complete
+  static consteval state_type pure_step(std::size_t state, std::size_t head) {
+    if (head == detail::invalid_index) return static_cast<state_type>(state);
+    const auto& t = Machine::normalized_model.transitions[head];
+    if (t.guard_idx != detail::invalid_index) return slow;
+    const auto& prog = Machine::programs.transitions[head];
+    if (prog.completes) return slow;
+    std::size_t next = state;
+    for (std::size_t i = 0; i < prog.actions.count; ++i) {
+      const auto& a = Machine::programs.actions[prog.actions.start + i];
+      if (a.kind != detail::action_kind::set_state) return slow;
+      next = a.index;
+    }
+    if (!prog.changes_state) return static_cast<state_type>(state);
+    for (std::size_t s = state; s != t.source_id && s != detail::invalid_index;
+         s = Machine::normalized_model.states[s].parent_id) {
+      if (Machine::programs.state_exits[s].count > 0) return slow;
+    }
+    return static_cast<state_type>(next);
+  }
+
+  // One row per event, plus a last row for names that are not in the model
+  // (wildcard transitions only). Each row also maps not_started to itself.
+  using step_row = std::array<state_type, state_count + 1>;
+
+  static consteval auto make_step_table() {
+    std::array<step_row, event_count + 1> table{};
+    for (std::size_t e = 0; e <= event_count; ++e) {
+      for (std::size_t s = 0; s < state_count; ++s) {
+        const std::size_t head = e < event_count
+                                     ? Machine::find_transition(s, e)
+                                     : Machine::tables.get_wildcard_transition_id(s);
+        table[e][s] = pure_step(s, head);
+      }
+      table[e][state_count] = not_started;
+    }
+    return table;
+  }
+
+  static constexpr auto step_table = make_step_table();
+
+ public:
+  explicit batch(std::size_t count = 0) : states_(count, not_started) {}
+
+  [[nodiscard]] std::size_t size() const noexcept { return states_.size(); }
+
+  // Adds instances (not started) or drops them from the end
+  void resize(std::size_t count) { states_.resize(count, not_started); }
+
+  [[nodiscard]] std::span<const state_type> states() const noexcept { return states_; }
+
+  [[nodiscard]] std::size_t state_id(std::size_t index) const noexcept {
+    return states_[index];
+  }
+
+  [[nodiscard]] std::string_view state(std::size_t index) const noexcept {
+    const std::size_t id = states_[index];
+    if (id >= state_count) return "";
+    return Machine::normalized_model.get_state_name(id);
+  }
+
+  // Starts instances [first, first + instances.size())
+  void start(std::span<instance_type> instances, std::size_t first = 0) {
+    context_type ctx{};
+    EventBase e{"init"};
+    auto& buf = scratch_for(1)[0];
+    buf.order.resize(instances.size());
+    for (std::size_t k = 0; k < instances.size(); ++k) {
+      buf.order[k] = static_cast<index_type>(k);
+    }
+    run_program(ctx, instances, first, e, Machine::programs.start, detail::invalid_index,
+                buf.order);
+  }
+
+  // Dispatches the event to instances [first, first + instances.size())
+  template <typename T>
+  void dispatch(std::span<instance_type> instances, const T& e, std::size_t first = 0) {
+    step(instances, first, e, event_id_of(e), scratch_for(1)[0]);
+  }
+
+  // Splits the span into `chunks` parts and steps them in parallel, one
+  // task per part on the given TaskProvider and the last on the calling
+  // thread. Behaviors must only touch their own instance.
+  template <typename TaskProvider, typename T>
+  void dispatch_parallel(TaskProvider& provider, std::span<instance_type> instances,
+                         const T& e, std::size_t chunks, std::size_t first = 0) {
+    if (chunks < 2 || instances.size() < chunks) {
+      dispatch(instances, e, first);
+      return;
+    }
+    const std::size_t event_id = event_id_of(e);
+    auto& buffers = scratch_for(chunks);
+    jobs_.resize(chunks);
+    const std::size_t per_chunk = instances.size() / chunks;
+    for (std::size_t c = 0; c < chunks; ++c) {
+      const std::size_t begin = c * per_chunk;
+      const std::size_t end = c + 1 == chunks ? instances.size() : begin + per_chunk;
+      jobs_[c] = chunk_job{this, instances.subspan(begin, end - begin), first + begin, &e,
+                           event_id, &buffers[c]};
+    }
+
+    std::vector<typename TaskProvider::TaskHandle> tasks;
+    tasks.reserve(chunks - 1);
+    for (std::size_t c = 0; c + 1 < chunks; ++c) {
+      tasks.push_back(provider.create_task(
+          [job = &jobs_[c]] { job->self->step(job->instances, job->first, *job->event,
+                                              job->event_id, *job->buf); },
+          "batch", 0, 0));
+    }
+    const auto& last = jobs_[chunks - 1];
+    step(last.instances, last.first, e, event_id, *last.buf);
+    for (auto& task : tasks) {
+      if (task.joinable()) task.join();
+    }
+  }
+
+ private:
+  struct scratch {
+    std::vector<state_type> next;      // fast-path lookup of each instance
+    std::vector<index_type> slow;      // instances that did not take the fast path
+    std::vector<index_type> selected;  // transition selected by each slow instance
+    std::vector<index_type> order;     // slow instances grouped by transition
+    std::vector<index_type> bucket;    // group offsets into order
+  };
+
+  struct chunk_job {
+    batch* self;
+    std::span<instance_type> instances;
+    std::size_t first;
+    const EventBase* event;
+    std::size_t event_id;
+    scratch* buf;
+  };
+
+  template <typename T>
+  static std::size_t event_id_of(const T& e) {
+    static_assert(std::is_base_of_v<EventBase, T>, "Must be an Event");
+    if constexpr (std::is_same_v<T, EventBase> || std::is_same_v<T, Event<void>>) {
+      return Machine::tables.get_event_id(e.name());
+    } else {
+      constexpr std::size_t id = Machine::tables.get_event_id(detail::type_name<T>());
+      return id;
+    }
+  }
+
+  std::vector<scratch>& scratch_for(std::size_t count) {
+    if (scratch_.size() < count) scratch_.resize(count);
+    return scratch_;
+  }
+
+  void step(std::span<instance_type> instances, std::size_t first, const EventBase& e,
+            std::size_t event_id, scratch& buf) {
+    const step_row& row = step_table[event_id < event_count ? event_id : event_count];
+    state_type* const states = states_.data() + first;
+    const std::size_t n = instances.size();
+
+    // Fast path: a gather per instance. Instances whose step runs a
+    // behavior keep their state and are marked in buf.next.
+    buf.next.resize(n);
+    if (!gather(row.data(), states, buf.next.data(), n)) return;
+
+    // Collect the marked instances for the grouped path
+    buf.slow.resize(n);
+    index_type* const slow_indices = buf.slow.data();
+    std::size_t slow_count = 0;
+    for (std::size_t k = 0; k < n; ++k) {
+      slow_indices[slow_count] = static_cast<index_type>(k);
+      slow_count += buf.next[k] == slow ? 1U : 0U;
+    }
+
+    context_type ctx{};
+
+    // Select the transition of every slow instance: its candidate chain
+    // (guards are per instance), then the wildcard chain
+    buf.selected.resize(slow_count);
+    for (std::size_t i = 0; i < slow_count; ++i) {
+      const std::size_t k = buf.slow[i];
+      buf.selected[i] = static_cast<index_type>(select(ctx, instances[k], e, states[k], event_id));
+    }
+
+    // Group by transition (counting sort)
+    buf.bucket.assign(transition_count + 2, 0);
+    for (std::size_t i = 0; i < slow_count; ++i) ++buf.bucket[buf.selected[i] + 1];
+    for (std::size_t t = 0; t <= transition_count; ++t) buf.bucket[t + 1] += buf.bucket[t];
+    buf.order.resize(slow_count);
+    for (std::size_t i = 0; i < slow_count; ++i) {
+      buf.order[buf.bucket[buf.selected[i]]++] = buf.slow[i];
+    }
+    // bucket[t] is now the end of group t, and the start of group t + 1
+
+    std::size_t begin = 0;
+    for (std::size_t t = 0; t < transition_count; ++t) {
+      const std::size_t end = buf.bucket[t];
+      if (end > begin) {
+        run_program(ctx, instances, first, e, Machine::programs.transitions[t],
+                    Machine::normalized_model.transitions[t].source_id,
+                    std::span<const index_type>(buf.order).subspan(begin, end - begin));
+      }
+      begin = end;
+    }
+  }
+
+  // Advances every instance whose next state is in the row and stores each
+  // lookup in next; true if any instance is marked slow. The stores are
+  // unconditional and the pointers restrict-qualified (byte-sized state ids
+  // may otherwise alias anything), so the loop vectorizes at -O3.
+  static bool gather(const state_type* __restrict row, state_type* __restrict states,
+                     state_type* __restrict next, std::size_t n) noexcept {
+    unsigned any_slow = 0;
+    for (std::size_t k = 0; k < n; ++k) {
+      const state_type s = states[k];
+      const state_type to = row[s];
+      const bool is_slow = to == slow;
+      next[k] = to;
+      states[k] = is_slow ? s : to;
+      any_slow |= is_slow ? 1U : 0U;
+    }
+    return any_slow != 0;
+  }
+
+  std::size_t select(context_type& ctx, instance_type& instance, const EventBase& e,
+                     std::size_t state, std::size_t event_id) const {
+    std::size_t t = event_id < event_count ? Machine::find_transition(state, event_id)
+                                           : detail::invalid_index;
+    for (; t != detail::invalid_index; t = Machine::tables.next_candidate[t]) {
+      if (guard_passes(ctx, instance, e, t)) return t;
+    }
+    t = Machine::tables.get_wildcard_transition_id(state);
+    for (; t != detail::invalid_index; t = Machine::tables.next_candidate[t]) {
+      if (guard_passes(ctx, instance, e, t)) return t;
+    }
+    return no_transition;
+  }
+
+  static bool guard_passes(context_type& ctx, instance_type& instance, const EventBase& e,
+                           std::size_t t) {
+    const std::size_t guard = Machine::normalized_model.transitions[t].guard_idx;
+    if (guard == detail::invalid_index || guard >= Machine::guard_table.size()) return true;
+    return Machine::guard_table[guard](ctx, instance, e);
+  }
+
+  // Runs one transition program for a group of instances, one action at a
+  // time across the group. `source` is the transition source; instances
+  // below it first leave their own active states.
+  void run_program(context_type& ctx, std::span<instance_type> instances, std::size_t first,
+                   const EventBase& e, const detail::transition_program& prog,
+                   std::size_t source, std::span<const index_type> group) {
+    state_type* const states = states_.data() + first;
+    if (prog.changes_state && source != detail::invalid_index) {
+      for (const index_type k : group) {
+        for (std::size_t s = states[k]; s != source && s != detail::invalid_index;
+             s = Machine::normalized_model.states[s].parent_id) {
+          run_actions(ctx, instances[k], e, Machine::programs.state_exits[s]);
+        }
+      }
+    }
+
+    for (std::size_t i = 0; i < prog.actions.count; ++i) {
+      const auto& a = Machine::programs.actions[prog.actions.start + i];
+      switch (a.kind) {
+        case detail::action_kind::exit:
+          for (const index_type k : group) Machine::exit_table[a.index](ctx, instances[k], e);
+          break;
+        case detail::action_kind::effect:
+          for (const index_type k : group) Machine::effect_table[a.index](ctx, instances[k], e);
+          break;
+        case detail::action_kind::entry:
+          for (const index_type k : group) Machine::entry_table[a.index](ctx, instances[k], e);
+          break;
+        case detail::action_kind::set_state:
+          for (const index_type k : group) states[k] = static_cast<state_type>(a.index);
+          break;
+        case detail::action_kind::stop_tasks:
+        case detail::action_kind::start_tasks:
+        case detail::action_kind::observe_exit:
+        case detail::action_kind::observe_enter:
+          break;  // no activities, timers or observer in a batch machine
+      }
+    }
+
+    if (prog.completes) {
+      for (const index_type k : group) complete(ctx, instances, first, k);
+    }
+  }
+
+  void run_actions(context_type& ctx, instance_type& instance, const EventBase& e,
+                   detail::action_range range) {
+    for (std::size_t i = 0; i < range.count; ++i) {
+      const auto& a = Machine::programs.actions[range.start + i];
+      if (a.kind == detail::action_kind::exit) Machine::exit_table[a.index](ctx, instance, e);
+    }
+  }
+
+  // Takes the first enabled completion transition of the instance's leaf,
+  // or of the enclosing states while they are final, like compile<>
+  void complete(context_type& ctx, std::span<instance_type> instances, std::size_t first,
+                index_type k) {
+    EventBase empty{""};
+    std::size_t curr = states_[first + k];
+    while (curr < state_count) {
+      const auto& range = Machine::tables.completion_transitions_ranges[curr];
+      for (std::size_t i = 0; i < range.count; ++i) {
+        const std::size_t t = Machine::tables.completion_transitions_list[range.start + i];
+        if (guard_passes(ctx, instances[k], empty, t)) {
+          run_program(ctx, instances, first, empty, Machine::programs.transitions[t],
+                      Machine::normalized_model.transitions[t].source_id,
+                      std::span<const index_type>(&k, 1));
+          return;
+        }
+      }
+      if (!any(Machine::normalized_model.states[curr].flags, detail::state_flags::final)) return;
+      curr = Machine::normalized_model.states[curr].parent_id;
+    }
+  }
+
+  std::vector<state_type> states_;
+  std::vector<scratch> scratch_;
+  std::vector<chunk_job> jobs_;
+};
+
+}  // namespace cthsm
@@ -4,7 +4,9 @@
 #include <atomic>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <string_view>
 #include <tuple>
@@ -13,11 +15,20 @@
 #include <utility>
 #include <vector>
 
+#include "cthsm/detail/ancestry.hpp"
 #include "cthsm/detail/behaviors.hpp"
+#include "cthsm/detail/compressed_tables.hpp"
+#include "cthsm/detail/deadline_heap.hpp"
 #include "cthsm/detail/expressions.hpp"
+#include "cthsm/detail/machine_state.hpp"
 #include "cthsm/detail/normalize.hpp"
+#include "cthsm/detail/perfect_hash.hpp"
+#include "cthsm/detail/programs.hpp"
+#include "cthsm/detail/regions.hpp"
 #include "cthsm/detail/structural_tuple.hpp"
 #include "cthsm/detail/tables.hpp"
+#include "instrumentation/cost_clock.hpp"
+#include "usdt.hpp"
 
 namespace cthsm {
 
@@ -70,6 +81,40 @@ struct SequentialTaskProvider {
 
 namespace detail {
 
+// How many tasks a provider can hold at once: its queue_depth if it has a
+// fixed number of task slots, unbounded otherwise
+template <typename Provider>
+consteval std::size_t task_capacity() {
+  if constexpr (requires { Provider::queue_depth; }) {
+    return Provider::queue_depth;
+  } else {
+    return std::numeric_limits<std::size_t>::max();
+  }
+}
+
+// How many tasks a provider runs at once: its worker_count if it runs them
+// on a fixed set of threads, unbounded otherwise
+template <typename Provider>
+consteval std::size_t task_concurrency() {
+  if constexpr (requires { Provider::worker_count; }) {
+    return Provider::worker_count;
+  } else {
+    return std::numeric_limits<std::size_t>::max();
+  }
+}
+
+// Whether the provider runs tasks on threads of its own and wants an
+// activity that returns there to leave its completion to the dispatching
+// thread (see compile<>::poll_activities)
+template <typename Provider>
+consteval bool defers_activity_completion() {
+  if constexpr (requires { Provider::defers_activity_completion; }) {
+    return Provider::defers_activity_completion;
+  } else {
+    return false;
+  }
+}
+
 template <typename T>
 struct is_duration : std::false_type {};
 
@@ -210,6 +255,14 @@ struct extract_instance_type<R (*)(Args...) noexcept> {
 
 }  // namespace detail
 
+namespace detail {
+// Id of a typed event: a hash of its type name, so an Event<T> carries the
+// same id whichever model it is dispatched to. Never 0, which marks events
+// named at runtime.
+template <typename T>
+inline constexpr std::uint64_t event_type_id = hash_key(type_name<T>(), 0) | 1U;
+}  // namespace detail
+
 struct EventBase {
   constexpr EventBase() noexcept = default;
   constexpr explicit EventBase(std::string_view name) noexcept : name_(name) {}
@@ -218,14 +271,25 @@ struct EventBase {
     return name_;
   }
 
+  // detail::event_type_id of a typed event, 0 for an event named at runtime.
+  // Typed behaviors check it instead of comparing names.
+  [[nodiscard]] constexpr std::uint64_t type_id() const noexcept {
+    return type_id_;
+  }
+
+ protected:
+  constexpr EventBase(std::string_view name, std::uint64_t type_id) noexcept
+      : name_(name), type_id_(type_id) {}
+
  private:
   std::string_view name_{};
+  std::uint64_t type_id_{0};
 };
 
 template <typename T = void>
 struct Event : EventBase {
     static constexpr std::string_view name_v = detail::type_name<T>();
-    constexpr Event() : EventBase(name_v) {}
+    constexpr Event() : EventBase(name_v, detail::event_type_id<T>) {}
 };
 
 template <>
@@ -245,6 +309,136 @@ consteval std::string_view type_name<Any>() {
 
 using Clock = std::chrono::steady_clock;
 
+// Clock that only moves when advanced. Used as the Clock parameter together
+// with TimerService, timer-driven code runs without sleeping.
+struct ManualClock {
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<ManualClock>;
+  static constexpr bool is_steady = true;
+
+  static time_point now() noexcept {
+    return time_point{duration{ticks_.load(std::memory_order_acquire)}};
+  }
+
+  static void advance(duration d) noexcept {
+    ticks_.fetch_add(d.count(), std::memory_order_acq_rel);
+  }
+
+  static void reset() noexcept { ticks_.store(0, std::memory_order_release); }
+
+ private:
+  static inline std::atomic<rep> ticks_{0};
+};
+
+// What a periodic timer does when it is polled more than one period late.
+//   catch_up: fire once for every missed period
+//   coalesce: fire once and continue at the next deadline still ahead
+enum class missed_ticks : unsigned { catch_up, coalesce };
+
+// When when() conditions are checked.
+//   on_step: synchronously at the end of every run-to-completion step and
+//            on notify_changed(); no task is needed
+//   poll:    a TaskProvider task re-evaluates the condition every 10 ms
+enum class when_mode : unsigned { on_step, poll };
+
+// How timers run.
+//   TaskTimers:   one TaskProvider task per armed after/every/at timer,
+//                 sleeping until it fires (default)
+//   TimerService: deadlines kept in a single heap ordered by Clock;
+//                 poll_timers() dispatches the ones that are due. `every`
+//                 deadlines are absolute, so periodic timers do not drift.
+template <when_mode Conditions = when_mode::on_step>
+struct TaskTimers {
+  static constexpr when_mode conditions = Conditions;
+};
+
+template <missed_ticks Missed = missed_ticks::coalesce,
+          when_mode Conditions = when_mode::on_step>
+struct TimerService {
+  static constexpr missed_ticks missed = Missed;
+  static constexpr when_mode conditions = Conditions;
+};
+
+// Storage layout of the (state, event) -> transition lookup.
+//   dense:      StateCount x EventCount matrix, one load per lookup
+//   compressed: event classes + deduplicated rows + comb-packed slots, for
+//               large models where the dense matrix is mostly empty
+enum class table_layout : unsigned { dense, compressed };
+
+// How dispatch reaches the transition behaviors.
+//   table:   one shared engine loop; guards, exits, effects and entries are
+//            called through the thunk tables
+//   inlined: a dedicated handler per (state, event) pair calls them directly
+//            so they can be inlined, selected through a jump table on the
+//            current state. Faster, at the cost of code size per pair.
+enum class dispatch_mode : unsigned { table, inlined };
+
+// Observer hooks, called with the integer ids of the machine's normalized
+// model (detail::invalid_index for an event name the model does not know).
+// Observers derive from NoObserver and hide the hooks they need; with
+// NoObserver itself no hook is called and no observe action is planned.
+//   on_dispatch(state, event):   an event reaches the active leaf `state`
+//   on_defer(state, event):      ... and is deferred
+//   on_unhandled(state, event):  ... and no transition takes it
+//   on_guard_rejected(transition): a candidate's guard returned false
+//   on_transition(transition):   a transition fires (not initial ones)
+//   on_exit(state):              after the exit behaviors of `state`
+//   on_enter(state):             before the entry behaviors of `state`
+// Two hooks are only called when the observer declares them, as timing
+// them reads Clock:
+//   on_complete(state, event, duration): a dispatch returns, after the
+//                                run-to-completion step it started
+//   on_dwell(state, duration):   after on_exit, the time since `state`
+//                                was entered; machine_state then keeps an
+//                                entry time per state
+// and one when it is declared, as it times every behavior call:
+//   on_behavior(kind, index, cost): after an entry, exit, effect, guard or
+//                                activity returns, with its index among the
+//                                model's behaviors of that kind and the
+//                                thread CPU time and cycle-counter ticks it
+//                                took (activities are timed on their task)
+// Sub machines report to the same Observer with their sub-model's ids.
+enum class behavior_kind : unsigned { entry, exit, effect, guard, activity };
+using behavior_cost = hsm::instrumentation::BehaviorCost;
+using cost_clock = hsm::instrumentation::CostClock;
+
+struct NoObserver {
+  static constexpr void on_dispatch(std::size_t, std::size_t) noexcept {}
+  static constexpr void on_defer(std::size_t, std::size_t) noexcept {}
+  static constexpr void on_unhandled(std::size_t, std::size_t) noexcept {}
+  static constexpr void on_guard_rejected(std::size_t) noexcept {}
+  static constexpr void on_transition(std::size_t) noexcept {}
+  static constexpr void on_exit(std::size_t) noexcept {}
+  static constexpr void on_enter(std::size_t) noexcept {}
+};
+
+namespace detail {
+template <typename T>
+struct is_timer_service : std::false_type {};
+
+template <missed_ticks Missed, when_mode Conditions>
+struct is_timer_service<TimerService<Missed, Conditions>> : std::true_type {};
+
+template <typename ModelData>
+consteval bool has_when_timers(const ModelData& data) {
+  for (const auto& t : data.transitions) {
+    if (t.timer_type == timer_kind::when) return true;
+  }
+  return false;
+}
+
+// Armed deadlines and periods, only present with TimerService
+template <typename Clock, std::size_t TimerCount>
+struct timer_service_state {
+  deadline_heap<typename Clock::time_point, TimerCount> heap{};
+  std::array<typename Clock::duration, TimerCount> period{};
+};
+
+struct no_timer_service {};
+}  // namespace detail
+
 struct Instance {
   constexpr Instance() = default;
   Instance(const Instance&) = delete;
@@ -278,6 +472,45 @@ template <std::size_t N, typename... Partials>
                std::forward<Partials>(partials)...);
 }
 
+// Orthogonal region of the enclosing state. A state with regions keeps one
+// active leaf per region; every region sees each dispatched event.
+//   state("running", region("audio", initial(target("muted")), ...),
+//                    region("video", initial(target("paused")), ...))
+template <typename Name, typename... Partials>
+[[nodiscard]] constexpr auto region(Name name, Partials&&... partials) {
+  using name_type = std::decay_t<Name>;
+  return detail::region_expr<name_type, std::decay_t<Partials>...>{
+      name_type{name},
+      detail::make_node_tuple(std::forward<Partials>(partials)...)};
+}
+
+template <std::size_t N, typename... Partials>
+[[nodiscard]] constexpr auto region(const char (&name)[N],
+                                    Partials&&... partials) {
+  return region(detail::make_fixed_string(name),
+                std::forward<Partials>(partials)...);
+}
+
+// Submachine state: while active it runs SubModel, a model defined on its
+// own, against the same instance. Every usage of a sub-model shares one
+// compiled copy of its tables and behaviors; a usage only adds its own
+// entries, exits and transitions, and the sub machine's runtime state.
+//   constexpr auto retry = define("retry", ...);
+//   state(..., submachine<retry>("fetch", transition(on("abort"), target("/m/idle"))))
+template <auto SubModel, typename Name, typename... Partials>
+[[nodiscard]] constexpr auto submachine(Name name, Partials&&... partials) {
+  using name_type = std::decay_t<Name>;
+  return detail::submachine_expr<SubModel, name_type, std::decay_t<Partials>...>{
+      name_type{name},
+      detail::make_node_tuple(std::forward<Partials>(partials)...)};
+}
+
+template <auto SubModel, std::size_t N, typename... Partials>
+[[nodiscard]] constexpr auto submachine(const char (&name)[N], Partials&&... partials) {
+  return submachine<SubModel>(detail::make_fixed_string(name),
+                              std::forward<Partials>(partials)...);
+}
+
 template <typename... Partials>
 [[nodiscard]] constexpr auto transition(Partials&&... partials) {
   return detail::transition_expr<std::decay_t<Partials>...>{
@@ -478,18 +711,121 @@ template <std::size_t N, typename... Partials>
 template <auto Model, typename InstanceType = Instance,
           typename TaskProvider = SequentialTaskProvider,
           typename Clock = cthsm::Clock, typename ContextType = cthsm::Context,
-          std::size_t MaxDeferred = 16>
+          std::size_t MaxDeferred = 16,
+          table_layout Layout = table_layout::dense,
+          dispatch_mode Dispatch = dispatch_mode::table,
+          typename Timers = TaskTimers<>, typename Observer = NoObserver>
 struct compile {
+  // Parents run the runner of their sub-models
+  template <auto, typename, typename, typename, typename, std::size_t, table_layout,
+            dispatch_mode, typename, typename>
+  friend struct compile;
+
   static constexpr auto model_ = Model;
   using instance_type = InstanceType;
   using TaskProviderType = TaskProvider;
   using ClockType = Clock;
   using context_type = ContextType;
   static constexpr std::size_t max_deferred_events = MaxDeferred;
+  static constexpr table_layout layout = Layout;
+  static constexpr dispatch_mode dispatch_kind = Dispatch;
+  using timer_policy = Timers;
+  static constexpr bool uses_timer_service = detail::is_timer_service<Timers>::value;
+  using observer_type = Observer;
+  static constexpr bool observed = !std::is_same_v<Observer, NoObserver>;
+  // Built with HSM_USDT: transition programs carry the observe actions for
+  // the enter/exit probes whatever the Observer
+  static constexpr bool probed = hsm::usdt::enabled;
+  static constexpr bool times_steps = requires(std::size_t id, typename Clock::duration d) {
+    Observer::on_complete(id, id, d);
+  };
+  static constexpr bool times_dwell = requires(std::size_t id, typename Clock::duration d) {
+    Observer::on_dwell(id, d);
+  };
+  static constexpr bool profiles_behaviors = requires(std::size_t id, behavior_cost c) {
+    Observer::on_behavior(behavior_kind::entry, id, c);
+  };
 
   // 1. Model Normalization & Tables
   static constexpr auto normalized_model = detail::normalize<model_>();
-  static constexpr auto tables = detail::build_tables(normalized_model);
+  // Compile-time only; runtime code reads `tables` (and the compressed
+  // lookup), so this copy is never emitted.
+  static constexpr auto dense_tables = detail::build_tables(normalized_model);
+
+  static consteval auto make_tables() {
+    if constexpr (Layout == table_layout::compressed) {
+      return detail::without_transition_table(dense_tables);
+    } else {
+      return dense_tables;
+    }
+  }
+
+  static consteval auto make_compressed_transitions() {
+    if constexpr (Layout == table_layout::compressed) {
+      constexpr auto shape = detail::measure_compression(dense_tables);
+      return detail::compress_transition_table<shape>(dense_tables);
+    } else {
+      return detail::no_compressed_table{};
+    }
+  }
+
+  static constexpr auto tables = make_tables();
+  static constexpr auto compressed_transitions = make_compressed_transitions();
+
+  // Depth/ancestor rows and O(1) LCA for paths only known at runtime
+  static constexpr auto ancestry = detail::build_ancestry(normalized_model);
+
+  // Composites targeted by history pseudostates; only these record history
+  static constexpr std::size_t history_composite_count =
+      detail::count_history_composites(normalized_model);
+  static constexpr auto history_slots =
+      detail::build_history_index<history_composite_count>(normalized_model);
+
+  // when() conditions checked after each run-to-completion step
+  static constexpr bool evaluates_conditions =
+      Timers::conditions == when_mode::on_step && detail::has_when_timers(normalized_model);
+
+  // Active-leaf slots; more than one only with orthogonal regions
+  static constexpr bool has_regions = detail::has_regions(normalized_model);
+  static constexpr std::size_t leaf_slot_count =
+      detail::count_leaf_slots(normalized_model);
+  static constexpr auto region_layout =
+      detail::build_region_layout<leaf_slot_count>(normalized_model);
+
+  // Flattened exit/effect/entry/initial-chain program of every transition
+  static constexpr std::size_t program_length =
+      detail::measure_programs(normalized_model, dense_tables, observed || probed);
+  static constexpr auto programs =
+      detail::build_programs<program_length>(normalized_model, dense_tables, observed || probed);
+
+  // States where completion can fire: those with completion transitions,
+  // and final states, which complete their parent. Completion is skipped
+  // for every other state, and compiled out for models with none.
+  static consteval auto make_completion_states() {
+    std::array<bool, decltype(normalized_model)::state_count> states{};
+    for (std::size_t s = 0; s < states.size(); ++s) {
+      states[s] = dense_tables.completion_transitions_ranges[s].count > 0 ||
+                  detail::any(normalized_model.states[s].flags, detail::state_flags::final);
+    }
+    return states;
+  }
+
+  static constexpr auto completion_states = make_completion_states();
+  static constexpr bool has_completion = [] {
+    for (bool completes : completion_states) {
+      if (completes) return true;
+    }
+    return false;
+  }();
+
+  static constexpr std::size_t find_transition(std::size_t state_id,
+                                               std::size_t event_id) {
+    if constexpr (Layout == table_layout::compressed) {
+      return compressed_transitions.get_transition_id(state_id, event_id);
+    } else {
+      return tables.transition_table[state_id][event_id];
+    }
+  }
 
   // 2. Behavior Extraction
   static constexpr auto entry_tuple = detail::extract_entries(model_);
@@ -499,6 +835,16 @@ struct compile {
   static constexpr auto effect_tuple = detail::extract_effects(model_);
   static constexpr auto timer_tuple = detail::extract_timers(model_);
 
+  // Sub-models of the submachine states, in state order. A usage runs the
+  // sub-model's own compile<> with the same policies, so its tables and
+  // thunks are instantiated once however often it is used.
+  using submachine_list = decltype(detail::extract_submachines(model_));
+  static constexpr std::size_t submachine_count = std::tuple_size_v<submachine_list>;
+  template <std::size_t I>
+  using submachine_type = compile<std::tuple_element_t<I, submachine_list>::model, InstanceType,
+                                  TaskProvider, Clock, ContextType, MaxDeferred, Layout, Dispatch,
+                                  Timers, Observer>;
+
   // 3. Activity Tracking Definitions
   static constexpr std::size_t total_activity_count =
       std::tuple_size_v<decltype(activity_tuple)>;
@@ -513,9 +859,14 @@ struct compile {
   };
 
   // 4. Thunk Types & Functions
+ private:
+  struct runner;
+
+ public:
   using behavior_fn = void (*)(ContextType&, instance_type&, const EventBase&);
   using guard_fn = bool (*)(ContextType&, instance_type&, const EventBase&);
-  using timer_fn = void (*)(ContextType&, instance_type&, const EventBase&, std::size_t, compile&, detail::timer_kind); 
+  using timer_fn = void (*)(ContextType&, instance_type&, const EventBase&, std::size_t, runner&, detail::timer_kind);
+  using schedule_fn = void (*)(ContextType&, instance_type&, const EventBase&, runner&, detail::timer_kind);
 
   template <typename F>
   static constexpr auto invoke(F&& f, ContextType& c, instance_type& i,
@@ -537,12 +888,13 @@ struct compile {
     } else if constexpr (std::is_invocable_v<F>) {
       return f();
     } else {
-      // Typed event check
+      // Typed event check: one integer compare of type ids, which folds
+      // away where the dispatched event type is known after inlining
       using ArgType =
           typename detail::extract_event_type<std::decay_t<F>>::type;
       if constexpr (!std::is_void_v<ArgType> &&
                     !std::is_same_v<ArgType, EventBase>) {
-        if (e.name() == detail::type_name<ArgType>()) {
+        if (e.type_id() == detail::event_type_id<ArgType>) {
           if constexpr (std::is_invocable_v<F, ContextType&, EffInst&,
                                             const ArgType&>) {
             return f(c, eff_i, static_cast<const ArgType&>(e));
@@ -570,12 +922,30 @@ struct compile {
     }
   }
 
-  template <std::size_t I> static void entry_thunk(ContextType& c, instance_type& i, const EventBase& e) { invoke(std::get<I>(entry_tuple), c, i, e); }
-  template <std::size_t I> static void exit_thunk(ContextType& c, instance_type& i, const EventBase& e) { invoke(std::get<I>(exit_tuple), c, i, e); }
-  template <std::size_t I> static void activity_thunk(ContextType& c, instance_type& i, const EventBase& e) { invoke(std::get<I>(activity_tuple), c, i, e); }
-  template <std::size_t I> static void effect_thunk(ContextType& c, instance_type& i, const EventBase& e) { invoke(std::get<I>(effect_tuple), c, i, e); }
-  template <std::size_t I> static bool guard_thunk(ContextType& c, instance_type& i, const EventBase& e) { return invoke(std::get<I>(guard_tuple), c, i, e); }
-  template <std::size_t I> static void timer_thunk(ContextType& c, instance_type& i, const EventBase& e, std::size_t /*id*/, compile& self, detail::timer_kind kind) {
+  // Calls behavior I of a kind, timed for Observer::on_behavior if declared
+  template <behavior_kind Kind, std::size_t I, typename F>
+  static auto profiled(F&& call) {
+    if constexpr (profiles_behaviors) {
+      const auto started = cost_clock::now();
+      if constexpr (std::is_void_v<decltype(call())>) {
+        call();
+        Observer::on_behavior(Kind, I, cost_clock::since(started));
+      } else {
+        auto result = call();
+        Observer::on_behavior(Kind, I, cost_clock::since(started));
+        return result;
+      }
+    } else {
+      return call();
+    }
+  }
+
+  template <std::size_t I> static void entry_thunk(ContextType& c, instance_type& i, const EventBase& e) { profiled<behavior_kind::entry, I>([&] { invoke(std::get<I>(entry_tuple), c, i, e); }); }
+  template <std::size_t I> static void exit_thunk(ContextType& c, instance_type& i, const EventBase& e) { profiled<behavior_kind::exit, I>([&] { invoke(std::get<I>(exit_tuple), c, i, e); }); }
+  template <std::size_t I> static void activity_thunk(ContextType& c, instance_type& i, const EventBase& e) { profiled<behavior_kind::activity, I>([&] { invoke(std::get<I>(activity_tuple), c, i, e); }); }
+  template <std::size_t I> static void effect_thunk(ContextType& c, instance_type& i, const EventBase& e) { profiled<behavior_kind::effect, I>([&] { invoke(std::get<I>(effect_tuple), c, i, e); }); }
+  template <std::size_t I> static bool guard_thunk(ContextType& c, instance_type& i, const EventBase& e) { return profiled<behavior_kind::guard, I>([&]() -> bool { return invoke(std::get<I>(guard_tuple), c, i, e); }); }
+  template <std::size_t I> static void timer_thunk(ContextType& c, instance_type& i, const EventBase& e, std::size_t /*id*/, runner& self, detail::timer_kind kind) {
       // Dispatch based logic: 
       // 1. Find transition associated with this timer index
       // 2. Get event name from transition
@@ -585,7 +955,7 @@ struct compile {
           using RetType = decltype(invoke(std::get<I>(timer_tuple), c, i, e));
           if constexpr (detail::is_duration_v<RetType>) {
               auto d = invoke(std::get<I>(timer_tuple), c, i, e);
-              self.task_provider_.sleep_for(std::chrono::duration_cast<std::chrono::milliseconds>(d), &c);
+              self.provider_->sleep_for(std::chrono::duration_cast<std::chrono::milliseconds>(d), &c);
               if (!c.is_set()) {
                   self.dispatch_timer_event(i, I); // dispatch event for timer I
               }
@@ -595,7 +965,7 @@ struct compile {
           if constexpr (detail::is_duration_v<RetType>) {
               auto d = invoke(std::get<I>(timer_tuple), c, i, e);
               while (!c.is_set()) {
-                  self.task_provider_.sleep_for(std::chrono::duration_cast<std::chrono::milliseconds>(d), &c);
+                  self.provider_->sleep_for(std::chrono::duration_cast<std::chrono::milliseconds>(d), &c);
                   if (c.is_set()) break;
                   self.dispatch_timer_event(i, I);
               }
@@ -604,7 +974,7 @@ struct compile {
           if constexpr (std::is_same_v<decltype(invoke(std::get<I>(timer_tuple), c, i, e)), bool>) {
                bool res = invoke(std::get<I>(timer_tuple), c, i, e);
                while (!res && !c.is_set()) {
-                   self.task_provider_.sleep_for(std::chrono::milliseconds(10), &c);
+                   self.provider_->sleep_for(std::chrono::milliseconds(10), &c);
                    if (c.is_set()) break;
                    res = invoke(std::get<I>(timer_tuple), c, i, e);
                }
@@ -627,13 +997,61 @@ struct compile {
           auto now = Clock::now();
           auto d = tp - now;
               if (d.count() > 0) {
-                 self.task_provider_.sleep_for(std::chrono::duration_cast<std::chrono::milliseconds>(d), &c);
+                 self.provider_->sleep_for(std::chrono::duration_cast<std::chrono::milliseconds>(d), &c);
               }
               if (!c.is_set()) self.dispatch_timer_event(i, I);
           }
       }
   }
 
+  // TimerService: computes the deadline (and period, for every) of timer I
+  // and puts it on the heap. `when` timers are conditions, not deadlines,
+  // and keep running as tasks.
+  template <std::size_t I> static void schedule_thunk(ContextType& c, instance_type& i, const EventBase& e, runner& self, detail::timer_kind kind) {
+      using duration = typename Clock::duration;
+      auto& service = self.state_->timer_service;
+      const auto now = Clock::now();
+      if (kind == detail::timer_kind::after || kind == detail::timer_kind::every) {
+          using RetType = decltype(invoke(std::get<I>(timer_tuple), c, i, e));
+          if constexpr (detail::is_duration_v<RetType>) {
+              auto d = std::chrono::duration_cast<duration>(invoke(std::get<I>(timer_tuple), c, i, e));
+              if (kind == detail::timer_kind::every) {
+                  // A zero period would fire forever within one poll
+                  if (d <= duration::zero()) d = duration{1};
+                  service.period[I] = d;
+              } else {
+                  service.period[I] = duration::zero();
+              }
+              service.heap.schedule(I, now + d);
+          }
+      } else if (kind == detail::timer_kind::at) {
+          auto tp = invoke(std::get<I>(timer_tuple), c, i, e);
+          using TP = decltype(tp);
+          if constexpr (detail::is_duration_v<TP> || std::is_same_v<TP, bool> || std::is_void_v<TP>) {
+              // Mismatched return type: never fires
+          } else {
+              service.period[I] = duration::zero();
+              if constexpr (std::is_same_v<typename TP::clock, Clock>) {
+                  service.heap.schedule(I, std::chrono::time_point_cast<duration>(tp));
+              } else {
+                  service.heap.schedule(
+                      I, now + std::chrono::duration_cast<duration>(tp - TP::clock::now()));
+              }
+          }
+      }
+  }
+
+  // when_mode::on_step: evaluates the condition of when timer I. A
+  // condition that returns nothing counts as satisfied.
+  template <std::size_t I> static bool condition_thunk(ContextType& c, instance_type& i, const EventBase& e) {
+      if constexpr (std::is_same_v<decltype(invoke(std::get<I>(timer_tuple), c, i, e)), bool>) {
+          return invoke(std::get<I>(timer_tuple), c, i, e);
+      } else {
+          invoke(std::get<I>(timer_tuple), c, i, e);
+          return true;
+      }
+  }
+
   template <std::size_t... Is>
   static constexpr auto make_entry_table(std::index_sequence<Is...>) {
     return std::array<behavior_fn, sizeof...(Is)>{&entry_thunk<Is>...};
@@ -658,6 +1076,14 @@ struct compile {
   static constexpr auto make_timer_table(std::index_sequence<Is...>) {
     return std::array<timer_fn, sizeof...(Is)>{&timer_thunk<Is>...};
   }
+  template <std::size_t... Is>
+  static constexpr auto make_condition_table(std::index_sequence<Is...>) {
+    return std::array<guard_fn, sizeof...(Is)>{&condition_thunk<Is>...};
+  }
+  template <std::size_t... Is>
+  static constexpr auto make_schedule_table(std::index_sequence<Is...>) {
+    return std::array<schedule_fn, sizeof...(Is)>{&schedule_thunk<Is>...};
+  }
 
   static constexpr auto entry_table = make_entry_table(
       std::make_index_sequence<std::tuple_size_v<decltype(entry_tuple)>>{});
@@ -671,51 +1097,240 @@ struct compile {
       std::make_index_sequence<std::tuple_size_v<decltype(guard_tuple)>>{});
   static constexpr auto timer_table = make_timer_table(
       std::make_index_sequence<std::tuple_size_v<decltype(timer_tuple)>>{});
+  static consteval auto make_schedule_table() {
+    if constexpr (uses_timer_service) {
+      return make_schedule_table(
+          std::make_index_sequence<std::tuple_size_v<decltype(timer_tuple)>>{});
+    } else {
+      return std::array<schedule_fn, 0>{};
+    }
+  }
+
+  static constexpr auto schedule_table = make_schedule_table();
+
+  static consteval auto make_condition_table() {
+    if constexpr (evaluates_conditions) {
+      return make_condition_table(
+          std::make_index_sequence<std::tuple_size_v<decltype(timer_tuple)>>{});
+    } else {
+      return std::array<guard_fn, 0>{};
+    }
+  }
+
+  static constexpr auto condition_table = make_condition_table();
+
+  // Direct (inlinable) calls of a contiguous behavior range, used by the
+  // inlined dispatch mode instead of looping over the tables above.
+  template <std::size_t First, std::size_t... Is> static void call_entries(ContextType& c, instance_type& i, const EventBase& e, std::index_sequence<Is...>) { (entry_thunk<First + Is>(c, i, e), ...); }
+  template <std::size_t First, std::size_t... Is> static void call_exits(ContextType& c, instance_type& i, const EventBase& e, std::index_sequence<Is...>) { (exit_thunk<First + Is>(c, i, e), ...); }
+  template <std::size_t First, std::size_t... Is> static void call_effects(ContextType& c, instance_type& i, const EventBase& e, std::index_sequence<Is...>) { (effect_thunk<First + Is>(c, i, e), ...); }
 
-  // 5. Data Members
-  TaskProvider task_provider_;
+  // Per-state handlers for dispatch_mode::inlined, indexed by state id.
+  using state_handler_fn = bool (*)(runner&, ContextType&, instance_type&, const EventBase&, std::size_t);
 
-  std::array<std::size_t, max_deferred_events> deferred_queue_;
-  std::size_t deferred_count_;
+  template <std::size_t S>
+  static bool state_handler(runner& self, ContextType& c, instance_type& i, const EventBase& e, std::size_t event_id) {
+    return self.dispatch_inlined<S>(c, i, e, event_id, std::make_index_sequence<runner::template inlined_events<S>.size()>{});
+  }
+
+  template <std::size_t... Ss>
+  static constexpr auto make_state_handler_table(std::index_sequence<Ss...>) {
+    return std::array<state_handler_fn, sizeof...(Ss)>{&state_handler<Ss>...};
+  }
+
+  // Models with regions always use the table engine, so dispatch_mode::inlined
+  // leaves this table empty for them (see docs/cthsm.md, Dispatch Mode).
+  static consteval auto make_inlined_dispatch_table() {
+    if constexpr (Dispatch == dispatch_mode::inlined && !has_regions) {
+      return make_state_handler_table(
+          std::make_index_sequence<decltype(normalized_model)::state_count>{});
+    } else {
+      return std::array<state_handler_fn, 0>{};
+    }
+  }
+
+  static constexpr auto inlined_dispatch_table = make_inlined_dispatch_table();
 
-  std::array<ContextType, total_activity_count> activity_contexts_;
-  std::array<std::optional<ActiveTask>, total_activity_count> active_tasks_;
+  // 5. Per-instance State
+  //
+  // Everything a machine changes while it runs; the tables, programs and
+  // thunks above are static. Parts a model does not use are empty types, so
+  // a machine without activities, timers, deferral, history or regions
+  // stores only the compact id of its active state.
+  using state_index = detail::compact_index_t<decltype(normalized_model)::state_count>;
+  using event_index = detail::compact_index_t<decltype(normalized_model)::event_count>;
+  static constexpr state_index no_state = std::numeric_limits<state_index>::max();
+
+  // Deferred events are only queued by models that defer any
+  static constexpr std::size_t deferral_capacity =
+      decltype(normalized_model)::deferred_count > 0 ? max_deferred_events : 0;
+
+  using history_type = detail::history_record<state_index, history_composite_count>;
+
+  template <std::size_t... Is>
+  static auto make_submachine_states(std::index_sequence<Is...>)
+      -> std::tuple<typename submachine_type<Is>::machine_state...>;
+  using submachine_states =
+      decltype(make_submachine_states(std::make_index_sequence<submachine_count>{}));
+  using timer_service_type =
+      std::conditional_t<uses_timer_service, detail::timer_service_state<Clock, total_timer_count>,
+                         detail::no_timer_service>;
+
+  struct machine_state {
+    state_index current{no_state};
+    [[no_unique_address]] detail::deferral_queue<event_index, deferral_capacity> deferred{};
+    // For UML 2.5 history pseudostates we store, for each composite targeted
+    // by a history pseudostate, the most recently active descendant leaf.
+    // This allows implementing both shallow and deep history:
+    //   - deep history: use the stored leaf directly
+    //   - shallow history: map the stored leaf to the direct child of the
+    //     composite and then follow its default initial chain
+    [[no_unique_address]] history_type history{};
+    [[no_unique_address]] detail::region_leaves<has_regions ? leaf_slot_count : 0> regions{};
+    [[no_unique_address]] detail::task_slots<ContextType, ActiveTask, total_activity_count, 0>
+        activities{};
+    [[no_unique_address]] detail::pending_activities<total_activity_count> pending{};
+    [[no_unique_address]] detail::task_slots<ContextType, ActiveTask, total_timer_count, 1>
+        timers{};
+    [[no_unique_address]] timer_service_type timer_service{};
+    [[no_unique_address]] detail::condition_slots<evaluates_conditions ? total_timer_count : 0>
+        conditions{};
+    // Runtime state of each submachine state's sub machine
+    [[no_unique_address]] submachine_states submachines{};
+    [[no_unique_address]] detail::entry_times<typename Clock::time_point,
+                                              times_dwell ? decltype(normalized_model)::state_count
+                                                          : 0>
+        entered{};
+  };
+
+  // Whether any activity or timer of the model runs as a TaskProvider task.
+  // Machines that need none can also be run from a bare machine_state.
+  static constexpr bool needs_task_provider =
+      total_activity_count > 0 ||
+      (total_timer_count > 0 &&
+       !(uses_timer_service && (evaluates_conditions || !detail::has_when_timers(normalized_model))));
+
+  // Whether an activity that returns by itself only flags its return, for
+  // the dispatching thread to complete (TaskProviders that run tasks on
+  // threads of their own opt in with defers_activity_completion)
+  static constexpr bool defers_completion =
+      total_activity_count > 0 && detail::defers_activity_completion<TaskProvider>();
+
+  // Activities and timers that run as TaskProvider tasks. All of them can be
+  // running at once, so a provider with fixed task slots needs this many; a
+  // task that cannot get a slot would wait for a context only this
+  // machine's dispatching thread can set.
+  static constexpr std::size_t task_slot_count = [] {
+    std::size_t n = total_activity_count;
+    for (const auto& timer : tables.state_timer_list) {
+      const bool when = timer.kind == detail::timer_kind::when;
+      if (when ? !evaluates_conditions : !uses_timer_service) ++n;
+    }
+    return n;
+  }();
+  static_assert(task_slot_count <= detail::task_capacity<TaskProvider>(),
+                "the TaskProvider's queue_depth is below the model's task_slot_count (activities and "
+                "task timers that can run at once)");
+  // Activities and task timers hold a worker until they return or are
+  // cancelled; one that waits for a worker would never run, and a timer
+  // would never fire
+  static_assert(task_slot_count <= detail::task_concurrency<TaskProvider>(),
+                "the TaskProvider's worker_count is below the model's task_slot_count (activities and "
+                "task timers that can run at once)");
+
+  static constexpr std::size_t current_of(const machine_state& m) noexcept {
+    return m.current == no_state ? detail::invalid_index : m.current;
+  }
 
-  std::array<ContextType, total_timer_count> timer_contexts_;
-  std::array<std::optional<ActiveTask>, total_timer_count> active_timer_tasks_;
+  // Submachine bindings: the usage index of every submachine state, and per
+  // usage a handful of thunks that run submachine_type<I> on its slot of
+  // machine_state::submachines.
+  static_assert(submachine_count == 0 || !has_regions,
+                "submachine states cannot be used in models with orthogonal regions");
+
+  static consteval auto make_submachine_slots() {
+    std::array<std::size_t, decltype(normalized_model)::state_count> slots{};
+    std::size_t next = 0;
+    for (std::size_t s = 0; s < slots.size(); ++s) {
+      slots[s] = detail::any(normalized_model.states[s].flags, detail::state_flags::submachine)
+                     ? next++
+                     : detail::invalid_index;
+    }
+    return slots;
+  }
+  static constexpr auto submachine_slots = make_submachine_slots();
+
+  struct submachine_binding {
+    void (*enter)(runner&, instance_type&, const EventBase&);
+    void (*exit)(runner&, instance_type&, const EventBase&);
+    bool (*offer)(runner&, instance_type&, const EventBase&, std::size_t);
+    bool (*finished)(runner&);
+    std::string_view (*state)(const machine_state&);
+  };
 
-  // For UML 2.5 history pseudostates we store, for each state, the most
-  // recently active descendant leaf. This allows implementing both
-  // shallow and deep history:
-  //   - deep history: use the stored leaf directly
-  //   - shallow history: map the stored leaf to the direct child of the
-  //     composite and then follow its default initial chain
-  std::array<std::size_t, decltype(normalized_model)::state_count> last_active_leaf_{};
+  // Event ids of the sub-model for this model's events
+  template <std::size_t I>
+  static consteval auto make_submachine_events() {
+    std::array<std::size_t, decltype(normalized_model)::event_count> ids{};
+    for (std::size_t ev = 0; ev < ids.size(); ++ev) {
+      ids[ev] = submachine_type<I>::tables.get_event_id(normalized_model.get_event_name(ev));
+    }
+    return ids;
+  }
 
-  std::size_t current_state_id_;
+  template <std::size_t I>
+  static constexpr auto sub_runner(runner& self) {
+    using sub = submachine_type<I>;
+    // Sub-model tasks would complete behind the parent's back
+    static_assert(sub::total_activity_count == 0 && sub::total_timer_count == 0,
+                  "sub-models cannot own activities or timers; put them on the submachine state");
+    return typename sub::runner{&std::get<I>(self.state_->submachines), self.provider_};
+  }
+  template <std::size_t I> static void submachine_enter(runner& self, instance_type& i, const EventBase& e) {
+    sub_runner<I>(self).start(i, e);
+  }
+  template <std::size_t I> static void submachine_exit(runner& self, instance_type& i, const EventBase& e) {
+    sub_runner<I>(self).exit_nested(i, e);
+  }
+  template <std::size_t I> static bool submachine_offer(runner& self, instance_type& i, const EventBase& e, std::size_t event_id) {
+    static constexpr auto events = make_submachine_events<I>();
+    // Events this model does not know may still be the sub-model's
+    const std::size_t sub_event = event_id != detail::invalid_index
+                                      ? events[event_id]
+                                      : submachine_type<I>::tables.get_event_id(e.name());
+    return sub_runner<I>(self).dispatch_by_id(i, e, sub_event);
+  }
+  template <std::size_t I> static bool submachine_finished(runner& self) {
+    return sub_runner<I>(self).finished_nested();
+  }
+  template <std::size_t I> static std::string_view submachine_state_of(const machine_state& m) {
+    return submachine_type<I>::state(std::get<I>(m.submachines));
+  }
 
-  // 6. Constructor & Destructor
-  constexpr compile(TaskProvider tp = {}) noexcept
-      : task_provider_(std::move(tp)),
-        deferred_queue_{},
-        deferred_count_{0},
-        activity_contexts_{},
-        active_tasks_{},
-        timer_contexts_{},
-        active_timer_tasks_{},
-        last_active_leaf_{},
-        current_state_id_(detail::invalid_index) {
-    last_active_leaf_.fill(detail::invalid_index);
+  template <std::size_t... Is>
+  static constexpr auto make_submachine_table(std::index_sequence<Is...>) {
+    return std::array<submachine_binding, sizeof...(Is)>{
+        submachine_binding{&submachine_enter<Is>, &submachine_exit<Is>, &submachine_offer<Is>,
+                           &submachine_finished<Is>, &submachine_state_of<Is>}...};
   }
+  static constexpr auto submachine_table =
+      make_submachine_table(std::make_index_sequence<submachine_count>{});
+
+  // 6. Data Members
+  [[no_unique_address]] TaskProvider task_provider_;
+  machine_state state_;
+
+  // 7. Constructor & Destructor
+  constexpr compile(TaskProvider tp = {}) noexcept : task_provider_(std::move(tp)), state_{} {}
 
   ~compile() {
     // Cancel all active tasks to unblock threads waiting on contexts
-    for (auto& task_opt : active_tasks_) {
+    for (auto& task_opt : state_.activities.tasks) {
       if (task_opt.has_value()) {
         task_opt->ctx->set();
       }
     }
-    for (auto& task_opt : active_timer_tasks_) {
+    for (auto& task_opt : state_.timers.tasks) {
       if (task_opt.has_value()) {
         task_opt->ctx->set();
       }
@@ -723,555 +1338,1431 @@ struct compile {
     // Member destructors will join tasks now that they are signalled
   }
 
-  // 7. Accessor
-  [[nodiscard]] constexpr std::string_view state() const noexcept {
-    if (current_state_id_ == detail::invalid_index) return "";
-    return normalized_model.get_state_name(current_state_id_);
+  // 8. Accessors
+  [[nodiscard]] static constexpr std::string_view state(const machine_state& m) noexcept {
+    if (m.current == no_state) return "";
+    return normalized_model.get_state_name(m.current);
   }
 
-  // 8. Public Methods
-  constexpr void start(instance_type& instance) {
-    // Reset
-    deferred_count_ = 0;
-    current_state_id_ = 0;  // Root
-    last_active_leaf_.fill(detail::invalid_index);
-
-    // Enter root
-    ContextType ctx{};
-    EventBase e{"init"};
-    enter_state(ctx, instance, e, 0);
-
-    resolve_initial(ctx, instance, e, 0);
-    resolve_completion(ctx, instance);
+  // Active leaf states: one per active region, otherwise just state()
+  [[nodiscard]] static constexpr std::size_t active_state_count(const machine_state& m) noexcept {
+    if constexpr (has_regions) {
+      std::size_t n = 0;
+      for (std::size_t leaf : m.regions.leaves) n += leaf != detail::invalid_index ? 1 : 0;
+      return n;
+    } else {
+      return m.current == no_state ? 0 : 1;
+    }
   }
 
-  constexpr void dispatch(instance_type& instance,
-                          std::string_view event_name) noexcept {
-    EventBase e{event_name};
-
-    dispatch_internal(instance, e, event_name);
+  [[nodiscard]] static constexpr std::string_view active_state(const machine_state& m,
+                                                               std::size_t index) noexcept {
+    if constexpr (has_regions) {
+      for (std::size_t leaf : m.regions.leaves) {
+        if (leaf == detail::invalid_index) continue;
+        if (index-- == 0) return normalized_model.get_state_name(leaf);
+      }
+      return "";
+    } else {
+      return index == 0 ? state(m) : "";
+    }
   }
 
-  template <typename T>
-  constexpr void dispatch(instance_type& instance) noexcept {
-    static_assert(
-        std::is_base_of_v<EventBase, T> || std::is_base_of_v<Event<T>, T>,
-        "Must be an Event");
-    T e{};
-    
-    if constexpr (std::is_same_v<T, EventBase> || std::is_same_v<T, Event<void>>) {
-        dispatch_internal(instance, e, e.name());
+  // Whether the state at `path` (a leaf or any ancestor) is active
+  [[nodiscard]] static constexpr bool is_active(const machine_state& m,
+                                                std::string_view path) noexcept {
+    std::size_t s = 0;
+    while (s < normalized_model.states.size() &&
+           normalized_model.get_state_name(s) != path) {
+      ++s;
+    }
+    if (s == normalized_model.states.size()) return false;
+    const auto contains = [&](std::size_t leaf) {
+      return leaf != detail::invalid_index && ancestry.depth[leaf] >= ancestry.depth[s] &&
+             ancestry.ancestor_at(leaf, ancestry.depth[s]) == s;
+    };
+    if constexpr (has_regions) {
+      for (std::size_t leaf : m.regions.leaves) {
+        if (contains(leaf)) return true;
+      }
+      return false;
     } else {
-        // Compile-time lookup for typed events
-        constexpr std::size_t id = tables.get_event_id(detail::type_name<T>());
-        dispatch_by_id(instance, e, id);
+      return contains(current_of(m));
     }
   }
 
-  template <typename T>
-  constexpr void dispatch(instance_type& instance, const T& e) noexcept {
-    static_assert(std::is_base_of_v<EventBase, T>, "Must be an Event");
-    
-    if constexpr (std::is_same_v<T, EventBase> || std::is_same_v<T, Event<void>>) {
-        dispatch_internal(instance, e, e.name());
-    } else {
-         // Compile-time lookup for typed events
-        constexpr std::size_t id = tables.get_event_id(detail::type_name<T>());
-        dispatch_by_id(instance, e, id);
+  // Active leaf of the sub machine run by the submachine state at `path`;
+  // empty while that state is inactive
+  [[nodiscard]] static constexpr std::string_view submachine_state(const machine_state& m,
+                                                                   std::string_view path) noexcept {
+    if constexpr (submachine_count > 0) {
+      for (std::size_t s = 0; s < normalized_model.states.size(); ++s) {
+        if (normalized_model.get_state_name(s) != path) continue;
+        const std::size_t slot = submachine_slots[s];
+        return slot == detail::invalid_index ? "" : submachine_table[slot].state(m);
+      }
     }
+    return "";
   }
 
- private:
-  constexpr void dispatch_by_id(instance_type& instance, const EventBase& e, std::size_t event_id) {
-     ContextType ctx{};
-     
-     if (event_id != detail::invalid_index && is_deferred(current_state_id_, event_id)) {
-         if (deferred_count_ < max_deferred_events) {
-             deferred_queue_[deferred_count_++] = event_id;
-         }
-         return;
-     }
-     
-     bool handled = dispatch_event_impl(ctx, instance, e, event_id);
-     
-     if (handled) {
-         process_deferred(instance);
-     }
-  }
-
-  constexpr void dispatch_internal(instance_type& instance, const EventBase& e, std::string_view event_name) {
-     std::size_t event_id = tables.get_event_id(event_name);
-     dispatch_by_id(instance, e, event_id);
+  [[nodiscard]] constexpr std::string_view state() const noexcept { return state(state_); }
+  [[nodiscard]] constexpr std::size_t active_state_count() const noexcept {
+    return active_state_count(state_);
+  }
+  [[nodiscard]] constexpr std::string_view active_state(std::size_t index) const noexcept {
+    return active_state(state_, index);
+  }
+  [[nodiscard]] constexpr bool is_active(std::string_view path) const noexcept {
+    return is_active(state_, path);
+  }
+  [[nodiscard]] constexpr std::string_view submachine_state(std::string_view path) const noexcept {
+    return submachine_state(state_, path);
   }
 
- public:
-  // Removed handle_timer as per instruction.
+  // 9. Public Methods
+  constexpr void start(instance_type& instance) { run().start(instance); }
 
-  constexpr void on_activity_complete(instance_type& instance, std::size_t idx) {
-      if (idx < active_tasks_.size()) {
-          active_tasks_[idx].reset();
-      }
-      ContextType ctx{};
-      resolve_completion(ctx, instance);
+  // Re-evaluates the when() conditions of the active states, for changes
+  // made outside a dispatch (when_mode::on_step)
+  constexpr void notify_changed(instance_type& instance) { run().notify_changed(instance); }
+
+  constexpr void dispatch(instance_type& instance, std::string_view event_name) noexcept {
+    run().dispatch(instance, event_name);
   }
 
-  constexpr void dispatch_timer_event(instance_type& instance,
-                                      std::size_t timer_idx) {
-    if (timer_idx < tables.timer_transition_map.size()) {
-      std::size_t t_id = tables.timer_transition_map[timer_idx];
-      if (t_id != detail::invalid_index) {
-        std::size_t event_id = normalized_model.transitions[t_id].event_id;
-        if (event_id != detail::invalid_index) {
-          std::string_view event_name =
-              normalized_model.get_event_name(event_id);
-          dispatch(instance, event_name);
-        }
-      }
-    }
+  template <typename T>
+  constexpr void dispatch(instance_type& instance) noexcept {
+    run().template dispatch<T>(instance);
   }
 
- private:
-  constexpr bool is_deferred(std::size_t state, std::size_t event_id) const {
-    std::string_view event_name = normalized_model.get_event_name(event_id);
-    std::size_t curr = state;
-    while (curr != detail::invalid_index) {
-      const auto& st = normalized_model.states[curr];
-      for (std::size_t i = 0; i < st.defer_count; ++i) {
-        std::size_t def_id =
-            normalized_model.deferred_events[st.defer_start + i];
-        if (normalized_model.get_event_name(def_id) == event_name) return true;
-      }
-      curr = st.parent_id;
-    }
-    return false;
+  template <typename T>
+  constexpr void dispatch(instance_type& instance, const T& e) noexcept {
+    run().dispatch(instance, e);
   }
 
-  constexpr bool dispatch_event_impl(ContextType& ctx, instance_type& instance, const EventBase& e, std::size_t event_id) {
-      if (current_state_id_ == detail::invalid_index) return false;
-      
-      std::size_t curr = current_state_id_;
-      std::size_t t_id = detail::invalid_index;
+  constexpr void on_activity_complete(instance_type& instance, std::size_t idx) {
+    run().on_activity_complete(instance, idx);
+  }
 
-      if (event_id != detail::invalid_index) {
-        t_id = tables.transition_table[curr][event_id];
-        
-        while (t_id != detail::invalid_index) {
-          const auto& t = normalized_model.transitions[t_id];
+  // For providers that defer activity completion (defers_completion), such
+  // as ThreadPoolTaskProvider: releases the activities that returned on
+  // their own and runs the completion transitions they allow, returning how
+  // many returned. Every dispatch does this first; call it from the thread
+  // that dispatches events to complete without waiting for the next event.
+  // Other providers complete an activity as it returns, and this returns 0.
+  std::size_t poll_activities(instance_type& instance) {
+    return run().collect_activities(instance);
+  }
 
-          bool guard_passed = true;
-          if (t.guard_idx != detail::invalid_index) {
-            if (t.guard_idx < guard_table.size()) {
-              guard_passed = guard_table[t.guard_idx](ctx, instance, e);
-            }
-          }
+  // TimerService only: dispatches the event of every timer whose deadline
+  // has passed on Clock, earliest first, and returns how many fired. Call it
+  // from the thread that dispatches events, e.g. from an event loop that
+  // sleeps until next_timer_deadline().
+  std::size_t poll_timers(instance_type& instance) requires uses_timer_service {
+    return run().poll_timers(instance);
+  }
 
-          if (guard_passed) {
-            execute_transition(ctx, instance, e, t, t_id);
-            return true;
-          }
+  // TimerService only: the earliest armed deadline, if any
+  [[nodiscard]] std::optional<typename Clock::time_point> next_timer_deadline() const
+      requires uses_timer_service {
+    return next_timer_deadline(state_);
+  }
 
-          t_id = tables.next_candidate[t_id];
-        }
-      }
-      
-      // Fallback to wildcard
-      t_id = tables.get_wildcard_transition_id(curr);
+  constexpr void dispatch_timer_event(instance_type& instance, std::size_t timer_idx) {
+    run().dispatch_timer_event(instance, timer_idx);
+  }
 
-      while (t_id != detail::invalid_index) {
-        const auto& t = normalized_model.transitions[t_id];
+  // The same operations on a bare machine_state, for models that need no
+  // TaskProvider, so machines can be kept by the million in a flat vector:
+  //
+  //   std::vector<machine::machine_state> states(n);
+  //   machine::dispatch(states[k], instances[k], event);
+  static constexpr void start(machine_state& m, instance_type& instance)
+    requires(!needs_task_provider)
+  {
+    runner{&m, nullptr}.start(instance);
+  }
 
-        bool guard_passed = true;
-        if (t.guard_idx != detail::invalid_index) {
-          if (t.guard_idx < guard_table.size()) {
-            guard_passed = guard_table[t.guard_idx](ctx, instance, e);
-          }
-        }
+  static constexpr void notify_changed(machine_state& m, instance_type& instance)
+    requires(!needs_task_provider)
+  {
+    runner{&m, nullptr}.notify_changed(instance);
+  }
 
-        if (guard_passed) {
-          execute_transition(ctx, instance, e, t, t_id);
-          return true;
-        }
+  static constexpr void dispatch(machine_state& m, instance_type& instance,
+                                 std::string_view event_name) noexcept
+    requires(!needs_task_provider)
+  {
+    runner{&m, nullptr}.dispatch(instance, event_name);
+  }
 
-        t_id = tables.next_candidate[t_id];
-      }
+  template <typename T>
+  static constexpr void dispatch(machine_state& m, instance_type& instance, const T& e) noexcept
+    requires(!needs_task_provider)
+  {
+    runner{&m, nullptr}.dispatch(instance, e);
+  }
 
-      return false;
+  static std::size_t poll_timers(machine_state& m, instance_type& instance)
+    requires(uses_timer_service && !needs_task_provider)
+  {
+    return runner{&m, nullptr}.poll_timers(instance);
   }
 
-  constexpr void execute_transition(Context& ctx, instance_type& instance,
-                                    const EventBase& e, const auto& t, std::size_t t_id) {
-    if (t.target_id != detail::invalid_index || t.history != detail::history_kind::none) {
-      std::size_t target = t.target_id;
-      std::size_t old_state = current_state_id_;
-      std::size_t lca = detail::invalid_index;
+  [[nodiscard]] static std::optional<typename Clock::time_point> next_timer_deadline(
+      const machine_state& m)
+    requires uses_timer_service
+  {
+    if (m.timer_service.heap.empty()) return std::nullopt;
+    return m.timer_service.heap.top_deadline();
+  }
 
-      // History resolution (UML 2.5 shallow / deep)
-      if (t.history != detail::history_kind::none) {
-        std::size_t parent = t.history_parent;
-        if (parent != detail::invalid_index) {
-          std::size_t leaf = last_active_leaf_[parent];
-          if (leaf == detail::invalid_index) {
-            // No prior history recorded – fall back to the composite's
-            // default initial chain as per UML.
-            target = parent;
-          } else if (t.history == detail::history_kind::deep) {
-            // Deep history: re-enter the exact leaf configuration.
-            target = leaf;
-          } else {
-            // Shallow history: re-enter the last active direct child of
-            // the composite, then follow its default initial chain.
-            std::size_t child = leaf;
-            while (child != detail::invalid_index) {
-              std::size_t p = normalized_model.states[child].parent_id;
-              if (p == parent) break;
-              child = p;
-            }
-            target = (child != detail::invalid_index) ? child : parent;
-          }
-        } else {
-          // Invalid history parent – treat as self-transition on current.
-          target = current_state_id_;
-        }
-        // LCA must be calculated dynamically for history
-        // Fallback to runtime LCA
-      } else {
-        // Use pre-computed LCA
-        lca = tables.transition_lca[t_id];
-      }
+ private:
+  // Runs the static tables against one machine_state. It is two pointers,
+  // so tasks capture it by value and keep running on the machine that
+  // started them.
+  struct runner {
+    machine_state* state_;
+    TaskProvider* provider_;
+
+    constexpr std::size_t current() const noexcept { return current_of(*state_); }
+    constexpr void set_current(std::size_t s) noexcept {
+      state_->current = s == detail::invalid_index ? no_state : static_cast<state_index>(s);
+    }
 
-      exit_to_lca(ctx, instance, e, old_state, target, t.kind, lca);
+    static constexpr EventBase init_event{"init"};
 
-      if (t.effect_start != detail::invalid_index) {
-        for (std::size_t i = 0; i < t.effect_count; ++i) {
-          effect_table[t.effect_start + i](ctx, instance, e);
-        }
+    constexpr void start(instance_type& instance) { start(instance, init_event); }
+
+    // As a sub machine, started with the event that entered its submachine
+    // state
+    constexpr void start(instance_type& instance, const EventBase& e) {
+      // Reset
+      if constexpr (deferral_capacity > 0) {
+        state_->deferred.count = 0;
+      }
+      set_current(0);  // Root
+      state_->history.leaf.fill(history_type::none);
+      if constexpr (uses_timer_service) {
+        state_->timer_service.heap.clear();
       }
+      state_->conditions.armed.fill(false);
 
-      enter_from_lca(ctx, instance, e, old_state, target, t.kind, lca);
-      current_state_id_ = target;
+      // Enter root
+      ContextType ctx{};
+      if constexpr (has_regions) {
+        state_->regions.leaves.fill(detail::invalid_index);
+        enter_path(ctx, instance, e, 0, 0);
+        sync_current_state();
+        resolve_completion(ctx, instance);
+        evaluate_conditions(instance);
+        return;
+      }
+      enter_state(ctx, instance, e, 0);
 
-      resolve_initial(ctx, instance, e, target);
+      resolve_initial(ctx, instance, e, 0);
       resolve_completion(ctx, instance);
-      // After the microstep completes, record history information for all
-      // ancestor composites of the active leaf.
-      update_history_from_leaf(current_state_id_);
-    } else {
-      if (t.effect_start != detail::invalid_index) {
-        for (std::size_t i = 0; i < t.effect_count; ++i) {
-          effect_table[t.effect_start + i](ctx, instance, e);
-        }
-      }
+      evaluate_conditions(instance);
     }
-  }
 
-  constexpr void exit_to_lca(
-      Context& ctx, instance_type& instance, const EventBase& e,
-      std::size_t source, std::size_t target,
-      detail::transition_kind kind, std::size_t lca) {
-    
-    if (lca == detail::invalid_index) {
-        // Fallback to full runtime calculation
-        exit_to_lca_runtime(ctx, instance, e, source, target, kind);
-        return;
+    // Re-evaluates the when() conditions of the active states, for changes
+    // made outside a dispatch (when_mode::on_step)
+    constexpr void notify_changed(instance_type& instance) {
+      evaluate_conditions(instance);
     }
 
-    for (std::size_t s = source; s != lca && s != detail::invalid_index;
-         s = normalized_model.states[s].parent_id) {
-      exit_state(ctx, instance, e, s);
+    constexpr void dispatch(instance_type& instance,
+                            std::string_view event_name) noexcept {
+      EventBase e{event_name};
+
+      dispatch_internal(instance, e, event_name);
+    }
+
+    template <typename T>
+    constexpr void dispatch(instance_type& instance) noexcept {
+      static_assert(
+          std::is_base_of_v<EventBase, T> || std::is_base_of_v<Event<T>, T>,
+          "Must be an Event");
+      T e{};
+
+      if constexpr (std::is_same_v<T, EventBase> || std::is_same_v<T, Event<void>>) {
+          dispatch_internal(instance, e, e.name());
+      } else {
+          // Compile-time lookup for typed events
+          constexpr std::size_t id = tables.get_event_id(detail::type_name<T>());
+          dispatch_by_id(instance, e, id);
+      }
+    }
+
+    template <typename T>
+    constexpr void dispatch(instance_type& instance, const T& e) noexcept {
+      static_assert(std::is_base_of_v<EventBase, T>, "Must be an Event");
+
+      if constexpr (std::is_same_v<T, EventBase> || std::is_same_v<T, Event<void>>) {
+          dispatch_internal(instance, e, e.name());
+      } else {
+           // Compile-time lookup for typed events
+          constexpr std::size_t id = tables.get_event_id(detail::type_name<T>());
+          dispatch_by_id(instance, e, id);
+      }
+    }
+
+    // Whether the event was taken or deferred; a parent machine offers the
+    // event to its own transitions otherwise
+    constexpr bool dispatch_by_id(instance_type& instance, const EventBase& e, std::size_t event_id) {
+      HSM_PROBE3(cthsm, dispatch, state_, current(), event_id);
+      bool handled;
+      if constexpr (times_steps) {
+        const auto started = Clock::now();
+        handled = run_step(instance, e, event_id);
+        Observer::on_complete(current(), event_id, Clock::now() - started);
+      } else {
+        handled = run_step(instance, e, event_id);
+      }
+      HSM_PROBE3(cthsm, complete, state_, current(), handled);
+      return handled;
+    }
+
+    constexpr bool run_step(instance_type& instance, const EventBase& e, std::size_t event_id) {
+       // Activities that returned on a worker since the last step complete
+       // first
+       if constexpr (defers_completion) collect_activities(instance);
+       ContextType ctx{};
+       if constexpr (observed) Observer::on_dispatch(current(), event_id);
+
+       if (event_id != detail::invalid_index && is_deferred_in_configuration(event_id)) {
+           HSM_PROBE3(cthsm, defer, state_, current(), event_id);
+           if constexpr (observed) Observer::on_defer(current(), event_id);
+           defer(event_id);
+           return true;
+       }
+
+       bool handled = dispatch_event_impl(ctx, instance, e, event_id);
+
+       if (handled) {
+           process_deferred(instance);
+       } else if constexpr (observed) {
+           Observer::on_unhandled(current(), event_id);
+       }
+       evaluate_conditions(instance);
+       return handled;
+    }
+
+    // Dispatches the event of every armed when() condition that holds. Each
+    // condition is checked at most once per call; nested dispatches skip the
+    // check, so a condition that stays true cannot loop.
+    constexpr void evaluate_conditions(instance_type& instance) {
+      if constexpr (evaluates_conditions) {
+        if (state_->conditions.evaluating) return;
+        state_->conditions.evaluating = true;
+        const EventBase e{""};
+        for (std::size_t idx = 0; idx < total_timer_count; ++idx) {
+          if (!state_->conditions.armed[idx]) continue;
+          if (!condition_table[idx](state_->timers.contexts[idx], instance, e)) continue;
+          state_->conditions.armed[idx] = false;
+          dispatch_timer_event(instance, idx);
+        }
+        state_->conditions.evaluating = false;
+      }
+    }
+
+    constexpr void dispatch_internal(instance_type& instance, const EventBase& e, std::string_view event_name) {
+       std::size_t event_id = tables.get_event_id(event_name);
+       dispatch_by_id(instance, e, event_id);
     }
-  }
 
-  constexpr void exit_to_lca_runtime(
-      Context& ctx, instance_type& instance, const EventBase& e,
-      std::size_t source, std::size_t target,
-      detail::transition_kind kind) {
-    std::array<std::size_t, 16> source_path;
-    std::size_t source_len = 0;
-    for (std::size_t s = source; s != detail::invalid_index;
-         s = normalized_model.states[s].parent_id) {
-      source_path[source_len++] = s;
+    constexpr void on_activity_complete(instance_type& instance, std::size_t idx) {
+        // A cancelled activity returns because its state is being exited (or
+        // the machine destroyed); the exiting thread owns its task slot then
+        // and there is no completion to process
+        if (idx < state_->activities.contexts.size() && state_->activities.contexts[idx].is_set()) return;
+        // On a worker thread of a deferring provider only the return is
+        // flagged; collect_activities does the rest on the dispatching thread
+        if constexpr (defers_completion) {
+            state_->pending.finish(idx);
+            return;
+        }
+        if (idx < state_->activities.tasks.size()) {
+            HSM_PROBE2(cthsm, activity_stop, state_, idx);
+            state_->activities.tasks[idx].reset();
+            state_->pending.clear(idx);
+        }
+        ContextType ctx{};
+        resolve_completion(ctx, instance);
+        evaluate_conditions(instance);
     }
 
-    std::array<std::size_t, 16> target_path;
-    std::size_t target_len = 0;
-    for (std::size_t s = target; s != detail::invalid_index;
-         s = normalized_model.states[s].parent_id) {
-      target_path[target_len++] = s;
+    // Releases the tasks of activities that returned by themselves and runs
+    // the completion they allow. Returns how many there were.
+    constexpr std::size_t collect_activities(instance_type& instance) {
+      std::size_t finished = 0;
+      state_->pending.take_finished([&](std::size_t idx) {
+        HSM_PROBE2(cthsm, activity_stop, state_, idx);
+        state_->activities.tasks[idx].reset();
+        ++finished;
+      });
+      if (finished > 0) {
+        ContextType ctx{};
+        resolve_completion(ctx, instance);
+        evaluate_conditions(instance);
+      }
+      return finished;
+    }
+
+    // TimerService only: dispatches the event of every timer whose deadline
+    // has passed on Clock, earliest first, and returns how many fired. Call it
+    // from the thread that dispatches events, e.g. from an event loop that
+    // sleeps until next_timer_deadline().
+    std::size_t poll_timers(instance_type& instance) requires uses_timer_service {
+      using duration = typename Clock::duration;
+      auto& service = state_->timer_service;
+      const auto now = Clock::now();
+      std::size_t fired = 0;
+      while (!service.heap.empty() && service.heap.top_deadline() <= now) {
+        const std::size_t idx = service.heap.top();
+        const auto period = service.period[idx];
+        // Re-arm before dispatching: the transition may exit the owning state,
+        // which cancels the timer again
+        if (period > duration::zero()) {
+          auto next = service.heap.top_deadline() + period;
+          if constexpr (Timers::missed == missed_ticks::coalesce) {
+            if (next <= now) next += period * ((now - next) / period + 1);
+          }
+          service.heap.schedule(idx, next);
+        } else {
+          service.heap.cancel(idx);
+        }
+        dispatch_timer_event(instance, idx);
+        ++fired;
+      }
+      return fired;
+    }
+
+    constexpr void dispatch_timer_event(instance_type& instance,
+                                        std::size_t timer_idx) {
+      HSM_PROBE2(cthsm, timer_fire, state_, timer_idx);
+      if (timer_idx < tables.timer_transition_map.size()) {
+        std::size_t t_id = tables.timer_transition_map[timer_idx];
+        if (t_id != detail::invalid_index) {
+          std::size_t event_id = normalized_model.transitions[t_id].event_id;
+          if (event_id != detail::invalid_index) {
+            std::string_view event_name =
+                normalized_model.get_event_name(event_id);
+            dispatch(instance, event_name);
+          }
+        }
+      }
     }
 
-    std::size_t lca = detail::invalid_index;
-    int i = static_cast<int>(source_len) - 1;
-    int j = static_cast<int>(target_len) - 1;
-    while (i >= 0 && j >= 0 &&
-           source_path[static_cast<std::size_t>(i)] ==
-               target_path[static_cast<std::size_t>(j)]) {
-      lca = source_path[static_cast<std::size_t>(i)];
-      i--;
-      j--;
+    constexpr bool is_deferred(std::size_t state, std::size_t event_id) const {
+      std::string_view event_name = normalized_model.get_event_name(event_id);
+      std::size_t curr = state;
+      while (curr != detail::invalid_index) {
+        const auto& st = normalized_model.states[curr];
+        for (std::size_t i = 0; i < st.defer_count; ++i) {
+          std::size_t def_id =
+              normalized_model.deferred_events[st.defer_start + i];
+          if (normalized_model.get_event_name(def_id) == event_name) return true;
+        }
+        curr = st.parent_id;
+      }
+      return false;
     }
 
-    if (kind == detail::transition_kind::external && source == target) {
-      if (normalized_model.states[source].parent_id != detail::invalid_index) {
-        lca = normalized_model.states[source].parent_id;
+    // With regions an event is deferred if any active leaf defers it.
+    constexpr bool is_deferred_in_configuration(std::size_t event_id) const {
+      if constexpr (has_regions) {
+        for (std::size_t leaf : state_->regions.leaves) {
+          if (leaf != detail::invalid_index && is_deferred(leaf, event_id)) return true;
+        }
+        return false;
       } else {
-        lca = detail::invalid_index;
+        return is_deferred(current(), event_id);
       }
     }
 
-    for (std::size_t s = source; s != lca && s != detail::invalid_index;
-         s = normalized_model.states[s].parent_id) {
-      exit_state(ctx, instance, e, s);
+    constexpr bool dispatch_event_impl(ContextType& ctx, instance_type& instance, const EventBase& e, std::size_t event_id) {
+        if (current() == detail::invalid_index) return false;
+
+        if constexpr (submachine_count > 0) {
+          if (offer_submachine(ctx, instance, e, event_id)) return true;
+        }
+
+        if constexpr (has_regions) {
+          return dispatch_regions(ctx, instance, e, event_id);
+        } else if constexpr (Dispatch == dispatch_mode::inlined) {
+          return inlined_dispatch_table[current()](*this, ctx, instance, e, event_id);
+        }
+
+        std::size_t t_id = select_transition(ctx, instance, e, current(), event_id);
+        if (t_id == detail::invalid_index) return false;
+
+        execute_transition(ctx, instance, e, normalized_model.transitions[t_id], t_id);
+        return true;
     }
-  }
 
-  constexpr void enter_from_lca(
-      Context& ctx, instance_type& instance, const EventBase& e,
-      std::size_t source, std::size_t target,
-      detail::transition_kind kind, std::size_t lca) {
+    // First enabled transition for the event from `state`: its candidate
+    // chain (the state, then its ancestors), then the wildcard chain.
+    constexpr std::size_t select_transition(ContextType& ctx, instance_type& instance,
+                                            const EventBase& e, std::size_t state,
+                                            std::size_t event_id) {
+        std::size_t t_id = detail::invalid_index;
+
+        if (event_id != detail::invalid_index) {
+          t_id = find_transition(state, event_id);
+
+          while (t_id != detail::invalid_index) {
+            if (guard_passes(ctx, instance, e, t_id)) return t_id;
+            t_id = tables.next_candidate[t_id];
+          }
+        }
+
+        // Fallback to wildcard
+        t_id = tables.get_wildcard_transition_id(state);
 
-    if (lca == detail::invalid_index) {
-         enter_from_lca_runtime(ctx, instance, e, source, target, kind);
-         return;
+        while (t_id != detail::invalid_index) {
+          if (guard_passes(ctx, instance, e, t_id)) return t_id;
+          t_id = tables.next_candidate[t_id];
+        }
+
+        return detail::invalid_index;
     }
 
-    std::array<std::size_t, 16> target_path;
-    std::size_t target_len = 0;
-    
-    // Build path from target up to LCA
-    for (std::size_t s = target; s != lca && s != detail::invalid_index;
-         s = normalized_model.states[s].parent_id) {
-      target_path[target_len++] = s;
+    constexpr bool guard_passes(ContextType& ctx, instance_type& instance,
+                                const EventBase& e, std::size_t t_id) {
+      const auto& t = normalized_model.transitions[t_id];
+      if (t.guard_idx != detail::invalid_index && t.guard_idx < guard_table.size()) {
+        const bool passed = guard_table[t.guard_idx](ctx, instance, e);
+        HSM_PROBE3(cthsm, guard, state_, t_id, passed);
+        if (passed) return true;
+        if constexpr (observed) Observer::on_guard_rejected(t_id);
+        return false;
+      }
+      return true;
     }
 
-    // Enter in reverse (from LCA down to target)
-    for (int j = static_cast<int>(target_len) - 1; j >= 0; j--) {
-      enter_state(ctx, instance, e, target_path[static_cast<std::size_t>(j)]);
+    constexpr void execute_transition(Context& ctx, instance_type& instance,
+                                      const EventBase& e, const auto& t, std::size_t t_id) {
+      observe_transition(t_id);
+      const auto& prog = programs.transitions[t_id];
+      if (prog.generic) {
+        execute_transition_generic(ctx, instance, e, t, t_id);
+        HSM_PROBE3(cthsm, transition_end, state_, t_id, current());
+        return;
+      }
+
+      if (prog.changes_state) {
+        // Inherited transition: leave the active states below its source
+        for (std::size_t s = current();
+             s != t.source_id && s != detail::invalid_index;
+             s = normalized_model.states[s].parent_id) {
+          run_actions(ctx, instance, e, programs.state_exits[s]);
+        }
+      }
+
+      run_actions(ctx, instance, e, prog.actions);
+
+      if (prog.changes_state) {
+        if (prog.completes) resolve_completion(ctx, instance);
+        if (prog.records_history) update_history_from_leaf(current());
+      }
+      HSM_PROBE3(cthsm, transition_end, state_, t_id, current());
     }
-  }
 
-  constexpr void enter_from_lca_runtime(
-      Context& ctx, instance_type& instance, const EventBase& e,
-      std::size_t source, std::size_t target,
-      detail::transition_kind kind) {
-    std::array<std::size_t, 16> source_path;
-    std::size_t source_len = 0;
-    for (std::size_t s = source; s != detail::invalid_index;
-         s = normalized_model.states[s].parent_id) {
-      source_path[source_len++] = s;
+    constexpr void run_actions(ContextType& ctx, instance_type& instance,
+                               const EventBase& e, detail::action_range range) {
+      for (std::size_t i = 0; i < range.count; ++i) {
+        const auto& a = programs.actions[range.start + i];
+        switch (a.kind) {
+          case detail::action_kind::exit:
+            exit_table[a.index](ctx, instance, e);
+            break;
+          case detail::action_kind::stop_tasks:
+            stop_state_tasks(instance, e, a.index);
+            break;
+          case detail::action_kind::effect:
+            effect_table[a.index](ctx, instance, e);
+            break;
+          case detail::action_kind::entry:
+            entry_table[a.index](ctx, instance, e);
+            break;
+          case detail::action_kind::start_tasks:
+            start_state_tasks(instance, e, a.index);
+            break;
+          case detail::action_kind::set_state:
+            set_current(a.index);
+            break;
+          case detail::action_kind::observe_exit:
+            observe_exit(a.index);
+            break;
+          case detail::action_kind::observe_enter:
+            observe_enter(a.index);
+            break;
+        }
+      }
+    }
+
+    // Runtime path for transitions without a program (history targets).
+    constexpr void execute_transition_generic(Context& ctx, instance_type& instance,
+                                              const EventBase& e, const auto& t,
+                                              std::size_t t_id) {
+      if (t.target_id != detail::invalid_index || t.history != detail::history_kind::none) {
+        std::size_t target = t.target_id;
+        std::size_t old_state = current();
+        std::size_t lca = detail::invalid_index;
+
+        // History resolution (UML 2.5 shallow / deep)
+        if (t.history != detail::history_kind::none) {
+          target = history_target(t, current());
+          // LCA must be calculated dynamically for history
+          // Fallback to runtime LCA
+        } else {
+          // Use pre-computed LCA
+          lca = tables.transition_lca[t_id];
+        }
+
+        exit_to_lca(ctx, instance, e, old_state, target, t.kind, lca);
+
+        if (t.effect_start != detail::invalid_index) {
+          for (std::size_t i = 0; i < t.effect_count; ++i) {
+            effect_table[t.effect_start + i](ctx, instance, e);
+          }
+        }
+
+        enter_from_lca(ctx, instance, e, old_state, target, t.kind, lca);
+        set_current(target);
+
+        resolve_initial(ctx, instance, e, target);
+        resolve_completion(ctx, instance);
+        // After the microstep completes, record history information for all
+        // ancestor composites of the active leaf.
+        update_history_from_leaf(current());
+      } else {
+        if (t.effect_start != detail::invalid_index) {
+          for (std::size_t i = 0; i < t.effect_count; ++i) {
+            effect_table[t.effect_start + i](ctx, instance, e);
+          }
+        }
+      }
     }
 
-    std::array<std::size_t, 16> target_path;
-    std::size_t target_len = 0;
-    for (std::size_t s = target; s != detail::invalid_index;
-         s = normalized_model.states[s].parent_id) {
-      target_path[target_len++] = s;
+    // Target of a history transition, from the recorded leaf of its composite.
+    // An invalid history parent is treated as a self-transition on `fallback`.
+    constexpr std::size_t history_target(const auto& t, std::size_t fallback) const {
+      std::size_t parent = t.history_parent;
+      if (parent == detail::invalid_index) return fallback;
+
+      std::size_t slot = history_slots.slot[parent];
+      if (slot == detail::invalid_index || state_->history.leaf[slot] == history_type::none) {
+        // No prior history recorded – fall back to the composite's
+        // default initial chain as per UML.
+        return parent;
+      }
+      const std::size_t leaf = state_->history.leaf[slot];
+      if (t.history == detail::history_kind::deep) {
+        // Deep history: re-enter the exact leaf configuration.
+        return leaf;
+      }
+      // Shallow history: re-enter the last active direct child of the
+      // composite, then follow its default initial chain.
+      return ancestry.depth[leaf] > ancestry.depth[parent]
+                 ? ancestry.ancestor_at(leaf, ancestry.depth[parent] + 1)
+                 : parent;
     }
 
-    int i = static_cast<int>(source_len) - 1;
-    int j = static_cast<int>(target_len) - 1;
-    while (i >= 0 && j >= 0 &&
-           source_path[static_cast<std::size_t>(i)] ==
-               target_path[static_cast<std::size_t>(j)]) {
-      i--;
-      j--;
+    constexpr void exit_to_lca(
+        Context& ctx, instance_type& instance, const EventBase& e,
+        std::size_t source, std::size_t target,
+        detail::transition_kind kind, std::size_t lca) {
+
+      if (lca == detail::invalid_index) {
+          // Fallback to full runtime calculation
+          lca = runtime_lca(source, target, kind);
+      }
+
+      for (std::size_t s = source; s != lca && s != detail::invalid_index;
+           s = normalized_model.states[s].parent_id) {
+        exit_state(ctx, instance, e, s);
+      }
     }
 
-    if (kind == detail::transition_kind::external && source == target) {
-      j = 0;
+    constexpr void enter_from_lca(
+        Context& ctx, instance_type& instance, const EventBase& e,
+        std::size_t source, std::size_t target,
+        detail::transition_kind kind, std::size_t lca) {
+
+      if (lca == detail::invalid_index) {
+          lca = runtime_lca(source, target, kind);
+      }
+
+      // Enter from just below the LCA down to the target
+      std::size_t first = lca == detail::invalid_index ? 0 : ancestry.depth[lca] + 1;
+      for (std::size_t d = first; d <= ancestry.depth[target]; ++d) {
+        enter_state(ctx, instance, e, ancestry.ancestor_at(target, d));
+      }
     }
 
-    for (; j >= 0; j--) {
-      enter_state(ctx, instance, e, target_path[static_cast<std::size_t>(j)]);
+    // LCA for targets only known at runtime (history). An external
+    // self-transition leaves and re-enters the state itself.
+    static constexpr std::size_t runtime_lca(std::size_t source, std::size_t target,
+                                             detail::transition_kind kind) {
+      if (kind == detail::transition_kind::external && source == target) {
+        return normalized_model.states[source].parent_id;
+      }
+      return ancestry.lca(source, target);
     }
-  }
 
-  constexpr void exit_state(Context& ctx, instance_type& instance,
-                            const EventBase& e, std::size_t s_id) {
-    const auto& s = normalized_model.states[s_id];
-    if (s.exit_start != detail::invalid_index) {
-      for (std::size_t i = 0; i < s.exit_count; ++i) {
-        exit_table[s.exit_start + i](ctx, instance, e);
+    constexpr void exit_state(Context& ctx, instance_type& instance,
+                              const EventBase& e, std::size_t s_id) {
+      const auto& s = normalized_model.states[s_id];
+      // A sub machine is exited before the state that runs it
+      const bool nested =
+          submachine_count > 0 && detail::any(s.flags, detail::state_flags::submachine);
+      if (nested) stop_state_tasks(instance, e, s_id);
+      if (s.exit_start != detail::invalid_index) {
+        for (std::size_t i = 0; i < s.exit_count; ++i) {
+          exit_table[s.exit_start + i](ctx, instance, e);
+        }
       }
+      if (!nested) stop_state_tasks(instance, e, s_id);
+      observe_exit(s_id);
     }
-    auto range = tables.state_timer_ranges[s_id];
-    for (std::size_t i = 0; i < range.count; ++i) {
-      auto& timer = tables.state_timer_list[range.start + i];
-      if constexpr (requires { instance.cancel_timer(timer.timer_idx); }) {
-        instance.cancel_timer(timer.timer_idx);
+
+    // Cancels the timers and activities owned by a state being exited, and
+    // exits the sub machine of a submachine state.
+    constexpr void stop_state_tasks(instance_type& instance, const EventBase& e,
+                                    std::size_t s_id) {
+      const auto& s = normalized_model.states[s_id];
+      if constexpr (submachine_count > 0) {
+        const std::size_t slot = submachine_slots[s_id];
+        if (slot != detail::invalid_index) submachine_table[slot].exit(*this, instance, e);
       }
-      if (timer.timer_idx < active_timer_tasks_.size() &&
-          active_timer_tasks_[timer.timer_idx].has_value()) {
-        active_timer_tasks_[timer.timer_idx]->ctx->set();
-        if (active_timer_tasks_[timer.timer_idx]->task.joinable()) {
-          active_timer_tasks_[timer.timer_idx]->task.join();
+      auto range = tables.state_timer_ranges[s_id];
+      for (std::size_t i = 0; i < range.count; ++i) {
+        auto& timer = tables.state_timer_list[range.start + i];
+        if constexpr (requires { instance.cancel_timer(timer.timer_idx); }) {
+          instance.cancel_timer(timer.timer_idx);
+        }
+        if constexpr (uses_timer_service) {
+          if (timer.timer_idx < total_timer_count) state_->timer_service.heap.cancel(timer.timer_idx);
+        }
+        if constexpr (evaluates_conditions) {
+          if (timer.timer_idx < total_timer_count) state_->conditions.armed[timer.timer_idx] = false;
+        }
+        if (timer.timer_idx < state_->timers.tasks.size() &&
+            state_->timers.tasks[timer.timer_idx].has_value()) {
+          state_->timers.tasks[timer.timer_idx]->ctx->set();
+          if (state_->timers.tasks[timer.timer_idx]->task.joinable()) {
+            state_->timers.tasks[timer.timer_idx]->task.join();
+          }
+          state_->timers.tasks[timer.timer_idx].reset();
         }
-        active_timer_tasks_[timer.timer_idx].reset();
       }
+      if (s.activity_start != detail::invalid_index) {
+        for (std::size_t i = 0; i < s.activity_count; ++i) {
+          std::size_t idx = s.activity_start + i;
+          if (idx < state_->activities.tasks.size() && state_->activities.tasks[idx].has_value()) {
+            HSM_PROBE2(cthsm, activity_stop, state_, idx);
+            state_->activities.tasks[idx]->ctx->set();
+            if (state_->activities.tasks[idx]->task.joinable()) {
+              state_->activities.tasks[idx]->task.join();
+            }
+            state_->activities.tasks[idx].reset();
+            state_->pending.clear(idx);
+          }
+        }
+      }
+    }
+
+    // Probe and observer call for a transition about to run its behaviors
+    constexpr void observe_transition([[maybe_unused]] std::size_t t_id) {
+      HSM_PROBE3(cthsm, transition_start, state_, t_id, current());
+      if constexpr (observed) Observer::on_transition(t_id);
     }
-    if (s.activity_start != detail::invalid_index) {
-      for (std::size_t i = 0; i < s.activity_count; ++i) {
-        std::size_t idx = s.activity_start + i;
-        if (idx < active_tasks_.size() && active_tasks_[idx].has_value()) {
-          active_tasks_[idx]->ctx->set();
-          if (active_tasks_[idx]->task.joinable()) {
-            active_tasks_[idx]->task.join();
+
+    // Probe and observer calls for a state being entered or exited; the
+    // entry time is only kept for observers with on_dwell
+    constexpr void observe_enter([[maybe_unused]] std::size_t s_id) {
+      HSM_PROBE2(cthsm, enter, state_, s_id);
+      if constexpr (observed) {
+        if constexpr (times_dwell) state_->entered.at[s_id] = Clock::now();
+        Observer::on_enter(s_id);
+      }
+    }
+
+    constexpr void observe_exit([[maybe_unused]] std::size_t s_id) {
+      HSM_PROBE2(cthsm, exit, state_, s_id);
+      if constexpr (observed) {
+        Observer::on_exit(s_id);
+        if constexpr (times_dwell) Observer::on_dwell(s_id, Clock::now() - state_->entered.at[s_id]);
+      }
+    }
+
+    constexpr void enter_state(ContextType& ctx, instance_type& instance,
+                               const EventBase& e, std::size_t s_id) {
+      observe_enter(s_id);
+      const auto& s = normalized_model.states[s_id];
+      if (s.entry_start != detail::invalid_index) {
+        for (std::size_t i = 0; i < s.entry_count; ++i) {
+          entry_table[s.entry_start + i](ctx, instance, e);
+        }
+      }
+      start_state_tasks(instance, e, s_id);
+    }
+
+    // Starts the activities and timers owned by a state being entered, and
+    // the sub machine of a submachine state.
+    constexpr void start_state_tasks(instance_type& instance, const EventBase& e,
+                                     std::size_t s_id) {
+      const auto& s = normalized_model.states[s_id];
+      if (s.activity_start != detail::invalid_index) {
+        for (std::size_t i = 0; i < s.activity_count; ++i) {
+          std::size_t idx = s.activity_start + i;
+          if (idx < state_->activities.tasks.size()) {
+            state_->activities.contexts[idx].reset();
+            ContextType* activity_ctx = &state_->activities.contexts[idx];
+            // Before the task exists: it may run, and finish, inline
+            state_->pending.set(idx);
+            HSM_PROBE2(cthsm, activity_start, state_, idx);
+
+          auto task = provider_->create_task(
+              [self = *this, idx, &instance, e, activity_ctx]() mutable {
+                activity_table[idx](*activity_ctx, instance, e);
+                self.on_activity_complete(instance, idx);
+              },
+              "activity", 0, 0);
+
+            state_->activities.tasks[idx] = ActiveTask{std::move(task), activity_ctx};
+          }
+        }
+      }
+      auto range = tables.state_timer_ranges[s_id];
+      for (std::size_t i = 0; i < range.count; ++i) {
+        auto& timer = tables.state_timer_list[range.start + i];
+        if (timer.timer_idx < timer_table.size()) {
+          state_->timers.contexts[timer.timer_idx].reset();
+          ContextType* timer_ctx = &state_->timers.contexts[timer.timer_idx];
+          HSM_PROBE2(cthsm, timer_arm, state_, timer.timer_idx);
+
+          if constexpr (evaluates_conditions) {
+            if (timer.kind == detail::timer_kind::when) {
+              state_->conditions.armed[timer.timer_idx] = true;
+              continue;
+            }
+          }
+          if constexpr (uses_timer_service) {
+            if (timer.kind != detail::timer_kind::when) {
+              schedule_table[timer.timer_idx](*timer_ctx, instance, e, *this, timer.kind);
+              continue;
+            }
           }
-          active_tasks_[idx].reset();
+
+          auto task = provider_->create_task(
+              [self = *this, &instance, e, timer]() mutable {
+                timer_table[timer.timer_idx](self.state_->timers.contexts[timer.timer_idx],
+                                             instance, e, timer.timer_idx, self, timer.kind);
+              },
+              "timer", 0, 0);
+
+          state_->timers.tasks[timer.timer_idx] =
+              ActiveTask{std::move(task), timer_ctx};
         }
       }
+      if constexpr (submachine_count > 0) {
+        const std::size_t slot = submachine_slots[s_id];
+        if (slot != detail::invalid_index) submachine_table[slot].enter(*this, instance, e);
+      }
     }
-  }
 
-  constexpr void enter_state(ContextType& ctx, instance_type& instance,
-                             const EventBase& e, std::size_t s_id) {
-    const auto& s = normalized_model.states[s_id];
-    if (s.entry_start != detail::invalid_index) {
-      for (std::size_t i = 0; i < s.entry_count; ++i) {
-        entry_table[s.entry_start + i](ctx, instance, e);
+    constexpr void resolve_initial(ContextType& ctx, instance_type& instance,
+                                   const EventBase& e, std::size_t current) {
+      std::size_t init = normalized_model.states[current].initial_transition_id;
+      while (init != detail::invalid_index) {
+        const auto& t = normalized_model.transitions[init];
+        if (t.effect_start != detail::invalid_index) {
+          for (std::size_t i = 0; i < t.effect_count; ++i) {
+            effect_table[t.effect_start + i](ctx, instance, e);
+          }
+        }
+        if (t.target_id != detail::invalid_index) {
+          enter_from_lca(ctx, instance, e, current, t.target_id,
+                         detail::transition_kind::local, current); // LCA is current/parent
+          current = t.target_id;
+          set_current(current);
+          init = normalized_model.states[current].initial_transition_id;
+        } else {
+          break;
+        }
       }
     }
-    if (s.activity_start != detail::invalid_index) {
-      for (std::size_t i = 0; i < s.activity_count; ++i) {
-        std::size_t idx = s.activity_start + i;
-        if (idx < active_tasks_.size()) {
-          activity_contexts_[idx].reset();
-          ContextType* activity_ctx = &activity_contexts_[idx];
 
-        auto task = task_provider_.create_task(
-            [this, idx, &instance, e, activity_ctx]() {
-              activity_table[idx](*activity_ctx, instance, e);
-              this->on_activity_complete(instance, idx);
-            },
-            "activity", 0, 0);
+    constexpr void resolve_completion(ContextType& ctx, instance_type& instance) {
+      if constexpr (!has_completion) return;
+      if constexpr (has_regions) {
+        resolve_completion_regions(ctx, instance);
+        return;
+      }
+      if (current() == detail::invalid_index) return;
+
+      std::size_t curr = current();
+      while (curr != detail::invalid_index) {
+        // Neither a completion transition nor a final state
+        if (!completion_states[curr]) return;
+        // Activity is still running, so state is not complete.
+        if (has_running_activity(curr)) return;
+        // Neither is a submachine state before its sub machine finished
+        if (!submachine_finished(curr)) return;
+
+        const auto& range = tables.completion_transitions_ranges[curr];
+        bool handled = false;
+        if (range.count > 0) {
+          for (std::size_t i = 0; i < range.count; ++i) {
+            std::size_t t_id = tables.completion_transitions_list[range.start + i];
+            const auto& t = normalized_model.transitions[t_id];
+            EventBase empty{""};
+
+            if (guard_passes(ctx, instance, empty, t_id)) {
+              execute_transition(ctx, instance, empty, t, t_id);
+              handled = true;
+              break;
+            }
+          }
+        }
+
+        if (handled) return;
 
-          active_tasks_[idx] = ActiveTask{std::move(task), activity_ctx};
+        // If current state is Final, its parent is also considered complete,
+        // so we check for completion transitions on the parent.
+        if ((normalized_model.states[curr].flags & detail::state_flags::final) != detail::state_flags::none) {
+          curr = normalized_model.states[curr].parent_id;
+        } else {
+          break;
         }
       }
     }
-    auto range = tables.state_timer_ranges[s_id];
-    for (std::size_t i = 0; i < range.count; ++i) {
-      auto& timer = tables.state_timer_list[range.start + i];
-      if (timer.timer_idx < timer_table.size()) {
-        timer_contexts_[timer.timer_idx].reset();
-        ContextType* timer_ctx = &timer_contexts_[timer.timer_idx];
 
-        auto task = task_provider_.create_task(
-            [this, &instance, e, timer, timer_ctx]() {
-              timer_table[timer.timer_idx](*timer_ctx, instance, e,
-                                           timer.timer_idx, *this, timer.kind);
-            },
-            "timer", 0, 0);
+    constexpr bool submachine_finished(std::size_t s_id) {
+      if constexpr (submachine_count > 0) {
+        const std::size_t slot = submachine_slots[s_id];
+        return slot == detail::invalid_index || submachine_table[slot].finished(*this);
+      }
+      return true;
+    }
 
-        active_timer_tasks_[timer.timer_idx] =
-            ActiveTask{std::move(task), timer_ctx};
+    // --- Submachine states ---
+    //
+    // A submachine state offers each event to its sub machine first; its own
+    // and its ancestors' transitions only see the events the sub machine
+    // did not take. Reaching a final state of the sub-model's root completes
+    // the submachine state.
+
+    constexpr bool offer_submachine(ContextType& ctx, instance_type& instance,
+                                    const EventBase& e, std::size_t event_id) {
+      const std::size_t slot = submachine_slots[current()];
+      if (slot == detail::invalid_index) return false;
+      if (!submachine_table[slot].offer(*this, instance, e, event_id)) return false;
+      resolve_completion(ctx, instance);
+      return true;
+    }
+
+    // Run on a sub machine when its submachine state is exited: leaves the
+    // active configuration, innermost first, and drops deferred events.
+    constexpr void exit_nested(instance_type& instance, const EventBase& e) {
+      if (current() == detail::invalid_index) return;
+      ContextType ctx{};
+      if constexpr (has_regions) {
+        exit_subtree(ctx, instance, e, 0);
+        state_->regions.leaves.fill(detail::invalid_index);
+      } else {
+        for (std::size_t s = current(); s != detail::invalid_index;
+             s = normalized_model.states[s].parent_id) {
+          exit_state(ctx, instance, e, s);
+        }
+      }
+      set_current(detail::invalid_index);
+      if constexpr (deferral_capacity > 0) {
+        state_->deferred.count = 0;
       }
     }
-  }
 
-  constexpr void resolve_initial(ContextType& ctx, instance_type& instance,
-                                 const EventBase& e, std::size_t current) {
-    std::size_t init = normalized_model.states[current].initial_transition_id;
-    while (init != detail::invalid_index) {
-      const auto& t = normalized_model.transitions[init];
+    // Whether a sub machine rests in a final state of its root (of every
+    // root region, with regions)
+    constexpr bool finished_nested() const {
+      if constexpr (has_regions) {
+        if (region_layout.orthogonal(0)) return regions_completed(0);
+      }
+      const std::size_t leaf = current();
+      return leaf != detail::invalid_index && normalized_model.states[leaf].parent_id == 0 &&
+             detail::any(normalized_model.states[leaf].flags, detail::state_flags::final);
+    }
+
+    constexpr bool has_running_activity(std::size_t s_id) const {
+      const auto& s = normalized_model.states[s_id];
+      return s.activity_start != detail::invalid_index &&
+             state_->pending.any(s.activity_start, s.activity_count);
+    }
+
+    // --- Orthogonal regions ---
+    //
+    // With regions the configuration is the region leaves, one leaf per
+    // region slot (see detail::region_layout). An event is offered to every active
+    // leaf in slot order and each region takes the first enabled transition of
+    // its own candidate chain, so one table lookup per region. A transition
+    // whose exit covers other regions consumes the event for them as well, and
+    // a transition of a shared ancestor fires once. current() follows
+    // the first active leaf so state() keeps working.
+
+    constexpr bool dispatch_regions(ContextType& ctx, instance_type& instance,
+                                    const EventBase& e, std::size_t event_id) {
+      const auto snapshot = state_->regions.leaves;
+      std::array<bool, leaf_slot_count> consumed{};
+      std::array<std::size_t, leaf_slot_count> fired{};
+      std::size_t fired_count = 0;
+
+      for (std::size_t i = 0; i < leaf_slot_count; ++i) {
+        const std::size_t leaf = snapshot[i];
+        if (leaf == detail::invalid_index || consumed[i] || state_->regions.leaves[i] != leaf) continue;
+
+        const std::size_t t_id = select_transition(ctx, instance, e, leaf, event_id);
+        if (t_id == detail::invalid_index) continue;
+
+        bool seen = false;
+        for (std::size_t f = 0; f < fired_count; ++f) seen = seen || fired[f] == t_id;
+        if (seen) continue;
+        fired[fired_count++] = t_id;
+
+        execute_region_transition(ctx, instance, e, t_id, leaf, consumed);
+      }
+
+      if (fired_count > 0) resolve_completion_regions(ctx, instance);
+      return fired_count > 0;
+    }
+
+    constexpr void execute_region_transition(ContextType& ctx, instance_type& instance,
+                                             const EventBase& e, std::size_t t_id,
+                                             std::size_t leaf,
+                                             std::array<bool, leaf_slot_count>& consumed) {
+      observe_transition(t_id);
+      const auto& t = normalized_model.transitions[t_id];
+      if (t.target_id == detail::invalid_index && t.history == detail::history_kind::none) {
+        run_effects(ctx, instance, e, t);
+        HSM_PROBE3(cthsm, transition_end, state_, t_id, current());
+        return;
+      }
+
+      std::size_t target = t.target_id;
+      std::size_t lca = detail::invalid_index;
+      if (t.history != detail::history_kind::none) {
+        target = history_target(t, leaf);
+      } else {
+        lca = tables.transition_lca[t_id];
+      }
+      if (lca == detail::invalid_index) lca = runtime_lca(t.source_id, target, t.kind);
+      // Crossing between regions leaves and re-enters the orthogonal state
+      if (lca != detail::invalid_index && region_layout.orthogonal(lca)) {
+        lca = normalized_model.states[lca].parent_id;
+      }
+
+      const std::size_t top_depth = lca == detail::invalid_index ? 0 : ancestry.depth[lca] + 1;
+      if (ancestry.depth[leaf] >= top_depth) {
+        const std::size_t top = ancestry.ancestor_at(leaf, top_depth);
+        exit_subtree(ctx, instance, e, top);
+        consume_slots(top, consumed, true);
+      }
+
+      run_effects(ctx, instance, e, t);
+
+      if (ancestry.depth[target] >= top_depth) {
+        enter_path(ctx, instance, e, top_depth, target);
+        consume_slots(ancestry.ancestor_at(target, top_depth), consumed, false);
+      }
+
+      sync_current_state();
+      if constexpr (history_composite_count > 0) {
+        for (std::size_t l : state_->regions.leaves) update_history_from_leaf(l);
+      }
+      HSM_PROBE3(cthsm, transition_end, state_, t_id, current());
+    }
+
+    constexpr void run_effects(ContextType& ctx, instance_type& instance,
+                               const EventBase& e, const auto& t) {
       if (t.effect_start != detail::invalid_index) {
         for (std::size_t i = 0; i < t.effect_count; ++i) {
           effect_table[t.effect_start + i](ctx, instance, e);
         }
       }
-      if (t.target_id != detail::invalid_index) {
-        enter_from_lca(ctx, instance, e, current, t.target_id,
-                       detail::transition_kind::local, current); // LCA is current/parent
-        current = t.target_id;
-        current_state_id_ = current;
-        init = normalized_model.states[current].initial_transition_id;
+    }
+
+    // The event is used up for every region below `s`; after exiting `s`
+    // its leaves are dropped as well.
+    constexpr void consume_slots(std::size_t s, std::array<bool, leaf_slot_count>& consumed,
+                                 bool clear) {
+      const std::size_t first = region_layout.slot[s];
+      for (std::size_t i = first; i < first + region_layout.width[s]; ++i) {
+        consumed[i] = true;
+        if (clear) state_->regions.leaves[i] = detail::invalid_index;
+      }
+    }
+
+    // Exits the active configuration below `s`, innermost first (regions in
+    // reverse order), then `s` itself.
+    constexpr void exit_subtree(ContextType& ctx, instance_type& instance,
+                                const EventBase& e, std::size_t s) {
+      const std::size_t d = ancestry.depth[s];
+      if (region_layout.orthogonal(s)) {
+        const auto regions = region_layout.regions[s];
+        for (std::size_t i = regions.count; i-- > 0;) {
+          exit_subtree(ctx, instance, e, region_layout.region_list[regions.start + i]);
+        }
       } else {
-        break;
+        const std::size_t leaf = state_->regions.leaves[region_layout.slot[s]];
+        if (leaf != detail::invalid_index && ancestry.depth[leaf] > d &&
+            ancestry.ancestor_at(leaf, d) == s) {
+          exit_subtree(ctx, instance, e, ancestry.ancestor_at(leaf, d + 1));
+        }
       }
+      exit_state(ctx, instance, e, s);
     }
-  }
 
-  constexpr void resolve_completion(ContextType& ctx, instance_type& instance) {
-    if (current_state_id_ == detail::invalid_index) return;
+    // Enters the ancestors of `target` from depth `first_depth` down, then the
+    // target's default configuration. Regions of an orthogonal state on the
+    // way take their default entry, in declaration order.
+    constexpr void enter_path(ContextType& ctx, instance_type& instance,
+                              const EventBase& e, std::size_t first_depth,
+                              std::size_t target) {
+      const std::size_t target_depth = ancestry.depth[target];
+      for (std::size_t d = first_depth; d <= target_depth; ++d) {
+        const std::size_t s = ancestry.ancestor_at(target, d);
+        enter_active(ctx, instance, e, s);
+        if (d < target_depth && region_layout.orthogonal(s)) {
+          const std::size_t next = ancestry.ancestor_at(target, d + 1);
+          const auto regions = region_layout.regions[s];
+          for (std::size_t i = 0; i < regions.count; ++i) {
+            const std::size_t r = region_layout.region_list[regions.start + i];
+            if (r == next) {
+              enter_path(ctx, instance, e, d + 1, target);
+            } else {
+              enter_active(ctx, instance, e, r);
+              enter_default(ctx, instance, e, r);
+            }
+          }
+          return;
+        }
+      }
+      enter_default(ctx, instance, e, target);
+    }
 
-    std::size_t curr = current_state_id_;
-    while (curr != detail::invalid_index) {
-      // Check if any activities are still running for this state
-      const auto& s = normalized_model.states[curr];
-      if (s.activity_start != detail::invalid_index) {
-        for (std::size_t i = 0; i < s.activity_count; ++i) {
-          std::size_t idx = s.activity_start + i;
-          if (idx < active_tasks_.size() && active_tasks_[idx].has_value()) {
-            // Activity is still running, so state is not complete.
-            return;
+    // Default entry below an already entered state: every region of an
+    // orthogonal state, otherwise the initial transition.
+    constexpr void enter_default(ContextType& ctx, instance_type& instance,
+                                 const EventBase& e, std::size_t s) {
+      if (region_layout.orthogonal(s)) {
+        const auto regions = region_layout.regions[s];
+        for (std::size_t i = 0; i < regions.count; ++i) {
+          const std::size_t r = region_layout.region_list[regions.start + i];
+          enter_active(ctx, instance, e, r);
+          enter_default(ctx, instance, e, r);
+        }
+        return;
+      }
+      const std::size_t init = normalized_model.states[s].initial_transition_id;
+      if (init == detail::invalid_index) return;
+      const auto& t = normalized_model.transitions[init];
+      run_effects(ctx, instance, e, t);
+      if (t.target_id != detail::invalid_index) {
+        enter_path(ctx, instance, e, ancestry.depth[s] + 1, t.target_id);
+      }
+    }
+
+    constexpr void enter_active(ContextType& ctx, instance_type& instance,
+                                const EventBase& e, std::size_t s) {
+      enter_state(ctx, instance, e, s);
+      state_->regions.leaves[region_layout.slot[s]] = s;
+    }
+
+    constexpr void sync_current_state() {
+      set_current(detail::invalid_index);
+      for (std::size_t leaf : state_->regions.leaves) {
+        if (leaf != detail::invalid_index) {
+          set_current(leaf);
+          return;
+        }
+      }
+    }
+
+    // Completion across regions: a final state completes its region, and an
+    // orthogonal state completes once all of its regions have. Runs until no
+    // region takes a completion transition.
+    constexpr void resolve_completion_regions(ContextType& ctx, instance_type& instance) {
+      bool fired = true;
+      while (fired) {
+        fired = false;
+        for (std::size_t i = 0; i < leaf_slot_count && !fired; ++i) {
+          if (state_->regions.leaves[i] != detail::invalid_index) {
+            fired = complete_from(ctx, instance, state_->regions.leaves[i]);
           }
         }
       }
+    }
 
-      const auto& range = tables.completion_transitions_ranges[curr];
-      bool handled = false;
-      if (range.count > 0) {
+    constexpr bool complete_from(ContextType& ctx, instance_type& instance, std::size_t leaf) {
+      std::size_t curr = leaf;
+      while (curr != detail::invalid_index) {
+        if (!completion_states[curr] || has_running_activity(curr)) return false;
+
+        const auto& range = tables.completion_transitions_ranges[curr];
         for (std::size_t i = 0; i < range.count; ++i) {
           std::size_t t_id = tables.completion_transitions_list[range.start + i];
-          const auto& t = normalized_model.transitions[t_id];
-
-          bool guard_passed = true;
-          if (t.guard_idx != detail::invalid_index) {
-            if (t.guard_idx < guard_table.size()) {
-              EventBase empty{""};
-              guard_passed = guard_table[t.guard_idx](ctx, instance, empty);
-            }
+          EventBase empty{""};
+          if (guard_passes(ctx, instance, empty, t_id)) {
+            std::array<bool, leaf_slot_count> consumed{};
+            execute_region_transition(ctx, instance, empty, t_id, leaf, consumed);
+            return true;
           }
+        }
 
-          if (guard_passed) {
-            EventBase empty{""};
-            execute_transition(ctx, instance, empty, t, t_id);
-            handled = true;
-            break;
+        if (!detail::any(normalized_model.states[curr].flags, detail::state_flags::final)) return false;
+        std::size_t parent = normalized_model.states[curr].parent_id;
+        if (parent != detail::invalid_index &&
+            detail::any(normalized_model.states[parent].flags, detail::state_flags::region)) {
+          parent = normalized_model.states[parent].parent_id;
+          if (!regions_completed(parent)) return false;
+        }
+        curr = parent;
+      }
+      return false;
+    }
+
+    constexpr bool regions_completed(std::size_t s) const {
+      const auto regions = region_layout.regions[s];
+      for (std::size_t i = 0; i < regions.count; ++i) {
+        const std::size_t r = region_layout.region_list[regions.start + i];
+        const std::size_t leaf = state_->regions.leaves[region_layout.slot[r]];
+        if (leaf == detail::invalid_index ||
+            normalized_model.states[leaf].parent_id != r ||
+            !detail::any(normalized_model.states[leaf].flags, detail::state_flags::final)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // --- Inlined dispatch (dispatch_mode::inlined) ---
+    //
+    // Everything below is resolved from the dense tables at compile time: the
+    // candidate chain of each (state, event) pair, each candidate's guard, and
+    // the exit/entry paths between the active leaf and the transition target.
+
+    // Canonical event ids with a candidate chain of their own in state S.
+    // Events that only reach the wildcard chain share the fallback below.
+    static constexpr bool has_own_chain(std::size_t s, std::size_t ev) {
+      std::size_t head = dense_tables.transition_table[s][ev];
+      return head != detail::invalid_index &&
+             head != dense_tables.wildcard_transition_table[s];
+    }
+
+    template <std::size_t S>
+    static consteval std::size_t count_inlined_events() {
+      std::size_t n = 0;
+      for (std::size_t ev = 0; ev < decltype(dense_tables)::event_count; ++ev) {
+        if (has_own_chain(S, ev)) ++n;
+      }
+      return n;
+    }
+
+    template <std::size_t S>
+    static consteval auto make_inlined_events() {
+      std::array<std::size_t, count_inlined_events<S>()> ids{};
+      std::size_t n = 0;
+      for (std::size_t ev = 0; ev < decltype(dense_tables)::event_count; ++ev) {
+        if (has_own_chain(S, ev)) ids[n++] = ev;
+      }
+      return ids;
+    }
+
+    template <std::size_t S>
+    static constexpr auto inlined_events = make_inlined_events<S>();
+
+    template <std::size_t S, std::size_t... Is>
+    bool dispatch_inlined(ContextType& ctx, instance_type& instance,
+                          const EventBase& e, [[maybe_unused]] std::size_t event_id,
+                          std::index_sequence<Is...>) {
+      bool handled = false;
+      static_cast<void>(
+          ((event_id == inlined_events<S>[Is] &&
+            (handled = try_inlined<S, dense_tables.transition_table[S][inlined_events<S>[Is]]>(
+                 ctx, instance, e),
+             true)) ||
+           ...));
+      if (handled) return true;
+      return try_inlined<S, dense_tables.wildcard_transition_table[S]>(ctx, instance, e);
+    }
+
+    // Walks one candidate chain. Chains can share tails through the wildcard
+    // links, so the walk is bounded by the transition count like the runtime
+    // loop would be by the guards.
+    template <std::size_t S, std::size_t T,
+              std::size_t Budget = decltype(dense_tables)::transition_count>
+    bool try_inlined(ContextType& ctx, instance_type& instance, const EventBase& e) {
+      if constexpr (T == detail::invalid_index || Budget == 0) {
+        return false;
+      } else {
+        constexpr auto t = normalized_model.transitions[T];
+        if constexpr (t.guard_idx < guard_table.size()) {
+          const bool passed = guard_thunk<t.guard_idx>(ctx, instance, e);
+          HSM_PROBE3(cthsm, guard, state_, T, passed);
+          if (!passed) {
+            if constexpr (observed) Observer::on_guard_rejected(T);
+            return try_inlined<S, dense_tables.next_candidate[T], Budget - 1>(ctx, instance, e);
           }
         }
+        run_inlined<S, T>(ctx, instance, e);
+        return true;
       }
-      
-      if (handled) return;
+    }
 
-      // If current state is Final, its parent is also considered complete,
-      // so we check for completion transitions on the parent.
-      if ((normalized_model.states[curr].flags & detail::state_flags::final) != detail::state_flags::none) {
-        curr = normalized_model.states[curr].parent_id;
+    template <std::size_t S, std::size_t T>
+    void run_inlined(ContextType& ctx, instance_type& instance, const EventBase& e) {
+      constexpr auto t = normalized_model.transitions[T];
+      constexpr std::size_t lca = dense_tables.transition_lca[T];
+
+      if constexpr (t.history != detail::history_kind::none ||
+                    (t.target_id != detail::invalid_index && lca == detail::invalid_index)) {
+        // Targets only known at runtime keep the generic path
+        execute_transition(ctx, instance, e, t, T);
+      } else if constexpr (t.target_id == detail::invalid_index) {
+        observe_transition(T);
+        call_effects<t.effect_start>(ctx, instance, e, std::make_index_sequence<t.effect_count>{});
+        HSM_PROBE3(cthsm, transition_end, state_, T, current());
       } else {
-        break;
+        observe_transition(T);
+        exit_inlined<S, lca>(ctx, instance, e);
+        call_effects<t.effect_start>(ctx, instance, e, std::make_index_sequence<t.effect_count>{});
+        enter_inlined<t.target_id, lca>(ctx, instance, e);
+        set_current(t.target_id);
+
+        resolve_initial_inlined<t.target_id>(ctx, instance, e);
+        if constexpr (may_complete(initial_leaf(t.target_id))) {
+          resolve_completion(ctx, instance);
+        }
+        update_history_from_leaf(current());
+        HSM_PROBE3(cthsm, transition_end, state_, T, current());
       }
     }
-  }
 
-  // Update history arrays from the currently active leaf state.
-  constexpr void update_history_from_leaf(std::size_t leaf_id) {
-    if (leaf_id == detail::invalid_index) return;
-    std::size_t curr = leaf_id;
-    while (curr != detail::invalid_index) {
-      last_active_leaf_[curr] = leaf_id;
-      curr = normalized_model.states[curr].parent_id;
+    template <std::size_t S>
+    void resolve_initial_inlined(ContextType& ctx, instance_type& instance, const EventBase& e) {
+      constexpr std::size_t init = normalized_model.states[S].initial_transition_id;
+      if constexpr (init != detail::invalid_index) {
+        constexpr auto t = normalized_model.transitions[init];
+        call_effects<t.effect_start>(ctx, instance, e, std::make_index_sequence<t.effect_count>{});
+        if constexpr (t.target_id != detail::invalid_index) {
+          enter_inlined<t.target_id, S>(ctx, instance, e);
+          set_current(t.target_id);
+          resolve_initial_inlined<t.target_id>(ctx, instance, e);
+        }
+      }
     }
-  }
 
-  constexpr void process_deferred(instance_type& instance) {
-    std::size_t count = deferred_count_;
-    if (count == 0) return;
+    // State reached by following the default initial chain from s.
+    static constexpr std::size_t initial_leaf(std::size_t s) {
+      std::size_t init = normalized_model.states[s].initial_transition_id;
+      while (init != detail::invalid_index &&
+             normalized_model.transitions[init].target_id != detail::invalid_index) {
+        s = normalized_model.transitions[init].target_id;
+        init = normalized_model.states[s].initial_transition_id;
+      }
+      return s;
+    }
 
-    std::array<std::size_t, max_deferred_events> current_queue = deferred_queue_;
-    deferred_count_ = 0;
+    // Whether resolve_completion can do anything once s is the active leaf.
+    static constexpr bool may_complete(std::size_t s) {
+      return tables.completion_transitions_ranges[s].count > 0 ||
+             (normalized_model.states[s].flags & detail::state_flags::final) !=
+                 detail::state_flags::none;
+    }
 
-    for (std::size_t i = 0; i < count; ++i) {
-      std::size_t evt_id = current_queue[i];
-      if (is_deferred(current_state_id_, evt_id)) {
-        if (deferred_count_ < max_deferred_events) {
-          deferred_queue_[deferred_count_++] = evt_id;
+    template <std::size_t From, std::size_t Lca>
+    void exit_inlined(ContextType& ctx, instance_type& instance, const EventBase& e) {
+      if constexpr (From != Lca && From != detail::invalid_index) {
+        constexpr auto s = normalized_model.states[From];
+        constexpr bool nested = detail::any(s.flags, detail::state_flags::submachine);
+        if constexpr (nested) {
+          stop_state_tasks(instance, e, From);
         }
-      } else {
-        std::string_view name = normalized_model.get_event_name(evt_id);
-        dispatch(instance, name);
+        call_exits<s.exit_start>(ctx, instance, e, std::make_index_sequence<s.exit_count>{});
+        if constexpr (owns_tasks(From) && !nested) {
+          stop_state_tasks(instance, e, From);
+        }
+        observe_exit(From);
+        exit_inlined<s.parent_id, Lca>(ctx, instance, e);
       }
     }
-  }
+
+    template <std::size_t To, std::size_t Lca>
+    void enter_inlined(ContextType& ctx, instance_type& instance, const EventBase& e) {
+      if constexpr (To != Lca && To != detail::invalid_index) {
+        constexpr auto s = normalized_model.states[To];
+        enter_inlined<s.parent_id, Lca>(ctx, instance, e);
+        observe_enter(To);
+        call_entries<s.entry_start>(ctx, instance, e, std::make_index_sequence<s.entry_count>{});
+        if constexpr (owns_tasks(To)) {
+          start_state_tasks(instance, e, To);
+        }
+      }
+    }
+
+    static constexpr bool owns_tasks(std::size_t s_id) {
+      return normalized_model.states[s_id].activity_count > 0 ||
+             tables.state_timer_ranges[s_id].count > 0 ||
+             detail::any(normalized_model.states[s_id].flags, detail::state_flags::submachine);
+    }
+
+    // Record the active leaf for every history-targeted composite above it.
+    constexpr void update_history_from_leaf(std::size_t leaf_id) {
+      if (leaf_id == detail::invalid_index) return;
+      for (std::size_t slot = 0; slot < history_composite_count; ++slot) {
+        std::size_t composite = history_slots.composites[slot];
+        std::size_t d = ancestry.depth[composite];
+        if (d <= ancestry.depth[leaf_id] && ancestry.ancestor_at(leaf_id, d) == composite) {
+          state_->history.leaf[slot] = static_cast<state_index>(leaf_id);
+        }
+      }
+    }
+
+    // Queues an event deferred by the active configuration; dropped when full
+    constexpr void defer(std::size_t event_id) {
+      if constexpr (deferral_capacity > 0) {
+        auto& queue = state_->deferred;
+        if (queue.count < deferral_capacity) {
+          queue.events[queue.count++] = static_cast<event_index>(event_id);
+        }
+      }
+    }
+
+    constexpr void process_deferred(instance_type& instance) {
+      if constexpr (deferral_capacity > 0) {
+        const std::size_t count = state_->deferred.count;
+        if (count == 0) return;
+
+        const auto current_queue = state_->deferred.events;
+        state_->deferred.count = 0;
+
+        for (std::size_t i = 0; i < count; ++i) {
+          std::size_t evt_id = current_queue[i];
+          if (is_deferred_in_configuration(evt_id)) {
+            defer(evt_id);
+          } else {
+            HSM_PROBE3(cthsm, dequeue, state_, current(), evt_id);
+            std::string_view name = normalized_model.get_event_name(evt_id);
+            dispatch(instance, name);
+          }
+        }
+      }
+    }
+  };
+
+  constexpr runner run() noexcept { return runner{&state_, &task_provider_}; }
 };
 
 }  // namespace cthsm
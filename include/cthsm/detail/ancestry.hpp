@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+#include "cthsm/detail/meta_model.hpp"
+
+namespace cthsm::detail {
+
+// Ancestor and LCA lookups over the state tree.
+//
+// ancestor[s][d] is the ancestor of s at depth d (the root has depth 0), so
+// the path from any ancestor down to s is read top-down without buffers.
+// LCA queries use the Euler tour of the tree with a sparse table over it
+// (range-minimum by depth), which answers any pair in O(1).
+template <std::size_t StateCount, std::size_t MaxDepth>
+struct ancestry_tables {
+  static constexpr std::size_t tour_length =
+      StateCount == 0 ? 0 : 2 * StateCount - 1;
+  static constexpr std::size_t levels =
+      tour_length == 0 ? 0 : static_cast<std::size_t>(std::bit_width(tour_length));
+
+  std::array<std::size_t, StateCount> depth{};
+  std::array<std::array<std::size_t, MaxDepth>, StateCount> ancestor{};
+  std::array<std::size_t, StateCount> first_visit{};
+  // sparse[k][i]: shallowest state in tour[i, i + 2^k)
+  std::array<std::array<std::size_t, tour_length>, levels> sparse{};
+
+  constexpr std::size_t ancestor_at(std::size_t s, std::size_t d) const {
+    return ancestor[s][d];
+  }
+
+  constexpr std::size_t lca(std::size_t a, std::size_t b) const {
+    if (a >= StateCount || b >= StateCount) return invalid_index;
+    std::size_t l = first_visit[a];
+    std::size_t r = first_visit[b];
+    if (l > r) {
+      std::size_t tmp = l;
+      l = r;
+      r = tmp;
+    }
+    const auto k = static_cast<std::size_t>(std::bit_width(r - l + 1)) - 1;
+    const std::size_t x = sparse[k][l];
+    const std::size_t y = sparse[k][r + 1 - (std::size_t{1} << k)];
+    return depth[x] <= depth[y] ? x : y;
+  }
+};
+
+template <typename ModelData>
+consteval auto build_ancestry(const ModelData& data) {
+    constexpr std::size_t SC = ModelData::state_count;
+    constexpr std::size_t MD = ModelData::max_depth;
+    using tables_type = ancestry_tables<SC, MD>;
+
+    tables_type out{};
+    for (auto& row : out.ancestor) row.fill(invalid_index);
+
+    for (std::size_t s = 0; s < SC; ++s) {
+        std::size_t d = 0;
+        for (std::size_t p = data.states[s].parent_id; p != invalid_index;
+             p = data.states[p].parent_id) {
+            ++d;
+        }
+        out.depth[s] = d;
+        for (std::size_t a = s; a != invalid_index; a = data.states[a].parent_id) {
+            out.ancestor[s][d--] = a;
+        }
+    }
+
+    // Euler tour (iterative DFS from every root)
+    std::vector<std::vector<std::size_t>> children(SC);
+    for (std::size_t s = 0; s < SC; ++s) {
+        const std::size_t p = data.states[s].parent_id;
+        if (p != invalid_index) children[p].push_back(s);
+    }
+    std::vector<std::size_t> tour;
+    struct frame { std::size_t state; std::size_t next_child; };
+    for (std::size_t root = 0; root < SC; ++root) {
+        if (data.states[root].parent_id != invalid_index) continue;
+        std::vector<frame> stack{{root, 0}};
+        out.first_visit[root] = tour.size();
+        tour.push_back(root);
+        while (!stack.empty()) {
+            frame& top = stack.back();
+            if (top.next_child < children[top.state].size()) {
+                const std::size_t child = children[top.state][top.next_child++];
+                out.first_visit[child] = tour.size();
+                tour.push_back(child);
+                stack.push_back({child, 0});
+            } else {
+                stack.pop_back();
+                if (!stack.empty()) tour.push_back(stack.back().state);
+            }
+        }
+    }
+
+    if constexpr (tables_type::levels > 0) {
+        for (std::size_t i = 0; i < tour.size() && i < tables_type::tour_length; ++i) {
+            out.sparse[0][i] = tour[i];
+        }
+        for (std::size_t k = 1; k < tables_type::levels; ++k) {
+            const std::size_t half = std::size_t{1} << (k - 1);
+            for (std::size_t i = 0; i + (std::size_t{1} << k) <= tables_type::tour_length; ++i) {
+                const std::size_t x = out.sparse[k - 1][i];
+                const std::size_t y = out.sparse[k - 1][i + half];
+                out.sparse[k][i] = out.depth[x] <= out.depth[y] ? x : y;
+            }
+        }
+    }
+
+    return out;
+}
+
+// Composites referenced by shallow_history/deep_history targets. Only these
+// need their last active leaf recorded.
+template <std::size_t StateCount, std::size_t Count>
+struct history_index {
+  static constexpr std::size_t count = Count;
+  std::array<std::size_t, Count> composites{};  // slot -> state id
+  std::array<std::size_t, StateCount> slot{};   // state id -> slot
+};
+
+// Marks every composite some history transition points at. Only runs
+// during constant evaluation.
+template <typename ModelData>
+constexpr std::vector<bool> history_targets(const ModelData& data) {
+    std::vector<bool> targeted(ModelData::state_count, false);
+    for (const auto& t : data.transitions) {
+        if (t.history != history_kind::none && t.history_parent < ModelData::state_count) {
+            targeted[t.history_parent] = true;
+        }
+    }
+    return targeted;
+}
+
+template <typename ModelData>
+consteval std::size_t count_history_composites(const ModelData& data) {
+    const auto targeted = history_targets(data);
+    std::size_t n = 0;
+    for (bool b : targeted) n += b ? 1 : 0;
+    return n;
+}
+
+template <std::size_t Count, typename ModelData>
+consteval auto build_history_index(const ModelData& data) {
+    constexpr std::size_t SC = ModelData::state_count;
+    history_index<SC, Count> out{};
+    out.slot.fill(invalid_index);
+    const auto targeted = history_targets(data);
+    std::size_t n = 0;
+    for (std::size_t s = 0; s < SC; ++s) {
+        if (!targeted[s]) continue;
+        out.slot[s] = n;
+        out.composites[n++] = s;
+    }
+    return out;
+}
+
+}  // namespace cthsm::detail
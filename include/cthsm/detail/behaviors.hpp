@@ -118,13 +118,14 @@ constexpr auto extract_guards_from_transition_tuple(const Tuple& t) {
     return extract_guards_from_transition(t, std::make_index_sequence<std::tuple_size_v<Tuple>>{});
 }
 
+// Matched by type: when_expr also has a predicate, but it is a timer
+template <typename Callable>
+constexpr auto extract_guards_item(const guard_expr<Callable>& node) {
+    return std::make_tuple(node.predicate);
+}
 template <typename T>
-constexpr auto extract_guards_item(const T& node) {
-    if constexpr (requires { node.predicate; }) { // guard_expr
-        return std::make_tuple(node.predicate);
-    } else {
-        return std::tuple<>{};
-    }
+constexpr auto extract_guards_item(const T&) {
+    return std::tuple<>{};
 }
 template <typename Tuple, std::size_t... Is>
 constexpr auto extract_guards_from_transition(const Tuple& t, std::index_sequence<Is...>) {
@@ -230,11 +231,16 @@ constexpr auto extract_effects(const initial_expr<Partials...>& node) {
 
 
 // --- Timers ---
+template <typename T>
+struct is_when_expr : std::false_type {};
+template <typename Callable>
+struct is_when_expr<when_expr<Callable>> : std::true_type {};
+
 template <typename T>
 constexpr auto extract_timers_item(const T& node) {
     if constexpr (requires { node.duration; }) { // after/every
         return std::make_tuple(node.duration);
-    } else if constexpr (requires { node.predicate; }) { // when
+    } else if constexpr (is_when_expr<T>::value) {
         return std::make_tuple(node.predicate);
     } else if constexpr (requires { node.time_point; }) { // at
         return std::make_tuple(node.time_point);
@@ -278,4 +284,31 @@ constexpr auto extract_timers(const initial_expr<Partials...>& node) {
     return extract_timers_tuple(node.elements);
 }
 
+// --- Submachine Extraction ---
+// One submachine_ref per submachine state, in state (pre-)order
+
+template <typename T>
+constexpr auto extract_submachines(const T& node) {
+    if constexpr (requires { node.elements; }) {
+        return extract_submachines_tuple(node.elements);
+    } else {
+        return std::tuple<>{};
+    }
+}
+
+template <typename Tuple, std::size_t... Is>
+constexpr auto extract_submachines_tuple_impl(const Tuple& t, std::index_sequence<Is...>) {
+    return tuple_cat_constexpr(extract_submachines(get<Is>(t))...);
+}
+
+template <typename Tuple>
+constexpr auto extract_submachines_tuple(const Tuple& t) {
+    return extract_submachines_tuple_impl(t, std::make_index_sequence<std::tuple_size_v<Tuple>>{});
+}
+
+template <auto SubModel, typename Name, typename... Partials>
+constexpr auto extract_submachines(const submachine_expr<SubModel, Name, Partials...>&) {
+    return std::tuple<submachine_ref<SubModel>>{};
+}
+
 } // namespace cthsm::detail
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "cthsm/detail/meta_model.hpp"
+
+namespace cthsm::detail {
+
+// Smallest unsigned type able to hold [0, N) plus a max() sentinel.
+template <std::size_t N>
+using compact_index_t = std::conditional_t<
+    (N < std::numeric_limits<std::uint8_t>::max()), std::uint8_t,
+    std::conditional_t<
+        (N < std::numeric_limits<std::uint16_t>::max()), std::uint16_t,
+        std::conditional_t<(N < std::numeric_limits<std::uint32_t>::max()),
+                           std::uint32_t, std::size_t>>>;
+
+// Placeholder used by compile<> when the dense layout is selected.
+struct no_compressed_table {};
+
+// Dimensions of a compressed transition table, computed from the dense one.
+struct compressed_shape {
+  std::size_t classes = 0;  // event equivalence classes (merged columns)
+  std::size_t rows = 0;     // distinct state rows (merged rows)
+  std::size_t slots = 0;    // length of the comb-packed slot array
+};
+
+// Compressed replacement for lookup_tables::transition_table.
+//
+// The dense StateCount x EventCount matrix is reduced in three steps:
+//   1. events whose columns are identical in every state share a class,
+//   2. states whose rows (over classes) are identical share a row,
+//   3. the distinct rows are overlaid into one slot array ("comb" packing):
+//      every row gets a base offset and each occupied slot records its
+//      owning row, so lookups that land in a foreign slot read as empty.
+// A lookup is still O(1): two small-array reads plus one checked slot read.
+template <std::size_t StateCount, std::size_t EventCount,
+          std::size_t TransitionCount, std::size_t Classes, std::size_t Rows,
+          std::size_t Slots>
+struct compressed_transition_table {
+  using class_type = compact_index_t<Classes>;
+  using row_type = compact_index_t<Rows>;
+  using slot_type = compact_index_t<Slots>;
+  using transition_type = compact_index_t<TransitionCount>;
+
+  static constexpr std::size_t class_count = Classes;
+  static constexpr std::size_t row_count = Rows;
+  static constexpr std::size_t slot_count = Slots;
+
+  static constexpr row_type no_owner = std::numeric_limits<row_type>::max();
+
+  std::array<class_type, EventCount> event_class{};
+  std::array<row_type, StateCount> state_row{};
+  std::array<slot_type, Rows> row_base{};
+  std::array<row_type, Slots> slot_owner{};
+  std::array<transition_type, Slots> slot_transition{};
+
+  constexpr std::size_t get_transition_id(std::size_t state_id,
+                                          std::size_t event_id) const {
+    if (state_id >= StateCount || event_id >= EventCount) return invalid_index;
+    const row_type row = state_row[state_id];
+    const std::size_t slot = static_cast<std::size_t>(row_base[row]) +
+                             static_cast<std::size_t>(event_class[event_id]);
+    if (slot_owner[slot] != row) return invalid_index;
+    return slot_transition[slot];
+  }
+
+  // Bytes occupied by the lookup arrays (for size comparisons in tests and
+  // benchmarks).
+  static constexpr std::size_t storage_bytes() {
+    return sizeof(event_class) + sizeof(state_row) + sizeof(row_base) +
+           sizeof(slot_owner) + sizeof(slot_transition);
+  }
+};
+
+struct compression_plan {
+  std::vector<std::size_t> event_class;  // event id -> class
+  std::vector<std::size_t> class_event;  // class -> representative event id
+  std::vector<std::size_t> state_row;    // state id -> row
+  std::vector<std::size_t> row_state;    // row -> representative state id
+  std::vector<std::size_t> row_base;     // row -> offset into slots
+  std::size_t slot_count = 0;
+};
+
+// Shared by measure_compression and compress_transition_table so both agree
+// on the layout. Only runs during constant evaluation.
+template <typename Tables>
+constexpr compression_plan plan_compression(const Tables& tables) {
+    constexpr std::size_t SC = Tables::state_count;
+    constexpr std::size_t EC = Tables::event_count;
+    const auto& dense = tables.transition_table;
+
+    constexpr auto mix = [](std::size_t h, std::size_t v) {
+        return (h ^ v) * std::size_t{1099511628211ULL};
+    };
+
+    compression_plan plan{};
+
+    // 1. Event equivalence classes (merge identical columns)
+    std::vector<std::size_t> column_hash(EC, std::size_t{14695981039346656037ULL});
+    for (std::size_t s = 0; s < SC; ++s) {
+        for (std::size_t e = 0; e < EC; ++e) {
+            column_hash[e] = mix(column_hash[e], dense[s][e]);
+        }
+    }
+
+    plan.event_class.assign(EC, invalid_index);
+    for (std::size_t e = 0; e < EC; ++e) {
+        for (std::size_t c = 0; c < plan.class_event.size(); ++c) {
+            std::size_t rep = plan.class_event[c];
+            if (column_hash[rep] != column_hash[e]) continue;
+            bool same = true;
+            for (std::size_t s = 0; s < SC && same; ++s) {
+                same = dense[s][rep] == dense[s][e];
+            }
+            if (same) {
+                plan.event_class[e] = c;
+                break;
+            }
+        }
+        if (plan.event_class[e] == invalid_index) {
+            plan.event_class[e] = plan.class_event.size();
+            plan.class_event.push_back(e);
+        }
+    }
+
+    const std::size_t K = plan.class_event.size();
+
+    // 2. Row deduplication over classes (states inheriting the same handlers)
+    std::vector<std::size_t> row_hash(SC, std::size_t{14695981039346656037ULL});
+    for (std::size_t s = 0; s < SC; ++s) {
+        for (std::size_t c = 0; c < K; ++c) {
+            row_hash[s] = mix(row_hash[s], dense[s][plan.class_event[c]]);
+        }
+    }
+
+    plan.state_row.assign(SC, invalid_index);
+    for (std::size_t s = 0; s < SC; ++s) {
+        for (std::size_t r = 0; r < plan.row_state.size(); ++r) {
+            std::size_t rep = plan.row_state[r];
+            if (row_hash[rep] != row_hash[s]) continue;
+            bool same = true;
+            for (std::size_t c = 0; c < K && same; ++c) {
+                same = dense[rep][plan.class_event[c]] == dense[s][plan.class_event[c]];
+            }
+            if (same) {
+                plan.state_row[s] = r;
+                break;
+            }
+        }
+        if (plan.state_row[s] == invalid_index) {
+            plan.state_row[s] = plan.row_state.size();
+            plan.row_state.push_back(s);
+        }
+    }
+
+    const std::size_t R = plan.row_state.size();
+
+    // 3. Comb packing, densest rows first (first-fit displacement)
+    std::vector<std::size_t> occupancy(R, 0);
+    std::vector<std::size_t> order(R, 0);
+    for (std::size_t r = 0; r < R; ++r) {
+        order[r] = r;
+        for (std::size_t c = 0; c < K; ++c) {
+            if (dense[plan.row_state[r]][plan.class_event[c]] != invalid_index) {
+                occupancy[r]++;
+            }
+        }
+    }
+    for (std::size_t i = 1; i < R; ++i) {
+        std::size_t r = order[i];
+        std::size_t j = i;
+        while (j > 0 && occupancy[order[j - 1]] < occupancy[r]) {
+            order[j] = order[j - 1];
+            --j;
+        }
+        order[j] = r;
+    }
+
+    std::vector<bool> used(K, false);
+    plan.row_base.assign(R, 0);
+    for (std::size_t r : order) {
+        const std::size_t s = plan.row_state[r];
+        std::size_t base = 0;
+        if (occupancy[r] > 0) {
+            for (;; ++base) {
+                bool fits = true;
+                for (std::size_t c = 0; c < K && fits; ++c) {
+                    if (dense[s][plan.class_event[c]] == invalid_index) continue;
+                    fits = base + c >= used.size() || !used[base + c];
+                }
+                if (fits) break;
+            }
+            if (used.size() < base + K) used.resize(base + K, false);
+            for (std::size_t c = 0; c < K; ++c) {
+                if (dense[s][plan.class_event[c]] != invalid_index) {
+                    used[base + c] = true;
+                }
+            }
+        }
+        plan.row_base[r] = base;
+    }
+    plan.slot_count = used.size();
+
+    return plan;
+}
+
+template <typename Tables>
+consteval compressed_shape measure_compression(const Tables& tables) {
+    auto plan = plan_compression(tables);
+    return {plan.class_event.size(), plan.row_state.size(), plan.slot_count};
+}
+
+template <compressed_shape Shape, typename Tables>
+consteval auto compress_transition_table(const Tables& tables) {
+    constexpr std::size_t SC = Tables::state_count;
+    constexpr std::size_t EC = Tables::event_count;
+    constexpr std::size_t TC = Tables::transition_count;
+
+    using table_type = compressed_transition_table<SC, EC, TC, Shape.classes,
+                                                   Shape.rows, Shape.slots>;
+    using class_type = typename table_type::class_type;
+    using row_type = typename table_type::row_type;
+    using slot_type = typename table_type::slot_type;
+    using transition_type = typename table_type::transition_type;
+
+    auto plan = plan_compression(tables);
+    table_type out{};
+
+    for (std::size_t e = 0; e < EC; ++e) {
+        out.event_class[e] = static_cast<class_type>(plan.event_class[e]);
+    }
+    for (std::size_t s = 0; s < SC; ++s) {
+        out.state_row[s] = static_cast<row_type>(plan.state_row[s]);
+    }
+    out.slot_owner.fill(table_type::no_owner);
+    out.slot_transition.fill(std::numeric_limits<transition_type>::max());
+
+    for (std::size_t r = 0; r < Shape.rows; ++r) {
+        const std::size_t base = plan.row_base[r];
+        const std::size_t s = plan.row_state[r];
+        out.row_base[r] = static_cast<slot_type>(base);
+        for (std::size_t c = 0; c < Shape.classes; ++c) {
+            std::size_t t_id = tables.transition_table[s][plan.class_event[c]];
+            if (t_id == invalid_index) continue;
+            out.slot_owner[base + c] = static_cast<row_type>(r);
+            out.slot_transition[base + c] = static_cast<transition_type>(t_id);
+        }
+    }
+
+    return out;
+}
+
+}  // namespace cthsm::detail
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include "cthsm/detail/meta_model.hpp"
+
+namespace cthsm::detail {
+
+// Binary min-heap of timer deadlines keyed by timer index. Every timer has
+// at most one pending deadline, so the heap never holds more than Capacity
+// entries and `position` lets a timer be cancelled in O(log n) when its
+// state is exited.
+template <typename TimePoint, std::size_t Capacity>
+struct deadline_heap {
+  std::array<std::size_t, Capacity> heap{};      // heap slot -> timer index
+  std::array<std::size_t, Capacity> position{};  // timer index -> heap slot
+  std::array<TimePoint, Capacity> deadline{};
+  std::size_t size{0};
+
+  constexpr deadline_heap() { position.fill(invalid_index); }
+
+  [[nodiscard]] constexpr bool empty() const { return size == 0; }
+  [[nodiscard]] constexpr bool contains(std::size_t timer) const {
+    return position[timer] != invalid_index;
+  }
+  [[nodiscard]] constexpr std::size_t top() const { return heap[0]; }
+  [[nodiscard]] constexpr TimePoint top_deadline() const { return deadline[heap[0]]; }
+
+  // Inserts the timer, or moves its deadline if already pending
+  constexpr void schedule(std::size_t timer, TimePoint when) {
+    if (contains(timer)) {
+      const TimePoint old = deadline[timer];
+      deadline[timer] = when;
+      if (when < old) {
+        sift_up(position[timer]);
+      } else {
+        sift_down(position[timer]);
+      }
+      return;
+    }
+    deadline[timer] = when;
+    heap[size] = timer;
+    position[timer] = size;
+    sift_up(size++);
+  }
+
+  constexpr void cancel(std::size_t timer) {
+    const std::size_t slot = position[timer];
+    if (slot == invalid_index) return;
+    position[timer] = invalid_index;
+    if (slot == --size) return;
+    heap[slot] = heap[size];
+    position[heap[slot]] = slot;
+    sift_down(slot);
+    sift_up(slot);
+  }
+
+  constexpr void clear() {
+    for (std::size_t i = 0; i < size; ++i) position[heap[i]] = invalid_index;
+    size = 0;
+  }
+
+ private:
+  constexpr bool earlier(std::size_t a, std::size_t b) const {
+    return deadline[heap[a]] < deadline[heap[b]];
+  }
+
+  constexpr void swap_slots(std::size_t a, std::size_t b) {
+    const std::size_t t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+    position[heap[a]] = a;
+    position[heap[b]] = b;
+  }
+
+  constexpr void sift_up(std::size_t slot) {
+    while (slot > 0) {
+      const std::size_t parent = (slot - 1) / 2;
+      if (!earlier(slot, parent)) break;
+      swap_slots(slot, parent);
+      slot = parent;
+    }
+  }
+
+  constexpr void sift_down(std::size_t slot) {
+    while (true) {
+      const std::size_t left = 2 * slot + 1;
+      const std::size_t right = left + 1;
+      std::size_t first = slot;
+      if (left < size && earlier(left, first)) first = left;
+      if (right < size && earlier(right, first)) first = right;
+      if (first == slot) return;
+      swap_slots(slot, first);
+      slot = first;
+    }
+  }
+};
+
+}  // namespace cthsm::detail
@@ -22,6 +22,28 @@ struct state_expr {
   structural_tuple<Partials...> elements;
 };
 
+// Orthogonal region: behaves like a state node in the tree, but all regions
+// of a state are active at the same time.
+template <typename Name, typename... Partials>
+struct region_expr {
+  Name name;
+  structural_tuple<Partials...> elements;
+};
+
+// Submachine state: a leaf of the enclosing model that runs SubModel, a
+// separately compiled model, while it is active. Its elements are the
+// usage's own behaviors and transitions.
+template <auto SubModel, typename Name, typename... Partials>
+struct submachine_expr {
+  Name name;
+  structural_tuple<Partials...> elements;
+};
+
+template <auto SubModel>
+struct submachine_ref {
+  static constexpr auto model = SubModel;
+};
+
 template <typename... Partials>
 struct transition_expr {
   structural_tuple<Partials...> elements;
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+#include "cthsm/detail/compressed_tables.hpp"
+#include "cthsm/detail/meta_model.hpp"
+
+namespace cthsm::detail {
+
+// Parts of compile<>::machine_state. Each one has an empty specialization
+// for models that do not use it, whose arrays are zero-length statics: code
+// indexing them still compiles, and the part takes no space in the machine.
+
+// Cancellation context and task handle of every activity or task timer.
+// Tag keeps the activity and timer parts distinct types, so both can be
+// empty members of the same machine.
+template <typename Context, typename Task, std::size_t N, int Tag>
+struct task_slots {
+  std::array<Context, N> contexts{};
+  std::array<std::optional<Task>, N> tasks{};
+};
+
+template <typename Context, typename Task, int Tag>
+struct task_slots<Context, Task, 0, Tag> {
+  static inline std::array<Context, 0> contexts{};
+  static inline std::array<std::optional<Task>, 0> tasks{};
+};
+
+// One bit per running activity, so whether a state still waits for any of
+// its activities is one atomic load. A bit is set before the activity task
+// is created and cleared when the activity returns or is cancelled. With a
+// provider that defers completion, an activity returning on a worker
+// thread moves its bit to `finished` instead, the only thing it touches
+// there; the dispatching thread then takes the finished bits, releases the
+// tasks and runs the completion. Cancelling an activity clears both bits
+// once its task has been joined.
+template <std::size_t N>
+struct pending_activities {
+  static constexpr std::size_t word_bits = 64;
+  static constexpr std::size_t word_count = (N + word_bits - 1) / word_bits;
+  std::array<std::atomic<std::uint64_t>, word_count> words{};
+  std::array<std::atomic<std::uint64_t>, word_count> finished{};
+
+  void set(std::size_t i) noexcept {
+    words[i / word_bits].fetch_or(bit(i), std::memory_order_release);
+  }
+  void clear(std::size_t i) noexcept {
+    words[i / word_bits].fetch_and(~bit(i), std::memory_order_release);
+    finished[i / word_bits].fetch_and(~bit(i), std::memory_order_release);
+  }
+  // From the activity's task, as it returns
+  void finish(std::size_t i) noexcept {
+    finished[i / word_bits].fetch_or(bit(i), std::memory_order_release);
+    words[i / word_bits].fetch_and(~bit(i), std::memory_order_release);
+  }
+
+  // Whether any activity in [first, first + count) is running
+  [[nodiscard]] bool any(std::size_t first, std::size_t count) const noexcept {
+    while (count > 0) {
+      const std::size_t offset = first % word_bits;
+      const std::size_t n = count < word_bits - offset ? count : word_bits - offset;
+      const std::uint64_t mask =
+          (n == word_bits ? ~std::uint64_t{0} : (std::uint64_t{1} << n) - 1) << offset;
+      if ((words[first / word_bits].load(std::memory_order_acquire) & mask) != 0) return true;
+      first += n;
+      count -= n;
+    }
+    return false;
+  }
+
+  // Calls f(i) for, and clears, every activity that finished since the
+  // last call
+  template <typename F>
+  void take_finished(F&& f) noexcept(noexcept(f(std::size_t{}))) {
+    for (std::size_t w = 0; w < word_count; ++w) {
+      if (finished[w].load(std::memory_order_relaxed) == 0) continue;
+      std::uint64_t bits = finished[w].exchange(0, std::memory_order_acq_rel);
+      while (bits != 0) {
+        f(w * word_bits + static_cast<std::size_t>(std::countr_zero(bits)));
+        bits &= bits - 1;
+      }
+    }
+  }
+
+ private:
+  static constexpr std::uint64_t bit(std::size_t i) noexcept {
+    return std::uint64_t{1} << (i % word_bits);
+  }
+};
+
+template <>
+struct pending_activities<0> {
+  void set(std::size_t) noexcept {}
+  void clear(std::size_t) noexcept {}
+  void finish(std::size_t) noexcept {}
+  [[nodiscard]] bool any(std::size_t, std::size_t) const noexcept { return false; }
+  template <typename F>
+  void take_finished(F&&) noexcept {}
+};
+
+// Events deferred by the active configuration, oldest first
+template <typename EventIndex, std::size_t N>
+struct deferral_queue {
+  std::array<EventIndex, N> events{};
+  compact_index_t<N + 1> count{0};
+};
+
+template <typename EventIndex>
+struct deferral_queue<EventIndex, 0> {
+  static constexpr std::size_t count = 0;
+};
+
+// Most recently active leaf of every history-targeted composite
+template <typename StateIndex, std::size_t N>
+struct history_record {
+  static constexpr StateIndex none = std::numeric_limits<StateIndex>::max();
+  std::array<StateIndex, N> leaf{};
+
+  constexpr history_record() { leaf.fill(none); }
+};
+
+template <typename StateIndex>
+struct history_record<StateIndex, 0> {
+  static constexpr StateIndex none = std::numeric_limits<StateIndex>::max();
+  static inline std::array<StateIndex, 0> leaf{};
+};
+
+// Active leaf of every region slot (see region_layout)
+template <std::size_t N>
+struct region_leaves {
+  std::array<std::size_t, N> leaves{};
+
+  constexpr region_leaves() { leaves.fill(invalid_index); }
+};
+
+template <>
+struct region_leaves<0> {
+  static inline std::array<std::size_t, 0> leaves{};
+};
+
+// Armed when() conditions (when_mode::on_step)
+template <std::size_t N>
+struct condition_slots {
+  std::array<bool, N> armed{};
+  bool evaluating{false};
+};
+
+template <>
+struct condition_slots<0> {
+  static inline std::array<bool, 0> armed{};
+};
+
+// When each state was last entered, for observers that time state dwell
+template <typename TimePoint, std::size_t N>
+struct entry_times {
+  std::array<TimePoint, N> at{};
+};
+
+template <typename TimePoint>
+struct entry_times<TimePoint, 0> {
+  static inline std::array<TimePoint, 0> at{};
+};
+
+}  // namespace cthsm::detail
@@ -15,6 +15,8 @@ enum class state_flags : unsigned {
   initial = 1U << 0U,
   final = 1U << 1U,
   choice = 1U << 2U,
+  region = 1U << 3U,  // orthogonal region of its parent state
+  submachine = 1U << 4U,  // runs a separately compiled sub-model
 };
 
 constexpr state_flags operator|(state_flags lhs, state_flags rhs) noexcept {
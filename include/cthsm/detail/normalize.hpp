@@ -89,21 +89,15 @@ struct model_counts {
 template <typename T>
 consteval model_counts count_recursive(const T& node, std::size_t parent_path_len);
 
-template <typename Tuple, std::size_t I>
-consteval model_counts count_tuple(const Tuple& t, std::size_t parent_path_len);
-
+// Element lists are walked head/tail rather than with get<I>, which costs
+// O(I) evaluation steps per element and made large models quadratic.
 template <typename Tuple>
 consteval model_counts count_partials(const Tuple& t, std::size_t parent_path_len) {
-  return count_tuple<Tuple, 0>(t, parent_path_len);
-}
-
-template <typename Tuple, std::size_t I>
-consteval model_counts count_tuple(const Tuple& t, std::size_t parent_path_len) {
-  if constexpr (I >= std::tuple_size_v<Tuple>) {
+  if constexpr (std::tuple_size_v<Tuple> == 0) {
     return {};
   } else {
-    return count_recursive(get<I>(t), parent_path_len) +
-           count_tuple<Tuple, I + 1>(t, parent_path_len);
+    return count_recursive(t.head, parent_path_len) +
+           count_partials(t.tail, parent_path_len);
   }
 }
 
@@ -141,6 +135,30 @@ consteval model_counts count_recursive(
   return counts;
 }
 
+// Region Expression
+template <typename Name, typename... Partials>
+consteval model_counts count_recursive(
+    const region_expr<Name, Partials...>& node, std::size_t parent_path_len) {
+  std::size_t current_len = parent_path_len + 1 + node.name.size();
+  model_counts counts = count_partials(node.elements, current_len);
+  counts.states += 1;
+  counts.string_size += current_len;
+  counts.max_depth += 1;
+  return counts;
+}
+
+// Submachine Expression: one state; the sub-model is counted on its own
+template <auto SubModel, typename Name, typename... Partials>
+consteval model_counts count_recursive(
+    const submachine_expr<SubModel, Name, Partials...>& node, std::size_t parent_path_len) {
+  std::size_t current_len = parent_path_len + 1 + node.name.size();
+  model_counts counts = count_partials(node.elements, current_len);
+  counts.states += 1;
+  counts.string_size += current_len;
+  counts.max_depth += 1;
+  return counts;
+}
+
 // Choice Expression
 template <typename Name, typename... Partials>
 consteval model_counts count_recursive(
@@ -280,6 +298,9 @@ struct populate_ctx {
     std::size_t effect_idx = 0;
     std::size_t timer_idx = 0;
     std::size_t defer_idx = 0;
+
+    // One past the last descendant of every state, filled after pass 1
+    std::array<std::size_t, ModelData::state_count> subtree_end{};
     
     constexpr void append_string(ModelData& data, std::string_view str) {
         for (char c : str) {
@@ -288,36 +309,54 @@ struct populate_ctx {
     }
 };
 
-// Helper to find state ID by absolute path
+// Path lookups walk the state tree one segment at a time. States are
+// numbered in pre-order, so the descendants of a state are the contiguous
+// ids [s + 1, subtree_end[s]) and a child search hops from one child to the
+// next without visiting grandchildren. The model root is always state 0.
 template <typename ModelData>
-constexpr std::size_t find_state_id(const ModelData& data, std::string_view path) {
-    for (std::size_t i = 0; i < data.state_count; ++i) {
-        if (data.get_state_name(i) == path) return i;
+constexpr std::size_t find_child(const ModelData& data, const populate_ctx<ModelData>& ctx,
+                                 std::size_t parent_id, std::string_view name) {
+    if (parent_id == invalid_index) {
+        if (data.state_count == 0 || data.states[0].name_length != name.size() + 1) return invalid_index;
+        return data.get_state_name(0).substr(1) == name ? 0 : invalid_index;
+    }
+
+    const std::size_t prefix = data.states[parent_id].name_length + 1;
+    const std::size_t end = ctx.subtree_end[parent_id];
+    for (std::size_t i = parent_id + 1; i < end; i = ctx.subtree_end[i]) {
+        if (data.states[i].name_length != prefix + name.size()) continue;
+        // Generated names tend to share prefixes, so compare from the back
+        const std::size_t offset = data.states[i].name_offset + prefix;
+        std::size_t k = name.size();
+        while (k > 0 && data.string_buffer[offset + k - 1] == name[k - 1]) --k;
+        if (k == 0) return i;
     }
     return invalid_index;
 }
 
-// Check if state matches parent + "/" + name
+// Follows a '/'-separated relative path down from `base_id`
 template <typename ModelData>
-constexpr std::size_t find_child_state(const ModelData& data, std::string_view parent_path, std::string_view name) {
-    for (std::size_t i = 0; i < data.state_count; ++i) {
-        std::string_view candidate = data.get_state_name(i);
-        
-        // Check length
-        if (candidate.size() != parent_path.size() + 1 + name.size()) continue;
-        
-        // Check parent prefix
-        if (!candidate.starts_with(parent_path)) continue;
-        
-        // Check separator
-        if (candidate[parent_path.size()] != '/') continue;
-        
-        // Check suffix
-        if (candidate.substr(parent_path.size() + 1) != name) continue;
-        
-        return i;
+constexpr std::size_t find_descendant(const ModelData& data, const populate_ctx<ModelData>& ctx,
+                                      std::size_t base_id, std::string_view path) {
+    if (path.empty()) return invalid_index;
+    std::size_t current = base_id;
+    std::size_t pos = 0;
+    while (pos <= path.size()) {
+        std::size_t end = pos;
+        while (end < path.size() && path[end] != '/') ++end;
+        current = find_child(data, ctx, current, path.substr(pos, end - pos));
+        if (current == invalid_index) return invalid_index;
+        pos = end + 1;
     }
-    return invalid_index;
+    return current;
+}
+
+// Helper to find state ID by absolute path
+template <typename ModelData>
+constexpr std::size_t find_state_id(const ModelData& data, const populate_ctx<ModelData>& ctx,
+                                    std::string_view path) {
+    if (path.empty() || path[0] != '/') return invalid_index;
+    return find_descendant(data, ctx, invalid_index, path.substr(1));
 }
 
 // Helper to resolve target ID
@@ -325,38 +364,23 @@ constexpr std::size_t find_child_state(const ModelData& data, std::string_view p
 // For history targets, we never call this – history resolution is handled
 // separately via annotated transition_desc fields.
 template <typename ModelData>
-constexpr std::size_t resolve_target(const ModelData& data, std::string_view target_path, std::size_t source_id) {
+constexpr std::size_t resolve_target(const ModelData& data, const populate_ctx<ModelData>& ctx,
+                                     std::string_view target_path, std::size_t source_id) {
     // 1. Exact match (Absolute)
-    std::size_t id = find_state_id(data, target_path);
-    if (id != invalid_index) return id;
+    if (!target_path.empty() && target_path[0] == '/') {
+        return find_state_id(data, ctx, target_path);
+    }
     
     // 2. Relative resolution
     if (source_id != invalid_index) {
-        std::string_view source_path = data.get_state_name(source_id);
-        
         // 2a. Check Child (source/target)
-        id = find_child_state(data, source_path, target_path);
+        std::size_t id = find_descendant(data, ctx, source_id, target_path);
         if (id != invalid_index) return id;
         
-        // 2b. Check Sibling (parent(source)/target)
+        // 2b. Check Sibling (parent(source)/target). The root has no siblings.
         std::size_t parent_id = data.states[source_id].parent_id;
-        std::string_view parent_path = (parent_id != invalid_index) ? data.get_state_name(parent_id) : "";
-        
-        // If parent is invalid (source is root), parent_path is "".
-        // If source is root, 2b checks root's siblings? Root has no siblings.
-        // But if source is root, 2a checked root's children.
-        // If parent is invalid, we already checked children. 
-        // But find_child_state("", "name") checks for "/name".
-        // Our states are absolute paths starting with /.
-        // Root name is "/root". parent is invalid.
-        
         if (parent_id != invalid_index) {
-             id = find_child_state(data, parent_path, target_path);
-             if (id != invalid_index) return id;
-        } else {
-             // Source is root?
-             // Special case: parent of source is invalid.
-             // We can try to resolve against ROOT siblings? No.
+             return find_descendant(data, ctx, parent_id, target_path);
         }
     }
     return invalid_index;
@@ -367,17 +391,14 @@ template <typename ModelData, typename T>
 constexpr void collect_states(ModelData& data, populate_ctx<ModelData>& ctx, 
                               const T& node, std::string_view parent_path, std::size_t parent_id);
 
-template <typename ModelData, typename Tuple, std::size_t I>
-constexpr void collect_states_tuple(ModelData& data, populate_ctx<ModelData>& ctx, 
-                                    const Tuple& t, std::string_view parent_path, std::size_t parent_id);
 
 template <typename ModelData, typename T>
 constexpr void collect_transitions(ModelData& data, populate_ctx<ModelData>& ctx,
                                    const T& node, std::size_t current_state_id);
 
-template <typename ModelData, typename Tuple, std::size_t I>
-constexpr void collect_transitions_tuple(ModelData& data, populate_ctx<ModelData>& ctx,
-                                         const Tuple& t, std::size_t current_state_id);
+template <typename ModelData, typename Tuple>
+constexpr void collect_transitions_partials(ModelData& data, populate_ctx<ModelData>& ctx,
+                                            const Tuple& t, std::size_t current_state_id);
 
 
 // --- Implementations: Collect States ---
@@ -385,15 +406,9 @@ constexpr void collect_transitions_tuple(ModelData& data, populate_ctx<ModelData
 template <typename ModelData, typename Tuple>
 constexpr void collect_states_partials(ModelData& data, populate_ctx<ModelData>& ctx, 
                                        const Tuple& t, std::string_view parent_path, std::size_t parent_id) {
-    collect_states_tuple<ModelData, Tuple, 0>(data, ctx, t, parent_path, parent_id);
-}
-
-template <typename ModelData, typename Tuple, std::size_t I>
-constexpr void collect_states_tuple(ModelData& data, populate_ctx<ModelData>& ctx, 
-                                    const Tuple& t, std::string_view parent_path, std::size_t parent_id) {
-    if constexpr (I < std::tuple_size_v<Tuple>) {
-        collect_states(data, ctx, get<I>(t), parent_path, parent_id);
-        collect_states_tuple<ModelData, Tuple, I + 1>(data, ctx, t, parent_path, parent_id);
+    if constexpr (std::tuple_size_v<Tuple> > 0) {
+        collect_states(data, ctx, t.head, parent_path, parent_id);
+        collect_states_partials(data, ctx, t.tail, parent_path, parent_id);
     }
 }
 
@@ -503,6 +518,18 @@ constexpr void collect_states(ModelData& data, populate_ctx<ModelData>& ctx,
     collect_state_node(data, ctx, node, parent_path, parent_id);
 }
 
+template <typename ModelData, typename Name, typename... Partials>
+constexpr void collect_states(ModelData& data, populate_ctx<ModelData>& ctx, 
+                              const region_expr<Name, Partials...>& node, std::string_view parent_path, std::size_t parent_id) {
+    collect_state_node(data, ctx, node, parent_path, parent_id, state_flags::region);
+}
+
+template <typename ModelData, auto SubModel, typename Name, typename... Partials>
+constexpr void collect_states(ModelData& data, populate_ctx<ModelData>& ctx, 
+                              const submachine_expr<SubModel, Name, Partials...>& node, std::string_view parent_path, std::size_t parent_id) {
+    collect_state_node(data, ctx, node, parent_path, parent_id, state_flags::submachine);
+}
+
 template <typename ModelData, typename Name, typename... Partials>
 constexpr void collect_states(ModelData& data, populate_ctx<ModelData>& ctx, 
                               const choice_expr<Name, Partials...>& node, std::string_view parent_path, std::size_t parent_id) {
@@ -544,15 +571,9 @@ constexpr void collect_states(ModelData& data, populate_ctx<ModelData>& ctx,
 template <typename ModelData, typename Tuple>
 constexpr void collect_transitions_partials(ModelData& data, populate_ctx<ModelData>& ctx, 
                                             const Tuple& t, std::size_t current_state_id) {
-    collect_transitions_tuple<ModelData, Tuple, 0>(data, ctx, t, current_state_id);
-}
-
-template <typename ModelData, typename Tuple, std::size_t I>
-constexpr void collect_transitions_tuple(ModelData& data, populate_ctx<ModelData>& ctx,
-                                         const Tuple& t, std::size_t current_state_id) {
-    if constexpr (I < std::tuple_size_v<Tuple>) {
-        collect_transitions(data, ctx, get<I>(t), current_state_id);
-        collect_transitions_tuple<ModelData, Tuple, I + 1>(data, ctx, t, current_state_id);
+    if constexpr (std::tuple_size_v<Tuple> > 0) {
+        collect_transitions(data, ctx, t.head, current_state_id);
+        collect_transitions_partials(data, ctx, t.tail, current_state_id);
     }
 }
 
@@ -580,6 +601,20 @@ constexpr void collect_transitions(ModelData& data, populate_ctx<ModelData>& ctx
     collect_transitions_partials(data, ctx, node.elements, my_id);
 }
 
+template <typename ModelData, typename Name, typename... Partials>
+constexpr void collect_transitions(ModelData& data, populate_ctx<ModelData>& ctx,
+                                   const region_expr<Name, Partials...>& node, std::size_t) {
+    std::size_t my_id = ctx.state_idx++;
+    collect_transitions_partials(data, ctx, node.elements, my_id);
+}
+
+template <typename ModelData, auto SubModel, typename Name, typename... Partials>
+constexpr void collect_transitions(ModelData& data, populate_ctx<ModelData>& ctx,
+                                   const submachine_expr<SubModel, Name, Partials...>& node, std::size_t) {
+    std::size_t my_id = ctx.state_idx++;
+    collect_transitions_partials(data, ctx, node.elements, my_id);
+}
+
 template <typename ModelData, typename Name, typename... Partials>
 constexpr void collect_transitions(ModelData& data, populate_ctx<ModelData>& ctx,
                                    const choice_expr<Name, Partials...>& node, std::size_t) {
@@ -772,22 +807,25 @@ template <typename ModelData, typename... Partials>
 constexpr void collect_transitions(ModelData& data, populate_ctx<ModelData>& ctx,
                                    const transition_expr<Partials...>& node, std::size_t current_state_id) {
     std::size_t id = ctx.transition_idx++;
+    // Work on a copy: every access through `node` re-walks the whole
+    // expression tree path down to it
+    const auto elements = node.elements;
     
-    std::string_view target_path = get_target_path<decltype(node.elements), 0>(node.elements);
-    std::string_view event_name = get_event_name<decltype(node.elements), 0>(node.elements);
+    std::string_view target_path = get_target_path<decltype(elements), 0>(elements);
+    std::string_view event_name = get_event_name<decltype(elements), 0>(elements);
     
     // History annotation (if present)
     history_kind h_kind = history_kind::none;
-    std::string_view history_parent_path = get_history_parent_path<decltype(node.elements), 0>(node.elements, h_kind);
+    std::string_view history_parent_path = get_history_parent_path<decltype(elements), 0>(elements, h_kind);
     
     std::size_t target_id = invalid_index;
     std::size_t history_parent_id = invalid_index;
     if (!history_parent_path.empty()) {
         // History transition – we resolve and cache the composite parent id only.
-        history_parent_id = find_state_id(data, history_parent_path);
+        history_parent_id = find_state_id(data, ctx, history_parent_path);
     } else if (!target_path.empty()) {
         // Regular target resolution
-        target_id = resolve_target(data, target_path, current_state_id);
+        target_id = resolve_target(data, ctx, target_path, current_state_id);
     }
     
     std::size_t event_id = invalid_index;
@@ -802,15 +840,15 @@ constexpr void collect_transitions(ModelData& data, populate_ctx<ModelData>& ctx
         };
     }
     
-    std::size_t guard = get_guard_idx<decltype(node.elements), 0>(node.elements, ctx.guard_idx);
+    std::size_t guard = get_guard_idx<decltype(elements), 0>(elements, ctx.guard_idx);
     
     std::size_t effect_start = invalid_index;
     std::size_t effect_count = 0;
-    get_effect_info<decltype(node.elements), 0>(node.elements, effect_start, effect_count, ctx.effect_idx);
+    get_effect_info<decltype(elements), 0>(elements, effect_start, effect_count, ctx.effect_idx);
     
     timer_kind t_kind = timer_kind::none;
     std::size_t t_idx = invalid_index;
-    get_timer_info<decltype(node.elements), 0>(node.elements, t_kind, t_idx, ctx.timer_idx);
+    get_timer_info<decltype(elements), 0>(elements, t_kind, t_idx, ctx.timer_idx);
 
     if (t_kind != timer_kind::none) {
         // Generate an internal event name for the timer
@@ -840,7 +878,7 @@ constexpr void collect_transitions(ModelData& data, populate_ctx<ModelData>& ctx
             std::size_t i = 0;
             temp = n;
             while (temp > 0) {
-                buf[i++] = '0' + (temp % 10);
+                buf[i++] = static_cast<char>('0' + temp % 10);
                 temp /= 10;
             }
             while (i > 0) {
@@ -925,7 +963,7 @@ constexpr void collect_transitions(ModelData& data, populate_ctx<ModelData>& ctx
         transition_id = ctx.transition_idx++;
         
         std::string_view target_path = get_target_path<decltype(node.elements), 0>(node.elements);
-        std::size_t target_id = resolve_target(data, target_path, current_state_id);
+        std::size_t target_id = resolve_target(data, ctx, target_path, current_state_id);
         
         std::size_t effect_start = invalid_index;
         std::size_t effect_count = 0;
@@ -968,6 +1006,15 @@ consteval auto normalize() {
   // Pass 1: States
   collect_states(data, ctx, Model, "", invalid_index);
   
+  // Subtree bounds for path lookups (children always follow their parent)
+  for (std::size_t s = ModelDataType::state_count; s-- > 0;) {
+    if (ctx.subtree_end[s] == 0) ctx.subtree_end[s] = s + 1;
+    const std::size_t p = data.states[s].parent_id;
+    if (p != invalid_index && ctx.subtree_end[s] > ctx.subtree_end[p]) {
+      ctx.subtree_end[p] = ctx.subtree_end[s];
+    }
+  }
+
   // Pass 2: Transitions
   ctx.state_idx = 0; 
   collect_transitions(data, ctx, Model, invalid_index);
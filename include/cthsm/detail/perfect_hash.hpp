@@ -0,0 +1,146 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "cthsm/detail/meta_model.hpp"
+
+namespace cthsm::detail {
+
+// FNV-1a over the key, seeded with a per-table salt.
+constexpr std::uint64_t hash_key(std::string_view key, std::uint64_t salt) noexcept {
+  std::uint64_t h = 14695981039346656037ULL ^ (salt * 0x9E3779B97F4A7C15ULL);
+  for (char c : key) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// Re-mixes a key hash with a bucket displacement seed (murmur3 finalizer).
+constexpr std::uint64_t displace(std::uint64_t h, std::uint64_t seed) noexcept {
+  std::uint64_t x = h ^ (seed * 0xC2B2AE3D27D4EB4FULL);
+  x ^= x >> 33U;
+  x *= 0xFF51AFD7ED558CCDULL;
+  x ^= x >> 33U;
+  x *= 0xC4CEB9FE1A85EC53ULL;
+  x ^= x >> 33U;
+  return x;
+}
+
+struct hashed_key {
+  std::size_t id{invalid_index};
+  std::string_view key{};
+};
+
+// Minimal perfect hash (CHD style "hash and displace") from string keys to
+// ids. Keys are split into buckets by one half of the key hash; every bucket
+// stores the displacement seed that places all of its keys into free slots.
+// A lookup hashes the key once, reads one seed and one slot, and confirms the
+// hit with a single string comparison.
+template <std::size_t Capacity>
+struct perfect_hash_map {
+  std::uint64_t salt{0};
+  std::size_t bucket_count{0};
+  std::size_t slot_count{0};
+  std::array<std::uint32_t, Capacity> seeds{};
+  std::array<hashed_key, Capacity> slots{};
+
+  [[nodiscard]] constexpr bool empty() const noexcept { return slot_count == 0; }
+
+  constexpr std::size_t find(std::string_view key) const noexcept {
+    if (slot_count == 0) return invalid_index;
+    const std::uint64_t h = hash_key(key, salt);
+    const std::uint32_t seed = seeds[(h >> 32U) % bucket_count];
+    const hashed_key& s = slots[displace(h, seed) % slot_count];
+    return s.key == key ? s.id : invalid_index;
+  }
+};
+
+// Builds the map for the first `count` (distinct) keys. Returns an empty map
+// if no layout is found, in which case callers keep their fallback lookup.
+template <std::size_t Capacity>
+consteval perfect_hash_map<Capacity> build_perfect_hash(
+    const std::array<hashed_key, Capacity>& keys,
+    std::size_t count) {
+    constexpr std::size_t max_salts = 32;
+    constexpr std::uint32_t max_seed = 1U << 16U;
+
+    perfect_hash_map<Capacity> map{};
+    if (count == 0) return map;
+
+    const std::size_t buckets = (count + 1) / 2;
+
+    for (std::uint64_t salt = 0; salt < max_salts; ++salt) {
+        std::array<std::uint64_t, Capacity> hashes{};
+        std::array<std::size_t, Capacity> bucket_of{};
+        std::array<std::size_t, Capacity> bucket_size{};
+        for (std::size_t i = 0; i < count; ++i) {
+            hashes[i] = hash_key(keys[i].key, salt);
+            bucket_of[i] = static_cast<std::size_t>((hashes[i] >> 32U) % buckets);
+            bucket_size[bucket_of[i]]++;
+        }
+
+        // Place the largest buckets first while the table is still empty
+        std::array<std::size_t, Capacity> order{};
+        for (std::size_t b = 0; b < buckets; ++b) order[b] = b;
+        for (std::size_t i = 1; i < buckets; ++i) {
+            std::size_t b = order[i];
+            std::size_t j = i;
+            while (j > 0 && bucket_size[order[j - 1]] < bucket_size[b]) {
+                order[j] = order[j - 1];
+                --j;
+            }
+            order[j] = b;
+        }
+
+        std::array<bool, Capacity> taken{};
+        std::array<std::size_t, Capacity> members{};
+        std::array<std::size_t, Capacity> positions{};
+        bool ok = true;
+
+        for (std::size_t oi = 0; oi < buckets && ok; ++oi) {
+            const std::size_t b = order[oi];
+            if (bucket_size[b] == 0) break;
+
+            std::size_t n = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                if (bucket_of[i] == b) members[n++] = i;
+            }
+
+            bool placed = false;
+            for (std::uint32_t seed = 0; seed < max_seed && !placed; ++seed) {
+                placed = true;
+                for (std::size_t k = 0; k < n && placed; ++k) {
+                    positions[k] = static_cast<std::size_t>(displace(hashes[members[k]], seed) % count);
+                    if (taken[positions[k]]) placed = false;
+                    for (std::size_t p = 0; p < k && placed; ++p) {
+                        if (positions[p] == positions[k]) placed = false;
+                    }
+                }
+                if (placed) {
+                    map.seeds[b] = seed;
+                    for (std::size_t k = 0; k < n; ++k) {
+                        taken[positions[k]] = true;
+                        map.slots[positions[k]] = keys[members[k]];
+                    }
+                }
+            }
+            ok = placed;
+        }
+
+        if (ok) {
+            map.salt = salt;
+            map.bucket_count = buckets;
+            map.slot_count = count;
+            return map;
+        }
+        map = perfect_hash_map<Capacity>{};
+    }
+
+    return map;
+}
+
+}  // namespace cthsm::detail
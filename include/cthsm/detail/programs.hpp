@@ -0,0 +1,230 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cthsm/detail/meta_model.hpp"
+
+namespace cthsm::detail {
+
+// One step of a precomputed transition program.
+//   exit / effect / entry: call exit_table / effect_table / entry_table[index]
+//   stop_tasks / start_tasks: cancel or start the timers and activities of
+//                             state `index`, and exit or start the sub
+//                             machine of a submachine state
+//   set_state: the state `index` becomes the active state
+//   observe_exit / observe_enter: report state `index` to the Observer;
+//                                 only planned for observed machines
+enum class action_kind : std::uint8_t {
+  exit,
+  stop_tasks,
+  effect,
+  entry,
+  start_tasks,
+  set_state,
+  observe_exit,
+  observe_enter,
+};
+
+struct action {
+  action_kind kind{action_kind::effect};
+  std::size_t index{invalid_index};
+};
+
+struct action_range {
+  std::size_t start{0};
+  std::size_t count{0};
+};
+
+// Everything a transition does once its guard passed, except exiting the
+// active leaf's ancestors below the transition source (inherited
+// transitions), which depends on the leaf and uses state_exits instead.
+struct transition_program {
+  action_range actions{};
+  // Transitions the program cannot express (history targets, no LCA) keep
+  // the generic engine path
+  bool generic{false};
+  // Whether the transition changes state at all (false for internal ones)
+  bool changes_state{false};
+  // Whether the reached leaf can take a completion transition
+  bool completes{false};
+  // Whether the model has history pseudostates that need recording
+  bool records_history{false};
+};
+
+template <std::size_t StateCount, std::size_t TransitionCount,
+          std::size_t ActionCount>
+struct transition_programs {
+  std::array<action, ActionCount> actions{};
+  // Exit program of every state (exit behaviors, then its tasks)
+  std::array<action_range, StateCount> state_exits{};
+  std::array<transition_program, TransitionCount> transitions{};
+  // Entering the root and following its default initial chain
+  transition_program start{};
+};
+
+struct program_plan {
+  std::vector<action> actions;
+  std::vector<action_range> state_exits;
+  std::vector<action_range> state_entries;
+  std::vector<transition_program> transitions;
+  transition_program start{};
+};
+
+// Shared by measure_programs and build_programs so both agree on the
+// layout. Only runs during constant evaluation. `observed` adds the
+// observe_exit/observe_enter markers; unobserved programs have none.
+template <typename ModelData, typename Tables>
+constexpr program_plan plan_programs(const ModelData& data, const Tables& tables,
+                                     bool observed) {
+    constexpr std::size_t SC = ModelData::state_count;
+    constexpr std::size_t TC = ModelData::transition_count;
+
+    program_plan plan{};
+
+    const auto owns_tasks = [&](std::size_t s) {
+        return data.states[s].activity_count > 0 || tables.state_timer_ranges[s].count > 0 ||
+               any(data.states[s].flags, state_flags::submachine);
+    };
+
+    // Per-state exit and entry programs
+    for (std::size_t s = 0; s < SC; ++s) {
+        const auto& st = data.states[s];
+        action_range exits{plan.actions.size(), 0};
+        // A sub machine is exited before the state that runs it
+        const bool nested = any(st.flags, state_flags::submachine);
+        if (nested) plan.actions.push_back({action_kind::stop_tasks, s});
+        for (std::size_t i = 0; i < st.exit_count; ++i) {
+            plan.actions.push_back({action_kind::exit, st.exit_start + i});
+        }
+        if (owns_tasks(s) && !nested) plan.actions.push_back({action_kind::stop_tasks, s});
+        if (observed) plan.actions.push_back({action_kind::observe_exit, s});
+        exits.count = plan.actions.size() - exits.start;
+        plan.state_exits.push_back(exits);
+    }
+    std::vector<action> entry_actions;
+    for (std::size_t s = 0; s < SC; ++s) {
+        const auto& st = data.states[s];
+        action_range entries{entry_actions.size(), 0};
+        if (observed) entry_actions.push_back({action_kind::observe_enter, s});
+        for (std::size_t i = 0; i < st.entry_count; ++i) {
+            entry_actions.push_back({action_kind::entry, st.entry_start + i});
+        }
+        if (owns_tasks(s)) entry_actions.push_back({action_kind::start_tasks, s});
+        entries.count = entry_actions.size() - entries.start;
+        plan.state_entries.push_back(entries);
+    }
+
+    bool has_history = false;
+    for (std::size_t t = 0; t < TC; ++t) {
+        has_history = has_history || data.transitions[t].history != history_kind::none;
+    }
+
+    const auto append_effects = [&](const auto& trans) {
+        if (trans.effect_start == invalid_index) return;
+        for (std::size_t i = 0; i < trans.effect_count; ++i) {
+            plan.actions.push_back({action_kind::effect, trans.effect_start + i});
+        }
+    };
+    const auto append_range = [&](const std::vector<action>& from, action_range r) {
+        for (std::size_t i = 0; i < r.count; ++i) plan.actions.push_back(from[r.start + i]);
+    };
+    // Entries from just below `lca` down to `target`, outermost first
+    const auto append_entries = [&](std::size_t lca, std::size_t target) {
+        std::vector<std::size_t> path;
+        for (std::size_t s = target; s != lca && s != invalid_index; s = data.states[s].parent_id) {
+            path.push_back(s);
+        }
+        for (std::size_t i = path.size(); i > 0; --i) {
+            append_range(entry_actions, plan.state_entries[path[i - 1]]);
+        }
+    };
+
+    // Default initial chain below `current`; returns the leaf it reaches
+    const auto append_initial_chain = [&](std::size_t current) {
+        std::size_t init = data.states[current].initial_transition_id;
+        while (init != invalid_index) {
+            const auto& it = data.transitions[init];
+            append_effects(it);
+            if (it.target_id == invalid_index) break;
+            append_entries(current, it.target_id);
+            current = it.target_id;
+            plan.actions.push_back({action_kind::set_state, current});
+            init = data.states[current].initial_transition_id;
+        }
+        return current;
+    };
+    const auto completes = [&](std::size_t leaf) {
+        return tables.completion_transitions_ranges[leaf].count > 0 ||
+               any(data.states[leaf].flags, state_flags::final);
+    };
+
+    for (std::size_t t = 0; t < TC; ++t) {
+        const auto& trans = data.transitions[t];
+        transition_program prog{};
+        prog.actions.start = plan.actions.size();
+
+        const std::size_t lca = tables.transition_lca[t];
+        if (trans.history != history_kind::none ||
+            (trans.target_id != invalid_index && lca == invalid_index)) {
+            prog.generic = true;
+        } else if (trans.target_id == invalid_index) {
+            append_effects(trans);
+        } else {
+            // Exits from the transition source up to the LCA
+            for (std::size_t s = trans.source_id; s != lca && s != invalid_index;
+                 s = data.states[s].parent_id) {
+                append_range(plan.actions, plan.state_exits[s]);
+            }
+            append_effects(trans);
+            append_entries(lca, trans.target_id);
+            plan.actions.push_back({action_kind::set_state, trans.target_id});
+
+            const std::size_t leaf = append_initial_chain(trans.target_id);
+            prog.changes_state = true;
+            prog.completes = completes(leaf);
+            prog.records_history = has_history;
+        }
+
+        prog.actions.count = plan.actions.size() - prog.actions.start;
+        plan.transitions.push_back(prog);
+    }
+
+    if constexpr (SC > 0) {
+        plan.start.actions.start = plan.actions.size();
+        append_range(entry_actions, plan.state_entries[0]);
+        plan.actions.push_back({action_kind::set_state, 0});
+        const std::size_t leaf = append_initial_chain(0);
+        plan.start.actions.count = plan.actions.size() - plan.start.actions.start;
+        plan.start.changes_state = true;
+        plan.start.completes = completes(leaf);
+        plan.start.records_history = has_history;
+    }
+
+    return plan;
+}
+
+template <typename ModelData, typename Tables>
+consteval std::size_t measure_programs(const ModelData& data, const Tables& tables,
+                                       bool observed = false) {
+    return plan_programs(data, tables, observed).actions.size();
+}
+
+template <std::size_t ActionCount, typename ModelData, typename Tables>
+consteval auto build_programs(const ModelData& data, const Tables& tables,
+                              bool observed = false) {
+    constexpr std::size_t SC = ModelData::state_count;
+    constexpr std::size_t TC = ModelData::transition_count;
+
+    auto plan = plan_programs(data, tables, observed);
+    transition_programs<SC, TC, ActionCount> out{};
+    for (std::size_t i = 0; i < ActionCount; ++i) out.actions[i] = plan.actions[i];
+    for (std::size_t s = 0; s < SC; ++s) out.state_exits[s] = plan.state_exits[s];
+    for (std::size_t t = 0; t < TC; ++t) out.transitions[t] = plan.transitions[t];
+    out.start = plan.start;
+    return out;
+}
+
+}  // namespace cthsm::detail
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "cthsm/detail/meta_model.hpp"
+
+namespace cthsm::detail {
+
+// Active-leaf slot layout for models with orthogonal regions.
+//
+// The active configuration is stored as a fixed array of leaves, one per
+// concurrently active region. Every state owns the slot range
+// [slot[s], slot[s] + width[s]): regions of an orthogonal state get disjoint
+// consecutive ranges, any other child shares the range of its parent. Models
+// without regions have a single slot.
+struct region_range {
+  std::size_t start{0};
+  std::size_t count{0};
+};
+
+template <std::size_t StateCount, std::size_t LeafCount>
+struct region_layout {
+  static constexpr std::size_t leaf_count = LeafCount;
+  std::array<std::size_t, StateCount> slot{};
+  std::array<std::size_t, StateCount> width{};
+  // Regions directly below each state, in declaration order
+  std::array<region_range, StateCount> regions{};
+  std::array<std::size_t, StateCount> region_list{};
+
+  constexpr bool orthogonal(std::size_t s) const { return regions[s].count > 0; }
+};
+
+// Widths of every state, computed bottom-up. Only runs during constant
+// evaluation.
+template <typename ModelData>
+constexpr std::vector<std::size_t> region_widths(const ModelData& data) {
+    constexpr std::size_t SC = ModelData::state_count;
+    std::vector<std::size_t> depth(SC, 0);
+    std::size_t max_depth = 0;
+    for (std::size_t s = 0; s < SC; ++s) {
+        for (std::size_t p = data.states[s].parent_id; p != invalid_index;
+             p = data.states[p].parent_id) {
+            ++depth[s];
+        }
+        if (depth[s] > max_depth) max_depth = depth[s];
+    }
+
+    std::vector<std::size_t> width(SC, 1);
+    std::vector<std::size_t> region_sum(SC, 0);
+    std::vector<std::size_t> child_max(SC, 1);
+    for (std::size_t d = max_depth + 1; d-- > 0;) {
+        for (std::size_t s = 0; s < SC; ++s) {
+            if (depth[s] != d) continue;
+            width[s] = region_sum[s] > child_max[s] ? region_sum[s] : child_max[s];
+            const std::size_t p = data.states[s].parent_id;
+            if (p == invalid_index) continue;
+            if (any(data.states[s].flags, state_flags::region)) {
+                region_sum[p] += width[s];
+            } else if (width[s] > child_max[p]) {
+                child_max[p] = width[s];
+            }
+        }
+    }
+    return width;
+}
+
+template <typename ModelData>
+consteval bool has_regions(const ModelData& data) {
+    for (std::size_t s = 0; s < ModelData::state_count; ++s) {
+        if (any(data.states[s].flags, state_flags::region)) return true;
+    }
+    return false;
+}
+
+template <typename ModelData>
+consteval std::size_t count_leaf_slots(const ModelData& data) {
+    if constexpr (ModelData::state_count == 0) {
+        return 1;
+    } else {
+        return region_widths(data)[0];
+    }
+}
+
+template <std::size_t LeafCount, typename ModelData>
+consteval auto build_region_layout(const ModelData& data) {
+    constexpr std::size_t SC = ModelData::state_count;
+    region_layout<SC, LeafCount> out{};
+    const auto width = region_widths(data);
+
+    std::vector<std::vector<std::size_t>> regions_of(SC);
+    for (std::size_t s = 0; s < SC; ++s) {
+        const std::size_t p = data.states[s].parent_id;
+        if (p != invalid_index && any(data.states[s].flags, state_flags::region)) {
+            regions_of[p].push_back(s);
+        }
+    }
+
+    std::size_t listed = 0;
+    std::vector<std::size_t> next_offset(SC, 0);
+    // Pre-order ids: every parent is placed before its children
+    for (std::size_t s = 0; s < SC; ++s) {
+        out.width[s] = width[s];
+        out.regions[s] = {listed, regions_of[s].size()};
+        for (std::size_t r : regions_of[s]) out.region_list[listed++] = r;
+
+        const std::size_t p = data.states[s].parent_id;
+        if (p == invalid_index) {
+            out.slot[s] = 0;
+        } else if (any(data.states[s].flags, state_flags::region)) {
+            out.slot[s] = out.slot[p] + next_offset[p];
+            next_offset[p] += width[s];
+        } else {
+            out.slot[s] = out.slot[p];
+        }
+    }
+    return out;
+}
+
+}  // namespace cthsm::detail
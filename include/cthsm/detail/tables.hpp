@@ -4,13 +4,21 @@
 #include <array>
 #include <cstddef>
 #include <string_view>
+#include <vector>
 
 #include "cthsm/detail/meta_model.hpp"
+#include "cthsm/detail/perfect_hash.hpp"
 
 namespace cthsm::detail {
 
+// Everything the engine needs at runtime except the dense
+// (state, event) -> transition matrix, which compressed layouts replace.
 template <std::size_t StateCount, std::size_t TransitionCount, std::size_t EventCount, std::size_t TimerCount>
-struct lookup_tables {
+struct lookup_tables_common {
+  static constexpr std::size_t state_count = StateCount;
+  static constexpr std::size_t transition_count = TransitionCount;
+  static constexpr std::size_t event_count = EventCount;
+
   struct event_entry {
       std::size_t id;
       std::string_view name;
@@ -19,7 +27,9 @@ struct lookup_tables {
   };
   
   std::array<event_entry, EventCount> sorted_events{};
-  std::array<std::array<std::size_t, EventCount>, StateCount> transition_table{};
+
+  // Minimal perfect hash over the distinct event names (canonical ids)
+  perfect_hash_map<EventCount> event_index{};
   
   // Chain of transitions for the same event (for guard fallbacks)
   std::array<std::size_t, TransitionCount> next_candidate{};
@@ -54,7 +64,10 @@ struct lookup_tables {
   std::array<std::size_t, TransitionCount> transition_lca{};
 
   constexpr std::size_t get_event_id(std::string_view name) const {
-      // Binary search
+      if (!event_index.empty()) {
+          return event_index.find(name);
+      }
+      // Binary search (only if no perfect hash could be built)
       auto it = std::lower_bound(sorted_events.begin(), sorted_events.end(), name, 
         [](const event_entry& e, std::string_view n) { return e.name < n; });
       
@@ -64,17 +77,29 @@ struct lookup_tables {
       return invalid_index;
   }
   
-  constexpr std::size_t get_transition_id(std::size_t state_id, std::size_t event_id) const {
-      if (state_id >= StateCount || event_id >= EventCount) return invalid_index;
-      return transition_table[state_id][event_id];
-  }
-
   constexpr std::size_t get_wildcard_transition_id(std::size_t state_id) const {
       if (state_id >= StateCount) return invalid_index;
       return wildcard_transition_table[state_id];
   }
 };
 
+template <std::size_t StateCount, std::size_t TransitionCount, std::size_t EventCount, std::size_t TimerCount>
+struct lookup_tables : lookup_tables_common<StateCount, TransitionCount, EventCount, TimerCount> {
+  std::array<std::array<std::size_t, EventCount>, StateCount> transition_table{};
+
+  constexpr std::size_t get_transition_id(std::size_t state_id, std::size_t event_id) const {
+      if (state_id >= StateCount || event_id >= EventCount) return invalid_index;
+      return transition_table[state_id][event_id];
+  }
+};
+
+// Copy of the tables without the dense matrix, for layouts that keep their
+// own transition lookup. Keeps the matrix out of the runtime image.
+template <std::size_t SC, std::size_t TC, std::size_t EC, std::size_t TmrC>
+consteval auto without_transition_table(const lookup_tables<SC, TC, EC, TmrC>& tables) {
+    return lookup_tables_common<SC, TC, EC, TmrC>(tables);
+}
+
 template <typename ModelData>
 consteval auto build_tables(const ModelData& data) {
     constexpr auto SC = ModelData::state_count;
@@ -91,52 +116,78 @@ consteval auto build_tables(const ModelData& data) {
     
     std::sort(tables.sorted_events.begin(), tables.sorted_events.end(), 
         [](const auto& a, const auto& b) { return a.name < b.name; });
-        
-    // 2. Build transition table
-    for (auto& row : tables.transition_table) {
-        row.fill(invalid_index);
-    }
-    tables.next_candidate.fill(invalid_index);
-    
-    for (std::size_t i = 0; i < EC; ) {
-        std::string_view name = tables.sorted_events[i].name;
-        std::size_t canonical_id = tables.sorted_events[i].id;
-        
-        for (std::size_t s = 0; s < SC; ++s) {
-            std::size_t curr = s;
-            std::size_t* link_ptr = &tables.transition_table[s][canonical_id];
-            
-            while (curr != invalid_index) {
-                for (std::size_t t = 0; t < TC; ++t) {
-                    const auto& trans = data.transitions[t];
-                    if (trans.source_id == curr && 
-                        trans.event_id != invalid_index &&
-                        data.get_event_name(trans.event_id) == name) {
-                        
-                        // Found a candidate
-                        if (*link_ptr == invalid_index) {
-                            *link_ptr = t;
-                            link_ptr = &tables.next_candidate[t];
-                        }
-                    }
-                }
-                curr = data.states[curr].parent_id;
-            }
+
+    // 1b. Perfect hash over distinct names; the first sorted entry of each
+    // name is its canonical id (the one lower_bound would find)
+    {
+        std::array<hashed_key, EC> keys{};
+        std::size_t distinct = 0;
+        for (std::size_t i = 0; i < EC; ++i) {
+            if (i > 0 && tables.sorted_events[i].name == tables.sorted_events[i - 1].name) continue;
+            keys[distinct++] = { tables.sorted_events[i].id, tables.sorted_events[i].name };
         }
+        tables.event_index = build_perfect_hash<EC>(keys, distinct);
+    }
         
+    // Canonical id of every event name, and each state's own transitions
+    // grouped by source (in declaration order) so every pass below touches
+    // a transition once instead of rescanning the whole list per state.
+    std::array<std::size_t, EC> canonical{};
+    for (std::size_t i = 0; i < EC; ) {
         std::size_t next_i = i + 1;
-        while (next_i < EC && tables.sorted_events[next_i].name == name) {
+        while (next_i < EC && tables.sorted_events[next_i].name == tables.sorted_events[i].name) {
             next_i++;
         }
+        for (std::size_t k = i; k < next_i; ++k) {
+            canonical[tables.sorted_events[k].id] = tables.sorted_events[i].id;
+        }
         i = next_i;
     }
 
+    std::vector<std::size_t> by_source_start(SC + 1, 0);
+    std::vector<std::size_t> by_source(TC, invalid_index);
+    for (std::size_t t = 0; t < TC; ++t) {
+        if (data.transitions[t].source_id < SC) by_source_start[data.transitions[t].source_id + 1]++;
+    }
+    for (std::size_t s = 0; s < SC; ++s) by_source_start[s + 1] += by_source_start[s];
+    {
+        std::vector<std::size_t> fill(by_source_start.begin(), by_source_start.end() - 1);
+        for (std::size_t t = 0; t < TC; ++t) {
+            const std::size_t src = data.transitions[t].source_id;
+            if (src < SC) by_source[fill[src]++] = t;
+        }
+    }
+
+    // 2. Build transition table
+    // The chain of (s, e) is s's own transitions for e, then the chain of
+    // (parent(s), e). States are numbered in pre-order, so each parent row
+    // is complete before its children inherit it.
+    tables.next_candidate.fill(invalid_index);
+    
+    for (std::size_t s = 0; s < SC; ++s) {
+        const std::size_t parent = data.states[s].parent_id;
+        if (parent != invalid_index) {
+            tables.transition_table[s] = tables.transition_table[parent];
+        } else {
+            tables.transition_table[s].fill(invalid_index);
+        }
+        // Reverse order leaves the first declared transition at the head
+        for (std::size_t k = by_source_start[s + 1]; k-- > by_source_start[s];) {
+            const std::size_t t = by_source[k];
+            const std::size_t event_id = data.transitions[t].event_id;
+            if (event_id == invalid_index) continue;
+            const std::size_t e = canonical[event_id];
+            tables.next_candidate[t] = tables.transition_table[s][e];
+            tables.transition_table[s][e] = t;
+        }
+    }
+
     // 2b. Wildcard Support
     // Identify * event ID
     std::size_t wildcard_event_id = invalid_index;
     for (std::size_t i = 0; i < EC; ++i) {
         if (data.get_event_name(i) == "*") {
-            wildcard_event_id = i;
+            wildcard_event_id = canonical[i];
             break;
         }
     }
@@ -155,12 +206,20 @@ consteval auto build_tables(const ModelData& data) {
                     if (head == invalid_index) {
                         tables.transition_table[s][e] = wildcard_head;
                     } else {
-                        // Append to tail
+                        // Append to tail. Chains of inherited transitions are
+                        // shared between sibling states, so the chain may
+                        // already lead into a wildcard chain; linking it again
+                        // would close a cycle.
                         std::size_t tail = head;
-                        while (tables.next_candidate[tail] != invalid_index) {
+                        bool linked = false;
+                        while (!linked && tables.next_candidate[tail] != invalid_index) {
                             tail = tables.next_candidate[tail];
+                            linked = data.transitions[tail].event_id != invalid_index &&
+                                     data.get_event_name(data.transitions[tail].event_id) == "*";
+                        }
+                        if (!linked) {
+                            tables.next_candidate[tail] = wildcard_head;
                         }
-                        tables.next_candidate[tail] = wildcard_head;
                     }
                 }
             }
@@ -177,10 +236,10 @@ consteval auto build_tables(const ModelData& data) {
         for (std::size_t s = 0; s < SC; ++s) {
             std::size_t start = current_list_idx;
             
-            // Scan transitions for this state
-            for (std::size_t t = 0; t < TC; ++t) {
+            for (std::size_t k = by_source_start[s]; k < by_source_start[s + 1]; ++k) {
+                const std::size_t t = by_source[k];
                 const auto& trans = data.transitions[t];
-                if (trans.source_id == s && trans.timer_type != timer_kind::none) {
+                if (trans.timer_type != timer_kind::none) {
                     tables.timer_transition_map[trans.timer_idx] = t;
                     tables.state_timer_list[current_list_idx++] = { trans.timer_idx, trans.timer_type };
                 }
@@ -195,10 +254,10 @@ consteval auto build_tables(const ModelData& data) {
         for (std::size_t s = 0; s < SC; ++s) {
             std::size_t start = current_list_idx;
             
-            for (std::size_t t = 0; t < TC; ++t) {
+            for (std::size_t k = by_source_start[s]; k < by_source_start[s + 1]; ++k) {
+                const std::size_t t = by_source[k];
                 const auto& trans = data.transitions[t];
-                if (trans.source_id == s && 
-                    trans.event_id == invalid_index && 
+                if (trans.event_id == invalid_index && 
                     trans.timer_type == timer_kind::none &&
                     trans.kind != transition_kind::local) { 
                     
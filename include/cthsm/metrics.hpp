@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "cthsm/cthsm.hpp"
+#include "instrumentation/latency_histogram.hpp"
+
+namespace cthsm {
+
+using latency_histogram = hsm::instrumentation::LatencyHistogram;
+
+template <std::size_t StateCount, std::size_t TransitionCount>
+struct metrics_snapshot {
+  // Indexed by the ids of the machine's normalized model
+  std::array<std::uint64_t, TransitionCount> transitions{};
+  std::array<std::uint64_t, StateCount> entries{};
+  // Time spent in completed visits of each state
+  std::array<std::chrono::nanoseconds, StateCount> dwell{};
+  std::uint64_t dispatched{0};
+  std::uint64_t deferred{0};
+  std::uint64_t unhandled{0};
+  // From dispatch to the end of its run-to-completion step
+  latency_histogram run_to_completion{};
+};
+
+// Runtime counters of every machine of one model, fed by MetricsObserver.
+// Every counter is a relaxed atomic, so instances may run on any thread
+// and snapshot() can be taken while they do; a snapshot is not one
+// consistent cut across counters.
+template <auto Model>
+class metrics {
+ public:
+  static constexpr std::size_t state_count = decltype(detail::normalize<Model>())::state_count;
+  static constexpr std::size_t transition_count =
+      decltype(detail::normalize<Model>())::transition_count;
+  using snapshot_type = metrics_snapshot<state_count, transition_count>;
+
+  // Ids outside the model (a sub machine's) are ignored
+  void transition_fired(std::size_t t) noexcept {
+    if (t < transition_count) bump(transitions_[t]);
+  }
+  void state_entered(std::size_t s) noexcept {
+    if (s < state_count) bump(entries_[s]);
+  }
+  void state_dwelled(std::size_t s, std::chrono::nanoseconds d) noexcept {
+    if (s < state_count) dwell_[s].fetch_add(as_ns(d), std::memory_order_relaxed);
+  }
+  void event_dispatched() noexcept { bump(dispatched_); }
+  void event_deferred() noexcept { bump(deferred_); }
+  void event_unhandled() noexcept { bump(unhandled_); }
+  void step_completed(std::chrono::nanoseconds d) noexcept {
+    bump(run_to_completion_[latency_histogram::bucket_of(as_ns(d))]);
+  }
+
+  [[nodiscard]] snapshot_type snapshot() const noexcept {
+    snapshot_type out{};
+    for (std::size_t t = 0; t < transition_count; ++t) out.transitions[t] = load(transitions_[t]);
+    for (std::size_t s = 0; s < state_count; ++s) {
+      out.entries[s] = load(entries_[s]);
+      out.dwell[s] = std::chrono::nanoseconds(static_cast<std::int64_t>(load(dwell_[s])));
+    }
+    out.dispatched = load(dispatched_);
+    out.deferred = load(deferred_);
+    out.unhandled = load(unhandled_);
+    for (std::size_t b = 0; b < latency_histogram::bucket_count; ++b) {
+      out.run_to_completion.buckets[b] = load(run_to_completion_[b]);
+    }
+    return out;
+  }
+
+ private:
+  using counter = std::atomic<std::uint64_t>;
+
+  static void bump(counter& c) noexcept { c.fetch_add(1, std::memory_order_relaxed); }
+  static std::uint64_t load(const counter& c) noexcept {
+    return c.load(std::memory_order_relaxed);
+  }
+  static std::uint64_t as_ns(std::chrono::nanoseconds d) noexcept {
+    return d.count() > 0 ? static_cast<std::uint64_t>(d.count()) : 0;
+  }
+
+  std::array<counter, transition_count> transitions_{};
+  std::array<counter, state_count> entries_{};
+  std::array<counter, state_count> dwell_{};
+  counter dispatched_{0};
+  counter deferred_{0};
+  counter unhandled_{0};
+  std::array<counter, latency_histogram::bucket_count> run_to_completion_{};
+};
+
+// Observer that counts into a metrics object with static storage duration:
+//   inline cthsm::metrics<model> lamp_metrics;
+//   using machine = compile<model, Lamp, SequentialTaskProvider, Clock, Context, 16,
+//                           table_layout::dense, dispatch_mode::table, TaskTimers<>,
+//                           MetricsObserver<lamp_metrics>>;
+// Dwell and run-to-completion times are measured on the machine's Clock.
+template <auto& Metrics>
+struct MetricsObserver : NoObserver {
+  static void on_dispatch(std::size_t, std::size_t) noexcept { Metrics.event_dispatched(); }
+  static void on_defer(std::size_t, std::size_t) noexcept { Metrics.event_deferred(); }
+  static void on_unhandled(std::size_t, std::size_t) noexcept { Metrics.event_unhandled(); }
+  static void on_transition(std::size_t t) noexcept { Metrics.transition_fired(t); }
+  static void on_enter(std::size_t s) noexcept { Metrics.state_entered(s); }
+
+  template <typename Duration>
+  static void on_dwell(std::size_t s, Duration d) noexcept {
+    Metrics.state_dwelled(s, std::chrono::duration_cast<std::chrono::nanoseconds>(d));
+  }
+
+  template <typename Duration>
+  static void on_complete(std::size_t, std::size_t, Duration d) noexcept {
+    Metrics.step_completed(std::chrono::duration_cast<std::chrono::nanoseconds>(d));
+  }
+};
+
+}  // namespace cthsm
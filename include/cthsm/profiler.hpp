@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+#include "instrumentation/behavior_profile.hpp"
+
+namespace cthsm {
+
+using behavior_profile = hsm::instrumentation::BehaviorProfile;
+using behavior_role = hsm::instrumentation::BehaviorRole;
+using hsm::instrumentation::write_folded_stacks;
+using hsm::instrumentation::write_profile_report;
+
+// Thread CPU time and cycle-counter ticks spent in every behavior of one
+// model, fed by ProfilerObserver. Behaviors are numbered entries first,
+// then exits, effects, guards and activities; names() resolves those
+// numbers to paths in the model, so the report and folded stacks of
+// write_profile_report and write_folded_stacks print model paths rather
+// than C++ symbols:
+//
+//   cthsm::write_profile_report(std::cout, pump_profiler.names(), pump_profiler.snapshot());
+//   cthsm::write_folded_stacks(folded, pump_profiler.names(), pump_profiler.snapshot());
+//
+// Counters are relaxed atomics, as in metrics<Model>.
+template <auto Model>
+class profiler {
+ public:
+  static constexpr std::size_t entry_count =
+      std::tuple_size_v<decltype(detail::extract_entries(Model))>;
+  static constexpr std::size_t exit_count =
+      std::tuple_size_v<decltype(detail::extract_exits(Model))>;
+  static constexpr std::size_t effect_count =
+      std::tuple_size_v<decltype(detail::extract_effects(Model))>;
+  static constexpr std::size_t guard_count =
+      std::tuple_size_v<decltype(detail::extract_guards(Model))>;
+  static constexpr std::size_t activity_count =
+      std::tuple_size_v<decltype(detail::extract_activities(Model))>;
+  static constexpr std::size_t behavior_count =
+      entry_count + exit_count + effect_count + guard_count + activity_count;
+
+  // behavior_count for an index outside the model (a sub machine's)
+  static constexpr std::size_t behavior_id(behavior_kind kind, std::size_t index) noexcept {
+    std::size_t first = 0, count = 0;
+    switch (kind) {
+      case behavior_kind::entry:
+        first = 0;
+        count = entry_count;
+        break;
+      case behavior_kind::exit:
+        first = entry_count;
+        count = exit_count;
+        break;
+      case behavior_kind::effect:
+        first = entry_count + exit_count;
+        count = effect_count;
+        break;
+      case behavior_kind::guard:
+        first = entry_count + exit_count + effect_count;
+        count = guard_count;
+        break;
+      case behavior_kind::activity:
+        first = entry_count + exit_count + effect_count + guard_count;
+        count = activity_count;
+        break;
+    }
+    return index < count ? first + index : behavior_count;
+  }
+
+  void record(behavior_kind kind, std::size_t index, const behavior_cost& cost) noexcept {
+    const std::size_t id = behavior_id(kind, index);
+    if (id >= behavior_count) return;
+    auto& slot = slots_[id];
+    slot.calls.fetch_add(1, std::memory_order_relaxed);
+    slot.cpu_ns.fetch_add(cost.cpu_ns, std::memory_order_relaxed);
+    slot.ticks.fetch_add(cost.ticks, std::memory_order_relaxed);
+    std::uint64_t seen = slot.max_cpu_ns.load(std::memory_order_relaxed);
+    while (cost.cpu_ns > seen && !slot.max_cpu_ns.compare_exchange_weak(
+                                     seen, cost.cpu_ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Behaviors called at least once, most CPU time first; ids index names()
+  [[nodiscard]] std::vector<behavior_profile> snapshot() const {
+    std::vector<behavior_profile> out;
+    for (std::size_t id = 0; id < behavior_count; ++id) {
+      const auto& slot = slots_[id];
+      const std::uint64_t calls = slot.calls.load(std::memory_order_relaxed);
+      if (calls == 0) continue;
+      behavior_profile profile;
+      profile.id = static_cast<std::uint32_t>(id);
+      profile.role = role_of(id);
+      profile.calls = calls;
+      profile.cpu = as_ns(slot.cpu_ns.load(std::memory_order_relaxed));
+      profile.max_cpu = as_ns(slot.max_cpu_ns.load(std::memory_order_relaxed));
+      profile.ticks = slot.ticks.load(std::memory_order_relaxed);
+      out.push_back(profile);
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const behavior_profile& a, const behavior_profile& b) {
+                       return a.cpu > b.cpu;
+                     });
+    return out;
+  }
+
+  // Qualified name of every behavior: the owning state's path and
+  // entry_<n>, exit_<n> or activity_<n>, or the transition's source path,
+  // its event (transition_<id> without one) and effect_<n> or guard
+  //   /pump/running/entry_0, /pump/idle/start/guard
+  [[nodiscard]] static std::vector<std::string> names() {
+    constexpr auto& model = normalized_model;
+    std::vector<std::string> out(behavior_count);
+    for (std::size_t s = 0; s < model.state_count; ++s) {
+      const auto& state = model.states[s];
+      const std::string path(model.get_state_name(s));
+      name_range(out, behavior_kind::entry, state.entry_start, state.entry_count, path + "/entry_");
+      name_range(out, behavior_kind::exit, state.exit_start, state.exit_count, path + "/exit_");
+      name_range(out, behavior_kind::activity, state.activity_start, state.activity_count,
+                 path + "/activity_");
+    }
+    for (std::size_t t = 0; t < model.transition_count; ++t) {
+      const auto& transition = model.transitions[t];
+      std::string path(model.get_state_name(transition.source_id));
+      path += '/';
+      if (transition.event_id != detail::invalid_index) {
+        path += model.get_event_name(transition.event_id);
+      } else {
+        path += "transition_" + std::to_string(t);
+      }
+      name_range(out, behavior_kind::effect, transition.effect_start, transition.effect_count,
+                 path + "/effect_");
+      if (transition.guard_idx != detail::invalid_index) {
+        const std::size_t id = behavior_id(behavior_kind::guard, transition.guard_idx);
+        if (id < behavior_count) out[id] = path + "/guard";
+      }
+    }
+    return out;
+  }
+
+ private:
+  static constexpr auto normalized_model = detail::normalize<Model>();
+
+  struct slot {
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> cpu_ns{0};
+    std::atomic<std::uint64_t> max_cpu_ns{0};
+    std::atomic<std::uint64_t> ticks{0};
+  };
+
+  static void name_range(std::vector<std::string>& out, behavior_kind kind, std::size_t start,
+                         std::size_t count, const std::string& prefix) {
+    if (start == detail::invalid_index) return;
+    for (std::size_t i = 0; i < count; ++i) {
+      const std::size_t id = behavior_id(kind, start + i);
+      if (id < behavior_count) out[id] = prefix + std::to_string(i);
+    }
+  }
+
+  static constexpr behavior_role role_of(std::size_t id) noexcept {
+    if (id < entry_count) return behavior_role::Entry;
+    if (id < entry_count + exit_count) return behavior_role::Exit;
+    if (id < entry_count + exit_count + effect_count) return behavior_role::Effect;
+    if (id < entry_count + exit_count + effect_count + guard_count) {
+      return behavior_role::Guard;
+    }
+    return behavior_role::Activity;
+  }
+
+  static std::chrono::nanoseconds as_ns(std::uint64_t ns) noexcept {
+    return std::chrono::nanoseconds(static_cast<std::int64_t>(ns));
+  }
+
+  std::array<slot, behavior_count> slots_{};
+};
+
+// Observer that times every behavior into a profiler with static storage
+// duration:
+//   inline cthsm::profiler<model> pump_profiler;
+//   using machine = compile<model, Pump, SequentialTaskProvider, Clock, Context, 16,
+//                           table_layout::dense, dispatch_mode::table, TaskTimers<>,
+//                           ProfilerObserver<pump_profiler>>;
+template <auto& Profiler>
+struct ProfilerObserver : NoObserver {
+  static void on_behavior(behavior_kind kind, std::size_t index,
+                          const behavior_cost& cost) noexcept {
+    Profiler.record(kind, index, cost);
+  }
+};
+
+}  // namespace cthsm
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+#include "instrumentation/watchdog.hpp"
+
+namespace cthsm {
+
+using watchdog = hsm::instrumentation::Watchdog;
+using watch_slot = hsm::instrumentation::WatchSlot;
+using step_overrun = hsm::instrumentation::StepOverrun;
+
+// Run-to-completion budgets of every machine of one model, checked by a
+// cthsm::watchdog through WatchdogObserver. A step started in a state gets
+// the budget set for it or its nearest ancestor, else the model's; 0 is
+// never overrun. Dispatch is synchronous, so each thread that dispatches
+// to a machine of the model claims a watchdog slot of its own on its first
+// step, and gives it back when it exits or the watchdog is detached.
+//
+// Overruns name the state by path, the event, and the transition or the
+// entry behaviors of the state that were running:
+//   /pump/idle/start, /pump/running/entry
+template <auto Model>
+class step_watch {
+  static constexpr auto normalized_model = detail::normalize<Model>();
+
+ public:
+  static constexpr std::size_t state_count = decltype(normalized_model)::state_count;
+  static constexpr std::size_t transition_count = decltype(normalized_model)::transition_count;
+
+  constexpr step_watch() = default;
+  constexpr explicit step_watch(std::chrono::nanoseconds step) : step_ns_(as_ns(step)) {}
+
+  ~step_watch() { attach(nullptr); }
+
+  step_watch(const step_watch&) = delete;
+  step_watch& operator=(const step_watch&) = delete;
+
+  void set_budget(std::chrono::nanoseconds step) noexcept {
+    step_ns_.store(as_ns(step), std::memory_order_relaxed);
+  }
+
+  // False for a path the model does not have
+  bool set_budget(std::string_view state, std::chrono::nanoseconds budget) noexcept {
+    for (std::size_t s = 0; s < state_count; ++s) {
+      if (normalized_model.get_state_name(s) != state) continue;
+      state_ns_[s].store(as_ns(budget) + 1, std::memory_order_relaxed);
+      return true;
+    }
+    return false;
+  }
+
+  // Budget of a step started in state s, in nanoseconds
+  [[nodiscard]] std::uint64_t budget_ns(std::size_t s) const noexcept {
+    while (s < state_count) {
+      const std::uint64_t listed = state_ns_[s].load(std::memory_order_relaxed);
+      if (listed != 0) return listed - 1;
+      s = normalized_model.states[s].parent_id;
+    }
+    return step_ns_.load(std::memory_order_relaxed);
+  }
+
+  // Reports to the watchdog under the given name, or stops (nullptr). Slots
+  // of the previous watchdog are given back, so attach while no machine of
+  // the model is dispatching, and detach before the watchdog goes away.
+  void attach(watchdog* target, std::string_view name = "") {
+    std::lock_guard lock(mutex_);
+    if (watchdog_) {
+      for (auto* slot : slots_) watchdog_->release(slot);
+    }
+    slots_.clear();
+    watchdog_ = target;
+    name_ = name;
+    if (watchdog_ && states_.empty()) build_names();
+    generation_.fetch_add(1, std::memory_order_release);
+  }
+
+  [[nodiscard]] std::uint64_t generation() const noexcept {
+    return generation_.load(std::memory_order_acquire);
+  }
+
+  // A slot for the calling thread, or nullptr without a watchdog or a free
+  // slot; generation is set to the attachment it belongs to
+  watch_slot* claim(watchdog*& owner, std::uint64_t& generation) {
+    std::lock_guard lock(mutex_);
+    generation = generation_.load(std::memory_order_relaxed);
+    owner = watchdog_;
+    if (!watchdog_) return nullptr;
+    auto* slot = watchdog_->claim(name_, {states_, events_, behaviors_});
+    if (slot) slots_.push_back(slot);
+    return slot;
+  }
+
+  void release(watch_slot* slot, std::uint64_t generation) {
+    std::lock_guard lock(mutex_);
+    if (generation != generation_.load(std::memory_order_relaxed)) return;
+    const auto it = std::find(slots_.begin(), slots_.end(), slot);
+    if (it == slots_.end()) return;
+    slots_.erase(it);
+    watchdog_->release(slot);
+  }
+
+  // Behavior ids: transitions first, then the entry behaviors of each state
+  static constexpr std::uint32_t transition_behavior(std::size_t t) noexcept {
+    return t < transition_count ? static_cast<std::uint32_t>(t) : invalid_id;
+  }
+  static constexpr std::uint32_t entry_behavior(std::size_t s) noexcept {
+    return s < state_count ? static_cast<std::uint32_t>(transition_count + s) : invalid_id;
+  }
+  static constexpr std::uint32_t id(std::size_t index) noexcept {
+    return index < std::numeric_limits<std::uint32_t>::max() ? static_cast<std::uint32_t>(index)
+                                                             : invalid_id;
+  }
+
+  static constexpr std::uint32_t invalid_id = std::numeric_limits<std::uint32_t>::max();
+
+ private:
+  static constexpr std::uint64_t as_ns(std::chrono::nanoseconds d) noexcept {
+    return d.count() > 0 ? static_cast<std::uint64_t>(d.count()) : 0;
+  }
+
+  void build_names() {
+    for (std::size_t s = 0; s < state_count; ++s) {
+      states_.emplace_back(normalized_model.get_state_name(s));
+    }
+    for (std::size_t e = 0; e < decltype(normalized_model)::event_count; ++e) {
+      events_.emplace_back(normalized_model.get_event_name(e));
+    }
+    for (std::size_t t = 0; t < transition_count; ++t) {
+      const auto& transition = normalized_model.transitions[t];
+      std::string name(normalized_model.get_state_name(transition.source_id));
+      name += '/';
+      if (transition.event_id != detail::invalid_index) {
+        name += normalized_model.get_event_name(transition.event_id);
+      } else {
+        name += "transition_" + std::to_string(t);
+      }
+      behaviors_.push_back(std::move(name));
+    }
+    for (std::size_t s = 0; s < state_count; ++s) {
+      behaviors_.push_back(states_[s] + "/entry");
+    }
+  }
+
+  std::atomic<std::uint64_t> step_ns_{0};
+  // Budget + 1 of each state; 0 inherits the parent's
+  std::array<std::atomic<std::uint64_t>, state_count> state_ns_{};
+  std::atomic<std::uint64_t> generation_{0};
+  std::mutex mutex_;
+  watchdog* watchdog_ = nullptr;
+  std::string name_;
+  std::vector<watch_slot*> slots_;
+  std::vector<std::string> states_;
+  std::vector<std::string> events_;
+  std::vector<std::string> behaviors_;
+};
+
+// Observer that marks every run-to-completion step in the calling thread's
+// watchdog slot of a step_watch with static storage duration:
+//   inline cthsm::step_watch<model> pump_watch{std::chrono::milliseconds(2)};
+//   using machine = compile<model, Pump, SequentialTaskProvider, Clock, Context, 16,
+//                           table_layout::dense, dispatch_mode::table, TaskTimers<>,
+//                           WatchdogObserver<pump_watch>>;
+//   pump_watch.attach(&watchdog, "pump");
+// A step runs from the outermost on_dispatch to its on_complete; deferred
+// events it replays and sub machines are part of it.
+template <auto& Watch>
+struct WatchdogObserver : NoObserver {
+  static void on_dispatch(std::size_t state, std::size_t event) {
+    auto& local = thread_slot::get();
+    if (local.depth++ != 0) return;
+    auto* slot = local.current();
+    if (slot) slot->begin(Watch.id(state), Watch.id(event), Watch.budget_ns(state));
+  }
+
+  static void on_transition(std::size_t t) noexcept {
+    auto& local = thread_slot::get();
+    if (local.depth != 0 && local.slot) local.slot->running(Watch.transition_behavior(t));
+  }
+
+  static void on_enter(std::size_t s) noexcept {
+    auto& local = thread_slot::get();
+    if (local.depth != 0 && local.slot) local.slot->running(Watch.entry_behavior(s));
+  }
+
+  template <typename Duration>
+  static void on_complete(std::size_t, std::size_t, Duration) {
+    auto& local = thread_slot::get();
+    if (local.depth == 0 || --local.depth != 0) return;
+    if (local.slot) local.owner->finish(*local.slot);
+  }
+
+ private:
+  struct thread_slot {
+    std::size_t depth = 0;
+    watch_slot* slot = nullptr;
+    watchdog* owner = nullptr;
+    std::uint64_t generation = 0;
+    bool claimed = false;
+
+    ~thread_slot() {
+      if (slot) Watch.release(slot, generation);
+    }
+
+    // The slot of the current attachment, claimed on first use
+    watch_slot* current() {
+      if (claimed && generation == Watch.generation()) return slot;
+      slot = Watch.claim(owner, generation);
+      claimed = true;
+      return slot;
+    }
+
+    static thread_slot& get() {
+      static thread_local thread_slot local;
+      return local;
+    }
+  };
+};
+
+}  // namespace cthsm
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "cthsm/cthsm.hpp"
+
+namespace cthsm {
+
+// TaskProvider that runs activities and task timers on a fixed pool of
+// worker threads. Tasks live in QueueDepth preallocated slots with the
+// callable stored inline (up to StorageSize bytes), so creating, running and
+// joining a task never allocates. The workers are started by the first
+// create_task, which lets the provider be moved into compile<> beforehand.
+//
+// An activity or task timer holds its worker until it returns or is
+// cancelled, so a task queued behind them would not run (and a timer would
+// not fire) until it is joined. compile<> therefore rejects a Workers below
+// its task_slot_count, the activities and task timers of the model.
+//
+// When every slot is taken, create_task waits until one is free: a slot is
+// free once its task has returned and its TaskHandle has been released.
+// compile<> rejects a QueueDepth below its task_slot_count too, so a
+// machine never waits on slots held by its own tasks.
+template <std::size_t Workers = 2, std::size_t QueueDepth = 16, std::size_t StorageSize = 64>
+class ThreadPoolTaskProvider {
+  static_assert(Workers > 0, "ThreadPoolTaskProvider needs at least one worker");
+  static_assert(QueueDepth > 0, "ThreadPoolTaskProvider needs at least one task slot");
+
+  enum class slot_state : std::uint8_t { free, queued, running, done };
+
+  // All fields are guarded by mutex_. A slot is reused once its task is
+  // done and its TaskHandle has been released, in either order.
+  struct slot {
+    alignas(std::max_align_t) std::byte storage[StorageSize];
+    void (*run)(void*){nullptr};  // invokes, then destroys, the stored callable
+    slot_state state{slot_state::free};
+    bool handle_held{false};
+  };
+
+ public:
+  class TaskHandle {
+   public:
+    TaskHandle() = default;
+    TaskHandle(const TaskHandle&) = delete;
+    TaskHandle& operator=(const TaskHandle&) = delete;
+
+    TaskHandle(TaskHandle&& other) noexcept
+        : pool_(other.pool_), slot_(other.slot_.exchange(nullptr, std::memory_order_acq_rel)) {}
+
+    TaskHandle& operator=(TaskHandle&& other) noexcept {
+      if (this != &other) {
+        join();
+        pool_ = other.pool_;
+        slot_.store(other.slot_.exchange(nullptr, std::memory_order_acq_rel),
+                    std::memory_order_release);
+      }
+      return *this;
+    }
+
+    ~TaskHandle() { join(); }
+
+    // Waits for the task to finish and releases its slot. A task no worker
+    // has picked up yet is run on the joining thread instead, which for a
+    // cancelled activity or timer returns at once rather than waiting for a
+    // worker to wake. A task that joins its own handle does not wait for
+    // itself. The slot pointer is taken atomically, so the slot is returned
+    // exactly once.
+    void join() {
+      slot* s = slot_.exchange(nullptr, std::memory_order_acq_rel);
+      if (s == nullptr) return;
+      if (s != current_) pool_->run_or_wait(*s);
+      pool_->release_handle(*s);
+    }
+
+    [[nodiscard]] bool joinable() const {
+      return slot_.load(std::memory_order_acquire) != nullptr;
+    }
+
+   private:
+    friend class ThreadPoolTaskProvider;
+    TaskHandle(ThreadPoolTaskProvider* pool, slot* s) : pool_(pool), slot_(s) {}
+
+    ThreadPoolTaskProvider* pool_{nullptr};
+    std::atomic<slot*> slot_{nullptr};
+  };
+
+  ThreadPoolTaskProvider() {
+    for (std::size_t i = 0; i < QueueDepth; ++i) free_[i] = QueueDepth - 1 - i;
+  }
+
+  // compile<> takes its provider by value. Workers only exist after the
+  // first create_task, so a pool that is moved has no running state to
+  // transfer and the new object simply starts out idle.
+  ThreadPoolTaskProvider(ThreadPoolTaskProvider&&) noexcept : ThreadPoolTaskProvider() {}
+  ThreadPoolTaskProvider(const ThreadPoolTaskProvider&) = delete;
+  ThreadPoolTaskProvider& operator=(const ThreadPoolTaskProvider&) = delete;
+  ThreadPoolTaskProvider& operator=(ThreadPoolTaskProvider&&) = delete;
+
+  // Lets queued tasks finish, then stops the workers
+  ~ThreadPoolTaskProvider() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (auto& worker : workers_) {
+      if (worker.joinable()) worker.join();
+    }
+  }
+
+  template <typename F>
+  TaskHandle create_task(F&& f, const char* /*name*/ = nullptr, std::size_t /*stack*/ = 0,
+                         int /*prio*/ = 0) {
+    using task_type = std::decay_t<F>;
+    static_assert(sizeof(task_type) <= StorageSize,
+                  "task does not fit in ThreadPoolTaskProvider storage; raise StorageSize");
+    static_assert(alignof(task_type) <= alignof(std::max_align_t),
+                  "task is over-aligned for ThreadPoolTaskProvider storage");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    slot_freed_.wait(lock, [this] { return free_count_ > 0; });
+    if (!started_) start_workers();
+
+    slot& s = slots_[free_[--free_count_]];
+    ::new (static_cast<void*>(s.storage)) task_type(std::forward<F>(f));
+    s.run = [](void* storage) {
+      auto* task = std::launder(static_cast<task_type*>(storage));
+      (*task)();
+      task->~task_type();
+    };
+    s.state = slot_state::queued;
+    s.handle_held = true;
+
+    queue_[(head_ + queued_) % QueueDepth] = static_cast<std::size_t>(&s - slots_.data());
+    ++queued_;
+    lock.unlock();
+    work_ready_.notify_one();
+    return TaskHandle{this, &s};
+  }
+
+  // Sleeps for the duration, returning early once ctx is set. Context is a
+  // plain atomic flag, so it is polled at a short interval.
+  template <typename ContextType = Context>
+  void sleep_for(std::chrono::milliseconds duration, ContextType* ctx = nullptr) {
+    if (ctx == nullptr) {
+      std::this_thread::sleep_for(duration);
+      return;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + duration;
+    while (!ctx->is_set()) {
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) return;
+      std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+          deadline - now, std::chrono::milliseconds(1)));
+    }
+  }
+
+  static constexpr std::size_t worker_count = Workers;
+  static constexpr std::size_t queue_depth = QueueDepth;
+  // Activities return on workers, so their completion is left to the
+  // dispatching thread (compile<>::poll_activities)
+  static constexpr bool defers_activity_completion = true;
+
+ private:
+  // Called with mutex_ held
+  void start_workers() {
+    started_ = true;
+    for (auto& worker : workers_) worker = std::thread([this] { worker_loop(); });
+  }
+
+  void worker_loop() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_ready_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+      if (queued_ == 0) return;
+      slot& s = slots_[queue_[head_]];
+      head_ = (head_ + 1) % QueueDepth;
+      --queued_;
+      s.state = slot_state::running;
+      lock.unlock();
+      execute(s);
+    }
+  }
+
+  // Runs a task no worker has picked up yet on the joining thread, or waits
+  // for the worker running it
+  void run_or_wait(slot& s) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (s.state == slot_state::queued) {
+      unqueue(s);
+      s.state = slot_state::running;
+      lock.unlock();
+      execute(s);
+      return;
+    }
+    task_done_.wait(lock, [&s] { return s.state == slot_state::done; });
+  }
+
+  // Called with mutex_ held
+  void unqueue(slot& s) {
+    const auto idx = static_cast<std::size_t>(&s - slots_.data());
+    std::size_t i = 0;
+    while (queue_[(head_ + i) % QueueDepth] != idx) ++i;
+    for (; i + 1 < queued_; ++i) {
+      queue_[(head_ + i) % QueueDepth] = queue_[(head_ + i + 1) % QueueDepth];
+    }
+    --queued_;
+  }
+
+  void execute(slot& s) {
+    slot* const outer = current_;
+    current_ = &s;
+    s.run(s.storage);
+    current_ = outer;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      s.state = slot_state::done;
+      if (!s.handle_held) free_slot(s);
+    }
+    task_done_.notify_all();
+  }
+
+  void release_handle(slot& s) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    s.handle_held = false;
+    if (s.state == slot_state::done) free_slot(s);
+  }
+
+  // Called with mutex_ held
+  void free_slot(slot& s) {
+    s.state = slot_state::free;
+    free_[free_count_++] = static_cast<std::size_t>(&s - slots_.data());
+    slot_freed_.notify_one();
+  }
+
+  // The task running on this thread, if it is a pool worker
+  static inline thread_local slot* current_ = nullptr;
+
+  std::array<slot, QueueDepth> slots_{};
+  std::array<std::size_t, QueueDepth> free_{};  // stack of free slot indices
+  std::size_t free_count_{QueueDepth};
+  std::array<std::size_t, QueueDepth> queue_{};  // ring of queued slot indices
+  std::size_t head_{0};
+  std::size_t queued_{0};
+
+  std::mutex mutex_;
+  std::condition_variable work_ready_;
+  std::condition_variable task_done_;
+  std::condition_variable slot_freed_;
+  bool started_{false};
+  bool stopping_{false};
+  std::array<std::thread, Workers> workers_{};
+};
+
+}  // namespace cthsm
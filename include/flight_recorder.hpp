@@ -0,0 +1,308 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Build with HSM_FLIGHT_RECORDER=1 to record; otherwise the hooks in hsm.hpp
+// compile to nothing and attached recorders stay empty.
+#ifndef HSM_FLIGHT_RECORDER
+#define HSM_FLIGHT_RECORDER 0
+#endif
+
+namespace hsm {
+
+inline constexpr bool flight_recorder_enabled = HSM_FLIGHT_RECORDER != 0;
+
+// What a trace record marks. A run-to-completion step starts with Dispatch
+// (or Defer, for an event the active state defers) and ends with Complete
+// or Unhandled; the Exit, Effect and Enter records of its transitions fall
+// in between.
+enum class TracePhase : std::uint8_t {
+  Dispatch,
+  Exit,
+  Effect,
+  Enter,
+  Complete,
+  Defer,
+  Unhandled,
+};
+
+inline constexpr std::string_view trace_phase_name(TracePhase phase) {
+  switch (phase) {
+    case TracePhase::Dispatch:
+      return "dispatch";
+    case TracePhase::Exit:
+      return "exit";
+    case TracePhase::Effect:
+      return "effect";
+    case TracePhase::Enter:
+      return "enter";
+    case TracePhase::Complete:
+      return "complete";
+    case TracePhase::Defer:
+      return "defer";
+    case TracePhase::Unhandled:
+      return "unhandled";
+  }
+  return "";
+}
+
+// One fixed-size record. Ids index the model's trace_names; 0 means none.
+struct TraceRecord {
+  std::uint64_t time_ns{0};  // steady_clock
+  std::uint32_t state{0};
+  std::uint32_t event{0};
+  std::uint32_t transition{0};
+  TracePhase phase{TracePhase::Dispatch};
+};
+
+// Lock-free ring of the most recent trace records. Writers claim a slot
+// with one fetch_add and publish it through the slot's sequence number, so
+// recording never blocks and snapshot() can run concurrently: it skips
+// records being overwritten instead of returning torn ones.
+class FlightRecorder {
+ public:
+  // Capacity is rounded up to a power of two
+  explicit FlightRecorder(std::size_t capacity = 4096)
+      : mask_(round_up(capacity) - 1),
+        slots_(std::make_unique<Slot[]>(mask_ + 1)) {}
+
+  void record(TracePhase phase, std::uint32_t state, std::uint32_t event,
+              std::uint32_t transition) noexcept {
+    const auto time = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+    const std::uint64_t n = head_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[n & mask_];
+    slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(time, std::memory_order_relaxed);
+    slot.ids.store(std::uint64_t{state} << 32U | event, std::memory_order_relaxed);
+    slot.info.store(std::uint64_t{transition} << 8U | static_cast<std::uint8_t>(phase),
+                    std::memory_order_relaxed);
+    slot.seq.store(2 * n + 2, std::memory_order_release);
+  }
+
+  // The retained records, oldest first
+  std::vector<TraceRecord> snapshot() const {
+    const std::uint64_t head = head_.load(std::memory_order_acquire);
+    const std::uint64_t first = head > capacity() ? head - capacity() : 0;
+    std::vector<TraceRecord> records;
+    records.reserve(static_cast<std::size_t>(head - first));
+    for (std::uint64_t n = first; n < head; ++n) {
+      const Slot& slot = slots_[n & mask_];
+      if (slot.seq.load(std::memory_order_acquire) != 2 * n + 2) continue;
+      const std::uint64_t time = slot.time.load(std::memory_order_relaxed);
+      const std::uint64_t ids = slot.ids.load(std::memory_order_relaxed);
+      const std::uint64_t info = slot.info.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != 2 * n + 2) continue;
+      records.push_back(TraceRecord{time, static_cast<std::uint32_t>(ids >> 32U),
+                                    static_cast<std::uint32_t>(ids),
+                                    static_cast<std::uint32_t>(info >> 8U),
+                                    static_cast<TracePhase>(info & 0xFFU)});
+    }
+    return records;
+  }
+
+  // Records written since construction, including overwritten ones
+  std::uint64_t recorded() const noexcept { return head_.load(std::memory_order_relaxed); }
+  std::size_t capacity() const noexcept { return mask_ + 1; }
+
+ private:
+  struct Slot {
+    std::atomic<std::uint64_t> seq{0};
+    std::atomic<std::uint64_t> time{0};
+    std::atomic<std::uint64_t> ids{0};
+    std::atomic<std::uint64_t> info{0};
+  };
+
+  static std::size_t round_up(std::size_t n) {
+    std::size_t p = 1;
+    while (p < n) p <<= 1U;
+    return p;
+  }
+
+  std::size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic<std::uint64_t> head_{0};
+};
+
+// --- Dump format ---
+//
+// A post-mortem dump is the model's trace names followed by the records,
+// little-endian as written by the host:
+//   "HSMTRACE" u32 version, u32 name count, names as (u32 length, bytes),
+//   u64 record count, records as (u64 time, u32 state, u32 event,
+//   u32 transition, u8 phase)
+
+namespace detail {
+
+template <typename T>
+void write_raw(std::ostream& out, T value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool read_raw(std::istream& in, T& value) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// Reads length bytes a chunk at a time, so a corrupt length runs into the
+// end of the stream instead of allocating all of it up front
+inline bool read_string(std::istream& in, std::uint32_t length, std::string& out) {
+  out.clear();
+  char chunk[256];
+  while (length > 0) {
+    const std::uint32_t n = length < sizeof(chunk) ? length : sizeof(chunk);
+    if (!in.read(chunk, static_cast<std::streamsize>(n))) return false;
+    out.append(chunk, n);
+    length -= n;
+  }
+  return true;
+}
+
+inline void write_json_string(std::ostream& out, std::string_view s) {
+  out << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20U) {
+      out << ' ';
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+}  // namespace detail
+
+inline constexpr std::uint32_t trace_dump_version = 1;
+
+inline void write_trace_dump(std::ostream& out, std::span<const std::string> names,
+                             std::span<const TraceRecord> records) {
+  out.write("HSMTRACE", 8);
+  detail::write_raw(out, trace_dump_version);
+  detail::write_raw(out, static_cast<std::uint32_t>(names.size()));
+  for (const auto& name : names) {
+    detail::write_raw(out, static_cast<std::uint32_t>(name.size()));
+    out.write(name.data(), static_cast<std::streamsize>(name.size()));
+  }
+  detail::write_raw(out, static_cast<std::uint64_t>(records.size()));
+  for (const auto& r : records) {
+    detail::write_raw(out, r.time_ns);
+    detail::write_raw(out, r.state);
+    detail::write_raw(out, r.event);
+    detail::write_raw(out, r.transition);
+    detail::write_raw(out, static_cast<std::uint8_t>(r.phase));
+  }
+}
+
+// Reads a dump written by write_trace_dump; false if it is not one
+inline bool read_trace_dump(std::istream& in, std::vector<std::string>& names,
+                            std::vector<TraceRecord>& records) {
+  char magic[8] = {};
+  std::uint32_t version = 0;
+  std::uint32_t name_count = 0;
+  if (!in.read(magic, sizeof(magic)) || std::string_view(magic, sizeof(magic)) != "HSMTRACE" ||
+      !detail::read_raw(in, version) || version != trace_dump_version ||
+      !detail::read_raw(in, name_count)) {
+    return false;
+  }
+  // The counts and lengths are not trusted: names and records are added
+  // as they are read
+  names.clear();
+  for (std::uint32_t i = 0; i < name_count; ++i) {
+    std::uint32_t length = 0;
+    std::string name;
+    if (!detail::read_raw(in, length) || !detail::read_string(in, length, name)) {
+      return false;
+    }
+    names.push_back(std::move(name));
+  }
+  std::uint64_t record_count = 0;
+  if (!detail::read_raw(in, record_count)) return false;
+  records.clear();
+  for (std::uint64_t i = 0; i < record_count; ++i) {
+    TraceRecord r{};
+    std::uint8_t phase = 0;
+    if (!detail::read_raw(in, r.time_ns) || !detail::read_raw(in, r.state) ||
+        !detail::read_raw(in, r.event) || !detail::read_raw(in, r.transition) ||
+        !detail::read_raw(in, phase)) {
+      return false;
+    }
+    r.phase = static_cast<TracePhase>(phase);
+    records.push_back(r);
+  }
+  return true;
+}
+
+// Chrome trace event JSON, loadable in chrome://tracing and Perfetto. Each
+// run-to-completion step is a slice named after its event, with its exits,
+// effects and entries as instant events inside it.
+inline void write_chrome_trace(std::ostream& out, std::span<const std::string> names,
+                               std::span<const TraceRecord> records, std::uint32_t pid = 1,
+                               std::uint32_t tid = 1) {
+  const auto name_of = [&](std::uint32_t id) -> std::string_view {
+    return id < names.size() ? std::string_view(names[id]) : std::string_view("?");
+  };
+  const std::uint64_t origin = records.empty() ? 0 : records.front().time_ns;
+  bool open = false;
+  bool first = true;
+  out << "{\"traceEvents\":[";
+  for (const auto& r : records) {
+    const char* ph = "i";
+    std::string_view name;
+    switch (r.phase) {
+      case TracePhase::Dispatch:
+        // A step cut short (the ring starts mid-step) has no Complete
+        if (open) continue;
+        ph = "B";
+        open = true;
+        name = name_of(r.event);
+        break;
+      case TracePhase::Complete:
+      case TracePhase::Unhandled:
+        if (!open) continue;
+        ph = "E";
+        open = false;
+        name = name_of(r.event);
+        break;
+      case TracePhase::Effect:
+        name = name_of(r.transition);
+        break;
+      default:
+        name = name_of(r.state);
+        break;
+    }
+    out << (first ? "" : ",") << "\n{\"name\":";
+    first = false;
+    detail::write_json_string(out, name);
+    out << ",\"cat\":\"" << trace_phase_name(r.phase) << "\",\"ph\":\"" << ph << "\"";
+    if (*ph == 'i') out << ",\"s\":\"t\"";
+    const std::uint64_t ns = r.time_ns - origin;
+    out << ",\"ts\":" << ns / 1000U << '.' << (ns % 1000U) / 100U << ",\"pid\":" << pid
+        << ",\"tid\":" << tid << ",\"args\":{\"state\":";
+    detail::write_json_string(out, name_of(r.state));
+    out << ",\"event\":";
+    detail::write_json_string(out, name_of(r.event));
+    out << ",\"transition\":";
+    detail::write_json_string(out, name_of(r.transition));
+    out << "}}";
+  }
+  out << "\n]}\n";
+}
+
+}  // namespace hsm
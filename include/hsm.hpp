@@ -9,18 +9,25 @@
 #include <cstdio>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <variant>
 #include <vector>
 
+#include "flight_recorder.hpp"
+#include "instrumentation/behavior_profile.hpp"
 #include "kind.hpp"
+#include "metrics.hpp"
 #include "path.hpp"
+#include "usdt.hpp"
 
 namespace hsm {
 
@@ -78,6 +85,16 @@ struct Event;
 struct Context;
 struct Partial;
 struct Instance;
+// Optional instrumentation, each in its own header (profiler.hpp,
+// stats_exporter.hpp, watchdog.hpp) along with its attach_* function
+class Profiler;
+class StatsExporter;
+struct StepBudget;
+namespace instrumentation {
+class Watchdog;
+}
+using instrumentation::BehaviorRole;
+using instrumentation::Watchdog;
 
 // Action template for user-defined behaviors
 template <typename T = Instance>
@@ -191,6 +208,8 @@ struct ElementInterface {
 struct Element : ElementInterface {
   Kind kind_;
   std::string qualified_name_;
+  // Index into Model::trace_names, assigned by define()
+  std::uint32_t trace_id = 0;
 
   explicit Element(Kind k, std::string qn = "")
       : kind_(k), qualified_name_(std::move(qn)) {}
@@ -274,6 +293,8 @@ struct Transition : Element {
 // Behavior
 struct Behavior : Element {
   std::function<void(Context&, Instance&, Event&)> method = nullptr;
+  // Set on the activities of after() and every()
+  bool timer = false;
 
   // Add non-templated constructor for direct Instance usage
   explicit Behavior(std::string qn,
@@ -384,6 +405,13 @@ struct Model : State {
       StringViewHash, StringViewEqual>
       deferred_map;
 
+  // Names behind flight recorder ids: trace_names[id] is the qualified name
+  // of a member, or an event name. Id 0 is the empty name.
+  std::vector<std::string> trace_names;
+  std::unordered_map<std::string, std::uint32_t, StringViewHash,
+                     StringViewEqual>
+      event_trace_ids;
+
   explicit Model(std::string qn) : State(std::move(qn)) {
     kind_ = Kind::StateMachine;
   }
@@ -408,6 +436,11 @@ struct Model : State {
   void add(std::unique_ptr<Partial> partial) {
     owned_elements.push_back(std::move(partial));
   }
+
+  std::uint32_t event_trace_id(std::string_view event_name) const {
+    auto it = event_trace_ids.find(event_name);
+    return it == event_trace_ids.end() ? 0 : it->second;
+  }
 };
 
 // Signal for synchronization
@@ -473,7 +506,8 @@ struct Mutex {
 // Fixed-size queue for events
 template <size_t MaxSize>
 struct FixedQueue {
-  bool push(Event&& event) {
+  // enqueued_ns travels with the event, for latency metrics
+  bool push(Event&& event, std::uint64_t enqueued_ns = 0) {
     std::unique_lock lock(mutex_);
     if (count_ == MaxSize) return false;
 
@@ -487,14 +521,16 @@ struct FixedQueue {
     }
 
     events_[insert_pos] = std::move(event);
+    enqueued_[insert_pos] = enqueued_ns;
     count_++;
     return true;
   }
 
-  Event pop() {
+  Event pop(std::uint64_t* enqueued_ns = nullptr) {
     std::unique_lock lock(mutex_);
     if (count_ == 0) return Event{};
 
+    if (enqueued_ns) *enqueued_ns = enqueued_[head_];
     auto result = std::move(events_[head_]);
     head_ = (head_ + 1) % MaxSize;
     count_--;
@@ -513,6 +549,7 @@ struct FixedQueue {
 
  private:
   std::array<Event, MaxSize> events_;
+  std::array<std::uint64_t, MaxSize> enqueued_{};
   size_t head_ = 0;
   size_t tail_ = 0;
   size_t count_ = 0;
@@ -564,9 +601,11 @@ inline std::vector<std::string_view> event_name_variants(
 struct Active {
   std::unique_ptr<TaskHandle> task;
   std::shared_ptr<Context> signal;
+  const Behavior* behavior = nullptr;
 
-  Active(std::unique_ptr<TaskHandle>&& t, std::shared_ptr<Context>&& s)
-      : task(std::move(t)), signal(std::move(s)) {}
+  Active(std::unique_ptr<TaskHandle>&& t, std::shared_ptr<Context>&& s,
+         const Behavior* b = nullptr)
+      : task(std::move(t)), signal(std::move(s)), behavior(b) {}
 
   // Make Active movable but not copyable
   Active(Active&&) = default;
@@ -699,11 +738,106 @@ inline void buildDeferredTable(Model& model) {
   }
 }
 
+// Assign flight recorder ids: the model, its members and the event names
+// it triggers on or defers, each in name order so ids are stable
+inline void buildTraceIds(Model& model) {
+  model.trace_names.assign(1, std::string{});
+  model.trace_id = 1;
+  model.trace_names.emplace_back(model.qualified_name());
+
+  std::vector<std::string_view> member_names;
+  std::vector<std::string_view> event_names;
+  for (const auto& [name, element] : model.members) {
+    member_names.push_back(name);
+    if (auto* transition = get_element<Transition>(element)) {
+      event_names.insert(event_names.end(), transition->events.begin(),
+                         transition->events.end());
+    } else if (auto* state = get_element<State>(element)) {
+      event_names.insert(event_names.end(), state->deferred.begin(),
+                         state->deferred.end());
+    }
+  }
+  std::sort(member_names.begin(), member_names.end());
+  std::sort(event_names.begin(), event_names.end());
+  event_names.erase(std::unique(event_names.begin(), event_names.end()),
+                    event_names.end());
+
+  for (auto name : member_names) {
+    auto* element = static_cast<Element*>(
+        get_element_interface(model.members.find(name)->second));
+    element->trace_id = static_cast<std::uint32_t>(model.trace_names.size());
+    model.trace_names.emplace_back(name);
+  }
+  model.event_trace_ids.clear();
+  for (auto name : event_names) {
+    model.event_trace_ids.emplace(
+        std::string(name), static_cast<std::uint32_t>(model.trace_names.size()));
+    model.trace_names.emplace_back(name);
+  }
+}
+
+// --- Instrumentation hooks ---
+//
+// What a machine reports to the optional instrumentation. The attach_*
+// functions of profiler.hpp, watchdog.hpp and stats_exporter.hpp install
+// implementations of these, so hsm.hpp needs none of those headers.
+
+// Times behavior and guard calls; called from activity threads too
+struct BehaviorHook {
+  // Runs call(arg), recording what it cost under the element's trace id
+  virtual void time(std::uint32_t id, BehaviorRole role, void (*call)(void*),
+                    void* arg) = 0;
+
+ protected:
+  ~BehaviorHook() = default;
+};
+
+// Sees every run-to-completion step of one machine, on its processing
+// thread
+struct StepHook {
+  virtual ~StepHook() = default;
+  virtual void begin(std::uint32_t state_id, std::uint32_t event_id) = 0;
+  virtual void running(std::uint32_t behavior_id) = 0;
+  virtual void finish() = 0;
+};
+
+// A machine's stats after its last run-to-completion step. Counters count
+// from attaching.
+struct MachineStats {
+  std::string_view state;
+  // Trace id of the active state (Model::trace_names)
+  std::uint32_t state_id = 0;
+  std::uint32_t queue_depth = 0;
+  // Started and not yet terminated activities; timers are the after() and
+  // every() activities among them
+  std::uint32_t activities = 0;
+  std::uint32_t timers = 0;
+  // Dequeued events that ran a step (deferrals do not count)
+  std::uint64_t dispatched = 0;
+  std::uint64_t deferred = 0;
+  std::uint64_t unhandled = 0;
+};
+
+// Publishes a machine's stats after every run-to-completion step
+struct StatsHook {
+  virtual ~StatsHook() = default;
+  virtual void publish(const MachineStats& stats) = 0;
+};
+
 // Main HSM class
 struct HSM : public Instance {
   friend struct Instance;
   friend Context& stop(Instance& instance);
-  friend void start(Instance& instance, std::unique_ptr<Model>& model);
+  friend void start(Instance& instance, std::unique_ptr<Model>& model,
+                    FlightRecorder* recorder);
+  friend void attach_flight_recorder(Instance& instance,
+                                     FlightRecorder* recorder);
+  friend void attach_metrics(Instance& instance, Metrics* metrics);
+  friend void attach_profiler(Instance& instance, Profiler* profiler);
+  friend bool attach_stats(Instance& instance, StatsExporter* exporter,
+                           std::string_view name);
+  friend bool attach_watchdog(Instance& instance, Watchdog* watchdog,
+                              const StepBudget& budget, std::string_view name);
 
   static constexpr size_t MAX_QUEUE_SIZE = 32;
 
@@ -786,6 +920,7 @@ struct HSM : public Instance {
     }
 
     initialized_ = true;
+    publish_stats();
     return processing_mutex_.wait();
   }
 
@@ -800,7 +935,9 @@ struct HSM : public Instance {
       return processing_mutex_.wait();
     }
 
-    if (!queue_.push(std::move(event))) {
+    auto* metrics = metrics_.load(std::memory_order_relaxed);
+    HSM_PROBE3(hsm, enqueue, &instance_, event.name.c_str(), queue_.size());
+    if (!queue_.push(std::move(event), metrics ? Metrics::now_ns() : 0)) {
       fprintf(stderr, "HSM queue full, event dropped\n");
       return processing_mutex_.wait();
     }
@@ -847,12 +984,17 @@ struct HSM : public Instance {
         if (active.task->joinable()) {
           active.task->join();
         }
+        HSM_PROBE2(hsm, activity_stop, &instance_, active.behavior->trace_id);
       }
       active_.clear();
+      activities_ = 0;
+      timers_ = 0;
     }
 
     // Set current state to null to indicate stopped
     current_state_.store(nullptr);
+    stats_hook_.reset();
+    step_hook_.reset();
 
     return processing_mutex_.wait();
   }
@@ -869,8 +1011,79 @@ struct HSM : public Instance {
   FixedQueue<MAX_QUEUE_SIZE> queue_;
   std::unordered_map<std::string, Active, StringViewHash, StringViewEqual>
       active_;
+  // Entries of active_, and the timers among them
+  std::uint32_t activities_ = 0;
+  std::uint32_t timers_ = 0;
   std::shared_ptr<TaskProvider> task_provider_;
   bool initialized_;
+  // Flight recorder of this instance, and the id of the event being
+  // processed; only used with HSM_FLIGHT_RECORDER
+  FlightRecorder* recorder_ = nullptr;
+  std::uint32_t trace_event_ = 0;
+  // Metrics of this instance, and when each active state was entered (by
+  // trace id, 0 if not known)
+  std::atomic<Metrics*> metrics_{nullptr};
+  std::vector<std::uint64_t> entered_ns_;
+  // Times every behavior call while attached; activity tasks read it too
+  std::atomic<BehaviorHook*> profiler_{nullptr};
+  // Publishes stats_ after every run-to-completion step
+  std::unique_ptr<StatsHook> stats_hook_;
+  MachineStats stats_{};
+  // Marks the run-to-completion steps for a watchdog
+  std::unique_ptr<StepHook> step_hook_;
+
+  void set_flight_recorder(FlightRecorder* recorder) {
+    std::lock_guard lock(processing_mutex_);
+    recorder_ = recorder;
+  }
+
+  void set_metrics(Metrics* metrics) {
+    std::lock_guard lock(processing_mutex_);
+    entered_ns_.assign(metrics ? model_.trace_names.size() : 0, 0);
+    metrics_.store(metrics, std::memory_order_relaxed);
+  }
+
+  void set_profiler(BehaviorHook* profiler) {
+    std::lock_guard lock(processing_mutex_);
+    profiler_.store(profiler, std::memory_order_relaxed);
+  }
+
+  // The previous hook is destroyed first, so it gives back its slot before
+  // attach_stats claims another
+  void set_stats(std::unique_ptr<StatsHook> hook) {
+    std::lock_guard lock(processing_mutex_);
+    stats_hook_.reset();
+    stats_hook_ = std::move(hook);
+    stats_ = MachineStats{};
+    publish_stats();
+  }
+
+  void set_step_hook(std::unique_ptr<StepHook> hook) {
+    std::lock_guard lock(processing_mutex_);
+    step_hook_.reset();
+    step_hook_ = std::move(hook);
+  }
+
+  void publish_stats() {
+    if (!stats_hook_) return;
+    auto* state = current_state_.load();
+    stats_.state = state ? state->qualified_name() : "";
+    stats_.state_id = state ? static_cast<const Element*>(state)->trace_id : 0;
+    stats_.queue_depth = static_cast<std::uint32_t>(queue_.size());
+    stats_.activities = activities_;
+    stats_.timers = timers_;
+    stats_hook_->publish(stats_);
+  }
+
+  void trace(TracePhase phase, const ElementInterface* state,
+             const Transition* trans = nullptr) {
+    if constexpr (flight_recorder_enabled) {
+      if (!recorder_) return;
+      recorder_->record(
+          phase, state ? static_cast<const Element*>(state)->trace_id : 0,
+          trace_event_, trans ? trans->trace_id : 0);
+    }
+  }
 
   ElementInterface* find_initial_vertex(State* root_state) {
     if (!root_state || root_state->initial.empty()) {
@@ -912,7 +1125,12 @@ struct HSM : public Instance {
             auto* guard = model_.get_member<Constraint>(transition->guard);
             if (guard && guard->condition) {
               Context ctx;
-              if (!guard->condition(ctx, instance_, event)) {
+              const bool passed =
+                  profiled(*guard, BehaviorRole::Guard, [&] {
+                    return guard->condition(ctx, instance_, event);
+                  });
+              HSM_PROBE3(hsm, guard, &instance_, transition->trace_id, passed);
+              if (!passed) {
                 continue;
               }
             }
@@ -926,10 +1144,16 @@ struct HSM : public Instance {
   }
 
   void process_queue() {
-    std::vector<Event> deferred;
+    // Deferred events keep their enqueue time
+    std::vector<std::pair<Event, std::uint64_t>> deferred;
+    auto* metrics = metrics_.load(std::memory_order_relaxed);
 
     while (!queue_.empty()) {
-      auto event = queue_.pop();
+      std::uint64_t enqueued_ns = 0;
+      if (metrics) metrics->queue_depth(queue_.size());
+      auto event = queue_.pop(&enqueued_ns);
+      HSM_PROBE3(hsm, dequeue, &instance_, event.name.c_str(), queue_.size());
+      const std::uint64_t started_ns = metrics ? Metrics::now_ns() : 0;
 
       auto event_names = event_name_variants(event.name);
       if (event_names.empty()) {
@@ -940,6 +1164,9 @@ struct HSM : public Instance {
       if (!state) {
         continue;
       }
+      if constexpr (flight_recorder_enabled) {
+        trace_event_ = recorder_ ? model_.event_trace_id(event.name) : 0;
+      }
 
       // O(1) deferred event check
       bool is_deferred = false;
@@ -957,9 +1184,22 @@ struct HSM : public Instance {
 
       // If deferred, skip transition lookup
       if (is_deferred) {
-        deferred.emplace_back(std::move(event));
+        trace(TracePhase::Defer, state);
+        HSM_PROBE3(hsm, defer, &instance_, event.name.c_str(),
+                   static_cast<const Element*>(state)->trace_id);
+        if (metrics) metrics->event_deferred();
+        if (stats_hook_) {
+          ++stats_.deferred;
+          publish_stats();
+        }
+        deferred.emplace_back(std::move(event), enqueued_ns);
         continue;
       }
+      trace(TracePhase::Dispatch, state);
+      if (step_hook_) {
+        step_hook_->begin(static_cast<const Element*>(state)->trace_id,
+                          model_.event_trace_id(event.name));
+      }
 
       // O(1) transition lookup
       auto* triggered_transition =
@@ -967,28 +1207,49 @@ struct HSM : public Instance {
 
       if (triggered_transition) {
         auto* old_state = state;
+        if (step_hook_) step_hook_->running(triggered_transition->trace_id);
+        HSM_PROBE3(hsm, transition_start, &instance_,
+                   triggered_transition->trace_id,
+                   static_cast<const Element*>(state)->trace_id);
         auto* next_state = transition(state, triggered_transition, event);
         if (!next_state) {
           std::cerr << "ERROR: transition() returned null" << std::endl;
         }
         current_state_.store(next_state);
+        HSM_PROBE3(
+            hsm, transition_end, &instance_, triggered_transition->trace_id,
+            next_state ? static_cast<const Element*>(next_state)->trace_id : 0);
+        trace(TracePhase::Complete, next_state, triggered_transition);
 
         // If state changed, re-queue deferred events immediately
         if (next_state &&
             next_state->qualified_name() != old_state->qualified_name()) {
-          for (auto& deferred_event : deferred) {
-            queue_.push(std::move(deferred_event));
+          for (auto& [deferred_event, deferred_ns] : deferred) {
+            queue_.push(std::move(deferred_event), deferred_ns);
           }
           deferred.clear();
         }
+      } else {
+        // No transition found: the event is discarded (not deferred)
+        trace(TracePhase::Unhandled, state);
+        if (metrics) metrics->event_unhandled();
+        if (stats_hook_) ++stats_.unhandled;
+      }
+      if (metrics) {
+        metrics->step_completed(enqueued_ns, started_ns, Metrics::now_ns());
+      }
+      if (step_hook_) step_hook_->finish();
+      if (stats_hook_) {
+        ++stats_.dispatched;
+        publish_stats();
       }
-      // If no transition found, event is discarded (not deferred)
     }
 
     // Re-queue any remaining deferred events
-    for (auto& event : deferred) {
-      queue_.push(std::move(event));
+    for (auto& [event, enqueued_ns] : deferred) {
+      queue_.push(std::move(event), enqueued_ns);
     }
+    if (!deferred.empty()) publish_stats();
     processing_mutex_.unlock();
   }
 
@@ -1066,6 +1327,9 @@ struct HSM : public Instance {
     }
 
     const auto& path = it->second;
+    if (auto* metrics = metrics_.load(std::memory_order_relaxed)) {
+      metrics->transition_fired(trans->trace_id);
+    }
 
     // Exit states
     for (const auto& exiting : path.exit) {
@@ -1074,10 +1338,11 @@ struct HSM : public Instance {
     }
 
     // Execute effects
+    if (!trans->effect.empty()) trace(TracePhase::Effect, current, trans);
     for (const auto& effect_name : trans->effect) {
       auto* effect = model_.get_member<Behavior>(effect_name);
       if (effect) {
-        execute_behavior(effect, event);
+        execute_behavior(effect, BehaviorRole::Effect, event);
       }
     }
 
@@ -1121,17 +1386,25 @@ struct HSM : public Instance {
     if (is_kind(vertex->kind(), Kind::State)) {
       auto* state = static_cast<State*>(vertex);
       if (!state || !is_kind(state->kind(), Kind::State)) return vertex;
+      trace(TracePhase::Enter, state);
+      HSM_PROBE2(hsm, enter, &instance_, state->trace_id);
+      if (auto* metrics = metrics_.load(std::memory_order_relaxed)) {
+        metrics->state_entered(state->trace_id);
+        if (state->trace_id < entered_ns_.size()) {
+          entered_ns_[state->trace_id] = Metrics::now_ns();
+        }
+      }
 
       // Execute entry actions
       for (const auto& entry_name : state->entry) {
         auto* entry = model_.get_member<Behavior>(entry_name);
-        if (entry) execute_behavior(entry, event);
+        if (entry) execute_behavior(entry, BehaviorRole::Entry, event);
       }
 
       // Start activities
       for (const auto& activity_name : state->activities) {
         auto* activity = model_.get_member<Behavior>(activity_name);
-        if (activity) execute_behavior(activity, event);
+        if (activity) execute_behavior(activity, BehaviorRole::Activity, event);
       }
 
       if (!default_entry || state->initial.empty()) {
@@ -1171,7 +1444,11 @@ struct HSM : public Instance {
           auto* guard = model_.get_member<Constraint>(choice_trans->guard);
           if (guard && guard->condition) {
             Context ctx;
-            guard_ok = guard->condition(ctx, instance_, event);
+            guard_ok = profiled(*guard, BehaviorRole::Guard, [&] {
+              return guard->condition(ctx, instance_, event);
+            });
+            HSM_PROBE3(hsm, guard, &instance_, choice_trans->trace_id,
+                       guard_ok);
           } else {
             guard_ok = false;
           }
@@ -1187,6 +1464,17 @@ struct HSM : public Instance {
   }
 
   void exit(State& state, Event& event) {
+    trace(TracePhase::Exit, &state);
+    HSM_PROBE2(hsm, exit, &instance_, state.trace_id);
+    if (auto* metrics = metrics_.load(std::memory_order_relaxed);
+        metrics && state.trace_id < entered_ns_.size()) {
+      auto& entered_ns = entered_ns_[state.trace_id];
+      if (entered_ns != 0) {
+        metrics->state_dwelled(state.trace_id, Metrics::now_ns() - entered_ns);
+      }
+      entered_ns = 0;
+    }
+
     // Terminate activities
     for (const auto& activity_name : state.activities) {
       terminate_activity(activity_name);
@@ -1195,17 +1483,46 @@ struct HSM : public Instance {
     // Execute exit actions
     for (const auto& exit_name : state.exit) {
       auto* exit_behavior = model_.get_member<Behavior>(exit_name);
-      if (exit_behavior) execute_behavior(exit_behavior, event);
+      if (exit_behavior) {
+        execute_behavior(exit_behavior, BehaviorRole::Exit, event);
+      }
     }
   }
 
-  void execute_behavior(Behavior* behavior, Event& event) {
+  // Calls a behavior or guard, timed on the calling thread when a profiler
+  // is attached. Activities run outside the step the watchdog sees.
+  template <typename F>
+  std::invoke_result_t<F&> profiled(const Element& element, BehaviorRole role,
+                                    F&& call) {
+    if (role != BehaviorRole::Activity && step_hook_) {
+      step_hook_->running(element.trace_id);
+    }
+    auto* profiler = profiler_.load(std::memory_order_relaxed);
+    if (!profiler) return call();
+    if constexpr (std::is_void_v<std::invoke_result_t<F&>>) {
+      auto timed = [&] { call(); };
+      profiler->time(element.trace_id, role, run_timed<decltype(timed)>, &timed);
+    } else {
+      std::invoke_result_t<F&> result{};
+      auto timed = [&] { result = call(); };
+      profiler->time(element.trace_id, role, run_timed<decltype(timed)>, &timed);
+      return result;
+    }
+  }
+
+  template <typename F>
+  static void run_timed(void* call) {
+    (*static_cast<F*>(call))();
+  }
+
+  void execute_behavior(Behavior* behavior, BehaviorRole role, Event& event) {
     if (!behavior || !behavior->method) return;
 
     // Fast path for non-concurrent behaviors (most common case)
     if (!is_kind(behavior->kind(), Kind::Concurrent)) {
       Context ctx;
-      behavior->method(ctx, instance_, event);
+      profiled(*behavior, role,
+               [&] { behavior->method(ctx, instance_, event); });
       return;
     }
 
@@ -1223,13 +1540,17 @@ struct HSM : public Instance {
 
       // Capture shared_ptr to keep Context alive
       auto task = task_provider_->create_task(
-          [this, behavior, event, ctx]() mutable {
-            behavior->method(*ctx, instance_, event);
+          [this, behavior, role, event, ctx]() mutable {
+            profiled(*behavior, role,
+                     [&] { behavior->method(*ctx, instance_, event); });
           },
           behavior_name, 0, 0);
 
+      HSM_PROBE2(hsm, activity_start, &instance_, behavior->trace_id);
       active_.emplace(std::move(behavior_name),
-                      Active(std::move(task), std::move(ctx)));
+                      Active(std::move(task), std::move(ctx), behavior));
+      ++activities_;
+      if (behavior->timer) ++timers_;
     }
   }
 
@@ -1241,6 +1562,9 @@ struct HSM : public Instance {
       if (it->second.task->joinable()) {
         it->second.task->join();
       }
+      HSM_PROBE2(hsm, activity_stop, &instance_, it->second.behavior->trace_id);
+      --activities_;
+      if (it->second.behavior->timer) --timers_;
       active_.erase(it);
     }
   }
@@ -1889,16 +2213,10 @@ class AfterBehavior : public Partial {
         duration_func_(std::move(duration_func)) {}
 
   void apply(Model& model, std::vector<ElementInterface*>& /*stack*/) override {
-    std::cerr << "DEBUG: AfterBehavior::apply called for transition_source: "
-              << transition_source_ << std::endl;
     auto* source_state = model.get_member<State>(transition_source_);
     if (!source_state) {
-      std::cerr << "DEBUG: AfterBehavior::apply - source_state not found!"
-                << std::endl;
       return;
     }
-    std::cerr << "DEBUG: AfterBehavior::apply - source_state found: "
-              << source_state->qualified_name() << std::endl;
 
     // Create activity name
     std::string activity_name = std::string(source_state->qualified_name()) +
@@ -1911,51 +2229,38 @@ class AfterBehavior : public Partial {
         std::function<void(Context&, T&, Event&)>(
             [event_name = event_name_, duration_func = duration_func_](
                 Context& signal, T& hsm, Event& event) {
-              std::cerr << "DEBUG: Timer behavior started for event: "
-                        << event_name << std::endl;
-
               // Calculate duration using the provided function
               auto duration = duration_func(signal, hsm, event);
-              std::cerr << "DEBUG: Timer duration: " << duration.count() << "ms"
-                        << std::endl;
-
               if (duration <= D(0)) {
-                std::cerr << "DEBUG: Timer duration <= 0, returning"
-                          << std::endl;
                 return;
               }
 
               // Start timer
-              std::cerr << "DEBUG: Timer starting sleep..." << std::endl;
+              HSM_PROBE3(hsm, timer_arm, static_cast<Instance*>(&hsm),
+                         event_name.c_str(),
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             duration)
+                             .count());
               hsm.task_provider().sleep_for(duration);
-              std::cerr << "DEBUG: Timer sleep completed" << std::endl;
 
               if (signal.is_set()) {
-                std::cerr << "DEBUG: Signal is set, timer cancelled"
-                          << std::endl;
                 return;
               }
 
               // Only dispatch if we are still in the same state
-              std::cerr << "DEBUG: Timer dispatching event via instance: "
-                        << event_name << std::endl;
               Event time_event(event_name, Kind::TimeEvent);
+              HSM_PROBE2(hsm, timer_fire, static_cast<Instance*>(&hsm),
+                         event_name.c_str());
 
               // Use Instance dispatch instead of HSM dispatch to avoid deadlock
               auto& ctx = hsm.Instance::dispatch(std::move(time_event));
               ctx.wait();
-              std::cerr << "DEBUG: Timer event dispatched via instance"
-                        << std::endl;
             }),
         Kind::Concurrent);
+    timer_behavior->timer = true;
 
-    std::cerr << "DEBUG: AfterBehavior::apply - creating activity: "
-              << activity_name << std::endl;
     model.set_member(activity_name, std::move(timer_behavior));
     source_state->activities.push_back(activity_name);
-    std::cerr << "DEBUG: AfterBehavior::apply - added activity to state, "
-                 "activities count: "
-              << source_state->activities.size() << std::endl;
   }
 };
 
@@ -1999,6 +2304,11 @@ class EveryBehavior : public Partial {
               }
 
               while (!signal.is_set()) {
+                HSM_PROBE3(hsm, timer_arm, static_cast<Instance*>(&hsm),
+                           event_name.c_str(),
+                           std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               duration)
+                               .count());
                 hsm.task_provider().sleep_for(duration);
 
                 if (signal.is_set()) {
@@ -2007,10 +2317,13 @@ class EveryBehavior : public Partial {
 
                 // Only dispatch if HSM is still running
                 Event time_event(event_name, Kind::TimeEvent);
+                HSM_PROBE2(hsm, timer_fire, static_cast<Instance*>(&hsm),
+                           event_name.c_str());
                 hsm.dispatch(std::move(time_event)).wait();
               }
             }),
         Kind::Concurrent);
+    timer_behavior->timer = true;
 
     model.set_member(activity_name, std::move(timer_behavior));
     source_state->activities.push_back(activity_name);
@@ -2028,26 +2341,18 @@ class PartialAfter : public Partial {
       : duration_func_(std::move(duration_func)) {}
 
   void apply(Model& model, std::vector<ElementInterface*>& stack) override {
-    std::cerr << "DEBUG: PartialAfter::apply called" << std::endl;
     auto* transition = find_in_stack<Transition>(stack, Kind::Transition);
     if (!transition) {
-      std::cerr << "DEBUG: No transition found in stack!" << std::endl;
       return;
     }
 
-    std::cerr << "DEBUG: Found transition: " << transition->qualified_name()
-              << std::endl;
-
     // Determine the source from the stack context since transition->source
     // isn't set yet
     std::string source_name;
     auto* owner = find_in_stack<Vertex>(stack, Kind::Vertex);
     if (owner) {
       source_name = std::string(owner->qualified_name());
-      std::cerr << "DEBUG: Determined source from stack: " << source_name
-                << std::endl;
     } else {
-      std::cerr << "DEBUG: No owner found in stack!" << std::endl;
       return;
     }
 
@@ -2055,16 +2360,12 @@ class PartialAfter : public Partial {
     std::string event_name = std::string(transition->qualified_name()) +
                              "_after_" + std::to_string(model.members.size());
 
-    std::cerr << "DEBUG: Generated event name: " << event_name << std::endl;
-
     // Add the time event to the transition's events
     transition->events.push_back(event_name);
 
     // Create and add the AfterBehavior partial
     model.add(std::make_unique<AfterBehavior<D, T>>(event_name, source_name,
                                                     duration_func_));
-
-    std::cerr << "DEBUG: Added AfterBehavior to owned_elements" << std::endl;
   }
 };
 
@@ -2348,15 +2649,33 @@ std::unique_ptr<Model> define(std::string name, TPartials&&... partials) {
   }
   buildTransitionTable(*model);
   buildDeferredTable(*model);
+  buildTraceIds(*model);
   return model;
 }
 
 // Global stop function for convenience, similar to the Go version
 inline Context& stop(Instance& instance) { return instance.__hsm->stop(); }
 
-inline void start(Instance& instance, std::unique_ptr<Model>& model) {
+// With a flight recorder, the machine records its steps into it from the
+// initial transition on (see flight_recorder.hpp)
+inline void start(Instance& instance, std::unique_ptr<Model>& model,
+                  FlightRecorder* recorder = nullptr) {
   auto hsm = new HSM(instance, model);
+  hsm->recorder_ = recorder;
   hsm->start().wait();
 }
 
+// Attaches a flight recorder to a started machine, or detaches it (nullptr)
+inline void attach_flight_recorder(Instance& instance,
+                                   FlightRecorder* recorder) {
+  if (instance.__hsm) instance.__hsm->set_flight_recorder(recorder);
+}
+
+// Attaches metrics sized for the model's trace ids to a started machine, or
+// detaches them (nullptr). Several instances may share one Metrics. Dwell
+// time is only counted for states entered while attached.
+inline void attach_metrics(Instance& instance, Metrics* metrics) {
+  if (instance.__hsm) instance.__hsm->set_metrics(metrics);
+}
+
 }  // namespace hsm
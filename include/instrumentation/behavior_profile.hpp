@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Per-behavior CPU profiles and their reports, shared by hsm::Profiler
+// (profiler.hpp) and cthsm::profiler (cthsm/profiler.hpp)
+namespace hsm::instrumentation {
+
+// What a profiled behavior is to the state or transition that owns it
+enum class BehaviorRole : std::uint8_t {
+  None,
+  Entry,
+  Exit,
+  Effect,
+  Guard,
+  Activity,
+};
+
+inline constexpr std::string_view behavior_role_name(BehaviorRole role) {
+  switch (role) {
+    case BehaviorRole::None:
+      return "";
+    case BehaviorRole::Entry:
+      return "entry";
+    case BehaviorRole::Exit:
+      return "exit";
+    case BehaviorRole::Effect:
+      return "effect";
+    case BehaviorRole::Guard:
+      return "guard";
+    case BehaviorRole::Activity:
+      return "activity";
+  }
+  return "";
+}
+
+// Totals of one behavior; id indexes the names the profile is reported with
+// (Model::trace_names for hsm)
+struct BehaviorProfile {
+  std::uint32_t id = 0;
+  BehaviorRole role = BehaviorRole::None;
+  std::uint64_t calls = 0;
+  std::chrono::nanoseconds cpu{0};
+  std::chrono::nanoseconds max_cpu{0};
+  std::uint64_t ticks = 0;
+};
+
+namespace detail {
+
+inline std::string_view profile_name(std::span<const std::string> names,
+                                     std::uint32_t id) {
+  return id < names.size() ? std::string_view(names[id]) : std::string_view{};
+}
+
+}  // namespace detail
+
+// A table of the profiles, in the order given (snapshot() sorts by CPU
+// time), with each behavior's share of the total
+inline void write_profile_report(std::ostream& out, std::span<const std::string> names,
+                                 const std::vector<BehaviorProfile>& profiles) {
+  std::uint64_t total_ns = 0;
+  for (const auto& p : profiles) total_ns += static_cast<std::uint64_t>(p.cpu.count());
+
+  char line[256];
+  std::snprintf(line, sizeof(line), "%-48s %-8s %10s %12s %10s %10s %7s %14s\n",
+                "BEHAVIOR", "ROLE", "CALLS", "CPU_US", "AVG_NS", "MAX_NS", "SHARE",
+                "TICKS");
+  out << line;
+  for (const auto& p : profiles) {
+    const std::string name(detail::profile_name(names, p.id));
+    const std::string role(behavior_role_name(p.role));
+    const auto cpu_ns = static_cast<std::uint64_t>(p.cpu.count());
+    std::snprintf(line, sizeof(line), "%-48s %-8s %10llu %12.1f %10llu %10llu %6.1f%% %14llu\n",
+                  name.c_str(), role.c_str(), static_cast<unsigned long long>(p.calls),
+                  static_cast<double>(cpu_ns) / 1000.0,
+                  static_cast<unsigned long long>(p.calls ? cpu_ns / p.calls : 0),
+                  static_cast<unsigned long long>(p.max_cpu.count()),
+                  total_ns ? 100.0 * static_cast<double>(cpu_ns) / static_cast<double>(total_ns)
+                           : 0.0,
+                  static_cast<unsigned long long>(p.ticks));
+    out << line;
+  }
+}
+
+// Folded stacks for flamegraph.pl, inferno or speedscope: one line per
+// behavior, its qualified name split at '/' into frames (the model, its
+// states, then the behavior), weighted by CPU nanoseconds
+//
+//   Pump;running;entry_0_x 48210
+inline void write_folded_stacks(std::ostream& out, std::span<const std::string> names,
+                                const std::vector<BehaviorProfile>& profiles) {
+  for (const auto& p : profiles) {
+    const std::string_view name = detail::profile_name(names, p.id);
+    bool first = true;
+    std::size_t at = 0;
+    while (at <= name.size()) {
+      std::size_t end = name.find('/', at);
+      if (end == std::string_view::npos) end = name.size();
+      if (end > at) {
+        if (!first) out << ';';
+        for (char c : name.substr(at, end - at)) out << (c == ';' || c == ' ' ? '_' : c);
+        first = false;
+      }
+      at = end + 1;
+    }
+    if (first) continue;
+    out << ' ' << p.cpu.count() << '\n';
+  }
+}
+
+}  // namespace hsm::instrumentation
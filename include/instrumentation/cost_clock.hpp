@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#define HSM_THREAD_CPU_CLOCK 1
+#else
+#define HSM_THREAD_CPU_CLOCK 0
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+// Behavior timing shared by hsm::Profiler and cthsm::profiler
+namespace hsm::instrumentation {
+
+// What one behavior call cost: CPU time of the calling thread, and ticks of
+// the CPU's cycle counter (TSC on x86, CNTVCT on AArch64) over the call
+struct BehaviorCost {
+  std::uint64_t cpu_ns = 0;
+  std::uint64_t ticks = 0;
+};
+
+// Reads both at the start and end of a call. Where there is no thread CPU
+// clock or cycle counter, steady_clock nanoseconds stand in for it.
+struct CostClock {
+  static std::uint64_t thread_cpu_ns() noexcept {
+#if HSM_THREAD_CPU_CLOCK
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+      return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ULL +
+             static_cast<std::uint64_t>(ts.tv_nsec);
+    }
+#endif
+    return steady_ns();
+  }
+
+  static std::uint64_t ticks() noexcept {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    return __rdtsc();
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+    std::uint64_t value;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return steady_ns();
+#endif
+  }
+
+  static BehaviorCost now() noexcept { return {thread_cpu_ns(), ticks()}; }
+
+  static BehaviorCost since(const BehaviorCost& start) noexcept {
+    const BehaviorCost end = now();
+    return {end.cpu_ns > start.cpu_ns ? end.cpu_ns - start.cpu_ns : 0,
+            end.ticks > start.ticks ? end.ticks - start.ticks : 0};
+  }
+
+ private:
+  static std::uint64_t steady_ns() noexcept {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+};
+
+}  // namespace hsm::instrumentation
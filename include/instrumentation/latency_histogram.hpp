@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// The latency histogram of hsm::Metrics and cthsm::metrics
+namespace hsm::instrumentation {
+
+// Latencies counted in power-of-two nanosecond buckets: bucket 0 holds
+// 0 ns, bucket b holds [2^(b-1), 2^b) ns, and the last bucket everything
+// from 2^(bucket_count-2) ns (about 4.6 minutes) up.
+struct LatencyHistogram {
+  static constexpr std::size_t bucket_count = 40;
+  std::array<std::uint64_t, bucket_count> buckets{};
+
+  static constexpr std::size_t bucket_of(std::uint64_t ns) noexcept {
+    const auto b = static_cast<std::size_t>(std::bit_width(ns));
+    return b < bucket_count ? b : bucket_count - 1;
+  }
+
+  // Exclusive upper bound of bucket b
+  static constexpr std::uint64_t upper_bound_ns(std::size_t b) noexcept {
+    return std::uint64_t{1} << b;
+  }
+
+  [[nodiscard]] constexpr std::uint64_t count() const noexcept {
+    std::uint64_t n = 0;
+    for (auto c : buckets) n += c;
+    return n;
+  }
+
+  // Upper bound of the bucket holding the q-quantile (0 < q <= 1), or 0
+  // without samples
+  [[nodiscard]] constexpr std::uint64_t quantile_ns(double q) const noexcept {
+    const std::uint64_t total = count();
+    if (total == 0) return 0;
+    auto rank = static_cast<std::uint64_t>(q * static_cast<double>(total));
+    if (rank == 0) rank = 1;
+    std::uint64_t seen = 0;
+    for (std::size_t b = 0; b < bucket_count; ++b) {
+      seen += buckets[b];
+      if (seen >= rank) return upper_bound_ns(b);
+    }
+    return upper_bound_ns(bucket_count - 1);
+  }
+};
+
+}  // namespace hsm::instrumentation
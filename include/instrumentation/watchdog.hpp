@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// The step watchdog shared by hsm (watchdog.hpp) and cthsm
+// (cthsm/step_watch.hpp)
+namespace hsm::instrumentation {
+
+// Names behind the ids a machine puts in its WatchSlot: an hsm model's
+// trace_names for all three, or the paths a cthsm::step_watch builds
+struct WatchNames {
+  std::span<const std::string> states;
+  std::span<const std::string> events;
+  std::span<const std::string> behaviors;
+};
+
+// A run-to-completion step that took longer than its budget
+struct StepOverrun {
+  std::string instance;
+  // State active when the step started, the event it handles, and the
+  // behavior (or transition) running when the overrun was seen
+  std::string state;
+  std::string event;
+  std::string behavior;
+  std::chrono::nanoseconds elapsed{0};
+  std::chrono::nanoseconds budget{0};
+  // False when the watchdog thread caught the step still running; the same
+  // step is reported again with its full length when it finishes, but only
+  // counted once
+  bool finished = false;
+};
+
+// The step a machine is running, written by the machine and read by the
+// watchdog. One per watched instance (or per dispatching thread, for
+// cthsm).
+struct WatchSlot {
+  std::atomic<bool> claimed{false};
+  // now_ns() at the start of the running step; 0 between steps
+  std::atomic<std::uint64_t> started_ns{0};
+  std::atomic<std::uint64_t> budget_ns{0};
+  std::atomic<std::uint64_t> step{0};
+  // Last step counted as an overrun
+  std::atomic<std::uint64_t> counted{0};
+  std::atomic<std::uint32_t> state{0};
+  std::atomic<std::uint32_t> event{0};
+  std::atomic<std::uint32_t> behavior{0};
+  std::atomic<std::uint64_t> overruns{0};
+  // Set on claim, before the slot is handed out
+  std::string instance;
+  WatchNames names;
+
+  // A budget of 0 is never overrun
+  void begin(std::uint32_t state_id, std::uint32_t event_id, std::uint64_t budget) noexcept {
+    step.store(step.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    state.store(state_id, std::memory_order_relaxed);
+    event.store(event_id, std::memory_order_relaxed);
+    behavior.store(0, std::memory_order_relaxed);
+    budget_ns.store(budget, std::memory_order_relaxed);
+    started_ns.store(now_ns(), std::memory_order_release);
+  }
+
+  void running(std::uint32_t behavior_id) noexcept {
+    behavior.store(behavior_id, std::memory_order_relaxed);
+  }
+
+  static std::uint64_t now_ns() noexcept {
+    // Never 0, which marks an idle slot
+    return static_cast<std::uint64_t>(
+               std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+                   .count()) |
+           1U;
+  }
+
+  // True for the first caller that counts this step
+  bool count(std::uint64_t current) noexcept {
+    std::uint64_t seen = counted.load(std::memory_order_relaxed);
+    while (seen != current) {
+      if (counted.compare_exchange_weak(seen, current, std::memory_order_relaxed)) {
+        overruns.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// Checks the run-to-completion steps of attached machines against their
+// budgets. A dedicated thread looks at every slot once per period, so a
+// step that hangs is reported while it runs; a machine also checks each
+// step when it finishes. Overruns are counted per slot and passed to the
+// handler, which may be called from the watchdog thread or from the
+// machine's own thread while it holds its processing lock.
+//
+//   hsm::Watchdog watchdog(16, std::chrono::milliseconds(10), [](const hsm::StepOverrun& o) {
+//     std::cerr << o.instance << " spent " << o.elapsed.count() << " ns in " << o.behavior;
+//   });
+//   hsm::attach_watchdog(instance, &watchdog, {std::chrono::milliseconds(2)}, "pump-1");
+//
+// cthsm machines attach through cthsm::step_watch.
+//
+// With a period of 0 there is no thread; call check() from a loop of your
+// own, such as the one that polls timers. The watchdog must outlive the
+// machines attached to it.
+class Watchdog {
+ public:
+  using Handler = std::function<void(const StepOverrun&)>;
+
+  explicit Watchdog(std::size_t slots,
+                    std::chrono::milliseconds period = std::chrono::milliseconds(10),
+                    Handler handler = nullptr)
+      : slots_(std::make_unique<WatchSlot[]>(slots)),
+        slot_count_(slots),
+        handler_(std::move(handler)) {
+    if (period.count() > 0) {
+      thread_ = std::jthread([this, period](std::stop_token stop) {
+        std::mutex mutex;
+        std::condition_variable_any wake;
+        std::unique_lock lock(mutex);
+        while (!wake.wait_for(lock, stop, period, [&stop] { return stop.stop_requested(); })) {
+          check();
+        }
+      });
+    }
+  }
+
+  ~Watchdog() {
+    if (thread_.joinable()) {
+      thread_.request_stop();
+      thread_.join();
+    }
+  }
+
+  Watchdog(const Watchdog&) = delete;
+  Watchdog& operator=(const Watchdog&) = delete;
+
+  std::size_t slot_count() const { return slot_count_; }
+
+  // A free slot, or nullptr if all are taken
+  WatchSlot* claim(std::string_view instance, WatchNames names) {
+    for (std::size_t i = 0; i < slot_count_; ++i) {
+      auto& slot = slots_[i];
+      bool expected = false;
+      if (!slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        continue;
+      }
+      std::lock_guard lock(mutex_);
+      slot.started_ns.store(0, std::memory_order_relaxed);
+      slot.overruns.store(0, std::memory_order_relaxed);
+      slot.instance = instance;
+      slot.names = names;
+      active_.push_back(&slot);
+      return &slot;
+    }
+    return nullptr;
+  }
+
+  void release(WatchSlot* slot) {
+    if (!slot) return;
+    {
+      std::lock_guard lock(mutex_);
+      std::erase(active_, slot);
+    }
+    slot->started_ns.store(0, std::memory_order_relaxed);
+    slot->claimed.store(false, std::memory_order_release);
+  }
+
+  // Ends the slot's step: reports and counts it if it ran over budget
+  void finish(WatchSlot& slot) {
+    const std::uint64_t started = slot.started_ns.load(std::memory_order_relaxed);
+    if (started == 0) return;
+    const std::uint64_t elapsed = WatchSlot::now_ns() - started;
+    slot.started_ns.store(0, std::memory_order_release);
+    const std::uint64_t budget = slot.budget_ns.load(std::memory_order_relaxed);
+    if (budget == 0 || elapsed <= budget) return;
+    const std::uint64_t step = slot.step.load(std::memory_order_relaxed);
+    if (slot.count(step)) overruns_.fetch_add(1, std::memory_order_relaxed);
+    report(slot, slot.state.load(std::memory_order_relaxed),
+           slot.event.load(std::memory_order_relaxed),
+           slot.behavior.load(std::memory_order_relaxed), elapsed, budget, true);
+  }
+
+  // Looks at every running step once, reporting those over budget that
+  // were not counted yet
+  void check() {
+    std::lock_guard lock(mutex_);
+    const std::uint64_t now = WatchSlot::now_ns();
+    for (auto* slot : active_) {
+      const std::uint64_t step = slot->step.load(std::memory_order_acquire);
+      const std::uint64_t started = slot->started_ns.load(std::memory_order_acquire);
+      if (started == 0 || now <= started) continue;
+      const std::uint64_t budget = slot->budget_ns.load(std::memory_order_relaxed);
+      const std::uint32_t state = slot->state.load(std::memory_order_relaxed);
+      const std::uint32_t event = slot->event.load(std::memory_order_relaxed);
+      const std::uint32_t behavior = slot->behavior.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      // The machine moved on to another step while we read
+      if (slot->step.load(std::memory_order_relaxed) != step) continue;
+      if (budget == 0 || now - started <= budget) continue;
+      if (!slot->count(step)) continue;
+      overruns_.fetch_add(1, std::memory_order_relaxed);
+      report(*slot, state, event, behavior, now - started, budget, false);
+    }
+  }
+
+  // Steps over budget, each counted once
+  std::uint64_t overruns() const { return overruns_.load(std::memory_order_relaxed); }
+
+ private:
+  static std::string name_of(std::span<const std::string> names, std::uint32_t id) {
+    return id < names.size() ? names[id] : std::string{};
+  }
+
+  void report(const WatchSlot& slot, std::uint32_t state, std::uint32_t event,
+              std::uint32_t behavior, std::uint64_t elapsed, std::uint64_t budget,
+              bool finished) {
+    if (!handler_) return;
+    StepOverrun overrun;
+    overrun.instance = slot.instance;
+    overrun.state = name_of(slot.names.states, state);
+    overrun.event = name_of(slot.names.events, event);
+    overrun.behavior = name_of(slot.names.behaviors, behavior);
+    overrun.elapsed = std::chrono::nanoseconds(static_cast<std::int64_t>(elapsed));
+    overrun.budget = std::chrono::nanoseconds(static_cast<std::int64_t>(budget));
+    overrun.finished = finished;
+    handler_(overrun);
+  }
+
+  std::unique_ptr<WatchSlot[]> slots_;
+  std::size_t slot_count_;
+  Handler handler_;
+  std::atomic<std::uint64_t> overruns_{0};
+  // Guards active_ and the names of claimed slots against check()
+  std::mutex mutex_;
+  std::vector<WatchSlot*> active_;
+  std::jthread thread_;
+};
+
+}  // namespace hsm::instrumentation
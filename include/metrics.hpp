@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "instrumentation/latency_histogram.hpp"
+
+namespace hsm {
+
+using instrumentation::LatencyHistogram;
+
+struct MetricsSnapshot {
+  // Indexed by trace id (Model::trace_names)
+  std::vector<std::uint64_t> transitions;
+  std::vector<std::uint64_t> entries;
+  // Time spent in completed visits of each state
+  std::vector<std::chrono::nanoseconds> dwell;
+  // Dequeued events that ran a run-to-completion step; a deferral does not
+  // count, and neither does the initial transition
+  std::uint64_t dispatched = 0;
+  std::uint64_t deferred = 0;
+  std::uint64_t unhandled = 0;
+  std::size_t queue_high_water = 0;
+  // From Instance::dispatch (or the first deferral) to the end of the
+  // run-to-completion step that consumed the event
+  LatencyHistogram enqueue_to_completion;
+  // From dequeue to the end of the event's run-to-completion step
+  LatencyHistogram run_to_completion;
+};
+
+// Runtime counters of one or more instances of a model, indexed by trace
+// id. Every counter is a relaxed atomic, so instances sharing a Metrics
+// may run on any thread and snapshot() can be taken while they do; a
+// snapshot is not one consistent cut across counters.
+//
+//   hsm::Metrics metrics(model->trace_names.size());
+//   hsm::attach_metrics(instance, &metrics);
+class Metrics {
+ public:
+  explicit Metrics(std::size_t ids)
+      : ids_(ids),
+        transitions_(std::make_unique<Counter[]>(ids)),
+        entries_(std::make_unique<Counter[]>(ids)),
+        dwell_(std::make_unique<Counter[]>(ids)) {}
+
+  static std::uint64_t now_ns() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+
+  // Ids beyond the size given at construction are ignored
+  void transition_fired(std::uint32_t id) {
+    if (id < ids_) bump(transitions_[id]);
+  }
+  void state_entered(std::uint32_t id) {
+    if (id < ids_) bump(entries_[id]);
+  }
+  void state_dwelled(std::uint32_t id, std::uint64_t ns) {
+    if (id < ids_) dwell_[id].fetch_add(ns, std::memory_order_relaxed);
+  }
+  void event_deferred() { bump(deferred_); }
+  void event_unhandled() { bump(unhandled_); }
+
+  void queue_depth(std::size_t depth) {
+    std::size_t seen = queue_high_water_.load(std::memory_order_relaxed);
+    while (depth > seen && !queue_high_water_.compare_exchange_weak(
+                               seen, depth, std::memory_order_relaxed)) {
+    }
+  }
+
+  // A dequeued event finished its run-to-completion step; enqueued_ns is
+  // 0 if the enqueue time is unknown
+  void step_completed(std::uint64_t enqueued_ns, std::uint64_t started_ns,
+                      std::uint64_t finished_ns) {
+    bump(dispatched_);
+    bump(run_to_completion_[LatencyHistogram::bucket_of(finished_ns -
+                                                         started_ns)]);
+    if (enqueued_ns != 0 && enqueued_ns <= finished_ns) {
+      bump(enqueue_to_completion_[LatencyHistogram::bucket_of(finished_ns -
+                                                             enqueued_ns)]);
+    }
+  }
+
+  std::size_t size() const { return ids_; }
+
+  MetricsSnapshot snapshot() const {
+    MetricsSnapshot out;
+    out.transitions.resize(ids_);
+    out.entries.resize(ids_);
+    out.dwell.resize(ids_);
+    for (std::size_t i = 0; i < ids_; ++i) {
+      out.transitions[i] = load(transitions_[i]);
+      out.entries[i] = load(entries_[i]);
+      out.dwell[i] =
+          std::chrono::nanoseconds(static_cast<std::int64_t>(load(dwell_[i])));
+    }
+    out.dispatched = load(dispatched_);
+    out.deferred = load(deferred_);
+    out.unhandled = load(unhandled_);
+    out.queue_high_water = queue_high_water_.load(std::memory_order_relaxed);
+    for (std::size_t b = 0; b < LatencyHistogram::bucket_count; ++b) {
+      out.enqueue_to_completion.buckets[b] = load(enqueue_to_completion_[b]);
+      out.run_to_completion.buckets[b] = load(run_to_completion_[b]);
+    }
+    return out;
+  }
+
+ private:
+  using Counter = std::atomic<std::uint64_t>;
+
+  static void bump(Counter& c) { c.fetch_add(1, std::memory_order_relaxed); }
+  static std::uint64_t load(const Counter& c) {
+    return c.load(std::memory_order_relaxed);
+  }
+
+  std::size_t ids_;
+  std::unique_ptr<Counter[]> transitions_;
+  std::unique_ptr<Counter[]> entries_;
+  std::unique_ptr<Counter[]> dwell_;
+  Counter dispatched_{0};
+  Counter deferred_{0};
+  Counter unhandled_{0};
+  std::atomic<std::size_t> queue_high_water_{0};
+  std::array<Counter, LatencyHistogram::bucket_count> enqueue_to_completion_{};
+  std::array<Counter, LatencyHistogram::bucket_count> run_to_completion_{};
+};
+
+}  // namespace hsm
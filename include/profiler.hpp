@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "hsm.hpp"
+#include "instrumentation/behavior_profile.hpp"
+#include "instrumentation/cost_clock.hpp"
+
+namespace hsm {
+
+using instrumentation::BehaviorCost;
+using instrumentation::BehaviorProfile;
+using instrumentation::BehaviorRole;
+using instrumentation::CostClock;
+using instrumentation::behavior_role_name;
+using instrumentation::write_folded_stacks;
+using instrumentation::write_profile_report;
+
+// Thread CPU time and cycle-counter ticks spent in every entry, exit,
+// effect, guard and activity call, indexed by trace id. Counters are
+// relaxed atomics, so instances sharing a Profiler may run on any thread
+// (activities are timed on their own) and snapshot() can be taken while
+// they do.
+//
+//   hsm::Profiler profiler(model->trace_names.size());
+//   hsm::attach_profiler(instance, &profiler);
+//   ...
+//   hsm::write_profile_report(std::cout, model->trace_names, profiler.snapshot());
+class Profiler final : public BehaviorHook {
+ public:
+  explicit Profiler(std::size_t ids)
+      : ids_(ids), slots_(std::make_unique<Slot[]>(ids)) {}
+
+  // Ids beyond the size given at construction are ignored
+  void record(std::uint32_t id, BehaviorRole role, const BehaviorCost& cost) {
+    if (id >= ids_) return;
+    auto& slot = slots_[id];
+    slot.role.store(static_cast<std::uint8_t>(role), std::memory_order_relaxed);
+    slot.calls.fetch_add(1, std::memory_order_relaxed);
+    slot.cpu_ns.fetch_add(cost.cpu_ns, std::memory_order_relaxed);
+    slot.ticks.fetch_add(cost.ticks, std::memory_order_relaxed);
+    std::uint64_t seen = slot.max_cpu_ns.load(std::memory_order_relaxed);
+    while (cost.cpu_ns > seen && !slot.max_cpu_ns.compare_exchange_weak(
+                                     seen, cost.cpu_ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  void time(std::uint32_t id, BehaviorRole role, void (*call)(void*),
+            void* arg) override {
+    const auto started = CostClock::now();
+    call(arg);
+    record(id, role, CostClock::since(started));
+  }
+
+  std::size_t size() const { return ids_; }
+
+  // Behaviors called at least once, most CPU time first
+  std::vector<BehaviorProfile> snapshot() const {
+    std::vector<BehaviorProfile> out;
+    for (std::size_t i = 0; i < ids_; ++i) {
+      const auto& slot = slots_[i];
+      const std::uint64_t calls = slot.calls.load(std::memory_order_relaxed);
+      if (calls == 0) continue;
+      BehaviorProfile profile;
+      profile.id = static_cast<std::uint32_t>(i);
+      profile.role =
+          static_cast<BehaviorRole>(slot.role.load(std::memory_order_relaxed));
+      profile.calls = calls;
+      profile.cpu = as_ns(slot.cpu_ns.load(std::memory_order_relaxed));
+      profile.max_cpu = as_ns(slot.max_cpu_ns.load(std::memory_order_relaxed));
+      profile.ticks = slot.ticks.load(std::memory_order_relaxed);
+      out.push_back(profile);
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const BehaviorProfile& a, const BehaviorProfile& b) {
+                       return a.cpu > b.cpu;
+                     });
+    return out;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<std::uint8_t> role{0};
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> cpu_ns{0};
+    std::atomic<std::uint64_t> max_cpu_ns{0};
+    std::atomic<std::uint64_t> ticks{0};
+  };
+
+  static std::chrono::nanoseconds as_ns(std::uint64_t ns) {
+    return std::chrono::nanoseconds(static_cast<std::int64_t>(ns));
+  }
+
+  std::size_t ids_;
+  std::unique_ptr<Slot[]> slots_;
+};
+
+// Attaches a profiler sized for the model's trace ids to a started machine,
+// or detaches it (nullptr). Several instances may share one Profiler.
+inline void attach_profiler(Instance& instance, Profiler* profiler) {
+  if (instance.__hsm) instance.__hsm->set_profiler(profiler);
+}
+
+}  // namespace hsm
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HSM_STATS_SHM 1
+#else
+#define HSM_STATS_SHM 0
+#endif
+
+#include "hsm.hpp"
+
+namespace hsm {
+
+// What an instance publishes after every run-to-completion step. Names are
+// NUL-terminated and truncated to fit. Counters count from attaching.
+struct StatsRecord {
+  char model[64];
+  char instance[64];
+  char state[128];
+  // steady_clock time of the last publish, for rates
+  std::uint64_t updated_ns;
+  // Dequeued events that ran a step (deferrals do not count)
+  std::uint64_t dispatched;
+  std::uint64_t deferred;
+  std::uint64_t unhandled;
+  // Trace id of the active state (Model::trace_names)
+  std::uint32_t state_id;
+  std::uint32_t queue_depth;
+  // Started and not yet terminated activities; timers are the after() and
+  // every() activities among them
+  std::uint32_t activities;
+  std::uint32_t timers;
+};
+
+static_assert(std::is_trivially_copyable_v<StatsRecord>);
+static_assert(sizeof(StatsRecord) % sizeof(std::uint64_t) == 0);
+
+inline constexpr std::size_t STATS_RECORD_WORDS =
+    sizeof(StatsRecord) / sizeof(std::uint64_t);
+
+template <std::size_t N>
+std::string_view stats_name(const char (&name)[N]) {
+  return std::string_view(name, static_cast<std::size_t>(
+                                    std::find(name, name + N, '\0') - name));
+}
+
+inline void copy_stats_name(char* out, std::size_t size, std::string_view name) {
+  const std::size_t n = std::min(name.size(), size - 1);
+  std::memcpy(out, name.data(), n);
+  std::memset(out + n, 0, size - n);
+}
+
+// One instance's record behind a seqlock. Only the instance that claimed
+// the slot writes it, so publish() is a fixed number of stores and never
+// waits; readers retry when they race with it.
+struct alignas(64) StatsSlot {
+  std::atomic<std::uint32_t> claimed{0};
+  std::atomic<std::uint32_t> seq{0};
+  std::array<std::atomic<std::uint64_t>, STATS_RECORD_WORDS> words{};
+
+  void publish(const StatsRecord& record) noexcept {
+    std::array<std::uint64_t, STATS_RECORD_WORDS> raw;
+    std::memcpy(raw.data(), &record, sizeof(record));
+    const std::uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < STATS_RECORD_WORDS; ++i) {
+      words[i].store(raw[i], std::memory_order_relaxed);
+    }
+    seq.store(s + 2, std::memory_order_release);
+  }
+
+  // False if the slot is unclaimed, not yet published, or kept changing
+  // over all attempts
+  bool read(StatsRecord& record, int attempts = 64) const noexcept {
+    for (int a = 0; a < attempts; ++a) {
+      if (!claimed.load(std::memory_order_acquire)) return false;
+      const std::uint32_t before = seq.load(std::memory_order_acquire);
+      if (before == 0) return false;
+      if (before & 1U) continue;
+      std::array<std::uint64_t, STATS_RECORD_WORDS> raw;
+      for (std::size_t i = 0; i < STATS_RECORD_WORDS; ++i) {
+        raw[i] = words[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq.load(std::memory_order_relaxed) != before) continue;
+      std::memcpy(&record, raw.data(), sizeof(record));
+      return true;
+    }
+    return false;
+  }
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free &&
+                  std::atomic<std::uint32_t>::is_always_lock_free,
+              "stats slots are shared between processes");
+
+// --- Segment layout ---
+//
+// A StatsHeader followed by slot_count StatsSlots. The magic is stored last
+// with release, so a reader that sees it sees an initialized segment.
+struct alignas(64) StatsHeader {
+  std::atomic<std::uint64_t> magic{0};
+  std::uint32_t version{0};
+  std::uint32_t slot_count{0};
+  std::uint32_t record_size{0};
+};
+
+inline constexpr std::uint64_t STATS_MAGIC = 0x53544154534d5348ULL;  // "HSMSTATS"
+inline constexpr std::uint32_t STATS_VERSION = 1;
+
+inline constexpr std::size_t stats_segment_size(std::size_t slots) {
+  return sizeof(StatsHeader) + slots * sizeof(StatsSlot);
+}
+
+// Totals of all published instances of one model
+struct ModelStats {
+  std::string model;
+  std::size_t instances = 0;
+  std::uint64_t dispatched = 0;
+  std::uint64_t deferred = 0;
+  std::uint64_t unhandled = 0;
+  std::uint64_t queue_depth = 0;
+  std::uint64_t activities = 0;
+  std::uint64_t timers = 0;
+};
+
+inline std::vector<ModelStats> aggregate_by_model(
+    const std::vector<StatsRecord>& records) {
+  std::vector<ModelStats> models;
+  for (const auto& record : records) {
+    const std::string_view name = stats_name(record.model);
+    auto it = std::find_if(models.begin(), models.end(),
+                           [&](const ModelStats& m) { return m.model == name; });
+    if (it == models.end()) {
+      it = models.insert(models.end(), ModelStats{});
+      it->model = name;
+    }
+    ++it->instances;
+    it->dispatched += record.dispatched;
+    it->deferred += record.deferred;
+    it->unhandled += record.unhandled;
+    it->queue_depth += record.queue_depth;
+    it->activities += record.activities;
+    it->timers += record.timers;
+  }
+  return models;
+}
+
+// Creates a POSIX shared-memory segment (shm_open name, e.g. "/myapp.hsm")
+// that instances publish their StatsRecord into, one slot each; see
+// attach_stats() in hsm.hpp. The segment is unlinked on destruction. On
+// failure (or without POSIX shared memory) the exporter is empty and
+// claim() returns nullptr.
+//
+//   hsm::StatsExporter exporter("/myapp.hsm", 64);
+//   hsm::attach_stats(instance, &exporter, "door-1");
+class StatsExporter {
+ public:
+  StatsExporter(std::string name, std::size_t slots) : name_(std::move(name)) {
+#if HSM_STATS_SHM
+    const int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) return;
+    const std::size_t size = stats_segment_size(slots);
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+      void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (base != MAP_FAILED) {
+        base_ = base;
+        size_ = size;
+      }
+    }
+    close(fd);
+    if (!base_) {
+      shm_unlink(name_.c_str());
+      return;
+    }
+    header_ = new (base_) StatsHeader{};
+    header_->version = STATS_VERSION;
+    header_->slot_count = static_cast<std::uint32_t>(slots);
+    header_->record_size = sizeof(StatsRecord);
+    slots_ = reinterpret_cast<StatsSlot*>(static_cast<char*>(base_) + sizeof(StatsHeader));
+    for (std::size_t i = 0; i < slots; ++i) new (&slots_[i]) StatsSlot{};
+    slot_count_ = slots;
+    header_->magic.store(STATS_MAGIC, std::memory_order_release);
+#else
+    (void)slots;
+#endif
+  }
+
+  ~StatsExporter() {
+#if HSM_STATS_SHM
+    if (base_) {
+      munmap(base_, size_);
+      shm_unlink(name_.c_str());
+    }
+#endif
+  }
+
+  StatsExporter(const StatsExporter&) = delete;
+  StatsExporter& operator=(const StatsExporter&) = delete;
+
+  explicit operator bool() const { return base_ != nullptr; }
+  const std::string& name() const { return name_; }
+  std::size_t slot_count() const { return slot_count_; }
+
+  // A free slot for one instance, or nullptr if all are taken
+  StatsSlot* claim() {
+    for (std::size_t i = 0; i < slot_count_; ++i) {
+      std::uint32_t expected = 0;
+      if (slots_[i].claimed.compare_exchange_strong(expected, 1,
+                                                    std::memory_order_acq_rel)) {
+        return &slots_[i];
+      }
+    }
+    return nullptr;
+  }
+
+  void release(StatsSlot* slot) {
+    if (slot) slot->claimed.store(0, std::memory_order_release);
+  }
+
+ private:
+  std::string name_;
+  void* base_ = nullptr;
+  std::size_t size_ = 0;
+  StatsHeader* header_ = nullptr;
+  StatsSlot* slots_ = nullptr;
+  std::size_t slot_count_ = 0;
+};
+
+// Maps an exporter's segment read-only from another process
+class StatsReader {
+ public:
+  explicit StatsReader(const std::string& name) {
+#if HSM_STATS_SHM
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return;
+    struct stat st {};
+    if (fstat(fd, &st) == 0 &&
+        static_cast<std::size_t>(st.st_size) >= sizeof(StatsHeader)) {
+      const auto size = static_cast<std::size_t>(st.st_size);
+      void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (base != MAP_FAILED) {
+        base_ = base;
+        size_ = size;
+      }
+    }
+    close(fd);
+    if (!base_) return;
+    const auto* header = static_cast<const StatsHeader*>(base_);
+    if (header->magic.load(std::memory_order_acquire) != STATS_MAGIC ||
+        header->version != STATS_VERSION ||
+        header->record_size != sizeof(StatsRecord) ||
+        stats_segment_size(header->slot_count) > size_) {
+      munmap(base_, size_);
+      base_ = nullptr;
+      return;
+    }
+    slots_ = reinterpret_cast<const StatsSlot*>(static_cast<const char*>(base_) +
+                                                sizeof(StatsHeader));
+    slot_count_ = header->slot_count;
+#else
+    (void)name;
+#endif
+  }
+
+  ~StatsReader() {
+#if HSM_STATS_SHM
+    if (base_) munmap(base_, size_);
+#endif
+  }
+
+  StatsReader(const StatsReader&) = delete;
+  StatsReader& operator=(const StatsReader&) = delete;
+
+  explicit operator bool() const { return base_ != nullptr; }
+  std::size_t slot_count() const { return slot_count_; }
+
+  bool read(std::size_t slot, StatsRecord& record) const {
+    return slot < slot_count_ && slots_[slot].read(record);
+  }
+
+  // Records of all published instances, in slot order
+  std::vector<StatsRecord> snapshot() const {
+    std::vector<StatsRecord> records;
+    StatsRecord record;
+    for (std::size_t i = 0; i < slot_count_; ++i) {
+      if (slots_[i].read(record)) records.push_back(record);
+    }
+    return records;
+  }
+
+ private:
+  void* base_ = nullptr;
+  std::size_t size_ = 0;
+  const StatsSlot* slots_ = nullptr;
+  std::size_t slot_count_ = 0;
+};
+
+// An instance's exporter slot and the record it publishes into it. Gives
+// the slot back when detached.
+class StatsExporterHook final : public StatsHook {
+ public:
+  StatsExporterHook(StatsExporter& exporter, StatsSlot& slot,
+                    std::string_view model, std::string_view instance)
+      : exporter_(exporter), slot_(slot) {
+    if (!model.empty() && model.front() == '/') model.remove_prefix(1);
+    copy_stats_name(record_.model, sizeof(record_.model), model);
+    copy_stats_name(record_.instance, sizeof(record_.instance), instance);
+  }
+
+  StatsExporterHook(const StatsExporterHook&) = delete;
+  StatsExporterHook& operator=(const StatsExporterHook&) = delete;
+
+  ~StatsExporterHook() override { exporter_.release(&slot_); }
+
+  void publish(const MachineStats& stats) override {
+    copy_stats_name(record_.state, sizeof(record_.state), stats.state);
+    record_.state_id = stats.state_id;
+    record_.queue_depth = stats.queue_depth;
+    record_.activities = stats.activities;
+    record_.timers = stats.timers;
+    record_.dispatched = stats.dispatched;
+    record_.deferred = stats.deferred;
+    record_.unhandled = stats.unhandled;
+    record_.updated_ns = Metrics::now_ns();
+    slot_.publish(record_);
+  }
+
+ private:
+  StatsExporter& exporter_;
+  StatsSlot& slot_;
+  StatsRecord record_{};
+};
+
+// Gives a started machine a slot of the exporter to publish its stats
+// under the given name, or gives its slot back (nullptr); stop() gives it
+// back too. False if the exporter has no free slot.
+inline bool attach_stats(Instance& instance, StatsExporter* exporter,
+                         std::string_view name = "") {
+  auto* hsm = instance.__hsm;
+  if (!hsm) return false;
+  hsm->set_stats(nullptr);
+  if (!exporter) return true;
+  auto* slot = exporter->claim();
+  if (!slot) return false;
+  hsm->set_stats(std::make_unique<StatsExporterHook>(
+      *exporter, *slot, hsm->model_.qualified_name(), name));
+  return true;
+}
+
+}  // namespace hsm
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+// Statically defined tracepoints (USDT) for perf, bpftrace and SystemTap.
+// Build with HSM_USDT=1 to place them; otherwise HSM_PROBEn expands to
+// nothing and its arguments are not evaluated. A placed probe is a single
+// nop plus an ELF note (.note.stapsdt) naming it, its provider and where
+// its arguments live, until a tracer attaches to it:
+//
+//   bpftrace -e 'usdt:./app:hsm:transition_start { @[arg1] = count(); }'
+//   perf probe -x ./app sdt_hsm:enter
+//
+// <sys/sdt.h> is used when it is available. Without it, GCC and Clang
+// emit the same note themselves on x86-64 and AArch64 ELF targets; other
+// targets get no probes. Every argument is passed as a 64-bit integer.
+//
+// Each probe has a semaphore, <provider>_<name>_semaphore in .probes, whose
+// address is recorded in its note. Tracers increment it while attached, and
+// a probe only evaluates its arguments while it is nonzero, so an untraced
+// probe costs a load and a branch. HSM_USDT_SEMAPHORE declares the semaphore
+// of a new probe; HSM_PROBE_ENABLED(provider, name) tests it.
+#ifndef HSM_USDT
+#define HSM_USDT 0
+#endif
+
+namespace hsm::usdt {
+
+template <typename T>
+constexpr std::uint64_t arg(T value) noexcept {
+  if constexpr (std::is_pointer_v<T>) {
+    return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(value));
+  } else if constexpr (std::is_enum_v<T>) {
+    return static_cast<std::uint64_t>(static_cast<std::underlying_type_t<T>>(value));
+  } else {
+    return static_cast<std::uint64_t>(value);
+  }
+}
+
+}  // namespace hsm::usdt
+
+#if HSM_USDT && __has_include(<sys/sdt.h>)
+
+#ifndef _SDT_HAS_SEMAPHORES
+#define _SDT_HAS_SEMAPHORES 1
+#endif
+#include <sys/sdt.h>
+
+#define HSM_USDT_PLACED 1
+#define HSM_USDT_STAP1(p, n, a1) STAP_PROBE1(p, n, a1)
+#define HSM_USDT_STAP2(p, n, a1, a2) STAP_PROBE2(p, n, a1, a2)
+#define HSM_USDT_STAP3(p, n, a1, a2, a3) STAP_PROBE3(p, n, a1, a2, a3)
+
+#elif HSM_USDT && (defined(__GNUC__) || defined(__clang__)) && defined(__ELF__) && \
+    (defined(__x86_64__) || defined(__aarch64__))
+
+#define HSM_USDT_PLACED 1
+
+#if defined(__x86_64__)
+#define HSM_USDT_CONSTRAINT "nor"
+#else
+#define HSM_USDT_CONSTRAINT "r"
+#endif
+
+// The note layout of <sys/sdt.h> (version 3): the probe address, the
+// address of _.stapsdt.base for prelink adjustment, the semaphore, then
+// the provider, probe name and argument specs as strings.
+#define HSM_USDT_NOTE(provider, name, args)                                \
+  "990: nop\n"                                                             \
+  ".pushsection .note.stapsdt,\"?\",\"note\"\n"                            \
+  ".balign 4\n"                                                            \
+  ".4byte 992f-991f, 994f-993f, 3\n"                                       \
+  "991: .asciz \"stapsdt\"\n"                                              \
+  "992: .balign 4\n"                                                       \
+  "993: .8byte 990b\n"                                                     \
+  ".8byte _.stapsdt.base\n"                                                \
+  ".8byte " #provider "_" #name "_semaphore\n"                            \
+  ".asciz \"" #provider "\"\n"                                             \
+  ".asciz \"" #name "\"\n"                                                 \
+  ".asciz \"" args "\"\n"                                                  \
+  "994: .balign 4\n"                                                       \
+  ".popsection\n"                                                          \
+  ".ifndef _.stapsdt.base\n"                                               \
+  ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+  ".weak _.stapsdt.base\n"                                                 \
+  ".hidden _.stapsdt.base\n"                                               \
+  "_.stapsdt.base: .space 1\n"                                             \
+  ".size _.stapsdt.base, 1\n"                                              \
+  ".popsection\n"                                                          \
+  ".endif\n"
+
+#define HSM_USDT_STAP1(p, n, x1)                                  \
+  __asm__ __volatile__(HSM_USDT_NOTE(p, n, "8@%[a1]")             \
+                       : : [a1] HSM_USDT_CONSTRAINT(x1))
+#define HSM_USDT_STAP2(p, n, x1, x2)                              \
+  __asm__ __volatile__(HSM_USDT_NOTE(p, n, "8@%[a1] 8@%[a2]")     \
+                       : : [a1] HSM_USDT_CONSTRAINT(x1),          \
+                         [a2] HSM_USDT_CONSTRAINT(x2))
+#define HSM_USDT_STAP3(p, n, x1, x2, x3)                              \
+  __asm__ __volatile__(HSM_USDT_NOTE(p, n, "8@%[a1] 8@%[a2] 8@%[a3]") \
+                       : : [a1] HSM_USDT_CONSTRAINT(x1),              \
+                         [a2] HSM_USDT_CONSTRAINT(x2),                \
+                         [a3] HSM_USDT_CONSTRAINT(x3))
+
+#else
+
+#define HSM_USDT_PLACED 0
+
+#endif
+
+#if HSM_USDT_PLACED
+
+// A weak hidden definition, so every translation unit of a binary shares
+// one semaphore per probe
+#define HSM_USDT_SEMAPHORE(provider, name)                                   \
+  extern "C" {                                                               \
+  __attribute__((weak, visibility("hidden"), section(".probes"))) volatile   \
+      unsigned short provider##_##name##_semaphore;                          \
+  }
+
+#define HSM_PROBE_ENABLED(provider, name)                                    \
+  (__builtin_expect(provider##_##name##_semaphore != 0, 0))
+
+// Probes may sit in constexpr functions; they only fire at run time
+#define HSM_PROBE1(provider, name, a1)                                       \
+  do {                                                                       \
+    if (!std::is_constant_evaluated() &&                                     \
+        HSM_PROBE_ENABLED(provider, name)) {                                 \
+      const std::uint64_t hsm_usdt_a1 = ::hsm::usdt::arg(a1);                \
+      HSM_USDT_STAP1(provider, name, hsm_usdt_a1);                           \
+    }                                                                        \
+  } while (0)
+#define HSM_PROBE2(provider, name, a1, a2)                                   \
+  do {                                                                       \
+    if (!std::is_constant_evaluated() &&                                     \
+        HSM_PROBE_ENABLED(provider, name)) {                                 \
+      const std::uint64_t hsm_usdt_a1 = ::hsm::usdt::arg(a1);                \
+      const std::uint64_t hsm_usdt_a2 = ::hsm::usdt::arg(a2);                \
+      HSM_USDT_STAP2(provider, name, hsm_usdt_a1, hsm_usdt_a2);              \
+    }                                                                        \
+  } while (0)
+#define HSM_PROBE3(provider, name, a1, a2, a3)                               \
+  do {                                                                       \
+    if (!std::is_constant_evaluated() &&                                     \
+        HSM_PROBE_ENABLED(provider, name)) {                                 \
+      const std::uint64_t hsm_usdt_a1 = ::hsm::usdt::arg(a1);                \
+      const std::uint64_t hsm_usdt_a2 = ::hsm::usdt::arg(a2);                \
+      const std::uint64_t hsm_usdt_a3 = ::hsm::usdt::arg(a3);                \
+      HSM_USDT_STAP3(provider, name, hsm_usdt_a1, hsm_usdt_a2,               \
+                     hsm_usdt_a3);                                           \
+    }                                                                        \
+  } while (0)
+
+#else
+
+#define HSM_USDT_SEMAPHORE(provider, name)
+#define HSM_PROBE_ENABLED(provider, name) false
+#define HSM_PROBE1(provider, name, a1) ((void)sizeof(a1))
+#define HSM_PROBE2(provider, name, a1, a2) ((void)sizeof(a1), (void)sizeof(a2))
+#define HSM_PROBE3(provider, name, a1, a2, a3) \
+  ((void)sizeof(a1), (void)sizeof(a2), (void)sizeof(a3))
+
+#endif
+
+HSM_USDT_SEMAPHORE(hsm, enqueue)
+HSM_USDT_SEMAPHORE(hsm, dequeue)
+HSM_USDT_SEMAPHORE(hsm, guard)
+HSM_USDT_SEMAPHORE(hsm, transition_start)
+HSM_USDT_SEMAPHORE(hsm, transition_end)
+HSM_USDT_SEMAPHORE(hsm, enter)
+HSM_USDT_SEMAPHORE(hsm, exit)
+HSM_USDT_SEMAPHORE(hsm, defer)
+HSM_USDT_SEMAPHORE(hsm, timer_arm)
+HSM_USDT_SEMAPHORE(hsm, timer_fire)
+HSM_USDT_SEMAPHORE(hsm, activity_start)
+HSM_USDT_SEMAPHORE(hsm, activity_stop)
+
+HSM_USDT_SEMAPHORE(cthsm, dispatch)
+HSM_USDT_SEMAPHORE(cthsm, complete)
+HSM_USDT_SEMAPHORE(cthsm, defer)
+HSM_USDT_SEMAPHORE(cthsm, dequeue)
+HSM_USDT_SEMAPHORE(cthsm, guard)
+HSM_USDT_SEMAPHORE(cthsm, transition_start)
+HSM_USDT_SEMAPHORE(cthsm, transition_end)
+HSM_USDT_SEMAPHORE(cthsm, enter)
+HSM_USDT_SEMAPHORE(cthsm, exit)
+HSM_USDT_SEMAPHORE(cthsm, timer_arm)
+HSM_USDT_SEMAPHORE(cthsm, timer_fire)
+HSM_USDT_SEMAPHORE(cthsm, activity_start)
+HSM_USDT_SEMAPHORE(cthsm, activity_stop)
+
+namespace hsm::usdt {
+
+inline constexpr bool enabled = HSM_USDT_PLACED != 0;
+
+}  // namespace hsm::usdt
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "hsm.hpp"
+#include "instrumentation/watchdog.hpp"
+
+namespace hsm {
+
+using instrumentation::StepOverrun;
+using instrumentation::WatchNames;
+using instrumentation::WatchSlot;
+using instrumentation::Watchdog;
+
+// Run-to-completion budget of an hsm model: `step` for every state, unless
+// the state or its nearest ancestor is listed in `states` (by qualified
+// name). A budget of 0 is never overrun.
+//
+//   hsm::StepBudget{std::chrono::milliseconds(2),
+//                   {{"/Pump/running", std::chrono::milliseconds(20)}}}
+struct StepBudget {
+  std::chrono::nanoseconds step{0};
+  std::vector<std::pair<std::string, std::chrono::nanoseconds>> states;
+
+  std::chrono::nanoseconds of(std::string_view state) const {
+    std::size_t matched = 0;
+    std::chrono::nanoseconds budget = step;
+    for (const auto& [name, listed] : states) {
+      if (name.size() < matched || name.size() > state.size() ||
+          state.compare(0, name.size(), name) != 0) {
+        continue;
+      }
+      if (name.size() != state.size() && state[name.size()] != '/') continue;
+      matched = name.size();
+      budget = listed;
+    }
+    return budget;
+  }
+};
+
+// An instance's watchdog slot, and the budget of a step started in each
+// state (by trace id). Gives the slot back when detached.
+class WatchdogHook final : public StepHook {
+ public:
+  WatchdogHook(Watchdog& watchdog, WatchSlot& slot,
+               std::vector<std::uint64_t> budget_ns)
+      : watchdog_(watchdog), slot_(slot), budget_ns_(std::move(budget_ns)) {}
+
+  WatchdogHook(const WatchdogHook&) = delete;
+  WatchdogHook& operator=(const WatchdogHook&) = delete;
+
+  ~WatchdogHook() override { watchdog_.release(&slot_); }
+
+  void begin(std::uint32_t state_id, std::uint32_t event_id) override {
+    slot_.begin(state_id, event_id, budget_ns_[state_id]);
+  }
+
+  void running(std::uint32_t behavior_id) override { slot_.running(behavior_id); }
+
+  void finish() override { watchdog_.finish(slot_); }
+
+ private:
+  Watchdog& watchdog_;
+  WatchSlot& slot_;
+  std::vector<std::uint64_t> budget_ns_;
+};
+
+// Has the watchdog check every run-to-completion step of a started machine
+// against the budget of the state it starts in, reporting overruns under
+// the given name; nullptr detaches, and stop() detaches too. False if the
+// watchdog has no free slot.
+inline bool attach_watchdog(Instance& instance, Watchdog* watchdog,
+                            const StepBudget& budget = {},
+                            std::string_view name = "") {
+  auto* hsm = instance.__hsm;
+  if (!hsm) return false;
+  hsm->set_step_hook(nullptr);
+  if (!watchdog) return true;
+  const std::span<const std::string> names(hsm->model_.trace_names);
+  auto* slot = watchdog->claim(name, {names, names, names});
+  if (!slot) return false;
+  std::vector<std::uint64_t> budget_ns(names.size(), 0);
+  for (std::size_t id = 1; id < names.size(); ++id) {
+    const auto ns = budget.of(names[id]).count();
+    budget_ns[id] = ns > 0 ? static_cast<std::uint64_t>(ns) : 0;
+  }
+  hsm->set_step_hook(std::make_unique<WatchdogHook>(*watchdog, *slot, std::move(budget_ns)));
+  return true;
+}
+
+}  // namespace hsm
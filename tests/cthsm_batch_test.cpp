@@ -0,0 +1,143 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cthsm/batch.hpp"
+#include "cthsm/thread_pool.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+struct Entity : Instance {
+  int id{0};
+  int level{0};
+  std::string trace;
+};
+
+constexpr auto model = define(
+    "m", initial(target("idle")),
+    state("idle", entry([](Entity& i) { i.trace += "+idle"; }),
+          exit([](Entity& i) { i.trace += "-idle"; }),
+          transition(on("go"), target("/m/active"), effect([](Entity& i) { i.trace += "!go"; })),
+          transition(on("park"), target("/m/parked"))),
+    // No behaviors on the way in or out: stepped by the gather fast path
+    state("parked", transition(on("park"), target("/m/spare")),
+          transition(on("back"), target("/m/idle"))),
+    state("spare", transition(on("park"), target("/m/parked"))),
+    state("active", entry([](Entity& i) { i.trace += "+active"; }),
+          exit([](Entity& i) { i.trace += "-active"; }), initial(target("low")),
+          state("low", exit([](Entity& i) { i.trace += "-low"; }),
+                transition(on("bump"), guard([](Entity& i) { return i.id % 2 == 0; }),
+                           target("/m/active/high")),
+                transition(on("bump"), effect([](Entity& i) { ++i.level; }))),
+          state("high", entry([](Entity& i) { i.trace += "+high"; })),
+          // Inherited by low and high
+          transition(on("reset"), target("/m/idle")),
+          transition(on("decide"), target("/m/pick"))),
+    choice("pick", transition(guard([](Entity& i) { return i.level > 0; }), target("/m/done")),
+           transition(target("/m/idle"))),
+    final("done"));
+
+using machine = compile<model, Entity>;
+
+constexpr const char* script[] = {"go",   "bump", "bump",   "reset", "park",  "park",
+                                  "park", "back", "go",     "bump",  "decide", "go",
+                                  "bump", "nope", "decide", "park"};
+
+std::vector<Entity> make_entities(std::size_t n) {
+  std::vector<Entity> entities(n);
+  for (std::size_t k = 0; k < n; ++k) entities[k].id = static_cast<int>(k);
+  return entities;
+}
+
+}  // namespace
+
+TEST_CASE("Batch - matches individually compiled machines") {
+  constexpr std::size_t n = 64;
+  auto batched = make_entities(n);
+  auto single = make_entities(n);
+  std::vector<machine> machines(n);
+
+  batch<machine> b(n);
+  b.start(batched);
+  for (std::size_t k = 0; k < n; ++k) machines[k].start(single[k]);
+
+  for (const char* event : script) {
+    // Dispatch to a different subset each time so instances diverge
+    const std::size_t first = std::string(event).size() % 3;
+    b.dispatch(std::span<Entity>(batched).subspan(first), EventBase{event}, first);
+    for (std::size_t k = first; k < n; ++k) machines[k].dispatch(single[k], EventBase{event});
+
+    for (std::size_t k = 0; k < n; ++k) {
+      CHECK(b.state(k) == machines[k].state());
+      CHECK(batched[k].trace == single[k].trace);
+      CHECK(batched[k].level == single[k].level);
+    }
+  }
+}
+
+TEST_CASE("Batch - behavior-free steps only change the state") {
+  auto entities = make_entities(4);
+  batch<machine> b(4);
+  b.start(entities);
+  b.dispatch(std::span<Entity>(entities), EventBase{"park"});
+  CHECK(b.state(0) == "/m/parked");
+  CHECK(entities[0].trace == "+idle-idle");
+
+  b.dispatch(std::span<Entity>(entities), EventBase{"park"});
+  b.dispatch(std::span<Entity>(entities), EventBase{"park"});
+  CHECK(b.state(3) == "/m/parked");
+  CHECK(entities[3].trace == "+idle-idle");
+}
+
+TEST_CASE("Batch - completion and final states") {
+  auto entities = make_entities(2);
+  batch<machine> b(2);
+  b.start(entities);
+  b.dispatch(std::span<Entity>(entities), EventBase{"go"});
+  b.dispatch(std::span<Entity>(entities), EventBase{"bump"});  // 0 goes high, 1 levels up
+  b.dispatch(std::span<Entity>(entities), EventBase{"decide"});
+  CHECK(b.state(0) == "/m/idle");
+  CHECK(b.state(1) == "/m/done");
+}
+
+TEST_CASE("Batch - unstarted instances ignore events") {
+  auto entities = make_entities(3);
+  batch<machine> b(3);
+  b.start(std::span<Entity>(entities).first(2));
+  b.dispatch(std::span<Entity>(entities), EventBase{"go"});
+  CHECK(b.state(1) == "/m/active/low");
+  CHECK(b.state(2).empty());
+  CHECK(b.state_id(2) == batch<machine>::not_started);
+  CHECK(entities[2].trace.empty());
+}
+
+TEST_CASE("Batch - parallel dispatch matches sequential dispatch") {
+  constexpr std::size_t n = 1000;
+  auto sequential = make_entities(n);
+  auto parallel = make_entities(n);
+  batch<machine> a(n);
+  batch<machine> b(n);
+  a.start(sequential);
+  b.start(parallel);
+
+  ThreadPoolTaskProvider<3, 8> pool;
+  for (const char* event : script) {
+    a.dispatch(std::span<Entity>(sequential), EventBase{event});
+    b.dispatch_parallel(pool, std::span<Entity>(parallel), EventBase{event}, 4);
+  }
+  for (std::size_t k = 0; k < n; ++k) {
+    CHECK(a.state_id(k) == b.state_id(k));
+    CHECK(sequential[k].trace == parallel[k].trace);
+  }
+}
+
+TEST_CASE("Batch - states are stored compactly") {
+  static_assert(std::is_same_v<batch<machine>::state_type, std::uint8_t>);
+  batch<machine> b(10);
+  CHECK(b.states().size_bytes() == 10);
+}
@@ -254,3 +254,34 @@ TEST_CASE("Completion - Activity and Hierarchy Mixed") {
     // Now should complete
     CHECK(sm.state() == "/MixedMachine/finished");
 }
+
+TEST_CASE("Completion - Activity that returns inline") {
+  // With SequentialTaskProvider the activity has already returned when the
+  // state is entered, so the state completes right away
+  constexpr auto model = define(
+      "InlineMachine", initial(target("working")),
+      state("working", activity([](TestInstance& i) { ++i.counter; }), transition(target("done"))),
+      state("done"));
+
+  compile<model, TestInstance> sm;
+  TestInstance inst;
+  sm.start(inst);
+  CHECK(inst.counter == 1);
+  CHECK(sm.state() == "/InlineMachine/done");
+}
+
+TEST_CASE("Completion - Only states with completion transitions or final states complete") {
+  constexpr auto model =
+      define("FlagMachine", initial(target("a")),
+             state("a", transition(on("go"), target("b"))),
+             state("b", transition(target("c"))), final("c"));
+  using machine = compile<model>;
+  static_assert(machine::has_completion);
+  CHECK_FALSE(machine::completion_states[1]);  // a
+  CHECK(machine::completion_states[2]);        // b
+  CHECK(machine::completion_states[3]);        // c
+
+  constexpr auto plain = define("Plain", initial(target("a")),
+                                state("a", transition(on("go"), target("a"))));
+  static_assert(!compile<plain>::has_completion);
+}
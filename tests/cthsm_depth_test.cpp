@@ -141,3 +141,85 @@ TEST_CASE("Deep Hierarchy Auto-Drill") {
   // So state should be L20 again.
   CHECK(sm.state() == "/DrillMachine/L1/L2/L3/L4/L5/L6/L7/L8/L9/L10/L11/L12/L13/L14/L15/L16/L17/L18/L19/L20");
 }
+
+TEST_CASE("Deep Hierarchy History (>16 levels)") {
+    constexpr auto model = define(
+      "HistoryMachine",
+      initial(target("L1")),
+      state("L1", initial(target("L2")),
+        state("L2", initial(target("L3")),
+          state("L3", initial(target("L4")),
+            state("L4", initial(target("L5")),
+              state("L5", initial(target("L6")),
+                state("L6", initial(target("L7")),
+                  state("L7", initial(target("L8")),
+                    state("L8", initial(target("L9")),
+                      state("L9", initial(target("L10")),
+                        state("L10", initial(target("L11")),
+                          state("L11", initial(target("L12")),
+                            state("L12", initial(target("L13")),
+                              state("L13", initial(target("L14")),
+                                state("L14", initial(target("L15")),
+                                  state("L15", initial(target("L16")),
+                                    state("L16", initial(target("L17")),
+                                      state("L17", initial(target("L18")),
+                                        state("L18", initial(target("L19")),
+                                          state("L19", initial(target("L20")),
+                                            state("L20",
+                                                transition(on("SIDE"), target("/HistoryMachine/L1/L2/L3/L4/L5/L6/L7/L8/L9/L10/L11/L12/L13/L14/L15/L16/L17/L18/L19/L20b"))
+                                            ),
+                                            state("L20b")
+                                          )
+                                        )
+                                      )
+                                    )
+                                  )
+                                )
+                              )
+                            )
+                          )
+                        )
+                      )
+                    )
+                  )
+                )
+              )
+            )
+          )
+        ),
+        transition(on("OUT"), target("/HistoryMachine/Out"))
+      ),
+      state("Out",
+        transition(on("DEEP"), target(deep_history("/HistoryMachine/L1"))),
+        transition(on("SHALLOW"), target(shallow_history("/HistoryMachine/L1")))
+      )
+  );
+
+  using sm_type = compile<model>;
+
+  // Only L1 is targeted by a history pseudostate
+  static_assert(sm_type::history_composite_count == 1);
+  static_assert(sm_type::ancestry.depth[0] == 0);
+
+  constexpr std::string_view deep_leaf =
+      "/HistoryMachine/L1/L2/L3/L4/L5/L6/L7/L8/L9/L10/L11/L12/L13/L14/L15/L16/L17/L18/L19/L20b";
+
+  sm_type sm;
+  Instance inst;
+  sm.start(inst);
+  sm.dispatch(inst, cthsm::EventBase{"SIDE"});
+  CHECK(sm.state() == deep_leaf);
+
+  sm.dispatch(inst, cthsm::EventBase{"OUT"});
+  CHECK(sm.state() == "/HistoryMachine/Out");
+
+  // Deep history re-enters all 21 levels from the root's child down
+  sm.dispatch(inst, cthsm::EventBase{"DEEP"});
+  CHECK(sm.state() == deep_leaf);
+
+  // Shallow history re-enters L2 and follows its default initial chain
+  sm.dispatch(inst, cthsm::EventBase{"OUT"});
+  sm.dispatch(inst, cthsm::EventBase{"SHALLOW"});
+  CHECK(sm.state() ==
+        "/HistoryMachine/L1/L2/L3/L4/L5/L6/L7/L8/L9/L10/L11/L12/L13/L14/L15/L16/L17/L18/L19/L20");
+}
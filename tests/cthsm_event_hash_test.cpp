@@ -0,0 +1,95 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <array>
+#include <string_view>
+
+#include "cthsm/cthsm.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+constexpr std::size_t synthetic_count = 300;
+
+// "ev000" ... "ev299", stored back to back
+constexpr auto synthetic_names = [] {
+  std::array<char, synthetic_count * 5> buf{};
+  for (std::size_t i = 0; i < synthetic_count; ++i) {
+    buf[i * 5 + 0] = 'e';
+    buf[i * 5 + 1] = 'v';
+    buf[i * 5 + 2] = static_cast<char>('0' + (i / 100) % 10);
+    buf[i * 5 + 3] = static_cast<char>('0' + (i / 10) % 10);
+    buf[i * 5 + 4] = static_cast<char>('0' + i % 10);
+  }
+  return buf;
+}();
+
+constexpr std::string_view synthetic_name(std::size_t i) {
+  return {synthetic_names.data() + i * 5, 5};
+}
+
+constexpr auto synthetic_map = []() consteval {
+  std::array<detail::hashed_key, synthetic_count> keys{};
+  for (std::size_t i = 0; i < synthetic_count; ++i) {
+    keys[i] = {i, synthetic_name(i)};
+  }
+  return detail::build_perfect_hash<synthetic_count>(keys, synthetic_count);
+}();
+
+constexpr auto model = define(
+    "machine", initial(target("idle")),
+    state("idle", transition(on("start"), target("running")),
+          transition(on("configure"), target("idle"))),
+    state("running", transition(on("stop"), target("idle")),
+          transition(on("start"), target("running")),
+          defer("configure")));
+
+using sm_type = compile<model>;
+
+}  // namespace
+
+TEST_CASE("Event hash - synthetic keys map to their ids") {
+  REQUIRE_FALSE(synthetic_map.empty());
+  CHECK(synthetic_map.slot_count == synthetic_count);
+  for (std::size_t i = 0; i < synthetic_count; ++i) {
+    CHECK(synthetic_map.find(synthetic_name(i)) == i);
+  }
+  CHECK(synthetic_map.find("ev300") == detail::invalid_index);
+  CHECK(synthetic_map.find("") == detail::invalid_index);
+  CHECK(synthetic_map.find("ev0000") == detail::invalid_index);
+}
+
+TEST_CASE("Event hash - model event ids match the sorted event list") {
+  constexpr auto& tables = sm_type::tables;
+  REQUIRE_FALSE(tables.event_index.empty());
+
+  for (const auto& entry : tables.sorted_events) {
+    std::size_t id = tables.get_event_id(entry.name);
+    REQUIRE(id != detail::invalid_index);
+    // Duplicate names all resolve to the same canonical id
+    CHECK(sm_type::normalized_model.get_event_name(id) == entry.name);
+    auto first = std::lower_bound(
+        tables.sorted_events.begin(), tables.sorted_events.end(), entry.name,
+        [](const auto& e, std::string_view n) { return e.name < n; });
+    CHECK(id == first->id);
+  }
+  CHECK(tables.get_event_id("missing") == detail::invalid_index);
+
+  static_assert(sm_type::tables.get_event_id("stop") != detail::invalid_index);
+  static_assert(sm_type::tables.get_event_id("nope") == detail::invalid_index);
+}
+
+TEST_CASE("Event hash - string dispatch uses the hashed ids") {
+  sm_type sm;
+  Instance inst;
+  sm.start(inst);
+  CHECK(sm.state() == "/machine/idle");
+
+  sm.dispatch(inst, std::string_view{"start"});
+  CHECK(sm.state() == "/machine/running");
+  sm.dispatch(inst, std::string_view{"bogus"});
+  CHECK(sm.state() == "/machine/running");
+  sm.dispatch(inst, std::string_view{"stop"});
+  CHECK(sm.state() == "/machine/idle");
+}
@@ -0,0 +1,115 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+struct TraceInstance : Instance {
+  std::vector<std::string> trace;
+  bool allow = false;
+};
+
+constexpr auto model = define(
+    "machine", initial(target("idle")),
+    state("idle", entry([](TraceInstance& i) { i.trace.emplace_back("enter idle"); }), exit([](TraceInstance& i) { i.trace.emplace_back("exit idle"); }),
+          transition(on("start"), target("/machine/active/a"),
+                     effect([](TraceInstance& i) { i.trace.emplace_back("effect start"); })),
+          transition(on("tick"), effect([](TraceInstance& i) { i.trace.emplace_back("idle tick"); }))),
+    state("active", entry([](TraceInstance& i) { i.trace.emplace_back("enter active"); }), exit([](TraceInstance& i) { i.trace.emplace_back("exit active"); }),
+          initial(target("a")),
+          transition(on("stop"), target("/machine/idle")),
+          transition(on("resume"), target(deep_history("/machine/active"))),
+          transition(on<Any>(), effect([](TraceInstance& i) { i.trace.emplace_back("active any"); })),
+          state("a", entry([](TraceInstance& i) { i.trace.emplace_back("enter a"); }), exit([](TraceInstance& i) { i.trace.emplace_back("exit a"); }),
+                transition(on("next"),
+                           guard([](TraceInstance& i) { return i.allow; }),
+                           target("b"), effect([](TraceInstance& i) { i.trace.emplace_back("guarded next"); })),
+                transition(on("next"), effect([](TraceInstance& i) { i.trace.emplace_back("fallback next"); })),
+                transition(on("again"), target("a"),
+                           effect([](TraceInstance& i) { i.trace.emplace_back("self a"); }))),
+          state("b", entry([](TraceInstance& i) { i.trace.emplace_back("enter b"); }), exit([](TraceInstance& i) { i.trace.emplace_back("exit b"); }),
+                transition(on("next"), target("a")),
+                transition(on("out"), target("/machine/paused")))),
+    state("paused", entry([](TraceInstance& i) { i.trace.emplace_back("enter paused"); }),
+          transition(on("resume"), target(deep_history("/machine/active")))));
+
+using table_sm = compile<model, TraceInstance>;
+using inlined_sm = compile<model, TraceInstance, SequentialTaskProvider, Clock,
+                           Context, 16, table_layout::dense,
+                           dispatch_mode::inlined>;
+
+template <typename SM>
+std::vector<std::string> run(const std::vector<std::string_view>& events) {
+  SM sm;
+  TraceInstance inst;
+  sm.start(inst);
+  for (auto name : events) {
+    if (name == "!allow") {
+      inst.allow = true;
+      continue;
+    }
+    sm.dispatch(inst, name);
+    inst.trace.push_back(std::string("@") + std::string(sm.state()));
+  }
+  return inst.trace;
+}
+
+}  // namespace
+
+TEST_CASE("Inlined dispatch - handler table covers every state") {
+  CHECK(inlined_sm::inlined_dispatch_table.size() ==
+        decltype(inlined_sm::normalized_model)::state_count);
+  CHECK(table_sm::inlined_dispatch_table.empty());
+}
+
+TEST_CASE("Inlined dispatch - matches table dispatch") {
+  const std::vector<std::string_view> events = {
+      "tick",  "unknown", "start", "next",   "again", "!allow", "next",
+      "bogus", "out",     "resume", "next",  "stop",  "resume", "stop"};
+  auto expected = run<table_sm>(events);
+  auto actual = run<inlined_sm>(events);
+  CHECK(actual == expected);
+  CHECK(actual.back() == "@/machine/idle");
+}
+
+TEST_CASE("Inlined dispatch - guards, effects and paths") {
+  inlined_sm sm;
+  TraceInstance inst;
+  sm.start(inst);
+  CHECK(sm.state() == "/machine/idle");
+
+  inst.trace.clear();
+  sm.dispatch(inst, EventBase{"start"});
+  CHECK(inst.trace == std::vector<std::string>{"exit idle", "effect start",
+                                               "enter active", "enter a"});
+
+  inst.trace.clear();
+  sm.dispatch(inst, EventBase{"next"});
+  CHECK(sm.state() == "/machine/active/a");
+  CHECK(inst.trace == std::vector<std::string>{"fallback next"});
+
+  inst.allow = true;
+  inst.trace.clear();
+  sm.dispatch(inst, EventBase{"next"});
+  CHECK(sm.state() == "/machine/active/b");
+  CHECK(inst.trace ==
+        std::vector<std::string>{"exit a", "guarded next", "enter b"});
+
+  inst.trace.clear();
+  sm.dispatch(inst, EventBase{"whatever"});
+  CHECK(sm.state() == "/machine/active/b");
+  CHECK(inst.trace == std::vector<std::string>{"active any"});
+
+  // History targets fall back to the generic path
+  sm.dispatch(inst, EventBase{"out"});
+  CHECK(sm.state() == "/machine/paused");
+  sm.dispatch(inst, EventBase{"resume"});
+  CHECK(sm.state() == "/machine/active/b");
+}
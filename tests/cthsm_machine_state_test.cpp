@@ -0,0 +1,132 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+struct Counter : Instance {
+  int entries{0};
+  std::string log;
+};
+
+constexpr auto plain_model = define(
+    "plain", initial(target("off")),
+    state("off", entry([](Counter& c) { ++c.entries; }), transition(on("flip"), target("/plain/on"))),
+    state("on", transition(on("flip"), target("/plain/off"))));
+
+constexpr auto deferring_model = define(
+    "deferring", initial(target("busy")),
+    state("busy", defer("job"), transition(on("done"), target("/deferring/idle"))),
+    state("idle", transition(on("job"), target("/deferring/busy"),
+                             effect([](Counter& c) { c.log += "job;"; }))));
+
+constexpr auto history_model = define(
+    "history", initial(target("work")),
+    state("work", initial(target("a")),
+          state("a", transition(on("next"), target("/history/work/b"))),
+          state("b", state("b1", transition(on("next"), target("/history/work/b/b2"))),
+                state("b2"), initial(target("b1"))),
+          transition(on("pause"), target("/history/paused"))),
+    state("paused", transition(on("resume"), target(deep_history("/history/work")))));
+
+constexpr auto activity_model =
+    define("tasks", initial(target("run")), state("run", activity([](Counter&) {})));
+
+constexpr auto service_model = define(
+    "service", initial(target("wait")),
+    state("wait", transition(after([] { return std::chrono::milliseconds(5); }),
+                             target("/service/late"))),
+    state("late"));
+
+using plain = compile<plain_model, Counter>;
+using deferring = compile<deferring_model, Counter>;
+using history = compile<history_model, Counter>;
+using tasks = compile<activity_model, Counter>;
+using service = compile<service_model, Counter, SequentialTaskProvider, ManualClock, Context, 16,
+                        table_layout::dense, dispatch_mode::table, TimerService<>>;
+
+template <typename Machine>
+concept runs_bare = requires(typename Machine::machine_state& m, Counter& c) {
+  Machine::start(m, c);
+};
+
+}  // namespace
+
+TEST_CASE("Machine state - only the parts a model uses are stored") {
+  static_assert(sizeof(plain::machine_state) == 1);
+  static_assert(sizeof(plain) == 1);
+  static_assert(sizeof(deferring::machine_state) > sizeof(plain::machine_state));
+  static_assert(sizeof(history::machine_state) == 1 + history::history_composite_count);
+  CHECK(plain::deferral_capacity == 0);
+  CHECK(deferring::deferral_capacity == 16);
+}
+
+TEST_CASE("Machine state - bare states in a flat vector match compiled machines") {
+  constexpr std::size_t n = 100;
+  std::vector<plain::machine_state> states(n);
+  std::vector<Counter> bare(n);
+  std::vector<plain> machines(n);
+  std::vector<Counter> owned(n);
+
+  for (std::size_t k = 0; k < n; ++k) {
+    plain::start(states[k], bare[k]);
+    machines[k].start(owned[k]);
+  }
+  for (std::size_t k = 0; k < n; k += 3) {
+    plain::dispatch(states[k], bare[k], EventBase{"flip"});
+    machines[k].dispatch(owned[k], EventBase{"flip"});
+  }
+  for (std::size_t k = 0; k < n; ++k) {
+    CHECK(plain::state(states[k]) == machines[k].state());
+    CHECK(bare[k].entries == owned[k].entries);
+  }
+  CHECK(plain::state(states[0]) == "/plain/on");
+  CHECK(plain::is_active(states[1], "/plain/off"));
+}
+
+TEST_CASE("Machine state - deferral through a bare state") {
+  deferring::machine_state m;
+  Counter c;
+  deferring::start(m, c);
+  deferring::dispatch(m, c, EventBase{"job"});
+  CHECK(deferring::state(m) == "/deferring/busy");
+  CHECK(c.log.empty());
+  deferring::dispatch(m, c, EventBase{"done"});
+  CHECK(deferring::state(m) == "/deferring/busy");
+  CHECK(c.log == "job;");
+}
+
+TEST_CASE("Machine state - history through a bare state") {
+  history::machine_state m;
+  Counter c;
+  history::start(m, c);
+  CHECK(history::state(m) == "/history/work/a");
+  history::dispatch(m, c, EventBase{"next"});
+  history::dispatch(m, c, EventBase{"next"});
+  CHECK(history::state(m) == "/history/work/b/b2");
+  history::dispatch(m, c, EventBase{"pause"});
+  history::dispatch(m, c, EventBase{"resume"});
+  CHECK(history::state(m) == "/history/work/b/b2");
+}
+
+TEST_CASE("Machine state - models with tasks need an owning machine") {
+  static_assert(tasks::needs_task_provider);
+  static_assert(!runs_bare<tasks>);
+  static_assert(runs_bare<plain>);
+  static_assert(!service::needs_task_provider);
+
+  ManualClock::reset();
+  service::machine_state m;
+  Counter c;
+  service::start(m, c);
+  ManualClock::advance(std::chrono::milliseconds(5));
+  CHECK(service::poll_timers(m, c) == 1);
+  CHECK(service::state(m) == "/service/late");
+}
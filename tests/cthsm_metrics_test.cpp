@@ -0,0 +1,106 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+
+#include "cthsm/metrics.hpp"
+
+using namespace cthsm;
+using namespace std::chrono_literals;
+
+namespace {
+
+struct Door : Instance {};
+
+constexpr auto model = define(
+    "door", initial(target("closed")),
+    state("closed", transition(on("open"), target("/door/opened"),
+                               effect([](Door&) { ManualClock::advance(100ns); }))),
+    state("opened", defer("lock"), transition(on("close"), target("/door/closed"))));
+
+inline metrics<model> door_metrics;
+
+using machine = compile<model, Door, SequentialTaskProvider, ManualClock, Context, 16,
+                        table_layout::dense, dispatch_mode::table, TaskTimers<>,
+                        MetricsObserver<door_metrics>>;
+
+std::size_t state_id(std::string_view name) {
+  for (std::size_t s = 0; s < metrics<model>::state_count; ++s) {
+    if (machine::normalized_model.get_state_name(s) == name) return s;
+  }
+  return detail::invalid_index;
+}
+
+std::size_t transition_id(std::string_view source) {
+  for (std::size_t t = 0; t < metrics<model>::transition_count; ++t) {
+    const auto& tr = machine::normalized_model.transitions[t];
+    if (tr.source_id < metrics<model>::state_count &&
+        machine::normalized_model.get_state_name(tr.source_id) == source &&
+        tr.event_id != detail::invalid_index) {
+      return t;
+    }
+  }
+  return detail::invalid_index;
+}
+
+}  // namespace
+
+TEST_CASE("Metrics - latency histogram buckets and quantiles") {
+  static_assert(latency_histogram::bucket_of(0) == 0);
+  static_assert(latency_histogram::bucket_of(1) == 1);
+  static_assert(latency_histogram::bucket_of(100) == 7);
+  static_assert(latency_histogram::bucket_of(~std::uint64_t{0}) ==
+                latency_histogram::bucket_count - 1);
+
+  latency_histogram h{};
+  CHECK(h.quantile_ns(0.5) == 0);
+  h.buckets[latency_histogram::bucket_of(100)] = 99;
+  h.buckets[latency_histogram::bucket_of(5000)] = 1;
+  CHECK(h.count() == 100);
+  CHECK(h.quantile_ns(0.5) == 128);
+  CHECK(h.quantile_ns(0.99) == 128);
+  CHECK(h.quantile_ns(1.0) == 8192);
+}
+
+TEST_CASE("Metrics - counters, dwell and run-to-completion times") {
+  static_assert(machine::times_steps && machine::times_dwell);
+
+  ManualClock::reset();
+  machine m;
+  Door d;
+  m.start(d);
+  ManualClock::advance(1000ns);
+  m.dispatch(d, EventBase{"open"});   // Effect takes 100 ns
+  m.dispatch(d, EventBase{"lock"});   // Deferred
+  m.dispatch(d, EventBase{"knock"});  // Unknown
+  ManualClock::advance(50ns);
+  m.dispatch(d, EventBase{"close"});  // Replays "lock", unhandled in closed
+  CHECK(m.state() == "/door/closed");
+
+  const auto snap = door_metrics.snapshot();
+  CHECK(snap.entries[state_id("/door")] == 1);
+  CHECK(snap.entries[state_id("/door/closed")] == 2);
+  CHECK(snap.entries[state_id("/door/opened")] == 1);
+  CHECK(snap.transitions[transition_id("/door/closed")] == 1);
+  CHECK(snap.transitions[transition_id("/door/opened")] == 1);
+
+  // Completed visits only: closed is active again
+  CHECK(snap.dwell[state_id("/door/closed")] == 1000ns);
+  CHECK(snap.dwell[state_id("/door/opened")] == 50ns);
+  CHECK(snap.dwell[state_id("/door")] == 0ns);
+
+  CHECK(snap.dispatched == 5);
+  CHECK(snap.deferred == 1);
+  CHECK(snap.unhandled == 2);
+  CHECK(snap.run_to_completion.count() == 5);
+  CHECK(snap.run_to_completion.buckets[0] == 4);
+  CHECK(snap.run_to_completion.buckets[latency_histogram::bucket_of(100)] == 1);
+}
+
+TEST_CASE("Metrics - machines without timing hooks keep no entry times") {
+  using plain = compile<model, Door>;
+  static_assert(!plain::times_steps && !plain::times_dwell);
+  static_assert(sizeof(plain::machine_state) < sizeof(machine::machine_state));
+}
@@ -0,0 +1,157 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+struct Light : Instance {
+  bool allowed{false};
+};
+
+struct Step {
+  char kind;
+  std::size_t a;
+  std::size_t b;
+};
+
+// Logs every hook; Tag keeps one log per machine type
+template <int Tag>
+struct Log : NoObserver {
+  static inline std::vector<Step> steps;
+  static void on_dispatch(std::size_t s, std::size_t e) { steps.push_back({'D', s, e}); }
+  static void on_defer(std::size_t s, std::size_t e) { steps.push_back({'F', s, e}); }
+  static void on_unhandled(std::size_t s, std::size_t e) { steps.push_back({'U', s, e}); }
+  static void on_guard_rejected(std::size_t t) { steps.push_back({'G', t, 0}); }
+  static void on_transition(std::size_t t) { steps.push_back({'T', t, 0}); }
+  static void on_exit(std::size_t s) { steps.push_back({'X', s, 0}); }
+  static void on_enter(std::size_t s) { steps.push_back({'N', s, 0}); }
+};
+
+// Only counts transitions; the other hooks stay NoObserver's
+struct Transitions : NoObserver {
+  static inline int count = 0;
+  static void on_transition(std::size_t) { ++count; }
+};
+
+constexpr auto model = define(
+    "lamp", initial(target("off")),
+    state("off", defer("later"),
+          transition(on("flip"), target("/lamp/on"),
+                     guard([](Light& l) { return l.allowed; })),
+          transition(on("flip"), target("/lamp/on/dim"))),
+    state("on", initial(target("bright")), state("bright"), state("dim"),
+          transition(on("flip"), target("/lamp/off"))));
+
+template <typename Machine>
+std::vector<std::string> describe(const std::vector<Step>& steps) {
+  constexpr auto& m = Machine::normalized_model;
+  const auto state = [&](std::size_t s) { return std::string(m.get_state_name(s)); };
+  const auto transition = [&](std::size_t t) {
+    return state(m.transitions[t].source_id) + "->" + state(m.transitions[t].target_id);
+  };
+  const auto event = [&](std::size_t e) {
+    return e == detail::invalid_index ? std::string("?") : std::string(m.get_event_name(e));
+  };
+  std::vector<std::string> out;
+  for (const auto& s : steps) {
+    switch (s.kind) {
+      case 'D': out.push_back("dispatch " + event(s.b) + " in " + state(s.a)); break;
+      case 'F': out.push_back("defer " + event(s.b) + " in " + state(s.a)); break;
+      case 'U': out.push_back("unhandled " + event(s.b) + " in " + state(s.a)); break;
+      case 'G': out.push_back("rejected " + transition(s.a)); break;
+      case 'T': out.push_back("transition " + transition(s.a)); break;
+      case 'X': out.push_back("exit " + state(s.a)); break;
+      case 'N': out.push_back("enter " + state(s.a)); break;
+      default: break;
+    }
+  }
+  return out;
+}
+
+const std::vector<std::string> expected = {
+    "enter /lamp",
+    "enter /lamp/off",
+    "dispatch later in /lamp/off",
+    "defer later in /lamp/off",
+    "dispatch flip in /lamp/off",
+    "rejected /lamp/off->/lamp/on",
+    "transition /lamp/off->/lamp/on/dim",
+    "exit /lamp/off",
+    "enter /lamp/on",
+    "enter /lamp/on/dim",
+    // The deferred event is dispatched again once off is left
+    "dispatch later in /lamp/on/dim",
+    "unhandled later in /lamp/on/dim",
+    "dispatch flip in /lamp/on/dim",
+    "transition /lamp/on->/lamp/off",
+    "exit /lamp/on/dim",
+    "exit /lamp/on",
+    "enter /lamp/off",
+    // "nothing" is not an event of the model
+    "dispatch ? in /lamp/off",
+    "unhandled ? in /lamp/off",
+};
+
+template <typename Machine>
+std::vector<std::string> run_lamp() {
+  Machine::observer_type::steps.clear();
+  Machine m;
+  Light l;
+  m.start(l);
+  m.dispatch(l, EventBase{"later"});
+  m.dispatch(l, EventBase{"flip"});
+  m.dispatch(l, EventBase{"flip"});
+  m.dispatch(l, EventBase{"nothing"});
+  return describe<Machine>(Machine::observer_type::steps);
+}
+
+}  // namespace
+
+TEST_CASE("Observer - the default observer plans no observe actions") {
+  using plain = compile<model, Light>;
+  using observed = compile<model, Light, SequentialTaskProvider, Clock, Context, 16,
+                           table_layout::dense, dispatch_mode::table, TaskTimers<>, Log<0>>;
+  static_assert(!plain::observed);
+  static_assert(observed::observed);
+  static_assert(sizeof(plain) == sizeof(observed));
+  // Builds with USDT probes plan the observe actions for every machine
+  if constexpr (!plain::probed) {
+    CHECK(plain::program_length < observed::program_length);
+    for (const auto& a : plain::programs.actions) {
+      CHECK(a.kind != detail::action_kind::observe_exit);
+      CHECK(a.kind != detail::action_kind::observe_enter);
+    }
+  }
+}
+
+TEST_CASE("Observer - hooks follow a run-to-completion step") {
+  using machine = compile<model, Light, SequentialTaskProvider, Clock, Context, 16,
+                          table_layout::dense, dispatch_mode::table, TaskTimers<>, Log<1>>;
+  CHECK(run_lamp<machine>() == expected);
+}
+
+TEST_CASE("Observer - inlined dispatch reports the same steps") {
+  using machine = compile<model, Light, SequentialTaskProvider, Clock, Context, 16,
+                          table_layout::dense, dispatch_mode::inlined, TaskTimers<>, Log<2>>;
+  CHECK(run_lamp<machine>() == expected);
+}
+
+TEST_CASE("Observer - an observer may hide only some hooks") {
+  using machine = compile<model, Light, SequentialTaskProvider, Clock, Context, 16,
+                          table_layout::dense, dispatch_mode::table, TaskTimers<>, Transitions>;
+  machine m;
+  Light l;
+  l.allowed = true;
+  m.start(l);
+  m.dispatch(l, EventBase{"flip"});
+  m.dispatch(l, EventBase{"flip"});
+  CHECK(m.state() == "/lamp/off");
+  CHECK(Transitions::count == 2);
+}
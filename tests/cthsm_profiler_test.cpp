@@ -0,0 +1,116 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cthsm/profiler.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+struct Pump : Instance {
+  bool primed{true};
+};
+
+void burn(std::uint64_t ns) {
+  const std::uint64_t start = cthsm::cost_clock::thread_cpu_ns();
+  while (cthsm::cost_clock::thread_cpu_ns() - start < ns) {
+  }
+}
+
+constexpr auto model = define(
+    "pump", initial(target("idle")),
+    state("idle", transition(on("start"), target("/pump/running"),
+                             guard([](Pump& p) { return p.primed; }),
+                             effect([](Pump&) { burn(200000); }))),
+    state("running", entry([](Pump&) { burn(2000000); }), exit([](Pump&) {}),
+          activity([](Pump&) { burn(300000); }),
+          transition(on("stop"), target("/pump/idle"))));
+
+inline profiler<model> table_profiler;
+inline profiler<model> inlined_profiler;
+
+template <auto& Profiler, dispatch_mode Mode>
+using machine = compile<model, Pump, SequentialTaskProvider, Clock, Context, 16,
+                        table_layout::dense, Mode, TaskTimers<>, ProfilerObserver<Profiler>>;
+
+template <typename Machine>
+void run() {
+  Machine m;
+  Pump p;
+  m.start(p);
+  m.dispatch(p, EventBase{"start"});
+  m.dispatch(p, EventBase{"stop"});
+  p.primed = false;
+  m.dispatch(p, EventBase{"start"});  // Guard rejects
+  CHECK(m.state() == "/pump/idle");
+}
+
+std::uint64_t calls_of(const std::vector<cthsm::behavior_profile>& profiles,
+                       const std::vector<std::string>& names, const std::string& name) {
+  for (const auto& p : profiles) {
+    if (names[p.id] == name) return p.calls;
+  }
+  return 0;
+}
+
+}  // namespace
+
+TEST_CASE("Profiler - behaviors are named by model path") {
+  using p = profiler<model>;
+  static_assert(p::behavior_count == 5);
+  static_assert(p::behavior_id(behavior_kind::guard, 0) == 3);
+  static_assert(p::behavior_id(behavior_kind::entry, 1) == p::behavior_count);
+
+  const auto names = p::names();
+  REQUIRE(names.size() == 5);
+  CHECK(names[p::behavior_id(behavior_kind::entry, 0)] == "/pump/running/entry_0");
+  CHECK(names[p::behavior_id(behavior_kind::exit, 0)] == "/pump/running/exit_0");
+  CHECK(names[p::behavior_id(behavior_kind::activity, 0)] == "/pump/running/activity_0");
+  CHECK(names[p::behavior_id(behavior_kind::effect, 0)] == "/pump/idle/start/effect_0");
+  CHECK(names[p::behavior_id(behavior_kind::guard, 0)] == "/pump/idle/start/guard");
+}
+
+TEST_CASE("Profiler - table and inlined dispatch time every behavior") {
+  static_assert(machine<table_profiler, dispatch_mode::table>::profiles_behaviors);
+  static_assert(!compile<model, Pump>::profiles_behaviors);
+
+  run<machine<table_profiler, dispatch_mode::table>>();
+  run<machine<inlined_profiler, dispatch_mode::inlined>>();
+
+  const auto names = profiler<model>::names();
+  for (const auto* prof : {&table_profiler, &inlined_profiler}) {
+    const auto profiles = prof->snapshot();
+    REQUIRE(profiles.size() == 5);
+    CHECK(names[profiles[0].id] == "/pump/running/entry_0");
+    CHECK(profiles[0].role == cthsm::behavior_role::Entry);
+    CHECK(profiles[0].cpu >= std::chrono::milliseconds(2));
+    CHECK(profiles[0].ticks > 0);
+    CHECK(calls_of(profiles, names, "/pump/idle/start/guard") == 2);
+    CHECK(calls_of(profiles, names, "/pump/idle/start/effect_0") == 1);
+    CHECK(calls_of(profiles, names, "/pump/running/exit_0") == 1);
+    CHECK(calls_of(profiles, names, "/pump/running/activity_0") == 1);
+    CHECK(std::is_sorted(profiles.begin(), profiles.end(),
+                         [](const auto& a, const auto& b) { return a.cpu > b.cpu; }));
+  }
+}
+
+TEST_CASE("Profiler - folded stacks use state paths as frames") {
+  const auto names = profiler<model>::names();
+  std::ostringstream folded;
+  cthsm::write_folded_stacks(folded, names, table_profiler.snapshot());
+  const std::string text = folded.str();
+  CHECK(text.rfind("pump;running;entry_0 ", 0) == 0);
+  CHECK(text.find("pump;idle;start;guard ") != std::string::npos);
+  CHECK(text.find("pump;running;activity_0 ") != std::string::npos);
+
+  std::ostringstream report;
+  cthsm::write_profile_report(report, names, table_profiler.snapshot());
+  CHECK(report.str().find("/pump/idle/start/effect_0") != std::string::npos);
+}
@@ -0,0 +1,193 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+struct TraceInstance : Instance {
+  std::vector<std::string> trace;
+};
+
+constexpr auto model = define(
+    "machine", initial(target("running")),
+    state("idle", entry([](TraceInstance& i) { i.trace.emplace_back("enter idle"); }),
+          transition(on("start"), target("/machine/running"))),
+    state("running",
+          entry([](TraceInstance& i) { i.trace.emplace_back("enter running"); }),
+          exit([](TraceInstance& i) { i.trace.emplace_back("exit running"); }),
+          transition(on("stop"), target("/machine/idle")),
+          transition(on("ping"), effect([](TraceInstance& i) { i.trace.emplace_back("ping"); })),
+          transition(target("/machine/done")),
+          region("audio",
+                 entry([](TraceInstance& i) { i.trace.emplace_back("enter audio"); }),
+                 exit([](TraceInstance& i) { i.trace.emplace_back("exit audio"); }),
+                 initial(target("muted")),
+                 state("muted",
+                       entry([](TraceInstance& i) { i.trace.emplace_back("enter muted"); }),
+                       exit([](TraceInstance& i) { i.trace.emplace_back("exit muted"); }),
+                       transition(on("toggle"), target("/machine/running/audio/playing"))),
+                 state("playing",
+                       entry([](TraceInstance& i) { i.trace.emplace_back("enter audio playing"); }),
+                       exit([](TraceInstance& i) { i.trace.emplace_back("exit audio playing"); }),
+                       transition(on("toggle"), target("/machine/running/audio/muted")),
+                       transition(on("end_audio"), target("/machine/running/audio/over"))),
+                 final("over")),
+          region("video",
+                 entry([](TraceInstance& i) { i.trace.emplace_back("enter video"); }),
+                 exit([](TraceInstance& i) { i.trace.emplace_back("exit video"); }),
+                 initial(target("paused")),
+                 state("paused",
+                       entry([](TraceInstance& i) { i.trace.emplace_back("enter paused"); }),
+                       exit([](TraceInstance& i) { i.trace.emplace_back("exit paused"); }),
+                       defer("seek"),
+                       transition(on("toggle"), target("/machine/running/video/playing"))),
+                 state("playing",
+                       entry([](TraceInstance& i) { i.trace.emplace_back("enter video playing"); }),
+                       exit([](TraceInstance& i) { i.trace.emplace_back("exit video playing"); }),
+                       transition(on("seek"),
+                                  effect([](TraceInstance& i) { i.trace.emplace_back("seek"); })),
+                       transition(on("end_video"), target("/machine/running/video/over"))),
+                 final("over"))),
+    state("done", entry([](TraceInstance& i) { i.trace.emplace_back("enter done"); })));
+
+using sm_type = compile<model, TraceInstance>;
+
+std::vector<std::string> active(const auto& sm) {
+  std::vector<std::string> out;
+  for (std::size_t i = 0; i < sm.active_state_count(); ++i) {
+    out.emplace_back(sm.active_state(i));
+  }
+  return out;
+}
+
+}  // namespace
+
+TEST_CASE("Regions - one leaf slot per region") {
+  static_assert(sm_type::has_regions);
+  CHECK(sm_type::leaf_slot_count == 2);
+
+  constexpr auto nested = define(
+      "machine", initial(target("a")),
+      state("a", region("r1", initial(target("x")), state("x")),
+            region("r2", initial(target("y")),
+                   state("y", region("p", initial(target("p1")), state("p1")),
+                         region("q", initial(target("q1")), state("q1"))))),
+      state("b"));
+  using nested_sm = compile<nested>;
+  CHECK(nested_sm::leaf_slot_count == 3);
+
+  nested_sm sm;
+  Instance inst;
+  sm.start(inst);
+  CHECK(active(sm) == std::vector<std::string>{"/machine/a/r1/x", "/machine/a/r2/y/p/p1",
+                                               "/machine/a/r2/y/q/q1"});
+
+  constexpr auto flat = define("machine", initial(target("a")), state("a"));
+  static_assert(!compile<flat>::has_regions);
+  CHECK(compile<flat>::leaf_slot_count == 1);
+}
+
+TEST_CASE("Regions - start enters every region") {
+  sm_type sm;
+  TraceInstance inst;
+  sm.start(inst);
+
+  CHECK(inst.trace == std::vector<std::string>{"enter running", "enter audio", "enter muted",
+                                               "enter video", "enter paused"});
+  CHECK(active(sm) == std::vector<std::string>{"/machine/running/audio/muted",
+                                               "/machine/running/video/paused"});
+  CHECK(sm.state() == "/machine/running/audio/muted");
+  CHECK(sm.is_active("/machine/running"));
+  CHECK(sm.is_active("/machine/running/video"));
+  CHECK_FALSE(sm.is_active("/machine/idle"));
+}
+
+TEST_CASE("Regions - one dispatch is evaluated in every region") {
+  sm_type sm;
+  TraceInstance inst;
+  sm.start(inst);
+  inst.trace.clear();
+
+  sm.dispatch(inst, EventBase{"toggle"});
+  CHECK(inst.trace == std::vector<std::string>{"exit muted", "enter audio playing",
+                                               "exit paused", "enter video playing"});
+  CHECK(active(sm) == std::vector<std::string>{"/machine/running/audio/playing",
+                                               "/machine/running/video/playing"});
+
+  // Only the audio region reacts
+  sm.dispatch(inst, EventBase{"toggle"});
+  CHECK(active(sm) == std::vector<std::string>{"/machine/running/audio/muted",
+                                               "/machine/running/video/playing"});
+}
+
+TEST_CASE("Regions - ancestor transitions fire once") {
+  sm_type sm;
+  TraceInstance inst;
+  sm.start(inst);
+  inst.trace.clear();
+
+  sm.dispatch(inst, EventBase{"ping"});
+  CHECK(inst.trace == std::vector<std::string>{"ping"});
+
+  inst.trace.clear();
+  sm.dispatch(inst, EventBase{"stop"});
+  CHECK(inst.trace == std::vector<std::string>{"exit paused", "exit video", "exit muted",
+                                               "exit audio", "exit running", "enter idle"});
+  CHECK(active(sm) == std::vector<std::string>{"/machine/idle"});
+  CHECK(sm.state() == "/machine/idle");
+
+  sm.dispatch(inst, EventBase{"start"});
+  CHECK(active(sm) == std::vector<std::string>{"/machine/running/audio/muted",
+                                               "/machine/running/video/paused"});
+}
+
+TEST_CASE("Regions - deferral checks every active leaf") {
+  sm_type sm;
+  TraceInstance inst;
+  sm.start(inst);
+  inst.trace.clear();
+
+  sm.dispatch(inst, EventBase{"seek"});
+  CHECK(inst.trace.empty());
+
+  // Leaving paused releases the deferred seek
+  sm.dispatch(inst, EventBase{"toggle"});
+  CHECK(inst.trace.back() == "seek");
+}
+
+TEST_CASE("Regions - orthogonal state completes when all regions are final") {
+  sm_type sm;
+  TraceInstance inst;
+  sm.start(inst);
+  sm.dispatch(inst, EventBase{"toggle"});
+
+  sm.dispatch(inst, EventBase{"end_audio"});
+  CHECK(active(sm) == std::vector<std::string>{"/machine/running/audio/over",
+                                               "/machine/running/video/playing"});
+
+  inst.trace.clear();
+  sm.dispatch(inst, EventBase{"end_video"});
+  CHECK(active(sm) == std::vector<std::string>{"/machine/done"});
+  CHECK(inst.trace == std::vector<std::string>{"exit video playing", "exit video",
+                                               "exit audio", "exit running", "enter done"});
+}
+
+TEST_CASE("Regions - inlined dispatch mode uses the region engine") {
+  using inlined_sm = compile<model, TraceInstance, SequentialTaskProvider, Clock, Context, 16,
+                             table_layout::dense, dispatch_mode::inlined>;
+  CHECK(inlined_sm::inlined_dispatch_table.empty());
+
+  inlined_sm sm;
+  TraceInstance inst;
+  sm.start(inst);
+  sm.dispatch(inst, EventBase{"toggle"});
+  CHECK(active(sm) == std::vector<std::string>{"/machine/running/audio/playing",
+                                               "/machine/running/video/playing"});
+}
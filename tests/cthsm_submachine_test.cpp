@@ -0,0 +1,131 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <string>
+#include <type_traits>
+
+#include "cthsm/cthsm.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+struct Job : Instance {
+  int attempts{0};
+  std::string log;
+};
+
+constexpr auto retry = define(
+    "retry", initial(target("trying")),
+    state("trying", entry([](Job& j) { ++j.attempts; }), exit([](Job& j) { j.log += "-trying"; }),
+          transition(on("fail"), target("/retry/waiting")),
+          transition(on("ok"), target("/retry/done"))),
+    state("waiting", defer("ok"), transition(on("again"), target("/retry/trying"))),
+    final("done"));
+
+constexpr auto model = define(
+    "m", initial(target("idle")),
+    state("idle", transition(on("fetch"), target("/m/fetch")),
+          transition(on("upload"), target("/m/upload"))),
+    submachine<retry>("fetch", entry([](Job& j) { j.log += "+fetch"; }),
+                      exit([](Job& j) { j.log += "-fetch"; }),
+                      // Only reached when the sub machine does not take "fail"
+                      transition(on("fail"), target("/m/broken")),
+                      transition(on("cancel"), target("/m/idle")), transition(target("/m/idle"))),
+    submachine<retry>("upload", transition(on("cancel"), target("/m/idle")),
+                      transition(target("/m/broken"))),
+    state("broken"));
+
+using machine = compile<model, Job>;
+
+constexpr auto inlined_model = define(
+    "n", initial(target("work")),
+    submachine<retry>("work", transition(target("/n/done"))), final("done"));
+
+using inlined = compile<inlined_model, Job, SequentialTaskProvider, Clock, Context, 16,
+                        table_layout::dense, dispatch_mode::inlined>;
+
+}  // namespace
+
+TEST_CASE("Submachine - usages share one compiled sub-model") {
+  static_assert(machine::submachine_count == 2);
+  static_assert(std::is_same_v<machine::submachine_type<0>, machine::submachine_type<1>>);
+  // The parent's tables hold the usages only, not copies of the sub-model
+  static_assert(decltype(machine::normalized_model)::state_count == 5);
+  static_assert(sizeof(machine::machine_state) <
+                1 + 2 * sizeof(machine::submachine_type<0>::machine_state) + 8);
+}
+
+TEST_CASE("Submachine - entering starts the sub machine, completion leaves it") {
+  machine m;
+  Job j;
+  m.start(j);
+  CHECK(m.submachine_state("/m/fetch").empty());
+
+  m.dispatch(j, EventBase{"fetch"});
+  CHECK(m.state() == "/m/fetch");
+  CHECK(m.submachine_state("/m/fetch") == "/retry/trying");
+  CHECK(j.attempts == 1);
+  CHECK(j.log == "+fetch");
+
+  m.dispatch(j, EventBase{"fail"});
+  m.dispatch(j, EventBase{"again"});  // Known to the sub-model only
+  CHECK(m.state() == "/m/fetch");
+  CHECK(j.attempts == 2);
+
+  m.dispatch(j, EventBase{"ok"});
+  CHECK(m.state() == "/m/idle");
+  CHECK(m.submachine_state("/m/fetch").empty());
+  CHECK(j.log == "+fetch-trying-trying-fetch");
+}
+
+TEST_CASE("Submachine - events the sub machine does not take reach the parent") {
+  machine m;
+  Job j;
+  m.start(j);
+  m.dispatch(j, EventBase{"fetch"});
+  m.dispatch(j, EventBase{"fail"});
+  CHECK(m.submachine_state("/m/fetch") == "/retry/waiting");
+
+  // "ok" is deferred by the sub machine, "fail" falls through to the usage
+  m.dispatch(j, EventBase{"ok"});
+  CHECK(m.state() == "/m/fetch");
+  m.dispatch(j, EventBase{"fail"});
+  CHECK(m.state() == "/m/broken");
+  CHECK(j.log == "+fetch-trying-fetch");
+}
+
+TEST_CASE("Submachine - each usage has its own runtime state") {
+  machine m;
+  Job j;
+  m.start(j);
+  m.dispatch(j, EventBase{"upload"});
+  m.dispatch(j, EventBase{"fail"});
+  CHECK(m.submachine_state("/m/upload") == "/retry/waiting");
+  m.dispatch(j, EventBase{"cancel"});
+  CHECK(m.submachine_state("/m/upload").empty());
+
+  m.dispatch(j, EventBase{"fetch"});
+  CHECK(m.submachine_state("/m/fetch") == "/retry/trying");
+  m.dispatch(j, EventBase{"cancel"});
+  m.dispatch(j, EventBase{"upload"});
+  m.dispatch(j, EventBase{"ok"});
+  CHECK(m.state() == "/m/broken");
+}
+
+TEST_CASE("Submachine - bare machine states and inlined dispatch") {
+  machine::machine_state state;
+  Job j;
+  machine::start(state, j);
+  machine::dispatch(state, j, EventBase{"fetch"});
+  CHECK(machine::submachine_state(state, "/m/fetch") == "/retry/trying");
+  machine::dispatch(state, j, EventBase{"ok"});
+  CHECK(machine::state(state) == "/m/idle");
+
+  inlined n;
+  Job k;
+  n.start(k);
+  CHECK(n.state() == "/n/work");
+  n.dispatch(k, EventBase{"ok"});
+  CHECK(n.state() == "/n/done");
+}
@@ -0,0 +1,112 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include "cthsm/cthsm.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+// Parent-level transitions are inherited by every child, so child rows are
+// largely identical and most event columns only differ in a few states.
+constexpr auto model = define(
+    "machine", initial(target("idle")),
+    state("idle", transition(on("start"), target("working"))),
+    state("working", initial(target("a")),
+          transition(on("stop"), target("/machine/idle")),
+          transition(on("abort"), target("/machine/idle")),
+          state("a", transition(on("next"), target("b"))),
+          state("b", transition(on("next"), target("c"))),
+          state("c", transition(on("back"), target("a"))),
+          state("d", transition(on("back"), target("a"))), state("e")),
+    state("unused", transition(on("never"), target("idle"))));
+
+using dense_sm = compile<model, Instance, SequentialTaskProvider, Clock,
+                         Context, 16, table_layout::dense>;
+using compressed_sm = compile<model, Instance, SequentialTaskProvider, Clock,
+                              Context, 16, table_layout::compressed>;
+
+template <typename Dense, typename Compressed>
+constexpr bool lookups_match() {
+  constexpr auto sc = decltype(Dense::tables)::state_count;
+  constexpr auto ec = decltype(Dense::tables)::event_count;
+  for (std::size_t s = 0; s < sc; ++s) {
+    for (std::size_t e = 0; e < ec; ++e) {
+      if (Dense::dense_tables.get_transition_id(s, e) !=
+          Compressed::compressed_transitions.get_transition_id(s, e)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST_CASE("Table compression - lookups match the dense table") {
+  static_assert(lookups_match<dense_sm, compressed_sm>());
+  CHECK(lookups_match<dense_sm, compressed_sm>());
+}
+
+TEST_CASE("Table compression - merges columns and rows") {
+  using table_type = std::decay_t<decltype(compressed_sm::compressed_transitions)>;
+  constexpr auto sc = decltype(compressed_sm::tables)::state_count;
+  constexpr auto ec = decltype(compressed_sm::tables)::event_count;
+
+  // "next" and "back" are declared twice; the duplicate ids never receive
+  // transitions of their own, so their empty columns collapse into one class.
+  CHECK(table_type::class_count < ec);
+  // e and working share their (inherited) row
+  CHECK(table_type::row_count < sc);
+  CHECK(table_type::slot_count <= table_type::row_count * table_type::class_count);
+  CHECK(table_type::storage_bytes() < sizeof(compressed_sm::dense_tables.transition_table));
+  // The runtime tables no longer carry the dense matrix
+  CHECK(sizeof(compressed_sm::tables) < sizeof(dense_sm::tables));
+}
+
+TEST_CASE("Table compression - out of range lookups are invalid") {
+  constexpr auto& table = compressed_sm::compressed_transitions;
+  CHECK(table.get_transition_id(1000, 0) == detail::invalid_index);
+  CHECK(table.get_transition_id(0, 1000) == detail::invalid_index);
+}
+
+TEST_CASE("Table compression - dispatch behaves like the dense layout") {
+  dense_sm dense;
+  compressed_sm compressed;
+  Instance dense_inst;
+  Instance compressed_inst;
+  dense.start(dense_inst);
+  compressed.start(compressed_inst);
+
+  const char* events[] = {"start", "next", "next", "back", "never", "unknown",
+                          "abort", "start", "next", "stop"};
+  for (const char* name : events) {
+    dense.dispatch(dense_inst, EventBase{name});
+    compressed.dispatch(compressed_inst, EventBase{name});
+    CHECK(dense.state() == compressed.state());
+  }
+  CHECK(compressed.state() == "/machine/idle");
+}
+
+TEST_CASE("Table compression - wildcard chains are preserved") {
+  constexpr auto wildcard_model = define(
+      "machine", initial(target("a")),
+      state("a", transition(on("go"), target("b")),
+            transition(on<Any>(), target("c"))),
+      state("b", transition(on("go"), target("a"))), state("c"));
+
+  using sm_type = compile<wildcard_model, Instance, SequentialTaskProvider,
+                          Clock, Context, 16, table_layout::compressed>;
+  using dense_type = compile<wildcard_model>;
+  static_assert(lookups_match<dense_type, sm_type>());
+
+  sm_type sm;
+  Instance inst;
+  sm.start(inst);
+  sm.dispatch(inst, EventBase{"go"});
+  CHECK(sm.state() == "/machine/b");
+  sm.dispatch(inst, EventBase{"go"});
+  CHECK(sm.state() == "/machine/a");
+  sm.dispatch(inst, EventBase{"anything"});
+  CHECK(sm.state() == "/machine/c");
+}
@@ -0,0 +1,263 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "cthsm/thread_pool.hpp"
+
+using namespace cthsm;
+using namespace std::chrono_literals;
+
+namespace {
+
+struct PoolInstance : Instance {
+  std::atomic<int> started{0};
+  std::atomic<int> cancelled{0};
+  std::atomic<bool> on_worker{false};
+  std::thread::id dispatcher{std::this_thread::get_id()};
+};
+
+// Runs until the state is exited, which would never return with the
+// sequential provider
+constexpr auto model = define(
+    "machine", initial(target("busy")),
+    state("busy",
+          activity([](Context& ctx, PoolInstance& i, const EventBase&) {
+            i.on_worker = std::this_thread::get_id() != i.dispatcher;
+            ++i.started;
+            while (!ctx.is_set()) std::this_thread::yield();
+            ++i.cancelled;
+          }),
+          transition(on("stop"), target("/machine/idle"))),
+    state("idle", transition(on("go"), target("/machine/busy"))));
+
+using pool_sm = compile<model, PoolInstance, ThreadPoolTaskProvider<2, 4>>;
+
+struct FinishInstance : Instance {
+  std::atomic<int> runs{0};
+  std::atomic<bool> on_worker{false};
+  std::thread::id dispatcher{std::this_thread::get_id()};
+};
+
+// The activity returns by itself, and its state then completes
+constexpr auto finishing_model = define(
+    "machine", initial(target("working")),
+    state("working",
+          activity([](FinishInstance& i) {
+            i.on_worker = std::this_thread::get_id() != i.dispatcher;
+            ++i.runs;
+          }),
+          transition(target("/machine/done")), transition(on("stop"), target("/machine/idle"))),
+    state("done", transition(on("again"), target("/machine/working"))),
+    state("idle", transition(on("again"), target("/machine/working"))));
+
+using finishing_sm = compile<finishing_model, FinishInstance, ThreadPoolTaskProvider<2, 4>>;
+
+// Two activities and a task timer, none of which returns until cancelled,
+// on a pool with exactly that many workers and slots
+constexpr auto filling_model = define(
+    "machine", initial(target("busy")),
+    state("busy",
+          activity([](Context& ctx, PoolInstance& i, const EventBase&) {
+            ++i.started;
+            while (!ctx.is_set()) std::this_thread::yield();
+            ++i.cancelled;
+          }),
+          activity([](Context& ctx, PoolInstance& i, const EventBase&) {
+            ++i.started;
+            while (!ctx.is_set()) std::this_thread::yield();
+            ++i.cancelled;
+          }),
+          transition(every([] { return 10s; }), target("/machine/busy")),
+          transition(on("stop"), target("/machine/idle"))),
+    state("idle", transition(on("go"), target("/machine/busy"))));
+
+using filling_sm = compile<filling_model, PoolInstance, ThreadPoolTaskProvider<3, 3>>;
+static_assert(filling_sm::task_slot_count == 3);
+
+struct TimedInstance : Instance {
+  std::atomic<int> cancelled{0};
+  std::atomic<bool> idle{false};
+};
+
+// An activity that runs until cancelled next to the timer that ends it;
+// each holds a worker. The timer's transition runs on its worker.
+constexpr auto timed_model = define(
+    "machine", initial(target("busy")),
+    state("busy",
+          activity([](Context& ctx, TimedInstance& i, const EventBase&) {
+            while (!ctx.is_set()) std::this_thread::yield();
+            ++i.cancelled;
+          }),
+          transition(after([] { return 5ms; }), target("/machine/idle"))),
+    state("idle", entry([](TimedInstance& i) { i.idle = true; })));
+
+using timed_sm = compile<timed_model, TimedInstance, ThreadPoolTaskProvider<2, 2>>;
+static_assert(timed_sm::task_slot_count == 2);
+
+template <typename Pred>
+bool eventually(Pred pred) {
+  const auto deadline = std::chrono::steady_clock::now() + 2s;
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > deadline) return false;
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST_CASE("Thread pool - join waits for the task to complete") {
+  ThreadPoolTaskProvider<2, 4> pool;
+  std::atomic<bool> done{false};
+  auto task = pool.create_task([&done] {
+    std::this_thread::sleep_for(20ms);
+    done = true;
+  });
+  CHECK(task.joinable());
+  task.join();
+  CHECK(done);
+  CHECK_FALSE(task.joinable());
+}
+
+TEST_CASE("Thread pool - slots are reused once tasks are joined") {
+  ThreadPoolTaskProvider<1, 2> pool;
+  std::atomic<int> runs{0};
+  for (int i = 0; i < 50; ++i) {
+    auto a = pool.create_task([&runs] { ++runs; });
+    auto b = pool.create_task([&runs] { ++runs; });
+    a.join();
+    b.join();
+  }
+  CHECK(runs == 100);
+}
+
+TEST_CASE("Thread pool - a full pool waits for a free slot") {
+  ThreadPoolTaskProvider<1, 1> pool;
+  std::atomic<bool> release{false};
+  auto blocker = pool.create_task([&release] {
+    while (!release) std::this_thread::yield();
+  });
+
+  std::atomic<bool> created{false};
+  std::thread::id ran_on{};
+  std::thread creator([&] {
+    auto task = pool.create_task([&ran_on] { ran_on = std::this_thread::get_id(); });
+    created = true;
+    task.join();
+  });
+  std::this_thread::sleep_for(20ms);
+  CHECK_FALSE(created);
+
+  // The slot is free once the task returned and its handle is released
+  release = true;
+  blocker.join();
+  creator.join();
+  CHECK(created);
+  CHECK(ran_on != std::this_thread::get_id());
+}
+
+TEST_CASE("Thread pool - sleep_for returns early when cancelled") {
+  ThreadPoolTaskProvider<1, 1> pool;
+  Context ctx;
+  std::atomic<bool> woke{false};
+  auto task = pool.create_task([&] {
+    pool.sleep_for(10s, &ctx);
+    woke = true;
+  });
+  ctx.set();
+  task.join();
+  CHECK(woke);
+}
+
+TEST_CASE("Thread pool - activities do not block the dispatch that starts them") {
+  pool_sm sm;
+  PoolInstance inst;
+  sm.start(inst);
+  CHECK(sm.state() == "/machine/busy");
+  CHECK(eventually([&] { return inst.started == 1; }));
+  CHECK(inst.on_worker);
+
+  // Exiting cancels the activity and waits for it to return
+  sm.dispatch(inst, EventBase{"stop"});
+  CHECK(sm.state() == "/machine/idle");
+  CHECK(inst.cancelled == 1);
+
+  for (int i = 0; i < 20; ++i) {
+    sm.dispatch(inst, EventBase{"go"});
+    sm.dispatch(inst, EventBase{"stop"});
+  }
+  CHECK(inst.started == 21);
+  CHECK(inst.cancelled == 21);
+}
+
+TEST_CASE("Thread pool - destroying the machine cancels running activities") {
+  PoolInstance inst;
+  {
+    pool_sm sm;
+    sm.start(inst);
+    CHECK(eventually([&] { return inst.started == 1; }));
+  }
+  CHECK(inst.cancelled == 1);
+}
+
+TEST_CASE("Thread pool - an activity that returns completes its state on the dispatching thread") {
+  finishing_sm sm;
+  FinishInstance inst;
+  sm.start(inst);
+  for (int i = 1; i <= 50; ++i) {
+    CHECK(eventually([&] { return inst.runs == i; }));
+    // The worker only flags the return; the completion transition is taken
+    // by poll_activities (or the next dispatch) on this thread
+    CHECK(eventually([&] {
+      sm.poll_activities(inst);
+      return sm.state() == "/machine/done";
+    }));
+    sm.dispatch(inst, EventBase{"again"});
+  }
+  CHECK(inst.on_worker);
+}
+
+TEST_CASE("Thread pool - exiting a state while its activity returns") {
+  finishing_sm sm;
+  FinishInstance inst;
+  sm.start(inst);
+  for (int i = 0; i < 200; ++i) {
+    // Either the return is collected first and the state completes, or
+    // "stop" exits it and cancels the activity
+    sm.dispatch(inst, EventBase{"stop"});
+    const auto state = sm.state();
+    CHECK((state == "/machine/done" || state == "/machine/idle"));
+    sm.dispatch(inst, EventBase{"again"});
+  }
+  CHECK(eventually([&] { return inst.runs == 201; }));
+}
+
+TEST_CASE("Thread pool - a model that fills every slot") {
+  filling_sm sm;
+  PoolInstance inst;
+  sm.start(inst);
+  for (int i = 1; i <= 20; ++i) {
+    CHECK(eventually([&] { return inst.started == 2 * i; }));
+    sm.dispatch(inst, EventBase{"stop"});
+    CHECK(sm.state() == "/machine/idle");
+    // Exiting joined all three, so entering again finds their slots free
+    sm.dispatch(inst, EventBase{"go"});
+    CHECK(sm.state() == "/machine/busy");
+  }
+  sm.dispatch(inst, EventBase{"stop"});
+  CHECK(inst.started == 42);
+  CHECK(inst.cancelled == 42);
+}
+
+TEST_CASE("Thread pool - a timer fires while an activity holds the other worker") {
+  for (int i = 0; i < 5; ++i) {
+    TimedInstance inst;
+    timed_sm sm;
+    sm.start(inst);
+    CHECK(eventually([&] { return inst.idle.load(); }));
+    CHECK(inst.cancelled == 1);
+  }
+}
@@ -0,0 +1,157 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+
+using namespace cthsm;
+using namespace std::chrono_literals;
+
+namespace {
+
+struct TickInstance : Instance {
+  int ticks{0};
+  std::vector<std::string> trace;
+};
+
+constexpr auto model = define(
+    "machine", initial(target("waiting")),
+    state("waiting",
+          transition(after([](TickInstance&) { return std::chrono::milliseconds(100); }),
+                     target("/machine/ticking")),
+          transition(on("skip"), target("/machine/idle"))),
+    state("ticking",
+          transition(every([](TickInstance&) { return std::chrono::milliseconds(10); }),
+                     effect([](TickInstance& i) { ++i.ticks; })),
+          transition(on("stop"), target("/machine/idle"))),
+    state("idle", transition(on("wait"), target("/machine/waiting"))));
+
+template <missed_ticks Missed = missed_ticks::coalesce>
+using service_sm = compile<model, TickInstance, SequentialTaskProvider, ManualClock, Context, 16,
+                           table_layout::dense, dispatch_mode::table, TimerService<Missed>>;
+
+ManualClock::time_point at_ms(long long ms) {
+  return ManualClock::time_point{std::chrono::milliseconds(ms)};
+}
+
+}  // namespace
+
+TEST_CASE("Timer service - after fires once its deadline has passed") {
+  ManualClock::reset();
+  service_sm<> sm;
+  TickInstance inst;
+  sm.start(inst);
+  CHECK(sm.next_timer_deadline() == at_ms(100));
+
+  ManualClock::advance(99ms);
+  CHECK(sm.poll_timers(inst) == 0);
+  CHECK(sm.state() == "/machine/waiting");
+
+  ManualClock::advance(1ms);
+  CHECK(sm.poll_timers(inst) == 1);
+  CHECK(sm.state() == "/machine/ticking");
+  // Entering ticking armed the periodic timer from the current time
+  CHECK(sm.next_timer_deadline() == at_ms(110));
+}
+
+TEST_CASE("Timer service - exiting a state cancels its timers") {
+  ManualClock::reset();
+  service_sm<> sm;
+  TickInstance inst;
+  sm.start(inst);
+
+  sm.dispatch(inst, EventBase{"skip"});
+  CHECK_FALSE(sm.next_timer_deadline().has_value());
+  ManualClock::advance(1s);
+  CHECK(sm.poll_timers(inst) == 0);
+  CHECK(sm.state() == "/machine/idle");
+
+  // Re-entering arms the timer relative to the new entry time
+  sm.dispatch(inst, EventBase{"wait"});
+  CHECK(sm.next_timer_deadline() == at_ms(1100));
+}
+
+TEST_CASE("Timer service - every uses absolute deadlines") {
+  ManualClock::reset();
+  service_sm<> sm;
+  TickInstance inst;
+  sm.start(inst);
+  ManualClock::advance(100ms);
+  sm.poll_timers(inst);
+
+  // Polling late does not shift later ticks
+  ManualClock::advance(13ms);
+  CHECK(sm.poll_timers(inst) == 1);
+  CHECK(sm.next_timer_deadline() == at_ms(120));
+  ManualClock::advance(7ms);
+  CHECK(sm.poll_timers(inst) == 1);
+  CHECK(inst.ticks == 2);
+
+  sm.dispatch(inst, EventBase{"stop"});
+  ManualClock::advance(100ms);
+  CHECK(sm.poll_timers(inst) == 0);
+  CHECK(inst.ticks == 2);
+}
+
+TEST_CASE("Timer service - missed tick policies") {
+  SUBCASE("coalesce fires once and skips to the next deadline ahead") {
+    ManualClock::reset();
+    service_sm<missed_ticks::coalesce> sm;
+    TickInstance inst;
+    sm.start(inst);
+    ManualClock::advance(100ms);
+    sm.poll_timers(inst);
+
+    ManualClock::advance(35ms);
+    CHECK(sm.poll_timers(inst) == 1);
+    CHECK(inst.ticks == 1);
+    CHECK(sm.next_timer_deadline() == at_ms(140));
+  }
+
+  SUBCASE("catch_up fires once per missed period") {
+    ManualClock::reset();
+    service_sm<missed_ticks::catch_up> sm;
+    TickInstance inst;
+    sm.start(inst);
+    ManualClock::advance(100ms);
+    sm.poll_timers(inst);
+
+    ManualClock::advance(35ms);
+    CHECK(sm.poll_timers(inst) == 3);
+    CHECK(inst.ticks == 3);
+    CHECK(sm.next_timer_deadline() == at_ms(140));
+  }
+}
+
+TEST_CASE("Timer service - at and ordering across timers") {
+  constexpr auto at_model = define(
+      "machine", initial(target("armed")),
+      state("armed",
+            transition(at([](TickInstance&) { return ManualClock::time_point{50ms}; }),
+                       effect([](TickInstance& i) { i.trace.emplace_back("at"); })),
+            transition(after([](TickInstance&) { return std::chrono::milliseconds(20); }),
+                       effect([](TickInstance& i) { i.trace.emplace_back("after"); })),
+            transition(every([](TickInstance&) { return std::chrono::milliseconds(30); }),
+                       effect([](TickInstance& i) { i.trace.emplace_back("every"); }))));
+  using at_sm = compile<at_model, TickInstance, SequentialTaskProvider, ManualClock, Context, 16,
+                        table_layout::dense, dispatch_mode::table, TimerService<>>;
+
+  ManualClock::reset();
+  at_sm sm;
+  TickInstance inst;
+  sm.start(inst);
+
+  ManualClock::advance(60ms);
+  // The ticks due at 30 and 60 are coalesced into one
+  CHECK(sm.poll_timers(inst) == 3);
+  CHECK(inst.trace == std::vector<std::string>{"after", "every", "at"});
+  CHECK(sm.next_timer_deadline() == at_ms(90));
+}
+
+TEST_CASE("Timer service - task timers remain the default") {
+  static_assert(!compile<model, TickInstance>::uses_timer_service);
+  static_assert(service_sm<>::uses_timer_service);
+}
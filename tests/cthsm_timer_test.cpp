@@ -5,6 +5,7 @@
 #include <chrono>
 #include <deque>
 #include <functional>
+#include <memory>
 
 #include "cthsm/cthsm.hpp"
 
@@ -220,7 +221,10 @@ TEST_CASE("Timers - When condition-based trigger") {
             transition(when(cond), target("done"), effect(on_trigger))),
       state("done"));
 
-  compile<model, WhenInstance, TestTaskProvider> sm;
+  // Polling fallback: the condition is re-evaluated by a task
+  compile<model, WhenInstance, TestTaskProvider, Clock, Context, 16, table_layout::dense,
+          dispatch_mode::table, TaskTimers<when_mode::poll>>
+      sm;
   WhenInstance inst;
   sm.start(inst);
 
@@ -0,0 +1,148 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <string>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+struct TraceInstance : Instance {
+  std::vector<std::string> trace;
+};
+
+constexpr auto model = define(
+    "machine", initial(target("idle")),
+    state("idle", exit([](TraceInstance& i) { i.trace.emplace_back("exit idle"); }),
+          transition(on("go"), target("outer"),
+                     effect([](TraceInstance& i) { i.trace.emplace_back("effect go"); })),
+          transition(on("ping"),
+                     effect([](TraceInstance& i) { i.trace.emplace_back("ping"); }))),
+    state("outer", entry([](TraceInstance& i) { i.trace.emplace_back("enter outer"); }),
+          exit([](TraceInstance& i) { i.trace.emplace_back("exit outer"); }),
+          initial(target("inner"),
+                  effect([](TraceInstance& i) { i.trace.emplace_back("init outer"); })),
+          transition(on("leave"), target("/machine/idle")),
+          state("inner", entry([](TraceInstance& i) { i.trace.emplace_back("enter inner"); }),
+                exit([](TraceInstance& i) { i.trace.emplace_back("exit inner"); }),
+                initial(target("leaf")),
+                state("leaf", entry([](TraceInstance& i) { i.trace.emplace_back("enter leaf"); }),
+                      exit([](TraceInstance& i) { i.trace.emplace_back("exit leaf"); }),
+                      transition(on("finish"), target("done"))),
+                final("done"), transition(target("/machine/idle")))));
+
+using sm_type = compile<model, TraceInstance>;
+
+template <typename SM = sm_type>
+constexpr std::size_t transition_for(std::string_view state, std::string_view event) {
+  const auto& m = SM::normalized_model;
+  for (std::size_t t = 0; t < m.transitions.size(); ++t) {
+    const auto& tr = m.transitions[t];
+    if (m.get_state_name(tr.source_id) == state && tr.event_id != detail::invalid_index &&
+        m.get_event_name(tr.event_id) == event) {
+      return t;
+    }
+  }
+  return detail::invalid_index;
+}
+
+}  // namespace
+
+TEST_CASE("Transition programs - flatten exits, effects, entries and initial chain") {
+  constexpr std::size_t go = transition_for("/machine/idle", "go");
+  static_assert(go != detail::invalid_index);
+  constexpr auto prog = sm_type::programs.transitions[go];
+
+  CHECK_FALSE(prog.generic);
+  CHECK(prog.changes_state);
+  CHECK_FALSE(prog.completes);
+  CHECK_FALSE(prog.records_history);
+
+  // exit idle, effect, enter outer, set outer, init effect, enter inner,
+  // set inner, enter leaf, set leaf
+  std::vector<detail::action_kind> kinds;
+  for (std::size_t i = 0; i < prog.actions.count; ++i) {
+    kinds.push_back(sm_type::programs.actions[prog.actions.start + i].kind);
+  }
+  using k = detail::action_kind;
+  CHECK(kinds == std::vector<k>{k::exit, k::effect, k::entry, k::set_state, k::effect,
+                                k::entry, k::set_state, k::entry, k::set_state});
+
+  sm_type sm;
+  TraceInstance inst;
+  sm.start(inst);
+  inst.trace.clear();
+  sm.dispatch(inst, EventBase{"go"});
+  CHECK(sm.state() == "/machine/outer/inner/leaf");
+  CHECK(inst.trace == std::vector<std::string>{"exit idle", "effect go", "enter outer",
+                                               "init outer", "enter inner", "enter leaf"});
+}
+
+TEST_CASE("Transition programs - internal transitions only run effects") {
+  constexpr std::size_t ping = transition_for("/machine/idle", "ping");
+  constexpr auto prog = sm_type::programs.transitions[ping];
+  CHECK_FALSE(prog.changes_state);
+  CHECK(prog.actions.count == 1);
+
+  sm_type sm;
+  TraceInstance inst;
+  sm.start(inst);
+  inst.trace.clear();
+  sm.dispatch(inst, EventBase{"ping"});
+  CHECK(sm.state() == "/machine/idle");
+  CHECK(inst.trace == std::vector<std::string>{"ping"});
+}
+
+TEST_CASE("Transition programs - inherited transitions exit the active leaf first") {
+  sm_type sm;
+  TraceInstance inst;
+  sm.start(inst);
+  sm.dispatch(inst, EventBase{"go"});
+  inst.trace.clear();
+
+  sm.dispatch(inst, EventBase{"leave"});
+  CHECK(sm.state() == "/machine/idle");
+  CHECK(inst.trace ==
+        std::vector<std::string>{"exit leaf", "exit inner", "exit outer"});
+}
+
+TEST_CASE("Transition programs - completion only where the leaf can complete") {
+  constexpr std::size_t finish = transition_for("/machine/outer/inner/leaf", "finish");
+  static_assert(sm_type::programs.transitions[finish].completes);
+
+  sm_type sm;
+  TraceInstance inst;
+  sm.start(inst);
+  sm.dispatch(inst, EventBase{"go"});
+  inst.trace.clear();
+
+  // done is final, so inner's completion transition fires
+  sm.dispatch(inst, EventBase{"finish"});
+  CHECK(sm.state() == "/machine/idle");
+}
+
+TEST_CASE("Transition programs - history targets keep the generic path") {
+  constexpr auto history_model = define(
+      "machine", initial(target("a")),
+      state("a", initial(target("x")), state("x", transition(on("next"), target("y"))),
+            state("y"), transition(on("out"), target("/machine/b"))),
+      state("b", transition(on("back"), target(deep_history("/machine/a")))));
+  using history_sm = compile<history_model>;
+
+  constexpr std::size_t back = transition_for<history_sm>("/machine/b", "back");
+  constexpr std::size_t out = transition_for<history_sm>("/machine/a", "out");
+  CHECK(history_sm::programs.transitions[back].generic);
+  CHECK(history_sm::programs.transitions[out].records_history);
+
+  history_sm sm;
+  Instance inst;
+  sm.start(inst);
+  sm.dispatch(inst, EventBase{"next"});
+  sm.dispatch(inst, EventBase{"out"});
+  CHECK(sm.state() == "/machine/b");
+  sm.dispatch(inst, EventBase{"back"});
+  CHECK(sm.state() == "/machine/a/y");
+}
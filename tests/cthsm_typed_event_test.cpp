@@ -95,3 +95,22 @@ TEST_CASE("Typed dispatch forwards event payloads") {
   sm.dispatch(dev, PayloadEvent{.value = 7});
   CHECK(dev.payload_sum == 12);
 }
+
+TEST_CASE("Typed events carry a type id, runtime events do not") {
+  static_assert(StartEvent{}.type_id() == cthsm::detail::event_type_id<StartEvent>);
+  static_assert(StartEvent{}.type_id() != 0);
+  static_assert(StartEvent{}.type_id() != PayloadEvent{}.type_id());
+  static_assert(cthsm::EventBase{"StartEvent"}.type_id() == 0);
+
+  compile<typed_model> sm;
+  Device dev;
+  sm.start(dev);
+
+  // A runtime event spelled like the type reaches the typed transition, but
+  // its typed guard only accepts the typed event itself
+  sm.dispatch(dev, cthsm::EventBase{cthsm::detail::type_name<StartEvent>()});
+  CHECK(sm.state() == "/device/idle");
+  CHECK(dev.runtime_entries == 1);
+  CHECK(dev.guard_checks == 0);
+  CHECK(dev.effect_calls == 0);
+}
@@ -0,0 +1,132 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cthsm/step_watch.hpp"
+
+using namespace cthsm;
+using namespace std::chrono_literals;
+
+namespace {
+
+struct Pump : Instance {};
+
+constexpr auto model = define(
+    "pump", initial(target("idle")),
+    state("idle", defer("flush"), transition(on("start"), target("/pump/running"))),
+    state("running", entry([](Pump&) { std::this_thread::sleep_for(20ms); }),
+          transition(on("flush"), target("/pump/draining"))),
+    state("draining", transition(on("stop"), target("/pump/idle"))));
+
+inline step_watch<model> pump_watch{5ms};
+
+using machine = compile<model, Pump, SequentialTaskProvider, Clock, Context, 16,
+                        table_layout::dense, dispatch_mode::table, TaskTimers<>,
+                        WatchdogObserver<pump_watch>>;
+
+struct Overruns {
+  std::mutex mutex;
+  std::vector<cthsm::step_overrun> seen;
+
+  cthsm::watchdog::Handler handler() {
+    return [this](const cthsm::step_overrun& overrun) {
+      std::lock_guard lock(mutex);
+      seen.push_back(overrun);
+    };
+  }
+};
+
+}  // namespace
+
+TEST_CASE("Watchdog - budgets are inherited from the nearest state") {
+  step_watch<model> watch{1ms};
+  const auto id = [](std::string_view name) {
+    for (std::size_t s = 0; s < step_watch<model>::state_count; ++s) {
+      if (machine::normalized_model.get_state_name(s) == name) return s;
+    }
+    return detail::invalid_index;
+  };
+  CHECK(watch.budget_ns(id("/pump/idle")) == 1000000);
+  CHECK(watch.set_budget("/pump", 2ms));
+  CHECK(watch.set_budget("/pump/running", 0ns));
+  CHECK_FALSE(watch.set_budget("/pump/missing", 3ms));
+  CHECK(watch.budget_ns(id("/pump/idle")) == 2000000);
+  CHECK(watch.budget_ns(id("/pump/running")) == 0);
+  watch.set_budget(4ms);
+  CHECK(watch.budget_ns(id("/pump/draining")) == 2000000);
+}
+
+TEST_CASE("Watchdog - a slow entry overruns the step that fired it") {
+  Overruns overruns;
+  cthsm::watchdog watchdog(1, 0ms, overruns.handler());
+  pump_watch.attach(&watchdog, "pump-1");
+
+  machine m;
+  Pump p;
+  m.start(p);
+  m.dispatch(p, EventBase{"start"});
+  CHECK(watchdog.overruns() == 1);
+  REQUIRE(overruns.seen.size() == 1);
+  CHECK(overruns.seen[0].instance == "pump-1");
+  CHECK(overruns.seen[0].state == "/pump/idle");
+  CHECK(overruns.seen[0].event == "start");
+  CHECK(overruns.seen[0].behavior == "/pump/running/entry");
+  CHECK(overruns.seen[0].finished);
+  CHECK(overruns.seen[0].elapsed >= 20ms);
+  CHECK(overruns.seen[0].budget == 5ms);
+
+  m.dispatch(p, EventBase{"flush"});
+  m.dispatch(p, EventBase{"stop"});
+  CHECK(watchdog.overruns() == 1);
+
+  // The deferred flush is replayed inside the same step, counted once
+  m.dispatch(p, EventBase{"flush"});
+  m.dispatch(p, EventBase{"start"});
+  CHECK(m.state() == "/pump/draining");
+  CHECK(watchdog.overruns() == 2);
+  REQUIRE(overruns.seen.size() == 2);
+  CHECK(overruns.seen[1].event == "start");
+  CHECK(overruns.seen[1].behavior == "/pump/draining/entry");
+  m.dispatch(p, EventBase{"stop"});
+
+  // A larger budget for steps started in idle
+  CHECK(pump_watch.set_budget("/pump/idle", 10s));
+  m.dispatch(p, EventBase{"start"});
+  CHECK(watchdog.overruns() == 2);
+
+  pump_watch.attach(nullptr);
+  m.dispatch(p, EventBase{"flush"});
+  m.dispatch(p, EventBase{"stop"});
+  pump_watch.set_budget("/pump/idle", 1ms);
+  m.dispatch(p, EventBase{"start"});
+  CHECK(watchdog.overruns() == 2);
+}
+
+TEST_CASE("Watchdog - each dispatching thread claims a slot of its own") {
+  Overruns overruns;
+  cthsm::watchdog watchdog(1, 0ms, overruns.handler());
+  pump_watch.set_budget("/pump/idle", 5ms);
+  pump_watch.attach(&watchdog, "pump");
+
+  machine m;
+  Pump p;
+  m.start(p);
+  m.dispatch(p, EventBase{"start"});
+  CHECK(watchdog.overruns() == 1);
+
+  // No slot left for a second thread; its steps go unwatched
+  std::thread([&] {
+    machine other;
+    Pump q;
+    other.start(q);
+    other.dispatch(q, EventBase{"start"});
+  }).join();
+  CHECK(watchdog.overruns() == 1);
+
+  pump_watch.attach(nullptr);
+}
@@ -0,0 +1,133 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <string>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+
+using namespace cthsm;
+
+namespace {
+
+struct LevelInstance : Instance {
+  int level{0};
+  int evaluations{0};
+  std::vector<std::string> trace;
+};
+
+// Counts every task the machine creates; on_step conditions must not create any
+struct CountingTaskProvider {
+  struct TaskHandle {
+    void join() {}
+    bool joinable() const { return false; }
+  };
+
+  static inline int created = 0;
+
+  template <typename F>
+  TaskHandle create_task(F&&, const char* = nullptr, std::size_t = 0, int = 0) {
+    ++created;
+    return TaskHandle{};
+  }
+
+  void sleep_for(std::chrono::milliseconds, Context* = nullptr) {}
+};
+
+constexpr auto model = define(
+    "tank", initial(target("filling")),
+    state("filling",
+          entry([](LevelInstance& i) { i.trace.emplace_back("enter filling"); }),
+          transition(on("pour"), effect([](LevelInstance& i) { i.level += 40; })),
+          transition(when([](LevelInstance& i) {
+                       ++i.evaluations;
+                       return i.level >= 100;
+                     }),
+                     target("/tank/full"))),
+    state("full", entry([](LevelInstance& i) { i.trace.emplace_back("enter full"); }),
+          transition(on("drain"), effect([](LevelInstance& i) { i.level = 0; })),
+          transition(when([](LevelInstance& i) { return i.level == 0; }),
+                     target("/tank/filling"))));
+
+using sm_type = compile<model, LevelInstance, CountingTaskProvider>;
+
+}  // namespace
+
+TEST_CASE("When - conditions are checked at the end of each step without tasks") {
+  static_assert(sm_type::evaluates_conditions);
+  CountingTaskProvider::created = 0;
+
+  sm_type sm;
+  LevelInstance inst;
+  sm.start(inst);
+  CHECK(inst.evaluations == 1);
+  CHECK(CountingTaskProvider::created == 0);
+
+  sm.dispatch(inst, EventBase{"pour"});
+  sm.dispatch(inst, EventBase{"pour"});
+  CHECK(sm.state() == "/tank/filling");
+  CHECK(inst.evaluations == 3);
+
+  // The step that makes the condition true also takes the transition
+  sm.dispatch(inst, EventBase{"pour"});
+  CHECK(sm.state() == "/tank/full");
+  CHECK(inst.trace.back() == "enter full");
+  CHECK(CountingTaskProvider::created == 0);
+}
+
+TEST_CASE("When - exiting a state disarms its conditions") {
+  sm_type sm;
+  LevelInstance inst;
+  sm.start(inst);
+  for (int k = 0; k < 3; ++k) sm.dispatch(inst, EventBase{"pour"});
+  REQUIRE(sm.state() == "/tank/full");
+
+  const int before = inst.evaluations;
+  sm.dispatch(inst, EventBase{"unknown"});
+  CHECK(inst.evaluations == before);
+}
+
+TEST_CASE("When - notify_changed picks up changes made outside dispatch") {
+  sm_type sm;
+  LevelInstance inst;
+  sm.start(inst);
+
+  inst.level = 150;
+  CHECK(sm.state() == "/tank/filling");
+  sm.notify_changed(inst);
+  CHECK(sm.state() == "/tank/full");
+
+  inst.level = 0;
+  sm.notify_changed(inst);
+  CHECK(sm.state() == "/tank/filling");
+}
+
+TEST_CASE("When - a condition that stays true fires once per step") {
+  constexpr auto loop_model = define(
+      "loop", initial(target("a")),
+      state("a", transition(when([](LevelInstance& i) {
+                              ++i.evaluations;
+                              return true;
+                            }),
+                            target("/loop/a"))));
+  compile<loop_model, LevelInstance> sm;
+  LevelInstance inst;
+  sm.start(inst);
+  CHECK(inst.evaluations == 1);
+  sm.notify_changed(inst);
+  CHECK(inst.evaluations == 2);
+}
+
+TEST_CASE("When - polling remains available") {
+  using polling_sm = compile<model, LevelInstance, CountingTaskProvider, Clock, Context, 16,
+                             table_layout::dense, dispatch_mode::table,
+                             TaskTimers<when_mode::poll>>;
+  static_assert(!polling_sm::evaluates_conditions);
+  CountingTaskProvider::created = 0;
+
+  polling_sm sm;
+  LevelInstance inst;
+  sm.start(inst);
+  CHECK(CountingTaskProvider::created == 1);
+  CHECK(inst.evaluations == 0);
+}
@@ -0,0 +1,159 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define HSM_FLIGHT_RECORDER 1
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hsm.hpp"
+
+class RecordedInstance : public hsm::Instance {};
+
+namespace {
+
+auto noop() {
+  return [](hsm::Context& /*ctx*/, hsm::Instance& /*inst*/,
+            hsm::Event& /*event*/) {};
+}
+
+std::string name_of(const std::unique_ptr<hsm::Model>& model,
+                    std::uint32_t id) {
+  return model->trace_names.at(id);
+}
+
+}  // namespace
+
+TEST_CASE("Flight recorder - ring keeps the newest records in order") {
+  hsm::FlightRecorder recorder(5);
+  CHECK(recorder.capacity() == 8);
+
+  for (std::uint32_t i = 0; i < 20; ++i) {
+    recorder.record(hsm::TracePhase::Enter, i, 0, 0);
+  }
+  auto records = recorder.snapshot();
+  CHECK(recorder.recorded() == 20);
+  REQUIRE(records.size() == 8);
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    CHECK(records[i].state == 12 + i);
+    CHECK(records[i].phase == hsm::TracePhase::Enter);
+  }
+  CHECK(records.front().time_ns <= records.back().time_ns);
+}
+
+TEST_CASE("Flight recorder - concurrent writers never yield torn records") {
+  hsm::FlightRecorder recorder(64);
+  std::vector<std::thread> writers;
+  for (std::uint32_t w = 1; w <= 4; ++w) {
+    writers.emplace_back([&recorder, w] {
+      for (std::uint32_t i = 0; i < 5000; ++i) {
+        recorder.record(hsm::TracePhase::Effect, w, w * 10, w * 100);
+      }
+    });
+  }
+  for (int i = 0; i < 50; ++i) {
+    for (const auto& r : recorder.snapshot()) {
+      CHECK(r.event == r.state * 10);
+      CHECK(r.transition == r.state * 100);
+    }
+  }
+  for (auto& t : writers) t.join();
+  CHECK(recorder.recorded() == 20000);
+  CHECK(recorder.snapshot().size() == 64);
+}
+
+TEST_CASE("Flight recorder - records the steps of a machine") {
+  auto model = hsm::define(
+      "Rec", hsm::initial(hsm::target("idle")),
+      hsm::state("idle", hsm::defer("later"),
+                 hsm::transition(hsm::on("go"), hsm::target("../busy"),
+                                 hsm::effect(noop()))),
+      hsm::state("busy", hsm::transition(hsm::on("later"),
+                                         hsm::target("../idle"))));
+
+  REQUIRE(model->event_trace_id("go") != 0);
+  CHECK(model->event_trace_id("unknown") == 0);
+
+  hsm::FlightRecorder recorder;
+  RecordedInstance instance;
+  hsm::start(instance, model, &recorder);
+  instance.dispatch(hsm::Event("later")).wait();
+  instance.dispatch(hsm::Event("nothing")).wait();
+  instance.dispatch(hsm::Event("go")).wait();
+  CHECK(instance.state() == "/Rec/idle");
+
+  std::vector<std::string> steps;
+  for (const auto& r : recorder.snapshot()) {
+    std::string step(hsm::trace_phase_name(r.phase));
+    if (r.state) step += " " + name_of(model, r.state);
+    if (r.event) step += " " + name_of(model, r.event);
+    steps.push_back(step);
+  }
+  const std::vector<std::string> expected = {
+      "enter /Rec/idle",
+      "defer /Rec/idle later",
+      // A deferred event is looked at again on every later dispatch
+      "defer /Rec/idle later",
+      "dispatch /Rec/idle",  // "nothing" is not an event of the model
+      "unhandled /Rec/idle",
+      "defer /Rec/idle later",
+      "dispatch /Rec/idle go",
+      "exit /Rec/idle go",
+      "effect /Rec/idle go",
+      "enter /Rec/busy go",
+      "complete /Rec/busy go",
+      // The deferred event is replayed once busy is active
+      "dispatch /Rec/busy later",
+      "exit /Rec/busy later",
+      "enter /Rec/idle later",
+      "complete /Rec/idle later",
+  };
+  CHECK(steps == expected);
+}
+
+TEST_CASE("Flight recorder - dumps round-trip and convert to Chrome trace") {
+  auto model = hsm::define(
+      "Dump", hsm::initial(hsm::target("a")),
+      hsm::state("a", hsm::transition(hsm::on("next"), hsm::target("../b"))),
+      hsm::state("b"));
+
+  hsm::FlightRecorder recorder;
+  RecordedInstance instance;
+  hsm::start(instance, model);
+  hsm::attach_flight_recorder(instance, &recorder);
+  instance.dispatch(hsm::Event("next")).wait();
+
+  const auto records = recorder.snapshot();
+  std::stringstream dump;
+  hsm::write_trace_dump(dump, model->trace_names, records);
+
+  std::vector<std::string> names;
+  std::vector<hsm::TraceRecord> loaded;
+  REQUIRE(hsm::read_trace_dump(dump, names, loaded));
+  CHECK(names == model->trace_names);
+  REQUIRE(loaded.size() == records.size());
+  CHECK(loaded.back().phase == hsm::TracePhase::Complete);
+  CHECK(loaded.back().time_ns == records.back().time_ns);
+
+  std::stringstream json;
+  hsm::write_chrome_trace(json, names, loaded);
+  const std::string text = json.str();
+  CHECK(text.rfind("{\"traceEvents\":[", 0) == 0);
+  CHECK(text.find("\"name\":\"next\",\"cat\":\"dispatch\",\"ph\":\"B\"") !=
+        std::string::npos);
+  CHECK(text.find("\"name\":\"/Dump/b\",\"cat\":\"enter\",\"ph\":\"i\"") !=
+        std::string::npos);
+  CHECK(text.find("\"cat\":\"complete\",\"ph\":\"E\"") != std::string::npos);
+
+  std::stringstream garbage("not a trace");
+  CHECK_FALSE(hsm::read_trace_dump(garbage, names, loaded));
+
+  // A corrupt name count and name length are not allocated up front
+  std::string corrupt = dump.str();
+  std::fill_n(corrupt.begin() + 12, 8, '\xff');
+  std::stringstream truncated(corrupt.substr(0, 64));
+  CHECK_FALSE(hsm::read_trace_dump(truncated, names, loaded));
+}
@@ -0,0 +1,131 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "hsm.hpp"
+
+class MeteredInstance : public hsm::Instance {};
+
+namespace {
+
+std::uint32_t id_of(const std::unique_ptr<hsm::Model>& model,
+                    const std::string& name) {
+  for (std::uint32_t i = 0; i < model->trace_names.size(); ++i) {
+    if (model->trace_names[i] == name) return i;
+  }
+  return 0;
+}
+
+std::uint32_t transition_from(const std::unique_ptr<hsm::Model>& model,
+                              const std::string& source) {
+  for (const auto& [name, element] : model->members) {
+    auto* transition = std::get_if<std::unique_ptr<hsm::Transition>>(&element);
+    if (transition && (*transition)->source == source &&
+        !(*transition)->events.empty()) {
+      return (*transition)->trace_id;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+TEST_CASE("Metrics - latency histogram buckets and quantiles") {
+  static_assert(hsm::LatencyHistogram::bucket_of(0) == 0);
+  static_assert(hsm::LatencyHistogram::bucket_of(1) == 1);
+  static_assert(hsm::LatencyHistogram::bucket_of(100) == 7);
+  static_assert(hsm::LatencyHistogram::bucket_of(~std::uint64_t{0}) ==
+                hsm::LatencyHistogram::bucket_count - 1);
+
+  hsm::LatencyHistogram h;
+  CHECK(h.quantile_ns(0.5) == 0);
+  h.buckets[hsm::LatencyHistogram::bucket_of(100)] = 99;
+  h.buckets[hsm::LatencyHistogram::bucket_of(5000)] = 1;
+  CHECK(h.count() == 100);
+  CHECK(h.quantile_ns(0.5) == 128);
+  CHECK(h.quantile_ns(1.0) == 8192);
+}
+
+TEST_CASE("Metrics - counts transitions, entries and dwell time") {
+  auto model = hsm::define(
+      "Door", hsm::initial(hsm::target("closed")),
+      hsm::state("closed",
+                 hsm::transition(hsm::on("open"), hsm::target("../opened"))),
+      hsm::state("opened", hsm::defer("lock"),
+                 hsm::transition(hsm::on("close"), hsm::target("../closed"),
+                                 hsm::effect([](hsm::Context&, hsm::Instance&,
+                                                hsm::Event&) {
+                                   std::this_thread::sleep_for(
+                                       std::chrono::milliseconds(2));
+                                 }))));
+
+  hsm::Metrics metrics(model->trace_names.size());
+  MeteredInstance instance;
+  hsm::start(instance, model);
+  hsm::attach_metrics(instance, &metrics);
+
+  instance.dispatch(hsm::Event("open")).wait();
+  instance.dispatch(hsm::Event("lock")).wait();
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  instance.dispatch(hsm::Event("knock")).wait();
+  instance.dispatch(hsm::Event("close")).wait();
+  CHECK(instance.state() == "/Door/closed");
+
+  const auto snap = metrics.snapshot();
+  CHECK(snap.transitions[transition_from(model, "/Door/closed")] == 1);
+  CHECK(snap.transitions[transition_from(model, "/Door/opened")] == 1);
+  CHECK(snap.entries[id_of(model, "/Door/opened")] == 1);
+  CHECK(snap.entries[id_of(model, "/Door/closed")] == 1);
+
+  // closed was entered before the metrics were attached
+  CHECK(snap.dwell[id_of(model, "/Door/closed")].count() == 0);
+  CHECK(snap.dwell[id_of(model, "/Door/opened")] >= std::chrono::milliseconds(5));
+
+  // lock is deferred again on every dispatch while opened, then replayed
+  // unhandled in closed
+  CHECK(snap.deferred == 3);
+  CHECK(snap.unhandled == 2);
+  CHECK(snap.dispatched == 4);
+  CHECK(snap.queue_high_water >= 1);
+  CHECK(snap.run_to_completion.count() == 4);
+  CHECK(snap.run_to_completion.quantile_ns(1.0) >= 2'000'000);
+  CHECK(snap.enqueue_to_completion.count() == 4);
+  // The deferred lock waited since its first dispatch
+  CHECK(snap.enqueue_to_completion.quantile_ns(1.0) >= 5'000'000);
+
+  hsm::attach_metrics(instance, nullptr);
+  instance.dispatch(hsm::Event("open")).wait();
+  CHECK(metrics.snapshot().dispatched == 4);
+  hsm::stop(instance).wait();
+}
+
+TEST_CASE("Metrics - instances share one Metrics across threads") {
+  auto model = hsm::define(
+      "Toggle", hsm::initial(hsm::target("a")),
+      hsm::state("a", hsm::transition(hsm::on("flip"), hsm::target("../b"))),
+      hsm::state("b", hsm::transition(hsm::on("flip"), hsm::target("../a"))));
+
+  hsm::Metrics metrics(model->trace_names.size());
+  MeteredInstance instances[4];
+  std::vector<std::thread> threads;
+  for (auto& instance : instances) {
+    hsm::start(instance, model);
+    hsm::attach_metrics(instance, &metrics);
+    threads.emplace_back([&instance] {
+      for (int i = 0; i < 500; ++i) instance.dispatch(hsm::Event("flip")).wait();
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  const auto snap = metrics.snapshot();
+  CHECK(snap.dispatched == 2000);
+  CHECK(snap.entries[id_of(model, "/Toggle/a")] +
+            snap.entries[id_of(model, "/Toggle/b")] ==
+        2000);
+  CHECK(snap.run_to_completion.count() == 2000);
+  for (auto& instance : instances) hsm::stop(instance).wait();
+}
@@ -0,0 +1,164 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "hsm.hpp"
+#include "profiler.hpp"
+
+class ProfiledInstance : public hsm::Instance {};
+
+namespace {
+
+// Burns at least the given thread CPU time
+void burn(std::uint64_t ns) {
+  const std::uint64_t start = hsm::CostClock::thread_cpu_ns();
+  while (hsm::CostClock::thread_cpu_ns() - start < ns) {
+  }
+}
+
+const hsm::BehaviorProfile* find(const std::vector<hsm::BehaviorProfile>& profiles,
+                                 const std::unique_ptr<hsm::Model>& model,
+                                 const std::string& prefix) {
+  for (const auto& p : profiles) {
+    if (model->trace_names[p.id].rfind(prefix, 0) == 0) return &p;
+  }
+  return nullptr;
+}
+
+auto pump_model() {
+  return hsm::define(
+      "Pump", hsm::initial(hsm::target("idle")),
+      hsm::state("idle",
+                 hsm::transition(hsm::on("start"), hsm::target("../running"),
+                                 hsm::guard([](hsm::Context&, hsm::Instance&,
+                                               hsm::Event&) { return true; }),
+                                 hsm::effect([](hsm::Context&, hsm::Instance&,
+                                                hsm::Event&) { burn(200000); }))),
+      hsm::state("running",
+                 hsm::entry([](hsm::Context&, hsm::Instance&, hsm::Event&) {
+                   burn(2000000);
+                 }),
+                 hsm::exit([](hsm::Context&, hsm::Instance&, hsm::Event&) {}),
+                 hsm::activity([](hsm::Context& ctx, hsm::Instance&, hsm::Event&) {
+                   burn(500000);
+                   while (!ctx.is_set()) {
+                     std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                   }
+                 }),
+                 hsm::transition(hsm::on("stop"), hsm::target("../idle"))));
+}
+
+}  // namespace
+
+TEST_CASE("Profiler - cost clock advances") {
+  const auto started = hsm::CostClock::now();
+  burn(100000);
+  const auto cost = hsm::CostClock::since(started);
+  CHECK(cost.cpu_ns >= 100000);
+  CHECK(cost.ticks > 0);
+}
+
+TEST_CASE("Profiler - times every behavior by role") {
+  auto model = pump_model();
+  hsm::Profiler profiler(model->trace_names.size());
+  ProfiledInstance pump;
+  hsm::start(pump, model);
+  hsm::attach_profiler(pump, &profiler);
+
+  pump.dispatch(hsm::Event("start")).wait();
+  pump.dispatch(hsm::Event("stop")).wait();
+  hsm::attach_profiler(pump, nullptr);
+  pump.dispatch(hsm::Event("start")).wait();
+  hsm::stop(pump).wait();
+
+  const auto profiles = profiler.snapshot();
+  REQUIRE(profiles.size() == 5);
+  for (std::size_t i = 1; i < profiles.size(); ++i) {
+    CHECK(profiles[i - 1].cpu >= profiles[i].cpu);
+  }
+
+  const auto* entry = find(profiles, model, "/Pump/running/entry_");
+  REQUIRE(entry != nullptr);
+  CHECK(entry == &profiles[0]);
+  CHECK(entry->role == hsm::BehaviorRole::Entry);
+  CHECK(entry->calls == 1);
+  CHECK(entry->cpu >= std::chrono::milliseconds(2));
+  CHECK(entry->max_cpu == entry->cpu);
+  CHECK(entry->ticks > 0);
+
+  const auto* activity = find(profiles, model, "/Pump/running/activity_");
+  REQUIRE(activity != nullptr);
+  CHECK(activity->role == hsm::BehaviorRole::Activity);
+  CHECK(activity->calls == 1);
+  CHECK(activity->cpu >= std::chrono::microseconds(500));
+
+  std::size_t guards = 0, effects = 0, exits = 0;
+  for (const auto& p : profiles) {
+    guards += p.role == hsm::BehaviorRole::Guard;
+    effects += p.role == hsm::BehaviorRole::Effect;
+    exits += p.role == hsm::BehaviorRole::Exit;
+    CHECK(p.calls == 1);  // Nothing after detaching
+  }
+  CHECK(guards == 1);
+  CHECK(effects == 1);
+  CHECK(exits == 1);
+}
+
+TEST_CASE("Profiler - report and folded stacks name model paths") {
+  auto model = pump_model();
+  hsm::Profiler profiler(model->trace_names.size());
+  ProfiledInstance pump;
+  hsm::start(pump, model);
+  hsm::attach_profiler(pump, &profiler);
+  pump.dispatch(hsm::Event("start")).wait();
+  hsm::stop(pump).wait();
+
+  const auto profiles = profiler.snapshot();
+  REQUIRE(!profiles.empty());
+
+  std::ostringstream report;
+  hsm::write_profile_report(report, model->trace_names, profiles);
+  const std::string table = report.str();
+  CHECK(table.rfind("BEHAVIOR", 0) == 0);
+  CHECK(table.find("/Pump/running/entry_") != std::string::npos);
+  CHECK(table.find(" guard ") != std::string::npos);
+  CHECK(table.find(" activity ") != std::string::npos);
+
+  std::ostringstream folded;
+  hsm::write_folded_stacks(folded, model->trace_names, profiles);
+  std::istringstream lines(folded.str());
+  std::string line;
+  std::size_t count = 0;
+  bool entry_first = false;
+  while (std::getline(lines, line)) {
+    const auto space = line.rfind(' ');
+    REQUIRE(space != std::string::npos);
+    CHECK(line.find('/') == std::string::npos);
+    CHECK(line.rfind("Pump;", 0) == 0);
+    CHECK(std::stoull(line.substr(space + 1)) ==
+          static_cast<unsigned long long>(profiles[count].cpu.count()));
+    if (count == 0) entry_first = line.rfind("Pump;running;entry_", 0) == 0;
+    ++count;
+  }
+  CHECK(count == profiles.size());
+  CHECK(entry_first);
+}
+
+TEST_CASE("Profiler - ignores ids beyond its size") {
+  hsm::Profiler profiler(2);
+  profiler.record(1, hsm::BehaviorRole::Exit, {10, 20});
+  profiler.record(1, hsm::BehaviorRole::Exit, {30, 5});
+  profiler.record(7, hsm::BehaviorRole::Entry, {10, 20});
+  const auto profiles = profiler.snapshot();
+  REQUIRE(profiles.size() == 1);
+  CHECK(profiles[0].id == 1);
+  CHECK(profiles[0].calls == 2);
+  CHECK(profiles[0].cpu == std::chrono::nanoseconds(40));
+  CHECK(profiles[0].max_cpu == std::chrono::nanoseconds(30));
+  CHECK(profiles[0].ticks == 25);
+}
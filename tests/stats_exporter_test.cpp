@@ -0,0 +1,176 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hsm.hpp"
+#include "stats_exporter.hpp"
+
+class StatsInstance : public hsm::Instance {};
+
+namespace {
+
+std::string segment_name(const char* test) {
+  return "/hsm_stats_test_" + std::to_string(getpid()) + "_" + test;
+}
+
+std::chrono::milliseconds timer_duration(hsm::Context&, StatsInstance&,
+                                         hsm::Event&) {
+  return std::chrono::milliseconds(30);
+}
+
+}  // namespace
+
+TEST_CASE("Stats exporter - publishes instance records") {
+  auto model = hsm::define(
+      "Door", hsm::initial(hsm::target("closed")),
+      hsm::state("closed",
+                 hsm::transition(hsm::on("open"), hsm::target("../opened"))),
+      hsm::state("opened", hsm::defer("lock"),
+                 hsm::activity([](hsm::Context& ctx, hsm::Instance&, hsm::Event&) {
+                   while (!ctx.is_set()) {
+                     std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                   }
+                 }),
+                 hsm::transition(hsm::on("close"), hsm::target("../closed"))));
+
+  hsm::StatsExporter exporter(segment_name("records"), 4);
+  REQUIRE(exporter);
+  StatsInstance front, back;
+  hsm::start(front, model);
+  hsm::start(back, model);
+  CHECK(hsm::attach_stats(front, &exporter, "front"));
+  CHECK(hsm::attach_stats(back, &exporter, "back"));
+
+  hsm::StatsReader reader(exporter.name());
+  REQUIRE(reader);
+  CHECK(reader.slot_count() == 4);
+
+  front.dispatch(hsm::Event("open")).wait();
+  front.dispatch(hsm::Event("lock")).wait();
+  front.dispatch(hsm::Event("knock")).wait();
+
+  auto records = reader.snapshot();
+  REQUIRE(records.size() == 2);
+  const auto& record = records[0];
+  CHECK(hsm::stats_name(record.model) == "Door");
+  CHECK(hsm::stats_name(record.instance) == "front");
+  CHECK(hsm::stats_name(record.state) == "/Door/opened");
+  CHECK(model->trace_names[record.state_id] == "/Door/opened");
+  CHECK(record.dispatched == 2);
+  CHECK(record.deferred == 2);
+  CHECK(record.unhandled == 1);
+  CHECK(record.queue_depth == 1);  // lock waits deferred
+  CHECK(record.activities == 1);
+  CHECK(record.timers == 0);
+  CHECK(record.updated_ns != 0);
+  CHECK(hsm::stats_name(records[1].state) == "/Door/closed");
+  CHECK(records[1].dispatched == 0);
+
+  const auto models = hsm::aggregate_by_model(records);
+  REQUIRE(models.size() == 1);
+  CHECK(models[0].model == "Door");
+  CHECK(models[0].instances == 2);
+  CHECK(models[0].dispatched == 2);
+  CHECK(models[0].activities == 1);
+
+  front.dispatch(hsm::Event("close")).wait();
+  hsm::StatsRecord closed;
+  REQUIRE(reader.read(0, closed));
+  CHECK(hsm::stats_name(closed.state) == "/Door/closed");
+  CHECK(closed.activities == 0);
+
+  // Detaching and stopping give the slots back
+  CHECK(hsm::attach_stats(back, nullptr));
+  CHECK(reader.snapshot().size() == 1);
+  hsm::stop(front).wait();
+  CHECK(reader.snapshot().empty());
+  hsm::stop(back).wait();
+}
+
+TEST_CASE("Stats exporter - counts timers and runs out of slots") {
+  auto model = hsm::define(
+      "Timed", hsm::initial(hsm::target("waiting")),
+      hsm::state("waiting",
+                 hsm::transition(
+                     hsm::after<std::chrono::milliseconds, StatsInstance>(
+                         timer_duration),
+                     hsm::target("../done"))),
+      hsm::state("done"));
+
+  hsm::StatsExporter exporter(segment_name("timers"), 1);
+  REQUIRE(exporter);
+  hsm::StatsReader reader(exporter.name());
+  StatsInstance instance, extra;
+  hsm::start(instance, model);
+  hsm::start(extra, model);
+  REQUIRE(hsm::attach_stats(instance, &exporter, "timed"));
+  CHECK_FALSE(hsm::attach_stats(extra, &exporter, "extra"));
+
+  hsm::StatsRecord record;
+  REQUIRE(reader.read(0, record));
+  CHECK(hsm::stats_name(record.state) == "/Timed/waiting");
+  CHECK(record.activities == 1);
+  CHECK(record.timers == 1);
+
+  for (int i = 0; i < 100 && instance.state() != "/Timed/done"; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  REQUIRE(reader.read(0, record));
+  CHECK(hsm::stats_name(record.state) == "/Timed/done");
+  CHECK(record.timers == 0);
+  hsm::stop(instance).wait();
+  hsm::stop(extra).wait();
+}
+
+TEST_CASE("Stats exporter - readers never see torn records") {
+  auto model = hsm::define(
+      "Toggle", hsm::initial(hsm::target("a")),
+      hsm::state("a", hsm::transition(hsm::on("flip"), hsm::target("../b"))),
+      hsm::state("b", hsm::transition(hsm::on("flip"), hsm::target("../a"))));
+
+  hsm::StatsExporter exporter(segment_name("torn"), 1);
+  REQUIRE(exporter);
+  StatsInstance instance;
+  hsm::start(instance, model);
+  REQUIRE(hsm::attach_stats(instance, &exporter, "toggle"));
+
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (int i = 0; i < 20000; ++i) instance.dispatch(hsm::Event("flip")).wait();
+    done = true;
+  });
+
+  hsm::StatsReader reader(exporter.name());
+  std::size_t reads = 0, torn = 0;
+  std::uint64_t last = 0;
+  hsm::StatsRecord record;
+  while (!done) {
+    if (!reader.read(0, record)) continue;
+    ++reads;
+    // The state name, its id and the dispatch count are published together
+    const auto state = hsm::stats_name(record.state);
+    const bool in_b = record.dispatched % 2 == 1;
+    if (model->trace_names[record.state_id] != state ||
+        state != (in_b ? "/Toggle/b" : "/Toggle/a") || record.dispatched < last) {
+      ++torn;
+    }
+    last = record.dispatched;
+  }
+  writer.join();
+  CHECK(reads > 0);
+  CHECK(torn == 0);
+  hsm::stop(instance).wait();
+}
+
+TEST_CASE("Stats exporter - reader rejects missing segments") {
+  hsm::StatsReader reader(segment_name("missing"));
+  CHECK_FALSE(reader);
+  CHECK(reader.snapshot().empty());
+}
@@ -0,0 +1,197 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#define HSM_USDT 1
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cthsm/cthsm.hpp"
+#include "hsm.hpp"
+
+#if defined(__linux__) && HSM_USDT_PLACED
+#include <elf.h>
+#endif
+
+namespace {
+
+struct Note {
+  std::string args;
+  std::uint64_t semaphore;
+};
+
+// "provider:name" -> argument specs and semaphore of every probe in the test
+// binary
+std::multimap<std::string, Note> read_probes() {
+  std::multimap<std::string, Note> probes;
+#if defined(__linux__) && HSM_USDT_PLACED
+  std::ifstream in("/proc/self/exe", std::ios::binary);
+  const std::vector<char> image{std::istreambuf_iterator<char>(in),
+                                std::istreambuf_iterator<char>()};
+  if (image.size() < sizeof(Elf64_Ehdr)) return probes;
+  Elf64_Ehdr header;
+  std::memcpy(&header, image.data(), sizeof(header));
+  std::vector<Elf64_Shdr> sections(header.e_shnum);
+  std::memcpy(sections.data(), image.data() + header.e_shoff,
+              sections.size() * sizeof(Elf64_Shdr));
+  const char* names = image.data() + sections[header.e_shstrndx].sh_offset;
+  for (const auto& section : sections) {
+    if (std::strcmp(names + section.sh_name, ".note.stapsdt") != 0) continue;
+    std::size_t at = section.sh_offset;
+    const std::size_t end = at + section.sh_size;
+    while (at + sizeof(Elf64_Nhdr) <= end) {
+      Elf64_Nhdr note;
+      std::memcpy(&note, image.data() + at, sizeof(note));
+      const char* name = image.data() + at + sizeof(note);
+      const char* desc = name + ((note.n_namesz + 3) & ~3U);
+      if (note.n_type == 3 && std::strcmp(name, "stapsdt") == 0) {
+        // pc, base, semaphore, then the strings
+        const char* provider = desc + 3 * sizeof(std::uint64_t);
+        const char* probe = provider + std::strlen(provider) + 1;
+        const char* args = probe + std::strlen(probe) + 1;
+        std::uint64_t semaphore;
+        std::memcpy(&semaphore, desc + 2 * sizeof(std::uint64_t), sizeof(semaphore));
+        probes.emplace(std::string(provider) + ":" + probe, Note{args, semaphore});
+      }
+      at = static_cast<std::size_t>(desc - image.data()) + ((note.n_descsz + 3) & ~3U);
+    }
+  }
+#endif
+  return probes;
+}
+
+std::size_t arg_count(const std::string& args) {
+  std::size_t n = 0;
+  for (std::size_t at = args.find('@'); at != std::string::npos; at = args.find('@', at + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+int evaluations = 0;
+
+int counted_argument() { return ++evaluations; }
+
+struct Pump : hsm::Instance {};
+
+std::chrono::milliseconds pump_timeout(hsm::Context&, Pump&, hsm::Event&) {
+  return std::chrono::milliseconds(5);
+}
+
+struct Valve : cthsm::Instance {
+  bool open_allowed{true};
+};
+
+constexpr auto valve_model = cthsm::define(
+    "valve", cthsm::initial(cthsm::target("closed")),
+    cthsm::state("closed", cthsm::defer("flush"),
+                 cthsm::transition(cthsm::on("open"), cthsm::target("/valve/opened"),
+                                   cthsm::guard([](Valve& v) { return v.open_allowed; }))),
+    cthsm::state("opened", cthsm::activity([](Valve&) {}),
+                 cthsm::transition(cthsm::after([] { return std::chrono::milliseconds(1); }),
+                                   cthsm::target("/valve/closed"))));
+
+}  // namespace
+
+TEST_CASE("USDT - probes are placed with their arguments") {
+  if (!hsm::usdt::enabled) {
+    MESSAGE("no USDT support on this target");
+    return;
+  }
+  const auto probes = read_probes();
+  const std::map<std::string, std::size_t> expected = {
+      {"hsm:enqueue", 3},          {"hsm:dequeue", 3},
+      {"hsm:guard", 3},            {"hsm:transition_start", 3},
+      {"hsm:transition_end", 3},   {"hsm:enter", 2},
+      {"hsm:exit", 2},             {"hsm:defer", 3},
+      {"hsm:timer_arm", 3},        {"hsm:timer_fire", 2},
+      {"hsm:activity_start", 2},   {"hsm:activity_stop", 2},
+      {"cthsm:dispatch", 3},       {"cthsm:complete", 3},
+      {"cthsm:defer", 3},          {"cthsm:dequeue", 3},
+      {"cthsm:guard", 3},          {"cthsm:transition_start", 3},
+      {"cthsm:transition_end", 3}, {"cthsm:enter", 2},
+      {"cthsm:exit", 2},           {"cthsm:timer_arm", 2},
+      {"cthsm:timer_fire", 2},     {"cthsm:activity_start", 2},
+      {"cthsm:activity_stop", 2},
+  };
+  for (const auto& [probe, args] : expected) {
+    INFO(probe);
+    const auto [first, last] = probes.equal_range(probe);
+    REQUIRE(first != last);
+    for (auto it = first; it != last; ++it) {
+      CHECK(arg_count(it->second.args) == args);
+      CHECK(it->second.semaphore != 0);
+    }
+  }
+}
+
+TEST_CASE("USDT - probe arguments are only evaluated while a tracer is attached") {
+  HSM_PROBE2(hsm, enter, &evaluations, counted_argument());
+  CHECK(evaluations == 0);
+#if HSM_USDT_PLACED
+  // What a tracer does when it attaches, and again when it detaches
+  hsm_enter_semaphore = 1;
+  CHECK(HSM_PROBE_ENABLED(hsm, enter));
+  HSM_PROBE2(hsm, enter, &evaluations, counted_argument());
+  CHECK(evaluations == 1);
+  hsm_enter_semaphore = 0;
+  HSM_PROBE2(hsm, enter, &evaluations, counted_argument());
+  CHECK(evaluations == 1);
+#endif
+}
+
+TEST_CASE("USDT - hsm machines behave the same with probes") {
+  auto model = hsm::define(
+      "Pump", hsm::initial(hsm::target("idle")),
+      hsm::state("idle", hsm::defer("flush"),
+                 hsm::transition(hsm::on("start"), hsm::target("../running"),
+                                 hsm::guard([](hsm::Context&, hsm::Instance&,
+                                               hsm::Event&) { return true; }))),
+      hsm::state("running",
+                 hsm::activity([](hsm::Context&, hsm::Instance&, hsm::Event&) {}),
+                 hsm::transition(
+                     hsm::after<std::chrono::milliseconds, Pump>(pump_timeout),
+                     hsm::target("../idle"))));
+
+  Pump pump;
+  hsm::start(pump, model);
+  pump.dispatch(hsm::Event("flush")).wait();
+  pump.dispatch(hsm::Event("start")).wait();
+  CHECK(pump.state() == "/Pump/running");
+  for (int i = 0; i < 100 && pump.state() != "/Pump/idle"; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  CHECK(pump.state() == "/Pump/idle");
+  hsm::stop(pump).wait();
+}
+
+TEST_CASE("USDT - cthsm machines behave the same with probes") {
+  cthsm::ManualClock::reset();
+  cthsm::compile<valve_model, Valve, cthsm::SequentialTaskProvider, cthsm::ManualClock,
+                 cthsm::Context, 16, cthsm::table_layout::dense, cthsm::dispatch_mode::table,
+                 cthsm::TimerService<>>
+      valve;
+  Valve v;
+  valve.start(v);
+  valve.dispatch(v, cthsm::EventBase{"flush"});
+  valve.dispatch(v, cthsm::EventBase{"open"});
+  CHECK(valve.state() == "/valve/opened");
+  cthsm::ManualClock::advance(std::chrono::milliseconds(2));
+  CHECK(valve.poll_timers(v) == 1);
+  CHECK(valve.state() == "/valve/closed");
+
+  cthsm::compile<valve_model, Valve, cthsm::SequentialTaskProvider, cthsm::Clock,
+                 cthsm::Context, 16, cthsm::table_layout::dense, cthsm::dispatch_mode::inlined>
+      inlined;
+  Valve w;
+  w.open_allowed = false;
+  inlined.start(w);
+  inlined.dispatch(w, cthsm::EventBase{"open"});
+  CHECK(inlined.state() == "/valve/closed");
+}
@@ -0,0 +1,125 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hsm.hpp"
+#include "watchdog.hpp"
+
+class WatchedInstance : public hsm::Instance {};
+
+namespace {
+
+struct Overruns {
+  std::mutex mutex;
+  std::vector<hsm::StepOverrun> seen;
+
+  hsm::Watchdog::Handler handler() {
+    return [this](const hsm::StepOverrun& overrun) {
+      std::lock_guard lock(mutex);
+      seen.push_back(overrun);
+    };
+  }
+
+  std::vector<hsm::StepOverrun> get() {
+    std::lock_guard lock(mutex);
+    return seen;
+  }
+};
+
+auto valve_model(std::chrono::milliseconds slow) {
+  return hsm::define(
+      "Valve", hsm::initial(hsm::target("closed")),
+      hsm::state("closed",
+                 hsm::transition(hsm::on("open"), hsm::target("../opened")),
+                 hsm::transition(hsm::on("tap"))),
+      hsm::state("opened",
+                 hsm::entry([slow](hsm::Context&, hsm::Instance&, hsm::Event&) {
+                   std::this_thread::sleep_for(slow);
+                 }),
+                 hsm::transition(hsm::on("close"), hsm::target("../closed"))));
+}
+
+}  // namespace
+
+TEST_CASE("Watchdog - budgets come from the nearest listed state") {
+  using std::chrono::milliseconds;
+  const hsm::StepBudget budget{milliseconds(2),
+                               {{"/M/a", milliseconds(5)}, {"/M/a/b", milliseconds(7)}}};
+  CHECK(budget.of("/M") == milliseconds(2));
+  CHECK(budget.of("/M/a") == milliseconds(5));
+  CHECK(budget.of("/M/a/c") == milliseconds(5));
+  CHECK(budget.of("/M/a/b/d") == milliseconds(7));
+  CHECK(budget.of("/M/ab") == milliseconds(2));
+}
+
+TEST_CASE("Watchdog - finished steps over budget are reported and counted") {
+  Overruns overruns;
+  hsm::Watchdog watchdog(2, std::chrono::milliseconds(0), overruns.handler());
+  auto model = valve_model(std::chrono::milliseconds(20));
+  WatchedInstance valve;
+  hsm::start(valve, model);
+  REQUIRE(hsm::attach_watchdog(valve, &watchdog, {std::chrono::milliseconds(5), {}}, "valve-1"));
+
+  valve.dispatch(hsm::Event("tap")).wait();
+  CHECK(watchdog.overruns() == 0);
+  valve.dispatch(hsm::Event("open")).wait();
+  CHECK(watchdog.overruns() == 1);
+
+  const auto seen = overruns.get();
+  REQUIRE(seen.size() == 1);
+  CHECK(seen[0].instance == "valve-1");
+  CHECK(seen[0].state == "/Valve/closed");
+  CHECK(seen[0].event == "open");
+  CHECK(seen[0].behavior.rfind("/Valve/opened/entry_", 0) == 0);
+  CHECK(seen[0].finished);
+  CHECK(seen[0].budget == std::chrono::milliseconds(5));
+  CHECK(seen[0].elapsed >= std::chrono::milliseconds(20));
+
+  // A larger budget for the state the step starts in
+  valve.dispatch(hsm::Event("close")).wait();
+  REQUIRE(hsm::attach_watchdog(
+      valve, &watchdog,
+      {std::chrono::milliseconds(5), {{"/Valve/closed", std::chrono::seconds(10)}}}, "valve-1"));
+  valve.dispatch(hsm::Event("open")).wait();
+  CHECK(watchdog.overruns() == 1);
+  hsm::stop(valve).wait();
+}
+
+TEST_CASE("Watchdog - the thread catches steps still running") {
+  Overruns overruns;
+  hsm::Watchdog watchdog(1, std::chrono::milliseconds(2), overruns.handler());
+  auto model = valve_model(std::chrono::milliseconds(60));
+  WatchedInstance valve;
+  hsm::start(valve, model);
+  REQUIRE(hsm::attach_watchdog(valve, &watchdog, {std::chrono::milliseconds(10), {}}, "slow"));
+
+  valve.dispatch(hsm::Event("open")).wait();
+  const auto seen = overruns.get();
+  REQUIRE(seen.size() == 2);
+  CHECK_FALSE(seen[0].finished);
+  CHECK(seen[0].behavior.rfind("/Valve/opened/entry_", 0) == 0);
+  CHECK(seen[0].elapsed < seen[1].elapsed);
+  CHECK(seen[1].finished);
+  CHECK(watchdog.overruns() == 1);
+  hsm::stop(valve).wait();
+}
+
+TEST_CASE("Watchdog - slots are given back on detach and stop") {
+  hsm::Watchdog watchdog(1, std::chrono::milliseconds(0));
+  auto model = valve_model(std::chrono::milliseconds(0));
+  WatchedInstance first, second;
+  hsm::start(first, model);
+  hsm::start(second, model);
+  REQUIRE(hsm::attach_watchdog(first, &watchdog, {std::chrono::milliseconds(1), {}}));
+  CHECK_FALSE(hsm::attach_watchdog(second, &watchdog, {std::chrono::milliseconds(1), {}}));
+  CHECK(hsm::attach_watchdog(first, nullptr));
+  CHECK(hsm::attach_watchdog(second, &watchdog, {std::chrono::milliseconds(1), {}}));
+  hsm::stop(second).wait();
+  CHECK(hsm::attach_watchdog(first, &watchdog, {std::chrono::milliseconds(1), {}}));
+  hsm::stop(first).wait();
+}